@@ -106,11 +106,11 @@ int getFastestRecordOnBlob() {
  *		  FILE	*fp
  *		  int	localRecord
  *		  char	*nickname
- * Outputs	: int 	status
+ * Outputs	: int 	status (0 if the server was reached, -1 otherwise)
  *
- * Retrieve the server's current fastest roadmap length.
+ * Upload the roadmap in fp to the server.
  -------------------------------------------------------------------*/
-void handle_post(char* url, FILE *fp, int localRecord, char *nickname) {
+int handle_post(char* url, FILE *fp, int localRecord, char *nickname) {
 	struct memory wt;
 	struct memory rt;
 	rt.data = NULL;
@@ -129,6 +129,7 @@ void handle_post(char* url, FILE *fp, int localRecord, char *nickname) {
 	fclose(fp);
 	sprintf(wt.data + fsize + bytes_written, "\"}");
 
+	int status = -1;
 	CURL *curl = curl_easy_init();
 	if (curl) {
 		cJSON *json = cJSON_Parse(wt.data);
@@ -144,35 +145,52 @@ void handle_post(char* url, FILE *fp, int localRecord, char *nickname) {
 		curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
 		curl_easy_setopt(curl, CURLOPT_WRITEDATA, &rt);
 		curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_data);
-		curl_easy_perform(curl);
+		// Only a 2xx reply means the roadmap was taken. Anything else (e.g. 429 or 5xx) is
+		// treated as the server being unreachable, so the spool keeps it and tries again.
+		long responseCode = 0;
+		if (curl_easy_perform(curl) == CURLE_OK
+			&& curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &responseCode) == CURLE_OK
+			&& responseCode >= 200 && responseCode < 300) {
+			status = 0;
+		}
+		else if (responseCode != 0) {
+			char message[100];
+			sprintf(message, "The server replied with HTTP status %ld. Will submit again later.", responseCode);
+			recipeLog(1, "Server", "Upload", "Error", message);
+		}
 		curl_slist_free_all(headers);
 		free(json_str);
 		
 		curl_easy_cleanup(curl);
 	}
-	curl_global_cleanup();
 	free(wt.data);
 
 	// Log the body of the return of the POST request
-	recipeLog(1, "Server", "Upload", "Response", rt.data);
+	if (status == 0) {
+		recipeLog(1, "Server", "Upload", "Response", rt.data);
+	}
 	free(rt.data);
+	return status;
 }
 
 
 /*-------------------------------------------------------------------
  * Function 	: testRecord
  * Inputs	: int localRecord
- * Outputs	: -1 - error locating the text file
- *		  0  - successful submission to the server
+ * Outputs	: TEST_RECORD_SUBMITTED - successful submission to the server
+ *		  TEST_RECORD_MISSING_FILE - error locating the text file
+ *		  TEST_RECORD_INVALID - the record itself is nonsense
+ *		  TEST_RECORD_SERVER_UNREACHABLE - could not reach the server
  *
- * Retrieve the server's current fastest roadmap length.
+ * Submit results/<localRecord>.txt to the server.
+ * This blocks on the network, so search threads should go through
+ * spoolSubmission instead of calling this directly.
  -------------------------------------------------------------------*/
 int testRecord(int localRecord) {
 	if (localRecord < 0) {
 		printf("Record submitted is invalid (less then 0). Likely due to corruption of the PB.txt file or unexpected error. Not submitting\n");
-		return -2;
+		return TEST_RECORD_INVALID;
 	}
-	int remoteRecord = getFastestRecordOnBlob();
 	char filename[32];
 	char *folder = "results/";
 	char *extension = ".txt";
@@ -181,16 +199,18 @@ int testRecord(int localRecord) {
 	FILE *fp = fopen(filename, "rb");
 	if (fp == NULL) {
 		printf("Error could not locate file: %s. Please submit an issue on github including your OS version.\n", filename);
-		return -1;
+		return TEST_RECORD_MISSING_FILE;
 	}
 
 	const char* username = getConfigStr("Username");
 	char nickname[20];
 	strncpy(nickname, username, 19);
 	nickname[19] = '\0';
-	handle_post("https://hundorecipes.azurewebsites.net/api/uploadAndVerify", fp, localRecord, nickname);
+	if (handle_post("https://hundorecipes.azurewebsites.net/api/uploadAndVerify", fp, localRecord, nickname) != 0) {
+		return TEST_RECORD_SERVER_UNREACHABLE;
+	}
 	
-	return 0;
+	return TEST_RECORD_SUBMITTED;
 }
 
 /*-------------------------------------------------------------------
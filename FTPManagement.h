@@ -1,8 +1,14 @@
 #include <stdio.h>
 #include "absl/base/port.h"
 
+// testRecord results
+#define TEST_RECORD_SUBMITTED 0
+#define TEST_RECORD_MISSING_FILE -1
+#define TEST_RECORD_INVALID -2
+#define TEST_RECORD_SERVER_UNREACHABLE -3
+
 ABSL_MUST_USE_RESULT_INCLUSIVE char *handle_get(char* url);
-void handle_post(char* url, FILE *fp, int localRecord, char *nickname);
+int handle_post(char* url, FILE *fp, int localRecord, char *nickname);
 int getFastestRecordOnBlob();
 int testRecord(int localRecord);
 int checkForUpdates(const char *local_ver);
@@ -0,0 +1,119 @@
+#include "atomic_file.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "base.h"
+#if _CIPES_IS_WINDOWS
+#include <windows.h>
+#include <io.h>
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+static unsigned long tmpFileCounter = 0;
+
+static unsigned long currentProcessId() {
+#if _CIPES_IS_WINDOWS
+	return (unsigned long)_getpid();
+#else
+	return (unsigned long)getpid();
+#endif
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: atomicFileOpen
+ * Inputs	: struct AtomicFile	*file
+ *		  const char		*finalPath
+ * Outputs	: bool			success
+ *
+ * Open a uniquely named temporary file next to finalPath for writing.
+ * The temporary file is in the same directory so the later rename
+ * never has to cross file systems.
+ -------------------------------------------------------------------*/
+bool atomicFileOpen(struct AtomicFile *file, const char *finalPath) {
+	file->fp = NULL;
+	unsigned long counter;
+	#pragma omp atomic capture
+	counter = ++tmpFileCounter;
+
+	int finalLength = snprintf(file->finalPath, ATOMIC_FILE_MAX_PATH, "%s", finalPath);
+	int tmpLength = snprintf(file->tmpPath, ATOMIC_FILE_MAX_PATH, "%s.%lu.%lu.tmp", finalPath, currentProcessId(), counter);
+	if (finalLength < 0 || finalLength >= ATOMIC_FILE_MAX_PATH || tmpLength < 0 || tmpLength >= ATOMIC_FILE_MAX_PATH) {
+		return false;
+	}
+
+	file->fp = fopen(file->tmpPath, "wb");
+	return file->fp != NULL;
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: atomicFileCommit
+ * Inputs	: struct AtomicFile	*file
+ * Outputs	: bool			success
+ *
+ * Make sure the temporary file actually reached the disk, then rename
+ * it over the final path. A crash at any point before the rename leaves
+ * the previous version of the final path intact.
+ -------------------------------------------------------------------*/
+bool atomicFileCommit(struct AtomicFile *file) {
+	if (file->fp == NULL) {
+		return false;
+	}
+	bool ok = fflush(file->fp) == 0;
+#if _CIPES_IS_WINDOWS
+	ok = ok && _commit(_fileno(file->fp)) == 0;
+#else
+	ok = ok && fsync(fileno(file->fp)) == 0;
+#endif
+	ok = (fclose(file->fp) == 0) && ok;
+	file->fp = NULL;
+
+	if (ok) {
+#if _CIPES_IS_WINDOWS
+		// Plain rename() refuses to replace an existing file on Windows.
+		ok = MoveFileExA(file->tmpPath, file->finalPath, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+		ok = rename(file->tmpPath, file->finalPath) == 0;
+#endif
+	}
+	if (!ok) {
+		remove(file->tmpPath);
+	}
+	return ok;
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: atomicFileAbort
+ * Inputs	: struct AtomicFile	*file
+ *
+ * Close and delete the temporary file without touching the final path.
+ -------------------------------------------------------------------*/
+void atomicFileAbort(struct AtomicFile *file) {
+	if (file->fp != NULL) {
+		fclose(file->fp);
+		file->fp = NULL;
+	}
+	remove(file->tmpPath);
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: atomicWriteString
+ * Inputs	: const char	*finalPath
+ *		  const char	*contents
+ * Outputs	: bool		success
+ *
+ * Atomically replace finalPath with a file containing exactly contents.
+ -------------------------------------------------------------------*/
+bool atomicWriteString(const char *finalPath, const char *contents) {
+	struct AtomicFile file;
+	if (!atomicFileOpen(&file, finalPath)) {
+		return false;
+	}
+	if (fputs(contents, file.fp) == EOF) {
+		atomicFileAbort(&file);
+		return false;
+	}
+	return atomicFileCommit(&file);
+}
@@ -0,0 +1,31 @@
+#ifndef CIPES_ATOMIC_FILE_H
+#define CIPES_ATOMIC_FILE_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Enough room for any path under results/ plus the temporary suffix.
+#define ATOMIC_FILE_MAX_PATH 256
+
+// A file being written to a temporary location, that only becomes visible at its
+// final path once atomicFileCommit succeeds.
+// Readers of the final path will see either the old complete file or the new complete file, never a partial one.
+struct AtomicFile {
+	FILE *fp;
+	char tmpPath[ATOMIC_FILE_MAX_PATH];
+	char finalPath[ATOMIC_FILE_MAX_PATH];
+};
+
+// Returns false (and leaves file->fp NULL) if the temporary file could not be created.
+bool atomicFileOpen(struct AtomicFile *file, const char *finalPath);
+// Flushes, closes, and renames the temporary file over the final path.
+// On failure, the temporary file is removed and the final path is left untouched.
+bool atomicFileCommit(struct AtomicFile *file);
+// Throws away everything written so far.
+void atomicFileAbort(struct AtomicFile *file);
+
+// Convenience for the common "whole file is one small string" case.
+bool atomicWriteString(const char *finalPath, const char *contents);
+
+#endif
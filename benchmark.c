@@ -0,0 +1,129 @@
+#include "benchmark.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+#include "base.h"
+#include "calculator.h"
+#include "config.h"
+#include "logger.h"
+#include "roadmap_optimizer.h"
+#include "search_stats.h"
+#include "start.h"
+#include "thread_affinity.h"
+#include "thread_local_random.h"
+
+#define BENCHMARK_DEFAULT_DIVES_PER_THREAD 20
+#define BENCHMARK_DEFAULT_THREADS 1
+#define BENCHMARK_DEFAULT_SEED 1
+// The search prunes and optimizes relative to the local record, so the workload depends heavily on it.
+// At 4500 or below, the default run never finishes a roadmap close enough to optimize. At this record
+// it runs optimizeRoadmap a few hundred thousand times and finds a few new records (each extending its
+// dive by millions of iterations), so the optimizer and the record path are measured along with the search.
+#define BENCHMARK_DEFAULT_LOCAL_RECORD 4600
+
+// The defaults from config.txt, minus anything that would make runs differ between hosts.
+#define BENCHMARK_CONFIG \
+	"select = 1;\n" \
+	"randomise = 0;\n" \
+	"debug = 0;\n" \
+	"logLevel = 0;\n" \
+	"branchLogInterval = 100;\n" \
+	"Username = \"benchmark\";\n" \
+	"Version = \"benchmark\";\n"
+
+struct BenchmarkThreadResult {
+	struct SearchStats stats;
+	double wallTimeSecs;
+};
+
+static void printStatsJson(const struct SearchStats *stats, double wallTimeSecs) {
+	printf("\"dives\": %ld, \"nodesExpanded\": %ld, \"nodesPerSec\": %.1f, \"legalMovesGenerated\": %ld, \"stateOKCalls\": %ld, \"stateOKRejections\": %ld, "
+		"\"optimizeRoadmapCalls\": %ld, \"recordsFound\": %ld, \"allocations\": %ld, \"wallTimeSecs\": %.6f",
+		stats->dives, stats->nodesExpanded, wallTimeSecs > 0 ? stats->nodesExpanded / wallTimeSecs : 0.0,
+		stats->legalMovesGenerated, stats->stateOKCalls, stats->stateOKRejections,
+		stats->optimizeRoadmapCalls, stats->recordsFound, stats->allocations, wallTimeSecs);
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: benchmarkMain
+ * Inputs	: int	argc
+ *		  char	**argv
+ * Outputs	: int	exit code
+ *
+ * Every thread draws from stream threadID of seed, and the local record
+ * always starts at the same value, so a single threaded run is fully
+ * reproducible.
+ * With several threads, the shared record still couples the threads,
+ * so node counts may vary slightly from run to run.
+ -------------------------------------------------------------------*/
+int benchmarkMain(int argc, char **argv) {
+	const long divesPerThread = argc >= 3 ? atol(argv[2]) : BENCHMARK_DEFAULT_DIVES_PER_THREAD;
+	const int threads = argc >= 4 ? atoi(argv[3]) : BENCHMARK_DEFAULT_THREADS;
+	const int seed = argc >= 5 ? atoi(argv[4]) : BENCHMARK_DEFAULT_SEED;
+	const int localRecord = argc >= 6 ? atoi(argv[5]) : BENCHMARK_DEFAULT_LOCAL_RECORD;
+	const int softMinTemperature = argc >= 7 ? atoi(argv[6]) : 0;
+	const char *threadAffinity = argc >= 8 ? argv[7] : "";
+	if (divesPerThread <= 0 || threads <= 0 || localRecord <= 0 || softMinTemperature < 0) {
+		printf("Usage: %s --bench [dives per thread] [threads] [seed] [local record] [softmin temperature] [thread affinity]\n", argv[0]);
+		return 1;
+	}
+
+	initConfigFromString(BENCHMARK_CONFIG);
+	init_level_cfg();
+	setBenchmarkMode(true);
+	setLocalRecord(localRecord);
+	initializeInvFrames();
+	initializeRecipeList();
+	initializeSoftMin(softMinTemperature);
+
+	initSearchStats(threads);
+	if (threadAffinity[0] != '\0' && !initThreadAffinity(threadAffinity, threads)) {
+		printf("Thread affinity \"%s\" can't be used here. It must be \"compact\", \"scatter\", or a list of usable CPUs like \"0,2,8-11\".\n", threadAffinity);
+		return 1;
+	}
+	// The optimizer thread is never started, so roadmaps are optimized inline and runs stay reproducible
+	initRoadmapOptimizer(threads);
+	struct BenchmarkThreadResult *results = calloc(threads, sizeof(struct BenchmarkThreadResult));
+	checkMallocFailed(results);
+
+	threadlocal_set_master_seed(seed);
+	const double startTime = omp_get_wtime();
+	#pragma omp parallel num_threads(threads)
+	{
+		const int rawID = omp_get_thread_num();
+		pinThreadToPlannedCpu(rawID);
+		threadlocal_srand_stream(rawID);
+		bindSearchStatsSlot(rawID);
+		struct SearchContext ctx;
+		initSearchContext(&ctx, rawID);
+
+		const double threadStartTime = omp_get_wtime();
+		while (ctx.stats->stats.dives < divesPerThread) {
+			calculateOrder(&ctx, divesPerThread - ctx.stats->stats.dives);
+		}
+		results[rawID].wallTimeSecs = omp_get_wtime() - threadStartTime;
+		readSearchStats(rawID, &results[rawID].stats);
+		threadlocal_rand_destroy();
+	}
+	const double wallTimeSecs = omp_get_wtime() - startTime;
+
+	struct SearchStats total;
+	readTotalSearchStats(&total);
+
+	printf("{\"seed\": %d, \"threads\": %d, \"divesPerThread\": %ld, \"startingRecord\": %d, \"bestFrames\": %d, ", seed, threads, divesPerThread, localRecord, getLocalRecord());
+	printStatsJson(&total, wallTimeSecs);
+	printf(", \"perThread\": [");
+	for (int i = 0; i < threads; ++i) {
+		printf(i == 0 ? "{" : ", {");
+		printStatsJson(&results[i].stats, results[i].wallTimeSecs);
+		printf(", \"cpu\": %d, \"numaNode\": %d}", getThreadCpu(i), getThreadNumaNode(i));
+	}
+	printf("]}\n");
+
+	free(results);
+	freeThreadAffinity();
+	freeRoadmapOptimizer();
+	freeSearchStats();
+	return 0;
+}
@@ -0,0 +1,9 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+// recipesAtHome --bench [dives per thread] [threads] [seed] [local record]
+// Run a fixed, reproducible search workload without config.txt, network access or file output,
+// and print throughput statistics as JSON on stdout.
+int benchmarkMain(int argc, char **argv);
+
+#endif
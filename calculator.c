@@ -14,23 +14,25 @@
 #include "base.h"
 #include "calculator.h"
 #include "FTPManagement.h"
+#include "submission_spool.h"
+#include "roadmap_binary.h"
+#include "atomic_file.h"
+#include "checkpoint.h"
+#include "cluster_client.h"
+#include "elite_pool.h"
+#include "path_replay.h"
+#include "local_search.h"
+#include "roadmap_optimizer.h"
+#include "search_stats.h"
+#include "shared_record.h"
 #include "recipes.h"
 #include "start.h"
 #include "shutdown.h"
+#include "worker_manager.h"
 #include "logger.h"
-#include "rand_replace.h"
 
 #include "absl/base/port.h"
 
-// DON'T TOUCH: These reflect the logic of Paper Mario TTYD itself. Changing these will result in invalid plans.
-#define CHOOSE_2ND_INGREDIENT_FRAMES 56 	// Penalty for choosing a 2nd item
-#define TOSS_FRAMES 32				// Penalty for having to toss an item
-#define ALPHA_SORT_FRAMES 38			// Penalty to perform alphabetical ascending sort
-#define REVERSE_ALPHA_SORT_FRAMES 40		// Penalty to perform alphabetical descending sort
-#define TYPE_SORT_FRAMES 39			// Penalty to perform type ascending sort
-#define REVERSE_TYPE_SORT_FRAMES 41		// Penalty to perform type descending sort
-#define JUMP_STORAGE_NO_TOSS_FRAMES 5		// Penalty for not tossing the last item (because we need to get Jump Storage)
-
 // User configurable tunables
 #define WEAK_PB_FLOOR 4500		// If PB is above this value, consider it a "weak" PB and don't increase iteration limit as much.
 // Just so first runs (like from non-existant results dir) don't spend so long trying to "optimize" a "not all that great" branch.
@@ -51,6 +53,12 @@
 #define ITERATION_LIMIT_INCREASE_GETTING_CLOSE ITERATION_LIMIT_INCREASE_FIRST / 4
 #define ITERATION_LIMIT_INCREASE_GETTING_KINDOF_CLOSE ITERATION_LIMIT_INCREASE_GETTING_CLOSE / 2
 #define SELECT_CHANCE_TO_SKIP_SEEMINGLY_GOOD_MOVE 25 // Chance (out of 100) for the select strategy to skip a seemingly good next move
+#define SELECT_SKIP_ROLL_OUTCOMES 99 // The skip used to be rolled per move as randint(0, 99) < SELECT_CHANCE_TO_SKIP_SEEMINGLY_GOOD_MOVE, which has 99 outcomes
+#define SELECT_SKIP_TABLE_LEVELS 4 // Skip counts decided by a single roll against selectSkipThresholds; longer runs of skips carry on one roll at a time
+#define SELECT_SKIP_TABLE_DENOMINATOR (SELECT_SKIP_ROLL_OUTCOMES * SELECT_SKIP_ROLL_OUTCOMES * SELECT_SKIP_ROLL_OUTCOMES * SELECT_SKIP_ROLL_OUTCOMES)
+#define SOFTMIN_WEIGHT_SCALE 65536 // Weight of the fastest legal move under softMin; slower moves get a fraction of this
+#define SOFTMIN_MAX_FRAME_DELTA 4095 // Legal moves more than this many frames slower than the fastest are never picked by softMin
+#define SOFTMIN_MAX_LEGAL_MOVES 16384 // softMin only weighs this many legal moves at a node, so its weight sum fits in an int
 #define DEFAULT_CAPACITY_FOR_EMPTY 8 // When initializing a dynamically sized array, an empty/NULL array will be initialized to an Array of this size on a new element add
 #define CAPACITY_INCREASE_FACTOR 1.5 // When a dynamically sized array is full, increase capacity by this factor
 #define CAPACITY_DECREASE_THRESHOLD 0.25 // When a dynamically sized array element count is below this fraction of the capacity, shrink it
@@ -80,6 +88,10 @@ _CIPES_STATIC_ASSERT(ITERATION_LIMIT_INCREASE_GETTING_KINDOF_CLOSE <= ITERATION_
 
 _CIPES_STATIC_ASSERT(SELECT_CHANCE_TO_SKIP_SEEMINGLY_GOOD_MOVE < 100, "Chance to skip greedy, seemingly best move must be < 100");
 _CIPES_STATIC_ASSERT(SELECT_CHANCE_TO_SKIP_SEEMINGLY_GOOD_MOVE >= 0, "Chance to skip greedy, seemingly best move must be >= 0");
+_CIPES_STATIC_ASSERT(SELECT_CHANCE_TO_SKIP_SEEMINGLY_GOOD_MOVE < SELECT_SKIP_ROLL_OUTCOMES, "Chance to skip greedy, seemingly best move must be < the outcomes of its roll");
+_CIPES_STATIC_ASSERT(SELECT_SKIP_TABLE_DENOMINATOR <= 0x7fffffff, "The select skip table must be rolled with a single random number");
+_CIPES_STATIC_ASSERT((long long)SOFTMIN_WEIGHT_SCALE * SOFTMIN_MAX_LEGAL_MOVES <= 0x7fffffff, "The softMin weight sum must fit in an int");
+_CIPES_STATIC_ASSERT(SOFTMIN_MAX_FRAME_DELTA > 0, "softMin must be able to pick moves slower than the fastest");
 _CIPES_STATIC_ASSERT(CHECK_SHUTDOWN_INTERVAL > 0, "Check for shutdown interval must be > 0");
 _CIPES_STATIC_ASSERT(CHECK_SHUTDOWN_INTERVAL < DEFAULT_ITERATION_LIMIT, "Check for shutdown interval must be < the default iteration limit");
 
@@ -88,6 +100,23 @@ _CIPES_STATIC_ASSERT(CHECK_SHUTDOWN_INTERVAL < DEFAULT_ITERATION_LIMIT, "Check f
 _CIPES_STATIC_ASSERT(CAPACITY_DECREASE_THRESHOLD <= CAPACITY_DECREASE_FACTOR, "The decrease threshold must be <= the decrease factor");
 _CIPES_STATIC_ASSERT(CAPACITY_INCREASE_FACTOR >= 1, "The increase factor must be >= 1");
 #endif
+
+// A roll below selectSkipThresholds[k], out of SELECT_SKIP_TABLE_DENOMINATOR, skips at least k + 1 moves.
+// Exactly the chance of k + 1 skips in a row rolled one at a time: (SKIP / OUTCOMES)^(k + 1).
+#define SELECT_SKIP SELECT_CHANCE_TO_SKIP_SEEMINGLY_GOOD_MOVE
+#define SELECT_OUTCOMES SELECT_SKIP_ROLL_OUTCOMES
+static const int selectSkipThresholds[SELECT_SKIP_TABLE_LEVELS] = {
+	SELECT_SKIP * SELECT_OUTCOMES * SELECT_OUTCOMES * SELECT_OUTCOMES,
+	SELECT_SKIP * SELECT_SKIP * SELECT_OUTCOMES * SELECT_OUTCOMES,
+	SELECT_SKIP * SELECT_SKIP * SELECT_SKIP * SELECT_OUTCOMES,
+	SELECT_SKIP * SELECT_SKIP * SELECT_SKIP * SELECT_SKIP,
+};
+
+// Weight of a legal move n frames slower than the fastest, out of SOFTMIN_WEIGHT_SCALE; 0 past softMinMaxDelta
+static int softMinWeights[SOFTMIN_MAX_FRAME_DELTA + 1];
+static int softMinMaxDelta = -1;	// -1 while softMin is disabled
+#undef SELECT_SKIP
+#undef SELECT_OUTCOMES
 _CIPES_STATIC_ASSERT(DEFAULT_CAPACITY_FOR_EMPTY > 0, "The default capacity must be > 0");
 _CIPES_STATIC_ASSERT(CAPACITY_DECREASE_FLOOR > 0, "The floor for capacity must be > 0");
 
@@ -117,20 +146,50 @@ typedef struct MoveDescription MoveDescription;
 int **invFrames;
 struct Recipe *recipeList;
 
+// The authoritative local PB, which results/PB.txt is brought up to date with.
+// Only accessed within critical(pb).
+static int savedPbRecord = UNSET_FRAME_RECORD;
+// The record last written to results/PB.txt. Only accessed within critical(pb_file).
+static int writtenPbRecord = UNSET_FRAME_RECORD;
+// When set, the search never touches the network or writes any files (see benchmark.c).
+static bool benchmarkMode = false;
+
 // Harmless race; if multiple threads try to initialize this they will
 // all initialize to the same thing.
 static const struct Cook EMPTY_COOK = {0};
 
+// The same as askedToShutdown, through the flag the context was bound to
+ABSL_ATTRIBUTE_ALWAYS_INLINE
+static inline bool contextAskedToShutdown(const struct SearchContext *ctx) {
+	return ABSL_PREDICT_FALSE(*ctx->shutdownRequested);
+}
+
 ABSL_ATTRIBUTE_UNUSED ABSL_ATTRIBUTE_ALWAYS_INLINE
-static inline bool checkShutdownOnIndex(int i) {
-	return i % CHECK_SHUTDOWN_INTERVAL == 0 && askedToShutdown();
+static inline void prefetchContextShutdown(const struct SearchContext *ctx) {
+	_PREFETCH_READ_NO_TEMPORAL_LOCALITY(ctx->shutdownRequested);
 }
 
+// The same as getLocalRecord, but without a call in the common case.
+// A corrupt record is left to getLocalRecord, which resets it.
+ABSL_ATTRIBUTE_ALWAYS_INLINE
+static inline int contextLocalRecord(const struct SearchContext *ctx) {
+	const int record = *ctx->localRecord;
+	return ABSL_PREDICT_FALSE(record < 0) ? getLocalRecord() : record;
+}
+
+// getCookFrames on a given table, for the search to use the one in its context
+static inline int getCookFramesFromTable(int **frameTable, const struct Inventory *inventory, const int *ingredientLoc, int numItems);
+
 ABSL_ATTRIBUTE_UNUSED ABSL_ATTRIBUTE_ALWAYS_INLINE
-static inline bool prefetchShutdownOnIndex(int i) {
+static inline bool checkShutdownOnIndex(const struct SearchContext *ctx, int i) {
+	return i % CHECK_SHUTDOWN_INTERVAL == 0 && contextAskedToShutdown(ctx);
+}
+
+ABSL_ATTRIBUTE_UNUSED ABSL_ATTRIBUTE_ALWAYS_INLINE
+static inline bool prefetchShutdownOnIndex(const struct SearchContext *ctx, int i) {
 #if ENABLE_PREFETCHING
 	if (i % CHECK_SHUTDOWN_INTERVAL == (CHECK_SHUTDOWN_INTERVAL - 1)) {
-		prefetchShutdown();
+		prefetchContextShutdown(ctx);
 		return true;
 	}
 #endif
@@ -138,33 +197,39 @@ static inline bool prefetchShutdownOnIndex(int i) {
 }
 
 ABSL_ATTRIBUTE_UNUSED ABSL_ATTRIBUTE_ALWAYS_INLINE
-static inline bool checkShutdownOnIndexWithPrefetch(int i) {
+static inline bool checkShutdownOnIndexWithPrefetch(const struct SearchContext *ctx, int i) {
 #if ENABLE_PREFETCHING
 	int modulo = i % CHECK_SHUTDOWN_INTERVAL;
 	switch (modulo) {
 		case 0:
-			return askedToShutdown();
+			return contextAskedToShutdown(ctx);
 		case (CHECK_SHUTDOWN_INTERVAL - 1):
-			prefetchShutdown();
+			prefetchContextShutdown(ctx);
 			return false;
 		default:
 			return false;
 	}
 #else
-	return checkShutdownOnIndex(i);
+	return checkShutdownOnIndex(ctx, i);
 #endif
 }
 
 ABSL_ATTRIBUTE_UNUSED ABSL_ATTRIBUTE_ALWAYS_INLINE
-static inline bool checkShutdownOnIndexLong(long i) {
-	return i % CHECK_SHUTDOWN_INTERVAL == 0 && askedToShutdown();
+static inline bool checkShutdownOnIndexLong(const struct SearchContext *ctx, long i) {
+	return i % CHECK_SHUTDOWN_INTERVAL == 0 && contextAskedToShutdown(ctx);
+}
+
+// Threads beyond the active worker count leave their dive at the same cadence as a shutdown
+ABSL_ATTRIBUTE_ALWAYS_INLINE
+static inline bool checkParkOnIndexLong(int rawID, long i) {
+	return i % CHECK_SHUTDOWN_INTERVAL == 0 && shouldParkWorker(rawID);
 }
 
 ABSL_ATTRIBUTE_UNUSED ABSL_ATTRIBUTE_ALWAYS_INLINE
-static inline bool prefetchShutdownOnIndexLong(long i) {
+static inline bool prefetchShutdownOnIndexLong(const struct SearchContext *ctx, long i) {
 #if ENABLE_PREFETCHING
 	if (i % CHECK_SHUTDOWN_INTERVAL == (CHECK_SHUTDOWN_INTERVAL - 1)) {
-		prefetchShutdown();
+		prefetchContextShutdown(ctx);
 		return true;
 	}
 #endif
@@ -173,20 +238,20 @@ static inline bool prefetchShutdownOnIndexLong(long i) {
 }
 
 ABSL_ATTRIBUTE_UNUSED ABSL_ATTRIBUTE_ALWAYS_INLINE
-static inline bool checkShutdownOnIndexLongWithPrefetch(long i) {
+static inline bool checkShutdownOnIndexLongWithPrefetch(const struct SearchContext *ctx, long i) {
 #if ENABLE_PREFETCHING
 	int modulo = i % CHECK_SHUTDOWN_INTERVAL;
 	switch (modulo) {
 		case 0:
-			return askedToShutdown();
+			return contextAskedToShutdown(ctx);
 		case (CHECK_SHUTDOWN_INTERVAL - 1):
-			prefetchShutdown();
+			prefetchContextShutdown(ctx);
 			return false;
 		default:
 			return false;
 	}
 #else
-	return checkShutdownOnIndexLong(i);
+	return checkShutdownOnIndexLong(ctx, i);
 #endif
 }
 
@@ -212,6 +277,30 @@ void initializeRecipeList() {
 	recipeList = getRecipeList();
 }
 
+/*-------------------------------------------------------------------
+ * Function 	: initSearchContext
+ * Inputs	: struct SearchContext	*ctx
+ *		  int			rawID
+ *
+ * Point ctx at the tables, record and shutdown flag every search reads,
+ * and at the calling thread's stats slot, so that must be bound first.
+ * Its own generator is seeded with stream rawID of the master seed.
+ * invFrames, recipeList and softMin must already be initialized.
+ -------------------------------------------------------------------*/
+void initSearchContext(struct SearchContext *ctx, int rawID) {
+	ctx->rawID = rawID;
+	ctx->invFrames = invFrames;
+	ctx->recipeList = recipeList;
+	ctx->localRecord = getLocalRecordAddress();
+	ctx->shutdownRequested = &_askedToShutdownVar;
+	ctx->logLevel = get_log_level();
+	ctx->stats = threadSearchStatsSlot;
+	ctx->softMinWeights = softMinWeights;
+	ctx->softMinMaxDelta = softMinMaxDelta;
+	ctx->diveSerial = 0;
+	random_state_seed_stream(&ctx->random, MAX(rawID, 0));
+}
+
 /*-------------------------------------------------------------------
  * Function 	: applyJumpStorageFramePenalty
  * Inputs	: struct BranchPath *node
@@ -262,7 +351,8 @@ ABSL_ATTRIBUTE_ALWAYS_INLINE static inline void copyOutputsFulfilledNoAlloc(outp
 
 /*-------------------------------------------------------------------
  * Function 	: createChapter5Struct
- * Inputs	: int				DB_place_index
+ * Inputs	: struct SearchContext	*ctx
+ *		  int				DB_place_index
  *		  int				CO_place_index
  *		  int				KM_place_index
  *		  int				CS_place_index
@@ -274,8 +364,9 @@ ABSL_ATTRIBUTE_ALWAYS_INLINE static inline void copyOutputsFulfilledNoAlloc(outp
  * lateSort tracks whether we performed the sort before or after the
  * Keel Mango, for printing purposes
  -------------------------------------------------------------------*/
-ABSL_MUST_USE_RESULT_INCLUSIVE struct CH5 *createChapter5Struct(struct CH5_Eval eval, int lateSort) {
+ABSL_MUST_USE_RESULT_INCLUSIVE struct CH5 *createChapter5Struct(struct SearchContext *ctx, struct CH5_Eval eval, int lateSort) {
 	struct CH5 *ch5 = malloc(sizeof(struct CH5));
+	COUNT_SLOT_STAT(ctx->stats, allocations);
 
 	checkMallocFailed(ch5);
 
@@ -291,7 +382,8 @@ ABSL_MUST_USE_RESULT_INCLUSIVE struct CH5 *createChapter5Struct(struct CH5_Eval
 
 /*-------------------------------------------------------------------
  * Function 	: createCookDescription
- * Inputs	: struct BranchPath 	  *node
+ * Inputs	: struct SearchContext	*ctx
+ *		  struct BranchPath 	  *node
  *		  struct Recipe 	  recipe
  *		  struct ItemCombination combo
  *		  enum Type_Sort	  *tempInventory
@@ -302,7 +394,7 @@ ABSL_MUST_USE_RESULT_INCLUSIVE struct CH5 *createChapter5Struct(struct CH5_Eval
  * Compartmentalization of generating a MoveDescription struct
  * based on various parameters dependent on what recip we're cooking
  -------------------------------------------------------------------*/
-MoveDescription createCookDescription(const struct BranchPath *node, struct Recipe recipe, struct ItemCombination combo, struct Inventory *tempInventory, int *tempFrames, int viableItems) {
+MoveDescription createCookDescription(struct SearchContext *ctx, const struct BranchPath *node, struct Recipe recipe, struct ItemCombination combo, struct Inventory *tempInventory, int *tempFrames, int viableItems) {
 	MoveDescription useDescription;
 	useDescription.action = Cook;
 
@@ -312,11 +404,11 @@ MoveDescription createCookDescription(const struct BranchPath *node, struct Reci
 	ingredientLoc[0] = indexOfItemInInventory(*tempInventory, combo.item1);
 
 	if (combo.numItems == 1) {
-		createCookDescription1Item(node, recipe, combo, tempInventory, ingredientLoc, tempFrames, viableItems, &useDescription);
+		createCookDescription1Item(ctx, node, recipe, combo, tempInventory, ingredientLoc, tempFrames, viableItems, &useDescription);
 	}
 	else {
 		ingredientLoc[1] = indexOfItemInInventory(*tempInventory, combo.item2);
-		createCookDescription2Items(node, recipe, combo, tempInventory, ingredientLoc, tempFrames, viableItems, &useDescription);
+		createCookDescription2Items(ctx, node, recipe, combo, tempInventory, ingredientLoc, tempFrames, viableItems, &useDescription);
 	}
 
 	return useDescription;
@@ -324,7 +416,8 @@ MoveDescription createCookDescription(const struct BranchPath *node, struct Reci
 
 /*-------------------------------------------------------------------
  * Function 	: createCookDescription1Item
- * Inputs	: struct BranchPath 		*node
+ * Inputs	: struct SearchContext	*ctx
+ *		  struct BranchPath 		*node
  *		  struct Recipe 		recipe
  *		  struct ItemCombination 	combo
  *		  enum Type_Sort		*tempInventory
@@ -338,24 +431,22 @@ MoveDescription createCookDescription(const struct BranchPath *node, struct Reci
  * length 1. Generates Cook structure and points to this structure
  * in useDescription.
  -------------------------------------------------------------------*/
-void createCookDescription1Item(const struct BranchPath *node, struct Recipe recipe, struct ItemCombination combo, struct Inventory *tempInventory, int *ingredientLoc, int *tempFrames, int viableItems, MoveDescription *useDescription) {
+void createCookDescription1Item(struct SearchContext *ctx, const struct BranchPath *node, struct Recipe recipe, struct ItemCombination combo, struct Inventory *tempInventory, int *ingredientLoc, int *tempFrames, int viableItems, MoveDescription *useDescription) {
 	// This is a potentially viable recipe with 1 ingredient
 	// Determine how many frames will be needed to select that item
-	*tempFrames = invFrames[viableItems - 1][ingredientLoc[0] - tempInventory->nulls];
+	*tempFrames = getCookFramesFromTable(ctx->invFrames, tempInventory, ingredientLoc, 1);
 
 	// Modify the inventory if the ingredient was in the first 10 slots
-	if (ingredientLoc[0] < 10) {
-		// Shift the inventory towards the front of the array to fill the null
-		*tempInventory = removeItem(*tempInventory, ingredientLoc[0]);
-	}
+	*tempInventory = removeCookIngredients(*tempInventory, ingredientLoc, 1);
 
-	generateCook(useDescription, combo, recipe, ingredientLoc, 0);
+	generateCook(ctx, useDescription, combo, recipe, ingredientLoc, 0);
 	generateFramesTaken(useDescription, node, *tempFrames);
 }
 
 /*-------------------------------------------------------------------
  * Function 	: createCookDescription2Items
- * Inputs	: struct BranchPath 		*node
+ * Inputs	: struct SearchContext	*ctx
+ *		  struct BranchPath 		*node
  *		  struct Recipe 		recipe
  *		  struct ItemCombination 	combo
  *		  enum Type_Sort		*tempInventory
@@ -369,125 +460,53 @@ void createCookDescription1Item(const struct BranchPath *node, struct Recipe rec
  * length 2. Swaps items if it's faster to choose the second item first.
  * Generates Cook structure and points to this structure in useDescription.
  -------------------------------------------------------------------*/
-void createCookDescription2Items(const struct BranchPath *node, struct Recipe recipe, struct ItemCombination combo, struct Inventory *tempInventory, int *ingredientLoc, int *tempFrames, int viableItems, MoveDescription *useDescription) {
+void createCookDescription2Items(struct SearchContext *ctx, const struct BranchPath *node, struct Recipe recipe, struct ItemCombination combo, struct Inventory *tempInventory, int *ingredientLoc, int *tempFrames, int viableItems, MoveDescription *useDescription) {
 	// This is a potentially viable recipe with 2 ingredients
-	//Baseline frames based on how many times we need to access the menu
-	*tempFrames = CHOOSE_2ND_INGREDIENT_FRAMES;
-
 	int swap = 0;
 
+	// Determine which order of ingredients to take
+	// The first picked item always vanishes from the list of ingredients when picking the 2nd ingredient
+	// There are some configurations where it is 2 frames faster to pick the ingredients in the reverse order
+	if (selectSecondItemFirst(ingredientLoc, tempInventory->nulls, viableItems)) {
+		// It's faster to select the 2nd item, so make it the priority and switch the order
+		swapItems(ingredientLoc);
+		swap = 1;
+	}
+
 	// Due to weird side-effects from Inventory Overload, choosing the item in index inventory.length - 1 will
 	// always cause the item in index inventory.length - 1 - inventory.nulls to disappear. In this case, we need
 	// to be super careful about trying to swap the ingredient order, as certain orders may be impossible.
 	int lastVisibleSlot = tempInventory->length - 1;
-	if (tempInventory->nulls) {
-		// Determine if it's faster to select the second item first
-		if (selectSecondItemFirst(ingredientLoc, tempInventory->nulls, viableItems)) {
-			swapItems(ingredientLoc);
-			swap = 1;
-		}
-
-		// This will cause the item in index length - 1 - nulls to disappear
-		// Verify that the second ingredient is NOT in this index
-		if (ingredientLoc[0] == lastVisibleSlot && ingredientLoc[1] == lastVisibleSlot - tempInventory->nulls) {
-			// This item will disappear. We will need to swap the order of the items
-			swapItems(ingredientLoc);
-			swap = swap ? 0 : 1;
-		}
-
-		// Calculate the number of frames to grab the first item
-		*tempFrames += invFrames[viableItems - 1][ingredientLoc[0] - tempInventory->nulls];
-
-		// Based on the index of the first item, calculate the frames to grab the second item
-
-		// If the first ingredient is in slots 1-10, the item is removed.
-		// We only care about this in order to adjust the index of the second item,
-		// which decreases by 1 in this scenario.
-		if (ingredientLoc[0] < 10 && ingredientLoc[1] > ingredientLoc[0]) {
-			*tempFrames += invFrames[viableItems - 2][ingredientLoc[1] - tempInventory->nulls - 1];
-		}
-		// The anomaly occurs
-		else if (ingredientLoc[0] == lastVisibleSlot) {
-			// We do not need to adjust the index of the item, as the index is before the removed item
-			if (ingredientLoc[1] < lastVisibleSlot - tempInventory->nulls) {
-				*tempFrames += invFrames[viableItems - 2][ingredientLoc[1] - tempInventory->nulls];
-			}
-			// Adjust the index because this index occurs after the index of the removed item
-			else {
-				*tempFrames += invFrames[viableItems - 2][ingredientLoc[1] - tempInventory->nulls - 1];
-			}
-		}
-		else {
-			// The first item will not disappear, OR it will not affect the index of the second item
-			if (ingredientLoc[0] >= 10) {
-				*tempFrames += invFrames[viableItems - 1][ingredientLoc[1] - tempInventory->nulls];
-			}
-			else {
-				*tempFrames += invFrames[viableItems - 2][ingredientLoc[1] - tempInventory->nulls];
-			}
-		}
+	if (tempInventory->nulls && ingredientLoc[0] == lastVisibleSlot && ingredientLoc[1] == lastVisibleSlot - tempInventory->nulls) {
+		// This item will disappear. We will need to swap the order of the items
+		swapItems(ingredientLoc);
+		swap = swap ? 0 : 1;
 	}
-	else {
-		// Determine which order of ingredients to take
-		// The first picked item always vanishes from the list of ingredients when picking the 2nd ingredient
-		// There are some configurations where it is 2 frames faster to pick the ingredients in the reverse order
-		if (selectSecondItemFirst(ingredientLoc, tempInventory->nulls, viableItems)) {
-			// It's faster to select the 2nd item, so make it the priority and switch the order
-			swapItems(ingredientLoc);
-			swap = 1;
-		}
 
-		// Calculate the number of frames needed to grab the first item
-		*tempFrames += invFrames[viableItems - 1][ingredientLoc[0] - tempInventory->nulls];
-
-		// Determine the frames needed for the 2nd ingredient
-		// First ingredient is always removed from the menu, so there is always 1 less viable item
-		if (ingredientLoc[1] > ingredientLoc[0]) {
-			// In this case, the 2nd ingredient has "moved up" one slot since the 1st ingredient vanishes
-			*tempFrames += invFrames[viableItems - 2][ingredientLoc[1] - tempInventory->nulls - 1];
-		}
-		else {
-			// In this case, the 2nd ingredient was found earlier on than the 1st ingredient, so no change to index
-			*tempFrames += invFrames[viableItems - 2][ingredientLoc[1] - tempInventory->nulls];
-		}
-	}
+	*tempFrames = getCookFramesFromTable(ctx->invFrames, tempInventory, ingredientLoc, 2);
 
 	// Set each inventory index to null if the item was in the first 10 slots
-	// To reduce complexity, remove the items in ascending order of index
-	if (ingredientLoc[0] < ingredientLoc[1]) {
-		if (ingredientLoc[0] < 10) {
-			*tempInventory = removeItem(*tempInventory, ingredientLoc[0]);
-		}
-		if (ingredientLoc[1] < 10) {
-			*tempInventory = removeItem(*tempInventory, ingredientLoc[1]);
-		}
-	}
-	else {
-		if (ingredientLoc[1] < 10) {
-			*tempInventory = removeItem(*tempInventory, ingredientLoc[1]);
-		}
-		if (ingredientLoc[0] < 10) {
-			*tempInventory = removeItem(*tempInventory, ingredientLoc[0]);
-		}
-	}
+	*tempInventory = removeCookIngredients(*tempInventory, ingredientLoc, 2);
 
 	// Describe what items were used
-	generateCook(useDescription, combo, recipe, ingredientLoc, swap);
+	generateCook(ctx, useDescription, combo, recipe, ingredientLoc, swap);
 	generateFramesTaken(useDescription, node, *tempFrames);
 }
 
 
 /*-------------------------------------------------------------------
  * Function 	: createMoveQuick
- *
+ * Inputs	: struct SearchContext	*ctx
  * Outputs	: struct BranchPath *newMoveNode
  *
  * Allocates a BranchPath struct on the heap, with the assurance that
  * the callee will either initialize the strcut's value to sane values,
  * or doesn't care in it's usage case.
  */
-static struct BranchPath *createMoveQuick() {
+static struct BranchPath *createMoveQuick(struct SearchContext *ctx) {
 	struct BranchPath *node = malloc(sizeof(struct BranchPath));
+	COUNT_SLOT_STAT(ctx->stats, allocations);
+	ADJUST_SLOT_GAUGE(ctx->stats, liveNodes, 1);
 	checkMallocFailed(node);
 	return node;
 }
@@ -495,7 +514,8 @@ static struct BranchPath *createMoveQuick() {
 
 /*-------------------------------------------------------------------
  * Function 	: createLegalMove
- * Inputs	: struct BranchPath		*node
+ * Inputs	: struct SearchContext	*ctx
+ *		  struct BranchPath		*node
  *		  enum Type_Sort		*inventory
  *		  MoveDescription	description
  *		  int				*outputsFulfilled
@@ -506,10 +526,10 @@ static struct BranchPath *createMoveQuick() {
  * Note: Although node is never modified by this function, it will be the
  * new {return}->prev node of the returned BranchPath, thus it is not const
  -------------------------------------------------------------------*/
-struct BranchPath *createLegalMove(struct BranchPath *mutableNode, struct Inventory inventory, MoveDescription description, const outputCreatedArray_t outputsFulfilled, int numOutputsFulfilled) {
+struct BranchPath *createLegalMove(struct SearchContext *ctx, struct BranchPath *mutableNode, struct Inventory inventory, MoveDescription description, const outputCreatedArray_t outputsFulfilled, int numOutputsFulfilled) {
   // Prefer to work with the const version when possible to ensure we really don't modify it.
   const struct BranchPath *node = mutableNode;
-	struct BranchPath *newLegalMove = createMoveQuick();
+	struct BranchPath *newLegalMove = createMoveQuick(ctx);
 
 	checkMallocFailed(newLegalMove);
 
@@ -533,20 +553,6 @@ struct BranchPath *createLegalMove(struct BranchPath *mutableNode, struct Invent
 	return newLegalMove;
 }
 
-/*-------------------------------------------------------------------
- * Function 	: createMoveRaw
- *
- * Outputs	: struct BranchPath *newMoveNode
- *
- * Allocates a BranchPath struct on the heap, setting some critical values
- * to sane initial values.
- */
-static struct BranchPath *createMoveZeroed() {
-	struct BranchPath *node = calloc(sizeof(struct BranchPath), 1);
-	checkMallocFailed(node);
-	return node;
-}
-
 /*-------------------------------------------------------------------
  * Function 	: filterOut2Ingredients
  * Inputs	: struct BranchPath		*node
@@ -569,7 +575,8 @@ void filterOut2Ingredients(struct BranchPath *node) {
 
 /*-------------------------------------------------------------------
  * Function 	: finalizeChapter5Eval
- * Inputs	: struct BranchPath		*node
+ * Inputs	: struct SearchContext	*ctx
+ *		  struct BranchPath		*node
  *		  enum Type_Sort		*inventory
  *		  enum Action			sort
  *		  struct CH5			*ch5Data
@@ -579,7 +586,7 @@ void filterOut2Ingredients(struct BranchPath *node) {
  *
  * Given input parameters, construct a new legal move to represent CH5
  -------------------------------------------------------------------*/
-void finalizeChapter5Eval(struct BranchPath *node, struct Inventory inventory, struct CH5 *ch5Data, int temp_frame_sum, const outputCreatedArray_t outputsFulfilled, int numOutputsFulfilled) {
+void finalizeChapter5Eval(struct SearchContext *ctx, struct BranchPath *node, struct Inventory inventory, struct CH5 *ch5Data, int temp_frame_sum, const outputCreatedArray_t outputsFulfilled, int numOutputsFulfilled) {
 	// Get the index of where to insert this legal move to
 	int insertIndex = getInsertionIndex(node, temp_frame_sum);
 
@@ -590,15 +597,16 @@ void finalizeChapter5Eval(struct BranchPath *node, struct Inventory inventory, s
 	description.totalFramesTaken = node->description.totalFramesTaken + temp_frame_sum;
 
 	// Create the legalMove node
-	struct BranchPath *legalMove = createLegalMove(node, inventory, description, outputsFulfilled, numOutputsFulfilled);
+	struct BranchPath *legalMove = createLegalMove(ctx, node, inventory, description, outputsFulfilled, numOutputsFulfilled);
 
 	// Apend the legal move
-	insertIntoLegalMoves(insertIndex, legalMove, node);
+	insertIntoLegalMoves(ctx, insertIndex, legalMove, node);
 }
 
 /*-------------------------------------------------------------------
  * Function 	: finalizeLegalMove
- * Inputs	: struct BranchPath		*node
+ * Inputs	: struct SearchContext	*ctx
+ *		  struct BranchPath		*node
  *		  int				tempFrames
  *		  MoveDescription	useDescription
  *		  enum Type_Sort		*tempInventory
@@ -612,9 +620,9 @@ void finalizeChapter5Eval(struct BranchPath *node, struct Inventory inventory, s
  * a valid recipe move. Also checks to see if the legal move exceeds
  * the frame limit
  -------------------------------------------------------------------*/
-void finalizeLegalMove(struct BranchPath *node, int tempFrames, MoveDescription useDescription, struct Inventory tempInventory, const outputCreatedArray_t tempOutputsFulfilled, int numOutputsFulfilled, enum HandleOutput tossType, enum Type_Sort toss, int tossIndex) {
+void finalizeLegalMove(struct SearchContext *ctx, struct BranchPath *node, int tempFrames, MoveDescription useDescription, struct Inventory tempInventory, const outputCreatedArray_t tempOutputsFulfilled, int numOutputsFulfilled, enum HandleOutput tossType, enum Type_Sort toss, int tossIndex) {
 	// Determine if the legal move exceeds the frame limit. If so, return out
-	if (useDescription.totalFramesTaken > getLocalRecord() + BUFFER_SEARCH_FRAMES) {
+	if (useDescription.totalFramesTaken > contextLocalRecord(ctx) + BUFFER_SEARCH_FRAMES) {
 		return;
 	}
 
@@ -622,6 +630,7 @@ void finalizeLegalMove(struct BranchPath *node, int tempFrames, MoveDescription
 	int insertIndex = getInsertionIndex(node, tempFrames);
 
 	struct Cook *cookNew = malloc(sizeof(struct Cook));
+	COUNT_SLOT_STAT(ctx->stats, allocations);
 
 	checkMallocFailed(cookNew);
 
@@ -632,10 +641,10 @@ void finalizeLegalMove(struct BranchPath *node, int tempFrames, MoveDescription
 	useDescription.data = cookNew;
 
 	// Create the legalMove node
-	struct BranchPath *newLegalMove = createLegalMove(node, tempInventory, useDescription, tempOutputsFulfilled, numOutputsFulfilled);
+	struct BranchPath *newLegalMove = createLegalMove(ctx, node, tempInventory, useDescription, tempOutputsFulfilled, numOutputsFulfilled);
 
 	// Insert this new move into the current node's legalMove array
-	insertIntoLegalMoves(insertIndex, newLegalMove, node);
+	insertIntoLegalMoves(ctx, insertIndex, newLegalMove, node);
 }
 
 /*-------------------------------------------------------------------
@@ -730,16 +739,82 @@ void freeNode(struct BranchPath *node) {
 		free(node->legalMoves);
 	}
 	free(node);
+	ADJUST_SEARCH_GAUGE(liveNodes, -1);
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: tradeForDriedBouquet
+ * Inputs	: int			**frameTable
+ *		  struct Inventory	inventory
+ *		  int			*frames_HD
+ *		  int			*frames_MC
+ * Outputs	: struct Inventory	inventory
+ *
+ * Trade the Mousse Cake and 2 Hot Dogs for the Dried Bouquet, which is
+ * only possible with both in the inventory and the Hot Dog in the last
+ * 10 slots. Shared by the search and the path replay, so a roadmap is
+ * checked with the same frame arithmetic that produced it.
+ -------------------------------------------------------------------*/
+struct Inventory tradeForDriedBouquet(int **frameTable, struct Inventory inventory, int *frames_HD, int *frames_MC) {
+	int mousse_cake_index = indexOfItemInInventory(inventory, Mousse_Cake);
+
+	// Calculate frames it takes the navigate to the Mousse Cake and the Hot Dog for the trade
+	*frames_HD = 2 * frameTable[inventory.length - 2 * inventory.nulls - 1][indexOfItemInInventory(inventory, Hot_Dog) - inventory.nulls];
+	*frames_MC = frameTable[inventory.length - 2 * inventory.nulls - 1][mousse_cake_index - inventory.nulls];
+
+	// If the Mousse Cake is in the first 10 slots, change it to NULL
+	if (mousse_cake_index < 10) {
+		inventory = removeItem(inventory, mousse_cake_index);
+	}
+	return inventory;
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: placeChapter5Item
+ * Inputs	: int			**frameTable
+ *		  struct Inventory	inventory
+ *		  int			index
+ *		  enum Type_Sort	item
+ *		  int			*frames
+ * Outputs	: struct Inventory	inventory
+ *
+ * Toss the item in one of the first 10 slots to make room for a
+ * Chapter 5 item, for when there is no null for it to be auto-placed in.
+ -------------------------------------------------------------------*/
+struct Inventory placeChapter5Item(int **frameTable, struct Inventory inventory, int index, enum Type_Sort item, int *frames) {
+	*frames = TOSS_FRAMES + frameTable[inventory.length][index + 1];
+	return replaceItem(inventory, index, item);
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: useThunderRage
+ * Inputs	: int			**frameTable
+ *		  struct Inventory	inventory
+ *		  int			*index
+ *		  int			*frames
+ * Outputs	: struct Inventory	inventory
+ *
+ * Use the Thunder Rage, which ends the Chapter 5 intermission. Using it
+ * in slots 1-10 will cause a NULL to appear in that slot.
+ -------------------------------------------------------------------*/
+struct Inventory useThunderRage(int **frameTable, struct Inventory inventory, int *index, int *frames) {
+	*index = indexOfItemInInventory(inventory, Thunder_Rage);
+	if (*index < 10) {
+		inventory = removeItem(inventory, *index);
+	}
+	*frames = frameTable[inventory.length - 1][*index];
+	return inventory;
 }
 
 /*-------------------------------------------------------------------
  * Function 	: fulfillChapter5
- * Inputs	: struct BranchPath	*curNode
+ * Inputs	: struct SearchContext	*ctx
+ *		  struct BranchPath	*curNode
  *
  * A preliminary step to determine Dried Bouquet and Coconut placement
  * before calling handleChapter5Eval
  -------------------------------------------------------------------*/
-void fulfillChapter5(struct BranchPath *curNode) {
+void fulfillChapter5(struct SearchContext *ctx, struct BranchPath *curNode) {
 	// Create an outputs chart but with the Dried Bouquet collected
 	// to ensure that the produced inventory can fulfill all remaining recipes
   outputCreatedArray_t tempOutputsFulfilled;
@@ -747,32 +822,21 @@ void fulfillChapter5(struct BranchPath *curNode) {
 	tempOutputsFulfilled[getIndexOfRecipe(Dried_Bouquet)] = true;
 	int numOutputsFulfilled = curNode->numOutputsCreated + 1;
 
-	struct Inventory newInventory = curNode->inventory;
-
-	int mousse_cake_index = indexOfItemInInventory(newInventory, Mousse_Cake);
-
 	// Create the CH5 eval struct
 	struct CH5_Eval eval;
 
-	// Calculate frames it takes the navigate to the Mousse Cake and the Hot Dog for the trade
-	eval.frames_HD = 2 * invFrames[newInventory.length - 2 * newInventory.nulls - 1][indexOfItemInInventory(newInventory, Hot_Dog) - newInventory.nulls];
-	eval.frames_MC = invFrames[newInventory.length - 2 * newInventory.nulls - 1][mousse_cake_index - newInventory.nulls];
-
-	// If the Mousse Cake is in the first 10 slots, change it to NULL
-	if (mousse_cake_index < 10) {
-		newInventory = removeItem(newInventory, mousse_cake_index);
-	}
+	struct Inventory newInventory = tradeForDriedBouquet(ctx->invFrames, curNode->inventory, &eval.frames_HD, &eval.frames_MC);
 
 	// Handle allocation of the first 2 CH5 items (Dried Bouquet and Coconut)
 	switch (newInventory.nulls) {
 		case 0 :
-			handleDBCOAllocation0Nulls(curNode, newInventory, tempOutputsFulfilled, numOutputsFulfilled, eval);
+			handleDBCOAllocation0Nulls(ctx, curNode, newInventory, tempOutputsFulfilled, numOutputsFulfilled, eval);
 			break;
 		case 1 :
-			handleDBCOAllocation1Null(curNode, newInventory, tempOutputsFulfilled, numOutputsFulfilled, eval);
+			handleDBCOAllocation1Null(ctx, curNode, newInventory, tempOutputsFulfilled, numOutputsFulfilled, eval);
 			break;
 		default :
-			handleDBCOAllocation2Nulls(curNode, newInventory, tempOutputsFulfilled, numOutputsFulfilled, eval);
+			handleDBCOAllocation2Nulls(ctx, curNode, newInventory, tempOutputsFulfilled, numOutputsFulfilled, eval);
 	}
 
 	// We know tempOutputsFulfilled does not escape this scope, so safe to be unallocated on return.
@@ -780,13 +844,14 @@ void fulfillChapter5(struct BranchPath *curNode) {
 
 /*-------------------------------------------------------------------
  * Function 	: fulfillRecipes
- * Inputs	: struct BranchPath	*curNode
+ * Inputs	: struct SearchContext	*ctx
+ *		  struct BranchPath	*curNode
  * 		  int			recipeIndex
  *
  * Iterate through all possible combinations of cooking different
  * recipes and create legal moves for them
  -------------------------------------------------------------------*/
-void fulfillRecipes(struct BranchPath *curNode) {
+void fulfillRecipes(struct SearchContext *ctx, struct BranchPath *curNode) {
 	// For debugging stacktraces
 	/*if (omp_get_thread_num() == 0) {
 		_assert_with_stacktrace(false);
@@ -810,7 +875,7 @@ void fulfillRecipes(struct BranchPath *curNode) {
 		}
 
 		// Only want ingredient combos that can be fulfilled right now!
-		struct Recipe recipe = recipeList[recipeIndex];
+		struct Recipe recipe = ctx->recipeList[recipeIndex];
 		struct ItemCombination *combos = recipe.combos;
 		for (int comboIndex = 0; comboIndex < recipe.countCombos; comboIndex++) {
 			struct ItemCombination combo = combos[comboIndex];
@@ -834,13 +899,13 @@ void fulfillRecipes(struct BranchPath *curNode) {
 
 			int tempFrames;
 
-			struct MoveDescription useDescription = createCookDescription(curNode, recipe, combo, &newInventory, &tempFrames, viableItems);
+			struct MoveDescription useDescription = createCookDescription(ctx, curNode, recipe, combo, &newInventory, &tempFrames, viableItems);
 
 			// Store the base useDescription's cook pointer to be freed later
 			struct Cook *cookBase = (struct Cook *)useDescription.data;
 
 			// Handle allocation of the output
-			handleRecipeOutput(curNode, newInventory, tempFrames, useDescription, tempOutputsFulfilled, numOutputsFulfilled, recipe.output, viableItems);
+			handleRecipeOutput(ctx, curNode, newInventory, tempFrames, useDescription, tempOutputsFulfilled, numOutputsFulfilled, recipe.output, viableItems);
 
 			free(cookBase);
 			// We know tempOutputsFulfilled does not escape this scope, so safe to be unallocated on return.
@@ -850,7 +915,8 @@ void fulfillRecipes(struct BranchPath *curNode) {
 
 /*-------------------------------------------------------------------
  * Function 	: generateCook
- * Inputs	: MoveDescription	*description
+ * Inputs	: struct SearchContext	*ctx
+ *		  MoveDescription	*description
  * 		  struct ItemCombination	combo
  *		  struct Recipe		recipe
  *		  int				*ingredientLoc
@@ -858,8 +924,9 @@ void fulfillRecipes(struct BranchPath *curNode) {
  *
  * Given input parameters, generate Cook structure
  -------------------------------------------------------------------*/
-void generateCook(MoveDescription *description, const struct ItemCombination combo, const struct Recipe recipe, const int *ingredientLoc, int swap) {
+void generateCook(struct SearchContext *ctx, MoveDescription *description, const struct ItemCombination combo, const struct Recipe recipe, const int *ingredientLoc, int swap) {
 	struct Cook *cook = malloc(sizeof(struct Cook));
+	COUNT_SLOT_STAT(ctx->stats, allocations);
 
 	checkMallocFailed(cook);
 
@@ -894,6 +961,84 @@ void generateFramesTaken(MoveDescription *description, const struct BranchPath *
 	description->totalFramesTaken = node->description.totalFramesTaken + framesTaken;
 }
 
+/*-------------------------------------------------------------------
+ * Function 	: getCookFramesFromTable
+ * Inputs	: int			**frameTable
+ *		  struct Inventory	*inventory
+ *		  int			*ingredientLoc
+ *		  int			numItems
+ * Outputs	: int			frames
+ *
+ * Frames needed to pick the ingredients at ingredientLoc, in that order,
+ * from the inventory as it was before cooking. This does not include
+ * handling the output.
+ -------------------------------------------------------------------*/
+ABSL_ATTRIBUTE_ALWAYS_INLINE
+static inline int getCookFramesFromTable(int **frameTable, const struct Inventory *inventory, const int *ingredientLoc, int numItems) {
+	int viableItems = inventory->length - 2 * inventory->nulls;
+
+	// Calculate the number of frames needed to grab the first item
+	int frames = frameTable[viableItems - 1][ingredientLoc[0] - inventory->nulls];
+	if (numItems == 1) {
+		return frames;
+	}
+
+	//Baseline frames based on how many times we need to access the menu
+	frames += CHOOSE_2ND_INGREDIENT_FRAMES;
+
+	if (inventory->nulls) {
+		int lastVisibleSlot = inventory->length - 1;
+
+		// Based on the index of the first item, calculate the frames to grab the second item
+
+		// If the first ingredient is in slots 1-10, the item is removed.
+		// We only care about this in order to adjust the index of the second item,
+		// which decreases by 1 in this scenario.
+		if (ingredientLoc[0] < 10 && ingredientLoc[1] > ingredientLoc[0]) {
+			frames += frameTable[viableItems - 2][ingredientLoc[1] - inventory->nulls - 1];
+		}
+		// The anomaly occurs
+		else if (ingredientLoc[0] == lastVisibleSlot) {
+			// We do not need to adjust the index of the item, as the index is before the removed item
+			if (ingredientLoc[1] < lastVisibleSlot - (int)inventory->nulls) {
+				frames += frameTable[viableItems - 2][ingredientLoc[1] - inventory->nulls];
+			}
+			// Adjust the index because this index occurs after the index of the removed item
+			else {
+				frames += frameTable[viableItems - 2][ingredientLoc[1] - inventory->nulls - 1];
+			}
+		}
+		else {
+			// The first item will not disappear, OR it will not affect the index of the second item
+			if (ingredientLoc[0] >= 10) {
+				frames += frameTable[viableItems - 1][ingredientLoc[1] - inventory->nulls];
+			}
+			else {
+				frames += frameTable[viableItems - 2][ingredientLoc[1] - inventory->nulls];
+			}
+		}
+	}
+	else {
+		// Determine the frames needed for the 2nd ingredient
+		// First ingredient is always removed from the menu, so there is always 1 less viable item
+		if (ingredientLoc[1] > ingredientLoc[0]) {
+			// In this case, the 2nd ingredient has "moved up" one slot since the 1st ingredient vanishes
+			frames += frameTable[viableItems - 2][ingredientLoc[1] - inventory->nulls - 1];
+		}
+		else {
+			// In this case, the 2nd ingredient was found earlier on than the 1st ingredient, so no change to index
+			frames += frameTable[viableItems - 2][ingredientLoc[1] - inventory->nulls];
+		}
+	}
+
+	return frames;
+}
+
+// For callers without a SearchContext, which read the shared table
+int getCookFrames(const struct Inventory *inventory, const int *ingredientLoc, int numItems) {
+	return getCookFramesFromTable(invFrames, inventory, ingredientLoc, numItems);
+}
+
 /*-------------------------------------------------------------------
  * Function 	: getInsertionIndex
  * Inputs	: struct BranchPath	*curNode
@@ -941,7 +1086,8 @@ int getSortFrames(enum Action action) {
 
 /*-------------------------------------------------------------------
  * Function 	: handleChapter5EarlySortEndItems
- * Inputs	: struct BranchPath	*node
+ * Inputs	: struct SearchContext	*ctx
+ *		  struct BranchPath	*node
  *		  enum Type_Sort	*inventory
  *		  int			*outputsFulfilled
  *		  int			numOutputsFulfilled
@@ -956,7 +1102,7 @@ int getSortFrames(enum Action action) {
  * Coconut and the Keel Mango. Place the Keel Mango and Courage Shell
  * in various inventory locations. Determine if the move is legal.
  -------------------------------------------------------------------*/
-void handleChapter5EarlySortEndItems(struct BranchPath *node, struct Inventory inventory, const outputCreatedArray_t outputsFulfilled, int numOutputsFulfilled, struct CH5_Eval eval) {
+void handleChapter5EarlySortEndItems(struct SearchContext *ctx, struct BranchPath *node, struct Inventory inventory, const outputCreatedArray_t outputsFulfilled, int numOutputsFulfilled, struct CH5_Eval eval) {
 	for (eval.KM_place_index = 0; eval.KM_place_index < 10; eval.KM_place_index++) {
 		// Don't allow current move to remove Thunder Rage or previously
 		// obtained items
@@ -966,9 +1112,7 @@ void handleChapter5EarlySortEndItems(struct BranchPath *node, struct Inventory i
 		}
 
 		// Replace the chosen item with the Keel Mango
-		struct Inventory km_temp_inventory = replaceItem(inventory, eval.KM_place_index, Keel_Mango);
-		// Calculate the frames for this action
-		eval.frames_KM = TOSS_FRAMES + invFrames[inventory.length][eval.KM_place_index + 1];
+		struct Inventory km_temp_inventory = placeChapter5Item(ctx->invFrames, inventory, eval.KM_place_index, Keel_Mango, &eval.frames_KM);
 
 		for (eval.CS_place_index = 1; eval.CS_place_index < 10; eval.CS_place_index++) {
 			// Don't allow current move to remove Thunder Rage or previously
@@ -980,25 +1124,18 @@ void handleChapter5EarlySortEndItems(struct BranchPath *node, struct Inventory i
 			}
 
 			// Replace the chosen item with the Courage Shell
-			struct Inventory kmcs_temp_inventory = replaceItem(km_temp_inventory, eval.CS_place_index, Courage_Shell);
-			// Calculate the frames for this action
-			eval.frames_CS = TOSS_FRAMES + invFrames[kmcs_temp_inventory.length][eval.CS_place_index + 1];
+			struct Inventory kmcs_temp_inventory = placeChapter5Item(ctx->invFrames, km_temp_inventory, eval.CS_place_index, Courage_Shell, &eval.frames_CS);
 
 			// The next event is using the Thunder Rage item before resuming the 2nd session of recipe fulfillment
-			eval.TR_use_index = indexOfItemInInventory(kmcs_temp_inventory, Thunder_Rage);
-			if (eval.TR_use_index < 10) {
-				kmcs_temp_inventory = removeItem(kmcs_temp_inventory, eval.TR_use_index);
-			}
-			// Calculate the frames for this action
-			eval.frames_TR = invFrames[kmcs_temp_inventory.length - 1][eval.TR_use_index];
+			kmcs_temp_inventory = useThunderRage(ctx->invFrames, kmcs_temp_inventory, &eval.TR_use_index, &eval.frames_TR);
 
 			// Calculate the frames of all actions done
 			int temp_frame_sum = eval.frames_DB + eval.frames_CO + eval.frames_KM + eval.frames_CS + eval.frames_TR + eval.frames_HD + eval.frames_MC + eval.sort_frames;
 
 			// Determine if the remaining inventory is sufficient to fulfill all remaining recipes
-			if (stateOK(kmcs_temp_inventory, outputsFulfilled, recipeList)) {
-				struct CH5 *ch5Data = createChapter5Struct(eval, 0);
-				finalizeChapter5Eval(node, kmcs_temp_inventory, ch5Data, temp_frame_sum, outputsFulfilled, numOutputsFulfilled);
+			if (stateOK(kmcs_temp_inventory, outputsFulfilled, ctx->recipeList, ctx->stats)) {
+				struct CH5 *ch5Data = createChapter5Struct(ctx, eval, 0);
+				finalizeChapter5Eval(ctx, node, kmcs_temp_inventory, ch5Data, temp_frame_sum, outputsFulfilled, numOutputsFulfilled);
 			}
 		}
 	}
@@ -1006,7 +1143,8 @@ void handleChapter5EarlySortEndItems(struct BranchPath *node, struct Inventory i
 
 /*-------------------------------------------------------------------
  * Function 	: handleChapter5Eval
- * Inputs	: struct BranchPath	*node
+ * Inputs	: struct SearchContext	*ctx
+ *		  struct BranchPath	*node
  *		  enum Type_Sort	*inventory
  *		  int			*outputsFulfilled
  *		  int			numOutputsFulfilled
@@ -1021,12 +1159,12 @@ void handleChapter5EarlySortEndItems(struct BranchPath *node, struct Inventory i
  * placing the Keel Mango by tossing various inventory items and
  * evaluate legal moves.
  -------------------------------------------------------------------*/
-void handleChapter5Eval(struct BranchPath *node, struct Inventory inventory, const outputCreatedArray_t outputsFulfilled, int numOutputsFulfilled, struct CH5_Eval eval) {
+void handleChapter5Eval(struct SearchContext *ctx, struct BranchPath *node, struct Inventory inventory, const outputCreatedArray_t outputsFulfilled, int numOutputsFulfilled, struct CH5_Eval eval) {
 	// Evaluate sorting before the Keel Mango
 	// Use -1 to identify that we are not collecting the Keel Mango until after the sort
 	eval.frames_KM = -1;
 	eval.KM_place_index = -1;
-	handleChapter5Sorts(node, inventory, outputsFulfilled, numOutputsFulfilled, eval);
+	handleChapter5Sorts(ctx, node, inventory, outputsFulfilled, numOutputsFulfilled, eval);
 
 	// Place the Keel Mango in a null spot if one is available.
 	if (inventory.nulls >= 1) {
@@ -1036,7 +1174,7 @@ void handleChapter5Eval(struct BranchPath *node, struct Inventory inventory, con
 		eval.KM_place_index = 0;
 
 		// Perform all sorts
-		handleChapter5Sorts(node, km_temp_inventory, outputsFulfilled, numOutputsFulfilled, eval);
+		handleChapter5Sorts(ctx, node, km_temp_inventory, outputsFulfilled, numOutputsFulfilled, eval);
 
 	}
 	else {
@@ -1048,19 +1186,18 @@ void handleChapter5Eval(struct BranchPath *node, struct Inventory inventory, con
 			}
 
 			// Making a copy of the temp inventory for what it looks like after the allocation of the KM
-			struct Inventory km_temp_inventory = replaceItem(inventory, eval.KM_place_index, Keel_Mango);
-			// Calculate the frames for this action
-			eval.frames_KM = TOSS_FRAMES + invFrames[inventory.length][eval.KM_place_index + 1];
+			struct Inventory km_temp_inventory = placeChapter5Item(ctx->invFrames, inventory, eval.KM_place_index, Keel_Mango, &eval.frames_KM);
 
 			// Perform all sorts
-			handleChapter5Sorts(node, km_temp_inventory, outputsFulfilled, numOutputsFulfilled, eval);
+			handleChapter5Sorts(ctx, node, km_temp_inventory, outputsFulfilled, numOutputsFulfilled, eval);
 		}
 	}
 }
 
 /*-------------------------------------------------------------------
  * Function 	: handleChapter5LateSortEndItems
- * Inputs	: struct BranchPath	*node
+ * Inputs	: struct SearchContext	*ctx
+ *		  struct BranchPath	*node
  *		  enum Type_Sort	*inventory
  *		  int			*outputsFulfilled
  *		  int			numOutputsFulfilled
@@ -1077,7 +1214,7 @@ void handleChapter5Eval(struct BranchPath *node, struct Inventory inventory, con
  * Keel Mango. Place the Courage Shell in various inventory locations.
  * Determine if a move is legal.
  -------------------------------------------------------------------*/
-void handleChapter5LateSortEndItems(struct BranchPath *node, struct Inventory inventory, const outputCreatedArray_t outputsFulfilled, int numOutputsFulfilled, struct CH5_Eval eval) {
+void handleChapter5LateSortEndItems(struct SearchContext *ctx, struct BranchPath *node, struct Inventory inventory, const outputCreatedArray_t outputsFulfilled, int numOutputsFulfilled, struct CH5_Eval eval) {
 	// Place the Courage Shell
 	for (eval.CS_place_index = 0; eval.CS_place_index < 10; eval.CS_place_index++) {
 		// Don't allow current move to remove Thunder Rage
@@ -1086,32 +1223,25 @@ void handleChapter5LateSortEndItems(struct BranchPath *node, struct Inventory in
 		}
 
 		// Replace the chosen item with the Courage Shell
-		struct Inventory cs_temp_inventory = replaceItem(inventory, eval.CS_place_index, Courage_Shell);
-		// Calculate the frames for this action
-		eval.frames_CS = TOSS_FRAMES + invFrames[cs_temp_inventory.length][eval.CS_place_index + 1];
+		struct Inventory cs_temp_inventory = placeChapter5Item(ctx->invFrames, inventory, eval.CS_place_index, Courage_Shell, &eval.frames_CS);
 
 		// The next event is using the Thunder Rage
-		eval.TR_use_index = indexOfItemInInventory(cs_temp_inventory, Thunder_Rage);
-		// Using the Thunder Rage in slots 1-10 will cause a NULL to appear in that slot
-		if (eval.TR_use_index < 10) {
-			cs_temp_inventory = removeItem(cs_temp_inventory, eval.TR_use_index);
-		}
-		// Calculate the frames for this action
-		eval.frames_TR = invFrames[cs_temp_inventory.length - 1][eval.TR_use_index];
+		cs_temp_inventory = useThunderRage(ctx->invFrames, cs_temp_inventory, &eval.TR_use_index, &eval.frames_TR);
 
 		// Calculate the frames of all actions done
 		int temp_frame_sum = eval.frames_DB + eval.frames_CO + eval.frames_KM + eval.frames_CS + eval.frames_TR + eval.frames_HD + eval.frames_MC + eval.sort_frames;
 
-		if (stateOK(cs_temp_inventory, outputsFulfilled, recipeList)) {
-			struct CH5 *ch5Data = createChapter5Struct(eval, 1);
-			finalizeChapter5Eval(node, cs_temp_inventory, ch5Data, temp_frame_sum, outputsFulfilled, numOutputsFulfilled);
+		if (stateOK(cs_temp_inventory, outputsFulfilled, ctx->recipeList, ctx->stats)) {
+			struct CH5 *ch5Data = createChapter5Struct(ctx, eval, 1);
+			finalizeChapter5Eval(ctx, node, cs_temp_inventory, ch5Data, temp_frame_sum, outputsFulfilled, numOutputsFulfilled);
 		}
 	}
 }
 
 /*-------------------------------------------------------------------
  * Function 	: handleChapter5Sorts
- * Inputs	: struct BranchPath	*node
+ * Inputs	: struct SearchContext	*ctx
+ *		  struct BranchPath	*node
  *		  enum Type_Sort	*inventory
  *		  int			*outputsFulfilled
  *		  int			numOutputsFulfilled
@@ -1128,7 +1258,7 @@ void handleChapter5LateSortEndItems(struct BranchPath *node, struct Inventory in
  * Only continue if a sort places the Coconut in slots 11-20.
  * Then, call an EndItems function to finalize the CH5 evaluation.
  -------------------------------------------------------------------*/
-void handleChapter5Sorts(struct BranchPath *node, struct Inventory inventory, const outputCreatedArray_t outputsFulfilled, int numOutputsFulfilled, struct CH5_Eval eval) {
+void handleChapter5Sorts(struct SearchContext *ctx, struct BranchPath *node, struct Inventory inventory, const outputCreatedArray_t outputsFulfilled, int numOutputsFulfilled, struct CH5_Eval eval) {
 	for (eval.sort = Sort_Alpha_Asc; eval.sort <= Sort_Type_Des; eval.sort++) {
 		struct Inventory sorted_inventory = getSortedInventory(inventory, eval.sort);
 
@@ -1142,17 +1272,18 @@ void handleChapter5Sorts(struct BranchPath *node, struct Inventory inventory, co
 		eval.sort_frames = getSortFrames(eval.sort);
 
 		if (eval.frames_KM == -1) {
-			handleChapter5EarlySortEndItems(node, sorted_inventory, outputsFulfilled, numOutputsFulfilled, eval);
+			handleChapter5EarlySortEndItems(ctx, node, sorted_inventory, outputsFulfilled, numOutputsFulfilled, eval);
 			continue;
 		}
 
-		handleChapter5LateSortEndItems(node, sorted_inventory, outputsFulfilled, numOutputsFulfilled, eval);
+		handleChapter5LateSortEndItems(ctx, node, sorted_inventory, outputsFulfilled, numOutputsFulfilled, eval);
 	}
 }
 
 /*-------------------------------------------------------------------
  * Function 	: handleDBCOAllocation0Nulls
- * Inputs	: struct BranchPath	*curNode
+ * Inputs	: struct SearchContext	*ctx
+ *		  struct BranchPath	*curNode
  *		  enum Type_Sort	*tempInventory
  *		  int			*outputsFulfilled
  *		  int			numOutputsFulfilled
@@ -1161,7 +1292,7 @@ void handleChapter5Sorts(struct BranchPath *node, struct Inventory inventory, co
  * Preliminary function to allocate Dried Bouquet and Coconut before
  * evaluating the rest of Chapter 5. There are no nulls in the inventory.
  -------------------------------------------------------------------*/
-void handleDBCOAllocation0Nulls(struct BranchPath *curNode, struct Inventory tempInventory, const outputCreatedArray_t tempOutputsFulfilled, int numOutputsFulfilled, struct CH5_Eval eval) {
+void handleDBCOAllocation0Nulls(struct SearchContext *ctx, struct BranchPath *curNode, struct Inventory tempInventory, const outputCreatedArray_t tempOutputsFulfilled, int numOutputsFulfilled, struct CH5_Eval eval) {
 	// No nulls to utilize for Chapter 5 intermission
 	// Both the DB and CO can only replace items in the first 10 slots
 	// The remaining items always slide down to fill the vacancy
@@ -1174,9 +1305,7 @@ void handleDBCOAllocation0Nulls(struct BranchPath *curNode, struct Inventory tem
 		}
 
 		// Replace the chosen item with the Dried Bouquet
-		struct Inventory db_temp_inventory = replaceItem(tempInventory, eval.DB_place_index, Dried_Bouquet);
-		// Calculate the frames for this action
-		eval.frames_DB = TOSS_FRAMES + invFrames[tempInventory.length][eval.DB_place_index + 1];
+		struct Inventory db_temp_inventory = placeChapter5Item(ctx->invFrames, tempInventory, eval.DB_place_index, Dried_Bouquet, &eval.frames_DB);
 
 		for (eval.CO_place_index = 1; eval.CO_place_index < 10; eval.CO_place_index++) {
 			// Don't allow current move to remove needed items
@@ -1186,20 +1315,18 @@ void handleDBCOAllocation0Nulls(struct BranchPath *curNode, struct Inventory tem
 			}
 
 			// Replace the chosen item with the Coconut
-			struct Inventory dbco_temp_inventory = replaceItem(db_temp_inventory, eval.CO_place_index, Coconut);
-
-			// Calculate the frames of this action
-			eval.frames_CO = TOSS_FRAMES + invFrames[tempInventory.length][eval.CO_place_index + 1];
+			struct Inventory dbco_temp_inventory = placeChapter5Item(ctx->invFrames, db_temp_inventory, eval.CO_place_index, Coconut, &eval.frames_CO);
 
 			// Handle the allocation of the Coconut sort, Keel Mango, and Courage Shell
-			handleChapter5Eval(curNode, dbco_temp_inventory, tempOutputsFulfilled, numOutputsFulfilled, eval);
+			handleChapter5Eval(ctx, curNode, dbco_temp_inventory, tempOutputsFulfilled, numOutputsFulfilled, eval);
 		}
 	}
 }
 
 /*-------------------------------------------------------------------
  * Function 	: handleDBCOAllocation1Null
- * Inputs	: struct BranchPath	*curNode
+ * Inputs	: struct SearchContext	*ctx
+ *		  struct BranchPath	*curNode
  *		  enum Type_Sort		*tempInventory
  *		  int			*outputsFulfilled
  *		  int			numOutputsFulfilled
@@ -1208,7 +1335,7 @@ void handleDBCOAllocation0Nulls(struct BranchPath *curNode, struct Inventory tem
  * Preliminary function to allocate Dried Bouquet and Coconut before
  * evaluating the rest of Chapter 5. There is 1 null in the inventory.
  -------------------------------------------------------------------*/
-void handleDBCOAllocation1Null(struct BranchPath *curNode, struct Inventory tempInventory, const outputCreatedArray_t tempOutputsFulfilled, int numOutputsFulfilled, struct CH5_Eval eval) {
+void handleDBCOAllocation1Null(struct SearchContext *ctx, struct BranchPath *curNode, struct Inventory tempInventory, const outputCreatedArray_t tempOutputsFulfilled, int numOutputsFulfilled, struct CH5_Eval eval) {
 	// The Dried Bouquet gets auto-placed in the 1st slot,
 	// and everything else gets shifted down one to fill the first NULL
 	tempInventory = addItem(tempInventory, Dried_Bouquet);
@@ -1223,18 +1350,17 @@ void handleDBCOAllocation1Null(struct BranchPath *curNode, struct Inventory temp
 		}
 
 		// Replace the item with the Coconut
-		struct Inventory co_temp_inventory = replaceItem(tempInventory, eval.CO_place_index, Coconut);
-		// Calculate the number of frames needed to pick this slot for replacement
-		eval.frames_CO = TOSS_FRAMES + invFrames[tempInventory.length][eval.CO_place_index + 1];
+		struct Inventory co_temp_inventory = placeChapter5Item(ctx->invFrames, tempInventory, eval.CO_place_index, Coconut, &eval.frames_CO);
 
 		// Handle the allocation of the Coconut sort, Keel Mango, and Courage Shell
-		handleChapter5Eval(curNode, co_temp_inventory, tempOutputsFulfilled, numOutputsFulfilled, eval);
+		handleChapter5Eval(ctx, curNode, co_temp_inventory, tempOutputsFulfilled, numOutputsFulfilled, eval);
 	}
 }
 
 /*-------------------------------------------------------------------
  * Function 	: handleDBCOAllocation2Nulls
- * Inputs	: struct BranchPath	*curNode
+ * Inputs	: struct SearchContext	*ctx
+ *		  struct BranchPath	*curNode
  *		  enum Type_Sort	*tempInventory
  *		  int			*outputsFulfilled
  *		  int			numOutputsFulfilled
@@ -1243,7 +1369,7 @@ void handleDBCOAllocation1Null(struct BranchPath *curNode, struct Inventory temp
  * Preliminary function to allocate Dried Bouquet and Coconut before
  * evaluating the rest of Chapter 5. There are >=2 nulls in the inventory.
  -------------------------------------------------------------------*/
-void handleDBCOAllocation2Nulls(struct BranchPath *curNode, struct Inventory tempInventory, const outputCreatedArray_t tempOutputsFulfilled, int numOutputsFulfilled, struct CH5_Eval eval) {
+void handleDBCOAllocation2Nulls(struct SearchContext *ctx, struct BranchPath *curNode, struct Inventory tempInventory, const outputCreatedArray_t tempOutputsFulfilled, int numOutputsFulfilled, struct CH5_Eval eval) {
 	// The Dried Bouquet gets auto-placed due to having nulls
 	tempInventory = addItem(tempInventory, Dried_Bouquet);
 	eval.DB_place_index = 0;
@@ -1255,12 +1381,13 @@ void handleDBCOAllocation2Nulls(struct BranchPath *curNode, struct Inventory tem
 	eval.frames_CO = 0;
 
 	// Handle the allocation of the Coconut, Sort, Keel Mango, and Courage Shell
-	handleChapter5Eval(curNode, tempInventory, tempOutputsFulfilled, numOutputsFulfilled, eval);
+	handleChapter5Eval(ctx, curNode, tempInventory, tempOutputsFulfilled, numOutputsFulfilled, eval);
 }
 
 /*-------------------------------------------------------------------
  * Function 	: handleRecipeOutput
- * Inputs	: struct BranchPath		*curNode
+ * Inputs	: struct SearchContext	*ctx
+ *		  struct BranchPath		*curNode
  *		  enum Type_Sort		*tempInventory
  *		  int				tempFrames
  *		  MoveDescription	useDescription
@@ -1273,14 +1400,14 @@ void handleDBCOAllocation2Nulls(struct BranchPath *curNode, struct Inventory tem
  * the output (either tossing the output, auto-placing it if there is a
  * null slot, or tossing a different item in the inventory)
  -------------------------------------------------------------------*/
-void handleRecipeOutput(struct BranchPath *curNode, struct Inventory tempInventory, int tempFrames, MoveDescription useDescription, const outputCreatedArray_t tempOutputsFulfilled, int numOutputsFulfilled, enum Type_Sort output, int viableItems) {
+void handleRecipeOutput(struct SearchContext *ctx, struct BranchPath *curNode, struct Inventory tempInventory, int tempFrames, MoveDescription useDescription, const outputCreatedArray_t tempOutputsFulfilled, int numOutputsFulfilled, enum Type_Sort output, int viableItems) {
 	// Options vary by whether there are NULLs within the inventory
 	if (tempInventory.nulls >= 1) {
 		tempInventory = addItem(tempInventory, ((struct Cook*)useDescription.data)->output);
 
 		// Check to see if this state is viable
-		if(stateOK(tempInventory, tempOutputsFulfilled, recipeList)) {
-			finalizeLegalMove(curNode, tempFrames, useDescription, tempInventory, tempOutputsFulfilled, numOutputsFulfilled, Autoplace, -1, -1);
+		if(stateOK(tempInventory, tempOutputsFulfilled, ctx->recipeList, ctx->stats)) {
+			finalizeLegalMove(ctx, curNode, tempFrames, useDescription, tempInventory, tempOutputsFulfilled, numOutputsFulfilled, Autoplace, -1, -1);
 		}
 	}
 	else {
@@ -1291,43 +1418,51 @@ void handleRecipeOutput(struct BranchPath *curNode, struct Inventory tempInvento
 		useDescription.totalFramesTaken += TOSS_FRAMES;
 
 		// Evaluate viability of tossing the output item itself
-		if (stateOK(tempInventory, tempOutputsFulfilled, recipeList)) {
-			finalizeLegalMove(curNode, tempFrames, useDescription, tempInventory, tempOutputsFulfilled, numOutputsFulfilled, Toss, output, -1);
+		if (stateOK(tempInventory, tempOutputsFulfilled, ctx->recipeList, ctx->stats)) {
+			finalizeLegalMove(ctx, curNode, tempFrames, useDescription, tempInventory, tempOutputsFulfilled, numOutputsFulfilled, Toss, output, -1);
 		}
 
 		// Evaluate the viability of tossing all current inventory items
 		// Assumed that it is impossible to toss and replace any items in the last 10 positions
-		tryTossInventoryItem(curNode, tempInventory, useDescription, tempOutputsFulfilled, numOutputsFulfilled, output, tempFrames, viableItems);
+		tryTossInventoryItem(ctx, curNode, tempInventory, useDescription, tempOutputsFulfilled, numOutputsFulfilled, output, tempFrames, viableItems);
 	}
 }
 
 /*-------------------------------------------------------------------
  * Function 	: handleSelectAndRandom
- * Inputs	: struct BranchPath	*curNode
+ * Inputs	: struct SearchContext	*ctx
+ *		  struct BranchPath	*curNode
  *		  int 			select
  *		  int 			randomise
  *
  * Based on configuration parameters select and randomise within config.txt,
  * manage the array of legal moves based on the designated behavior of the parameters.
  -------------------------------------------------------------------*/
-void handleSelectAndRandom(struct BranchPath *curNode, int select, int randomise) {
-	/*if (select && curNode->moves < 55 && curNode->numLegalMoves > 0) {
-		softMin(curNode);
-	}*/
-
+void handleSelectAndRandom(struct SearchContext *ctx, struct BranchPath *curNode, int select, int randomise) {
+	// softMin weighs each legal move by how much slower it is than the fastest
+	if (select && curNode->moves < 55 && curNode->numLegalMoves > 0 && ctx->softMinMaxDelta >= 0) {
+		softMin(ctx, curNode);
+	}
 	// Old method of handling select
 	// Somewhat random process of picking the quicker moves to recurse down
 	// Arbitrarily skip over the fastest legal move with a given probability
-	if (select && curNode->moves < 55 && curNode->numLegalMoves > 0) {
+	else if (select && curNode->moves < 55 && curNode->numLegalMoves > 0) {
+		// The number of skips is geometric, so draw it from the table with one roll
+		// instead of rolling for each move skipped
 		int nextMoveIndex = 0;
-		while (nextMoveIndex < curNode->numLegalMoves - 1 && randint(0, 99) < SELECT_CHANCE_TO_SKIP_SEEMINGLY_GOOD_MOVE) {
-			if (checkShutdownOnIndexWithPrefetch(nextMoveIndex)) {
-				break;
-			}
+		const int roll = random_state_randint(&ctx->random, 0, SELECT_SKIP_TABLE_DENOMINATOR);
+		while (nextMoveIndex < SELECT_SKIP_TABLE_LEVELS && roll < selectSkipThresholds[nextMoveIndex]) {
 			nextMoveIndex++;
 		}
+		// Past the table, each further skip is as likely as the first
+		if (nextMoveIndex == SELECT_SKIP_TABLE_LEVELS) {
+			while (nextMoveIndex < curNode->numLegalMoves - 1 && random_state_randint(&ctx->random, 0, SELECT_SKIP_ROLL_OUTCOMES) < SELECT_CHANCE_TO_SKIP_SEEMINGLY_GOOD_MOVE) {
+				nextMoveIndex++;
+			}
+		}
+		nextMoveIndex = MIN(nextMoveIndex, curNode->numLegalMoves - 1);
 
-		if (askedToShutdown()) {
+		if (contextAskedToShutdown(ctx)) {
 			return;
 		}
 
@@ -1342,21 +1477,22 @@ void handleSelectAndRandom(struct BranchPath *curNode, int select, int randomise
 	// When not doing the select methodology, and opting for randomize
 	// just shuffle the entire list of legal moves and pick the new first item
 	else if (randomise) {
-		if (askedToShutdown()) {
+		if (contextAskedToShutdown(ctx)) {
 			return;
 		}
-		shuffleLegalMoves(curNode);
+		shuffleLegalMoves(ctx, curNode);
 	}
 }
 
 /*-------------------------------------------------------------------
  * Function 	: handleSorts
- * Inputs	: struct BranchPath	*curNode
+ * Inputs	: struct SearchContext	*ctx
+ *		  struct BranchPath	*curNode
  *
  * Perform the 4 different sorts, determine if they changed the inventory,
  * and if so, generate a legal move to represent the sort.
  -------------------------------------------------------------------*/
-void handleSorts(struct BranchPath *curNode) {
+void handleSorts(struct SearchContext *ctx, struct BranchPath *curNode) {
 	// Limit the number of sorts allowed in a roadmap
 	if (curNode->totalSorts < 10) {
 		// Perform the 4 different sorts
@@ -1373,10 +1509,10 @@ void handleSorts(struct BranchPath *curNode) {
 				description.framesTaken = sortFrames;
 
 				// Create the legalMove node
-				struct BranchPath *newLegalMove = createLegalMove(curNode, sorted_inventory, description, curNode->outputCreated, curNode->numOutputsCreated);
+				struct BranchPath *newLegalMove = createLegalMove(ctx, curNode, sorted_inventory, description, curNode->outputCreated, curNode->numOutputsCreated);
 
 				// Insert this new move into the current node's legalMove array
-				insertIntoLegalMoves(curNode->numLegalMoves, newLegalMove, curNode);
+				insertIntoLegalMoves(ctx, curNode->numLegalMoves, newLegalMove, curNode);
 			}
 		}
 	}
@@ -1384,13 +1520,13 @@ void handleSorts(struct BranchPath *curNode) {
 
 /*-------------------------------------------------------------------
  * Function 	: initializeRoot
- * Inputs	: struct Job		job
+ * Inputs	: struct SearchContext	*ctx
  * Outputs	: struct BranchPath	*root
  *
  * Generate the root of the tree graph
  -------------------------------------------------------------------*/
-struct BranchPath *initializeRoot() {
-	struct BranchPath *root = createMoveQuick();
+struct BranchPath *initializeRoot(struct SearchContext *ctx) {
+	struct BranchPath *root = createMoveQuick(ctx);
 
 	checkMallocFailed(root);
 
@@ -1463,7 +1599,8 @@ static struct CapacityComputationResult capacityCompute(const ssize_t currentCap
 
 /*-------------------------------------------------------------------
  * Function 	: insertIntoLegalMoves
- * Inputs	: int			insertIndex
+ * Inputs	: struct SearchContext	*ctx
+ *		  int			insertIndex
  *		  struct BranchPath	*newLegalMove
  *		  struct BranchPath	*curNode
  *
@@ -1474,7 +1611,7 @@ static struct CapacityComputationResult capacityCompute(const ssize_t currentCap
  * Note: Even though newLegalMove is never modified in this function,
  * it maybe be set as a pointer in the curNode->legalMoves array, and thus it is not const
  -------------------------------------------------------------------*/
-void insertIntoLegalMoves(int insertIndex, struct BranchPath *mutableNewLegalMove, struct BranchPath *curNode) {
+void insertIntoLegalMoves(struct SearchContext *ctx, int insertIndex, struct BranchPath *mutableNewLegalMove, struct BranchPath *curNode) {
   // Prefer to work with the const version when possible to ensure we really don't modify it.
   const struct BranchPath *newLegalMove = mutableNewLegalMove;
 	struct CapacityComputationResult capacityChanges = capacityCompute(
@@ -1483,6 +1620,7 @@ void insertIntoLegalMoves(int insertIndex, struct BranchPath *mutableNewLegalMov
 		// Failsafes. Ensure we are at least reaching the target of new size
 		// Reallocate the legalMove array to make room for a new legal move
 		struct BranchPath **temp = realloc(curNode->legalMoves, sizeof(curNode->legalMoves[0]) * (capacityChanges.newCapacity));
+		COUNT_SLOT_STAT(ctx->stats, allocations);
 		checkMallocFailed(temp);
 #if AGGRESSIVE_0_ALLOCATING
 		// Zero out the new parts of the array so viewing array contents doesn't cause dereferencing of invalid pointers,
@@ -1517,133 +1655,148 @@ void insertIntoLegalMoves(int insertIndex, struct BranchPath *mutableNewLegalMov
 
 	// Increase numLegalMoves
 	curNode->numLegalMoves++;
+	COUNT_SLOT_STAT(ctx->stats, legalMovesGenerated);
 
 	return;
 }
 
-/*-------------------------------------------------------------------
- * Function 	: copyAllNodes
- * Inputs	: struct BranchPath	*newNode
- *		  struct BranchPath	*oldNode
- * Outputs	: struct BranchPath	*newNode
- *
- * Duplicate all the contents of a roadmap to a new memory region.
- * This is used for optimizeRoadmap.
- -------------------------------------------------------------------*/
-struct BranchPath *copyAllNodes(struct BranchPath *newNode, const struct BranchPath *oldNode) {
-	do {
-		newNode->moves = oldNode->moves;
-		newNode->inventory = oldNode->inventory;
-		newNode->description = oldNode->description;
-		switch (newNode->description.action) {
-			case (Begin) :
-				newNode->description.data = NULL;
-				break;
-			case (Sort_Alpha_Asc) :
-				newNode->description.data = NULL;
-				break;
-			case (Sort_Alpha_Des) :
-				newNode->description.data = NULL;
-				break;
-			case (Sort_Type_Asc) :
-				newNode->description.data = NULL;
-				break;
-			case (Sort_Type_Des) :
-				newNode->description.data = NULL;
-				break;
-			case (Cook) :
-				newNode->description.data = malloc(sizeof(struct Cook));
-
-				checkMallocFailed(newNode->description.data);
-
-				copyCook((struct Cook *)newNode->description.data, (struct Cook *)oldNode->description.data);
-				break;
-			case (Ch5) :
-				newNode->description.data = malloc(sizeof(struct CH5));
-
-				checkMallocFailed(newNode->description.data);
-
-				struct CH5 *newData = (struct CH5 *)newNode->description.data;
-				struct CH5 *oldData = (struct CH5 *)oldNode->description.data;
-				newData->indexDriedBouquet = oldData->indexDriedBouquet;
-				newData->indexCoconut =  oldData->indexCoconut;
-				newData->ch5Sort = oldData->ch5Sort;
-				newData->indexKeelMango = oldData->indexKeelMango;
-				newData->indexCourageShell = oldData->indexCourageShell;
-				newData->indexThunderRage = oldData->indexThunderRage;
-				newData->lateSort = oldData->lateSort;
-				break;
-			default :
-				break;
-		}
-
-		copyOutputsFulfilledNoAlloc(newNode->outputCreated, oldNode->outputCreated);
-		newNode->numOutputsCreated = oldNode->numOutputsCreated;
-		newNode->legalMoves = NULL;
-		newNode->numLegalMoves = 0;
-		newNode->capacityLegalMoves = 0;
-		if (newNode->numOutputsCreated < NUM_RECIPES) {
-			newNode->next = createMoveZeroed();
-
-			checkMallocFailed(newNode->next);
-
-			newNode->next->prev = newNode;
-			newNode = newNode->next;
-		}
-		else {
-			newNode->next = NULL;
-		}
-
-		oldNode = oldNode->next;
-	} while (oldNode != NULL);
-
-	// Returns the deepest node in the tree after copying everything
-	return newNode;
-}
-
 /*-------------------------------------------------------------------
  * Function 	: optimizeRoadmap
- * Inputs	: struct BranchPath		*root
- * Outputs	: struct OptimizeResult	result
+ * Inputs	: struct BranchPath	*root
+ *		  struct CompactRoadmap	*optimized
  *
  * Given a complete roadmap, attempt to rearrange recipes such that they
  * are placed in more efficient locations in the roadmap. This is effective
  * in shaving off upwards of 100 frames off of a roadmap.
+ * The roadmap itself is left untouched, and the rearranged one is only
+ * written out as its moves, so no nodes are allocated. Use buildReplayPath
+ * to turn it into a path if it is needed as one.
  -------------------------------------------------------------------*/
-struct OptimizeResult optimizeRoadmap(const struct BranchPath *root) {
-	// First copy all nodes to new memory locations so we can begin rearranging nodes
-	struct BranchPath *newRoot = createMoveZeroed();
-
-	checkMallocFailed(newRoot);
-
-	newRoot->prev = NULL;
-
-	// newNode is now the leaf of the tree (for easy list manipulation later)
-	struct BranchPath *newNode = copyAllNodes(newRoot, root);
+void optimizeRoadmap(const struct BranchPath *root, struct CompactRoadmap *optimized) {
+	// Nodes of the roadmap which stay where they are, starting with root
+	const struct BranchPath *keptNodes[REPLAY_MAX_MOVES + 1];
 
 	// List of recipes that can be potentially rearranged into a better location within the roadmap
 	enum Type_Sort rearranged_recipes[NUM_RECIPES];
 
-	// Ignore the last recipe as the mistake can almost always be cooked last
-	newNode = newNode->prev;
-
 	// Determine which steps can be rearranged
-	int num_rearranged_recipes = removeRecipesForReallocation(newNode, rearranged_recipes);
+	int numKeptNodes = 0;
+	int num_rearranged_recipes = removeRecipesForReallocation(root, keptNodes, &numKeptNodes, rearranged_recipes);
 
-	// Now that all rearranged items have been removed,
-	// find the optimal place they can be inserted again, such that they don't affect the inventory
-	reallocateRecipes(newRoot, rearranged_recipes, num_rearranged_recipes);
+	// Now find the optimal place the removed recipes can be inserted again, such that they don't affect the inventory,
+	// and write out the new roadmap
+	reallocateRecipes(keptNodes, numKeptNodes, rearranged_recipes, num_rearranged_recipes, optimized);
+}
 
-	// All items have been rearranged and placed into a new roadmap
-	// Recalculate the total frame count
-	for (newNode = newRoot; newNode->next != NULL; newNode = newNode->next) {
-		newNode->next->description.totalFramesTaken = newNode->next->description.framesTaken + newNode->description.totalFramesTaken;
+/*-------------------------------------------------------------------
+ * Function 	: saveRecordRoadmap
+ * Inputs	: struct CompactRoadmap	*roadmap
+ * Outputs	: bool			saved
+ *
+ * Build the nodes of a record roadmap, which until now was only held as
+ * its moves, and save it to results/ as text and binary. Returns true
+ * once the moves replayed to the frames claimed and the text file was
+ * written, as only then can the record be submitted.
+ -------------------------------------------------------------------*/
+static bool saveRecordRoadmap(const struct CompactRoadmap *roadmap) {
+	bool saved = false;
+	enum ReplayError error = REPLAY_OK;
+	int failedMove = -1;
+	struct BranchPath *last = buildReplayPath(roadmap->moves, roadmap->numMoves, &error, &failedMove);
+	if (last == NULL || last->description.totalFramesTaken != roadmap->frames) {
+		char message[150];
+		sprintf(message, "Could not rebuild the %d frame record roadmap to save it: %s at move %d", roadmap->frames,
+			last == NULL ? getReplayErrorName(error) : getReplayErrorName(REPLAY_STATE_MISMATCH), failedMove);
+		recipeLog(1, "Calculator", "Roadmap", "Error", message);
 	}
+	else {
+		struct BranchPath *root = last;
+		while (root->prev != NULL) {
+			root = root->prev;
+		}
+		char *filename = malloc(sizeof(char) * 17);
+		sprintf(filename, "results/%d.txt", roadmap->frames);
+		saved = printResults(filename, root);
+		sprintf(filename, "results/%d.bin", roadmap->frames);
+		writeBinaryRoadmap(filename, root);
+		free(filename);
+	}
+	if (last != NULL) {
+		freeAllNodes(last);
+	}
+	return saved;
+}
 
-	struct OptimizeResult result;
-	result.root = newRoot;
-	result.last = newNode;
-	return result;
+/*-------------------------------------------------------------------
+ * Function 	: optimizeAndSaveRoadmap
+ * Inputs	: int			rawID
+ *		  struct BranchPath	*root
+ *		  int			frames
+ *		  int			*optimizedFrames
+ *		  bool			allowLocalSearch
+ * Outputs	: bool			newRecord
+ *
+ * Optimize a complete roadmap which finished at frames, and if that
+ * beats the local record, save it to results/. Called by the optimizer
+ * thread on behalf of search thread rawID, or by the search thread
+ * itself when the optimizer is busy, in which case allowLocalSearch is
+ * false so the search never stalls on a local search.
+ -------------------------------------------------------------------*/
+bool optimizeAndSaveRoadmap(int rawID, const struct BranchPath *root, int frames, int *optimizedFrames, bool allowLocalSearch) {
+	struct CompactRoadmap optimized;
+	optimizeRoadmap(root, &optimized);
+	*optimizedFrames = optimized.frames;
+	// Roadmaps close enough to the record get a short local search for what optimizeRoadmap can't find
+	int localSearchFrames = getConfigInt("localSearchFrames");
+	int localSearchMillis = getConfigInt("localSearchMillis");
+	if (allowLocalSearch && localSearchFrames > 0 && localSearchMillis > 0 && *optimizedFrames < getLocalRecord() + localSearchFrames) {
+		if (improveRoadmapLocally(&optimized, localSearchMillis / 1000.0)) {
+			if (will_log_level(3)) {
+				char tmp[200];
+				sprintf(tmp, "Thread %d][Local search saved %d frames on a %d frame roadmap", rawID + 1, *optimizedFrames - optimized.frames, *optimizedFrames);
+				recipeLog(3, "Calculator", "Optimizer", "Local Search", tmp);
+			}
+			// The moved sorts can open up cheaper places for the tossed recipes, so rearrange them again
+			struct BranchPath *last = buildReplayPath(optimized.moves, optimized.numMoves, NULL, NULL);
+			if (last != NULL) {
+				struct BranchPath *improvedRoot = last;
+				while (improvedRoot->prev != NULL) {
+					improvedRoot = improvedRoot->prev;
+				}
+				struct CompactRoadmap reoptimized;
+				optimizeRoadmap(improvedRoot, &reoptimized);
+				if (reoptimized.frames < optimized.frames) {
+					optimized = reoptimized;
+				}
+				freeAllNodes(last);
+			}
+			*optimizedFrames = optimized.frames;
+		}
+	}
+	bool newRecord = false;
+	if (*optimizedFrames < getLocalRecord()) {
+		#pragma omp critical(optimize)
+		{
+			// The record is only lowered, and so published, once the roadmap is safely in results/.
+			// Another roadmap (maybe in another process) may have been saved since the check above.
+			if (*optimizedFrames < getLocalRecord() && (benchmarkMode || saveRecordRoadmap(&optimized))) {
+				newRecord = lowerLocalRecord(*optimizedFrames);
+			}
+			if (newRecord) {
+				NOISY_DEBUG("New PB!\n");
+				if (will_log_level(1)) {
+					char tmp[200];
+					sprintf(tmp, "Thread %d][New local fastest roadmap found! %d frames, saved %d after rearranging", rawID + 1, *optimizedFrames, frames - *optimizedFrames);
+					recipeLog(1, "Calculator", "Info", "Roadmap", tmp);
+				}
+				reportClusterRecord(&optimized);
+				if (getConfigInt("debug")) {
+					spoolSubmission(*optimizedFrames);
+				}
+			}
+		}
+	}
+	return newRecord;
 }
 
 /*-------------------------------------------------------------------
@@ -1898,19 +2051,22 @@ void printNodeDescription(const struct BranchPath * curNode, FILE * fp)
  * Function 	: printResults
  * Inputs	: char			*filename
  *		  struct BranchPath	*path
+ * Outputs	: bool			written
  *
  * Parent function for children print functions. This parent function
  * is called when a roadmap has been found which beats the current
  * local record.
  -------------------------------------------------------------------*/
-void printResults(const char *filename, const struct BranchPath *path) {
-	FILE *fp = fopen(filename, "w");
-	if (fp == NULL) {
+bool printResults(const char *filename, const struct BranchPath *path) {
+	// Written to a temporary file first, so an interrupted write never leaves a truncated roadmap behind
+	struct AtomicFile file;
+	if (!atomicFileOpen(&file, filename)) {
 		printf("Could not locate %s... This is a bug.\n", filename);
 		printf("Press ENTER to exit.\n");
 		ABSL_ATTRIBUTE_UNUSED char exitChar = getchar();
 		exit(1);
 	}
+	FILE *fp = file.fp;
 	// Write header information
 	printFileHeader(fp);
 
@@ -1934,9 +2090,81 @@ void printResults(const char *filename, const struct BranchPath *path) {
 		fprintf(fp, "\n");
 	} while ((curNode = curNode->next) != NULL);
 
-	fclose(fp);
+	if (!atomicFileCommit(&file)) {
+		recipeLog(1, "Calculator", "File", "Error", "Unable to save roadmap.");
+		return false;
+	}
 
 	recipeLog(5, "Calculator", "File", "Write", "Data for roadmap written.");
+	return true;
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: setBenchmarkMode
+ * Inputs	: bool	enabled
+ *
+ * Stop calculateOrder from writing results or checking for updates.
+ * Must be called before any calls to calculateOrder.
+ -------------------------------------------------------------------*/
+void setBenchmarkMode(bool enabled) {
+	benchmarkMode = enabled;
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: setSavedPbRecord
+ * Inputs	: int	frames
+ *
+ * Record the PB that was read from results/PB.txt at startup.
+ * Must be called before any calls to calculateOrder.
+ -------------------------------------------------------------------*/
+void setSavedPbRecord(int frames) {
+	savedPbRecord = frames;
+	writtenPbRecord = frames;
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: writePbFile
+ *
+ * Bring results/PB.txt up to date with the in-memory PB. The file is
+ * replaced atomically, so it is never seen truncated or half written.
+ * Writes are serialized and always use the latest PB, so a slower
+ * thread finishing its write late can never replace a faster record.
+ * When the record is shared with other processes, their writes are
+ * serialized too, and a file already holding a faster PB is left be.
+ -------------------------------------------------------------------*/
+static void writePbFile() {
+	#pragma omp critical(pb_file)
+	{
+		int latest;
+		#pragma omp critical(pb)
+		{
+			latest = savedPbRecord;
+		}
+		if (latest < writtenPbRecord) {
+			const bool sharedLock = lockSharedRecordFile();
+			FILE *fp = sharedLock ? fopen("results/PB.txt", "r") : NULL;
+			int written;
+			if (fp != NULL) {
+				if (fscanf(fp, "%d", &written) == 1 && written >= 0 && written <= latest) {
+					writtenPbRecord = latest;
+				}
+				fclose(fp);
+			}
+			if (latest < writtenPbRecord) {
+				char contents[16];
+				sprintf(contents, "%d", latest);
+				if (atomicWriteString("results/PB.txt", contents)) {
+					writtenPbRecord = latest;
+				}
+				else {
+					recipeLog(1, "Calculator", "Roadmap", "Error", "Unable to write results/PB.txt. Will try again on the next PB.");
+				}
+			}
+			if (sharedLock) {
+				unlockSharedRecordFile();
+			}
+		}
+	}
 }
 
 /*-------------------------------------------------------------------
@@ -1966,199 +2194,211 @@ void printSortData(FILE *fp, enum Action curNodeAction) {
 	};
 }
 
+// The cheapest way found to cook (and toss) one of the recipes being reinserted
+struct Reinsertion {
+	int frames;
+	int placement;	// The new cook goes right after this kept node, or -1 if none was found
+	struct Cook cook;
+};
+
+/*-------------------------------------------------------------------
+ * Function : considerReinsertion
+ * Inputs	: struct Reinsertion	*best
+ *			  struct Inventory	*inventory
+ *			  int				placement
+ *			  enum Type_Sort	output
+ *			  int				numItems
+ *			  enum Type_Sort	item1
+ *			  int				itemIndex1
+ *			  enum Type_Sort	item2
+ *			  int				itemIndex2
+ *
+ * Cost the cook, picking the ingredient in itemIndex1 first, and keep
+ * it if it beats the best placement so far. The frames are computed
+ * with getCookFrames, exactly as the search costs its own cooks.
+ -------------------------------------------------------------------*/
+static void considerReinsertion(struct Reinsertion *best, const struct Inventory *inventory, int placement, enum Type_Sort output, int numItems,
+	enum Type_Sort item1, int itemIndex1, enum Type_Sort item2, int itemIndex2) {
+	const int ingredientLoc[2] = { itemIndex1, itemIndex2 };
+	const int frames = TOSS_FRAMES + getCookFrames(inventory, ingredientLoc, numItems);
+	if (frames >= best->frames) {
+		return;
+	}
+	best->frames = frames;
+	best->placement = placement;
+	best->cook = EMPTY_COOK;
+	best->cook.numItems = numItems;
+	best->cook.item1 = item1;
+	best->cook.itemIndex1 = itemIndex1;
+	best->cook.item2 = item2;
+	best->cook.itemIndex2 = itemIndex2;
+	best->cook.output = output;
+	best->cook.handleOutput = Toss;
+}
+
+// Append a move to the roadmap being written out by reallocateRecipes
+static void appendOptimizedMove(struct CompactRoadmap *optimized, const struct ReplayMove *move, int framesTaken) {
+	_assert_with_stacktrace(optimized->numMoves < REPLAY_MAX_MOVES);
+	optimized->moves[optimized->numMoves++] = *move;
+	optimized->frames += framesTaken;
+}
+
 /*-------------------------------------------------------------------
  * Function : reallocateRecipes
- * Inputs	: struct BranchPath	*newRoot
+ * Inputs	: struct BranchPath	**keptNodes
+ *			  int				numKeptNodes
  *			  enum Type_Sort	*rearranged_recipes
  *			  int				num_rearranged_recipes
+ *			  struct CompactRoadmap	*optimized
  *
  * Given a set of recipes, find alternative places in the roadmap to
- * cook these recipes such that we minimize the frame cost.
- * Note: Even though newRoot is never modified in this function,
- * it may be set as the pointer to newly allocated nodes, and thus is not const
+ * cook these recipes such that we minimize the frame cost, and write
+ * the moves of the kept nodes, with the recipes in their new places, to
+ * optimized.
+ * A reinserted cook only uses ingredients from the last 10 slots (which
+ * are duplicated) and tosses its output, so it leaves the inventory
+ * exactly as it was. The cost of a recipe at a placement therefore does
+ * not depend on where the other recipes go, and taking the cheapest
+ * placement of each recipe on its own is the optimal joint assignment,
+ * whatever order the recipes come in. Every copy of each ingredient, and
+ * both orders of picking 2 ingredients, are tried.
  -------------------------------------------------------------------*/
-void reallocateRecipes(struct BranchPath* mutableNewRoot, const enum Type_Sort* rearranged_recipes, int num_rearranged_recipes) {
-  // Prefer to work with the const version when possible to ensure we really don't modify it.
-  ABSL_ATTRIBUTE_UNUSED const struct BranchPath* newRoot = mutableNewRoot;
+void reallocateRecipes(const struct BranchPath *const *keptNodes, int numKeptNodes, const enum Type_Sort *rearranged_recipes, int num_rearranged_recipes,
+	struct CompactRoadmap *optimized) {
+	struct Reinsertion best[NUM_RECIPES];
+
+	// Every placement is chosen on the roadmap as it was before anything is reinserted
 	for (int recipe_offset = 0; recipe_offset < num_rearranged_recipes; recipe_offset++) {
-		// Establish a default bound for the optimal place for this item
-		int record_frames = 9999;
-		struct BranchPath *record_placement_node = NULL;
-		struct Cook *record_description = NULL;
-		struct Cook temp_description = {0};
-
-		// Evaluate all recipes and determine the optimal recipe and location
-		int recipe_index = getIndexOfRecipe(rearranged_recipes[recipe_offset]);
-		struct Recipe recipe = recipeList[recipe_index];
+		best[recipe_offset].frames = INT_MAX;
+		best[recipe_offset].placement = -1;
+
+		struct Recipe recipe = recipeList[getIndexOfRecipe(rearranged_recipes[recipe_offset])];
 		for (int recipe_combo_index = 0; recipe_combo_index < recipe.countCombos; recipe_combo_index++) {
 			struct ItemCombination combo = recipe.combos[recipe_combo_index];
 
-			// Evaluate placing after each node where it can be placed
-			for (struct BranchPath *mutablePlacement = combo.numItems == 2 ? mutableNewRoot->next : mutableNewRoot;
-			    mutablePlacement != NULL; mutablePlacement = mutablePlacement->next) {
-			  // Prefer to work with the const version when possible to ensure we really don't modify it.
-			  const struct BranchPath *placement = mutablePlacement;
+			// Evaluate placing after each node where it can be placed. Never after the last node:
+			// the final cook would no longer end the roadmap, and its Jump Storage penalty would change.
+			for (int placement = combo.numItems == 2 ? 1 : 0; placement < numKeptNodes - 1; placement++) {
 				// Only want moments when there are no NULLs in the inventory
-				if (placement->inventory.nulls) {
+				const struct Inventory *inventory = &keptNodes[placement]->inventory;
+				if (inventory->nulls) {
 					continue;
 				}
 
 				// Only want recipes where all ingredients are in the last 10 slots of the evaluated inventory
-				int indexItem1 = indexOfItemInInventory(placement->inventory, combo.item1);
-				int indexItem2 = INDEX_ITEM_UNDEFINED;
-				if (indexItem1 < 10) {
-					continue;
-				}
-				if (combo.numItems == 2) {
-					indexItem2 = indexOfItemInInventory(placement->inventory, combo.item2);
-					if (indexItem2 < 10) {
+				for (int indexItem1 = 10; indexItem1 < inventory->length; ++indexItem1) {
+					if (inventory->inventory[indexItem1] != combo.item1) {
 						continue;
 					}
-				}
-
-				// This is a valid recipe and location to fulfill (and toss) the output
-				// Calculate the frames needed to produce this step
-				int temp_frames = TOSS_FRAMES;
-				temp_description = EMPTY_COOK;
-				temp_description.output = recipe.output;
-				temp_description.handleOutput = Toss;
-
-				if (combo.numItems == 1) {
-					// Only one ingredient to navigate to
-					temp_frames += invFrames[placement->inventory.length - 1][indexItem1];
-					temp_description.numItems = 1;
-					temp_description.item1 = combo.item1;
-					temp_description.itemIndex1 = indexItem1;
-					temp_description.item2 = -1;
-					temp_description.itemIndex2 = -1;
-				}
-				else {
-					_assert_with_stacktrace(indexItem2 != INDEX_ITEM_UNDEFINED);
-
-					// Two ingredients to navigate to, but order matters
-					// Pick the larger-index number ingredient first, as it will reduce
-					// the frames needed to reach the other ingredient
-					temp_frames += CHOOSE_2ND_INGREDIENT_FRAMES;
-					temp_description.numItems = 2;
-
-					if (indexItem1 > indexItem2) {
-						temp_frames += invFrames[placement->inventory.length - 1][indexItem1];
-						temp_frames += invFrames[placement->inventory.length - 2][indexItem2];
-						temp_description.item1 = combo.item1;
-						temp_description.itemIndex1 = indexItem1;
-						temp_description.item2 = combo.item2;
-						temp_description.itemIndex2 = indexItem2;
-					}
-					else {
-						temp_frames += invFrames[placement->inventory.length - 1][indexItem2];
-						temp_frames += invFrames[placement->inventory.length - 2][indexItem1];
-						temp_description.item1 = combo.item2;
-						temp_description.itemIndex1 = indexItem2;
-						temp_description.item2 = combo.item1;
-						temp_description.itemIndex2 = indexItem1;
+					if (combo.numItems == 1) {
+						considerReinsertion(&best[recipe_offset], inventory, placement, recipe.output, 1, combo.item1, indexItem1, -1, -1);
+						continue;
 					}
-				}
-
-				// Compare the current placement to the current record
-				if (temp_frames < record_frames) {
-					// Update the record information
-					record_frames = temp_frames;
-					record_placement_node = mutablePlacement;
-
-					if (record_description == NULL) {
-						record_description = malloc(sizeof(struct Cook));
-						checkMallocFailed(record_description);
+					for (int indexItem2 = 10; indexItem2 < inventory->length; ++indexItem2) {
+						if (indexItem2 == indexItem1 || inventory->inventory[indexItem2] != combo.item2) {
+							continue;
+						}
+						// Either ingredient can be picked first; try the larger index first
+						if (indexItem1 > indexItem2) {
+							considerReinsertion(&best[recipe_offset], inventory, placement, recipe.output, 2, combo.item1, indexItem1, combo.item2, indexItem2);
+							considerReinsertion(&best[recipe_offset], inventory, placement, recipe.output, 2, combo.item2, indexItem2, combo.item1, indexItem1);
+						}
+						else {
+							considerReinsertion(&best[recipe_offset], inventory, placement, recipe.output, 2, combo.item2, indexItem2, combo.item1, indexItem1);
+							considerReinsertion(&best[recipe_offset], inventory, placement, recipe.output, 2, combo.item1, indexItem1, combo.item2, indexItem2);
+						}
 					}
-					copyCook(record_description, &temp_description);
 				}
 			}
 		}
 
 		// All recipe combos and intervals have been evaluated
-		// Insert the optimized output in the designated interval
-		if (record_placement_node == NULL) {
+		if (best[recipe_offset].placement < 0) {
 			// This is an error
 			recipeLog(7, "Calculator", "Roadmap", "Optimize", "OptimizeRoadmap couldn't find a valid placement...");
 			exit(1);
 		}
+	}
 
-		struct BranchPath *insertNode = createMoveZeroed();
-		checkMallocFailed(insertNode);
-
-		// Set pointers to and from surrounding structs
-		insertNode->prev = record_placement_node;
-		record_placement_node->next->prev = insertNode;
-		insertNode->next = record_placement_node->next;
-		record_placement_node->next = insertNode;
-
-		// Initialize the new node
-		insertNode->moves = record_placement_node->moves + 1;
-		insertNode->inventory = record_placement_node->inventory;
-		insertNode->description.action = Cook;
-		insertNode->description.data = (void *)record_description;
-		insertNode->description.framesTaken = record_frames;
-		copyOutputsFulfilledNoAlloc(insertNode->outputCreated, record_placement_node->outputCreated);
-		insertNode->outputCreated[recipe_index] = true;
-		insertNode->numOutputsCreated = record_placement_node->numOutputsCreated + 1;
-		insertNode->legalMoves = NULL;
-		insertNode->numLegalMoves = 0;
-		insertNode->capacityLegalMoves = 0;
+	// Write out the kept moves, each followed by the recipes placed after it, in roadmap order
+	optimized->numMoves = 0;
+	optimized->frames = keptNodes[0]->description.totalFramesTaken;
+	for (int placement = 0; placement < numKeptNodes; placement++) {
+		struct ReplayMove move;
+		if (placement > 0) {
+			getReplayMove(keptNodes[placement], &move);
+			appendOptimizedMove(optimized, &move, keptNodes[placement]->description.framesTaken);
+		}
+		for (int recipe_offset = 0; recipe_offset < num_rearranged_recipes; recipe_offset++) {
+			if (best[recipe_offset].placement != placement) {
+				continue;
+			}
+			memset(&move, 0, sizeof(move));
+			move.action = Cook;
+			move.cook = best[recipe_offset].cook;
+			appendOptimizedMove(optimized, &move, best[recipe_offset].frames);
+		}
+	}
+}
 
-		// Update all subsequent nodes with
-		for (struct BranchPath *node = insertNode->next; node!= NULL; node = node->next) {
-			node->outputCreated[recipe_index] = true;
-			++node->numOutputsCreated;
-			++node->moves;
+/*-------------------------------------------------------------------
+ * Function 	: removeCookIngredients
+ * Inputs	: struct Inventory	inventory
+ *		  int			*ingredientLoc
+ *		  int			numItems
+ * Outputs	: struct Inventory	inventory
+ *
+ * Set each ingredient's inventory index to null if the item was in the
+ * first 10 slots. Items in the last 10 slots are duplicated, so they stay.
+ -------------------------------------------------------------------*/
+struct Inventory removeCookIngredients(struct Inventory inventory, const int *ingredientLoc, int numItems) {
+	if (numItems == 1) {
+		if (ingredientLoc[0] < 10) {
+			inventory = removeItem(inventory, ingredientLoc[0]);
 		}
+		return inventory;
 	}
+
+	// To reduce complexity, remove the items in ascending order of index
+	int lower = ingredientLoc[0] < ingredientLoc[1] ? ingredientLoc[0] : ingredientLoc[1];
+	int upper = ingredientLoc[0] < ingredientLoc[1] ? ingredientLoc[1] : ingredientLoc[0];
+	if (lower < 10) {
+		inventory = removeItem(inventory, lower);
+	}
+	if (upper < 10) {
+		inventory = removeItem(inventory, upper);
+	}
+	return inventory;
 }
 
 /*-------------------------------------------------------------------
  * Function : removeRecipesForReallocation
- * Inputs	: struct BranchPath	*node
+ * Inputs	: struct BranchPath	*root
+ *			  struct BranchPath	**keptNodes
+ *			  int				*numKeptNodes
  *			  enum Type_Sort	*rearranged_recipes
+ * Outputs	: int				num_rearranged_recipes
  *
  * Look through a completed roadmap to find recipes which can be
  * performed elsewhere in the roadmap without affecting the inventory.
- * Store these recipes in rearranged_recipes for later.
+ * Store these recipes in rearranged_recipes for later, and every other
+ * node (starting with root) in keptNodes. The roadmap is not modified.
  -------------------------------------------------------------------*/
-int removeRecipesForReallocation(struct BranchPath* node, enum Type_Sort *rearranged_recipes) {
+int removeRecipesForReallocation(const struct BranchPath *root, const struct BranchPath **keptNodes, int *numKeptNodes, enum Type_Sort *rearranged_recipes) {
 	int num_rearranged_recipes = 0;
-	while (node->moves > 1) {
-		// Ignore sorts/CH5
-		if (node->description.action != Cook) {
-			node = node->prev;
-			continue;
-		}
-
-		// Ignore recipes which do not toss the output
-		struct Cook* cookData = (struct Cook*)node->description.data;
-		if (cookData->handleOutput != Toss) {
-			node = node->prev;
+	for (const struct BranchPath *node = root; node != NULL; node = node->next) {
+		// Only recipes which toss the output can be moved. Ignore sorts/CH5, the first move,
+		// and the last recipe, as the mistake can almost always be cooked last.
+		if (node->moves > 1 && node->next != NULL && node->description.action == Cook
+			&& ((const struct Cook *)node->description.data)->handleOutput == Toss) {
+			// This output can potentially be relocated to a quicker time
+			rearranged_recipes[num_rearranged_recipes] = ((const struct Cook *)node->description.data)->output;
+			num_rearranged_recipes++;
 			continue;
 		}
 
-		// At this point, we have a recipe which tosses the output
-		// This output can potentially be relocated to a quicker time
-		enum Type_Sort tossed_item = cookData->output;
-		rearranged_recipes[num_rearranged_recipes] = tossed_item;
-		num_rearranged_recipes++;
-
-		// First update subsequent nodes to remove this item from outputCreated
-		struct BranchPath* newNode = node->next;
-		while (newNode != NULL) {
-			newNode->outputCreated[getIndexOfRecipe(tossed_item)] = 0;
-			newNode->numOutputsCreated--;
-			newNode = newNode->next;
-		}
-
-		// Now, get rid of this current node
-		checkMallocFailed(node->next);
-		node->prev->next = node->next;
-		node->next->prev = node->prev;
-		newNode = node->prev;
-		freeNode(node);
-		node = newNode;
+		_assert_with_stacktrace(*numKeptNodes <= REPLAY_MAX_MOVES);
+		keptNodes[(*numKeptNodes)++] = node;
 	}
 
 	return num_rearranged_recipes;
@@ -2276,48 +2516,99 @@ void shiftUpLegalMoves(struct BranchPath *node, int startIndex) {
 }
 
 /*-------------------------------------------------------------------
- * Function 	: softMin
- * Inputs	: struct BranchPath	*node
+ * Function 	: initializeSoftMin
+ * Inputs	: int	temperature
  *
- * This is an experimental function which may substitute the original
- * "select" methodology when determining what next node to explore.
- * This is a variation of the Softmax function. Essentially, the
- * original methodology uses an arbitrary distribution when determining
- * which legal move to take. softMin uses the framecount of each legal
- * move to construct a distribution for which a given node will have a
- * higher probability than subsequent nodes depending on how much faster
- * the given node is compared to the subsequent nodes.
- * For more information on Softmax: https://en.wikipedia.org/wiki/Softmax_function
+ * Tabulate the softmin weight e^(-n / temperature) of a legal move n
+ * frames slower than the fastest, so softMin needs no floating point.
+ * A temperature of 0 or less disables softMin. Must be called before
+ * any SearchContext is initialized, as each one copies the setting.
  -------------------------------------------------------------------*/
-void softMin(struct BranchPath *node) {
-	// If numLegalMoves is 0 or 1, we will get an error when trying to do x % 0
-	if (node->numLegalMoves < 2) {
+void initializeSoftMin(int temperature) {
+	softMinMaxDelta = -1;
+	if (temperature <= 0) {
 		return;
 	}
 
-	// Calculate the sum of framecount for all legalMoves
-	int frameCountSum = 0;
-	for (int i = 0; i < node->numLegalMoves; i++) {
-		frameCountSum += node->legalMoves[i]->description.framesTaken;
+	// e^(-1 / temperature) by its Taylor series, as the argument is at most 1
+	double ratio = 1.0;
+	double term = 1.0;
+	for (int i = 1; i < 20; ++i) {
+		term *= -1.0 / (temperature * i);
+		ratio += term;
+	}
+
+	double weight = SOFTMIN_WEIGHT_SCALE;
+	for (int delta = 0; delta <= SOFTMIN_MAX_FRAME_DELTA && (int)(weight + 0.5) > 0; ++delta) {
+		softMinWeights[delta] = (int)(weight + 0.5);
+		softMinMaxDelta = delta;
+		weight *= ratio;
 	}
+}
 
-	// Do some janky shit to recalculate the sum such that the node with the
-	// lowest framecount has a higher "value"
+/*-------------------------------------------------------------------
+ * Function 	: softMinWeight
+ * Inputs	: struct SearchContext	*ctx
+ *		  struct BranchPath	*move
+ *		  int			fastestFrames
+ * Outputs	: int			weight of the move under softMin
+ *
+ * Sorts make no progress by themselves, so a sort costs all of its frames
+ * on top of the fastest move; anything else costs the frames it takes
+ * past the fastest move.
+ -------------------------------------------------------------------*/
+static inline int softMinWeight(const struct SearchContext *ctx, const struct BranchPath *move, int fastestFrames) {
+	const struct MoveDescription *description = &move->description;
+	const int delta = (description->action >= Sort_Alpha_Asc && description->action <= Sort_Type_Des)
+		? description->framesTaken
+		: MAX(description->framesTaken - fastestFrames, 0);
+	return delta > ctx->softMinMaxDelta ? 0 : ctx->softMinWeights[delta];
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: softMin
+ * Inputs	: struct SearchContext	*ctx
+ *		  struct BranchPath	*node
+ *
+ * An alternative to the "select" methodology when determining what
+ * next node to explore. This is a variation of the Softmax function:
+ * each legal move is picked with a chance proportional to
+ * e^(-frames slower than the fastest move / temperature), so a move
+ * is picked less often the slower it is compared to the others.
+ * The pick takes a single random draw: the weights are summed in one
+ * pass, then a second pass walks them until the running sum passes the
+ * draw. Both passes are O(legal moves) on every visit, including the
+ * revisits after backtracking; caching cumulative weights would not
+ * help there, as backtracking frees the picked move and so changes
+ * every running sum after it.
+ * Only the first SOFTMIN_MAX_LEGAL_MOVES moves are weighed, which keeps
+ * the weight sum within an int; any moves past them are never picked.
+ * For more information on Softmax: https://en.wikipedia.org/wiki/Softmax_function
+ -------------------------------------------------------------------*/
+void softMin(struct SearchContext *ctx, struct BranchPath *node) {
+	if (node->numLegalMoves < 2) {
+		return;
+	}
+
+	// Cooks and Chapter 5 moves are kept in order of frames taken, so the first one is the fastest.
+	// Sorts are listed after them
+	const int fastestFrames = node->legalMoves[0]->description.framesTaken;
+	const int numMoves = MIN(node->numLegalMoves, SOFTMIN_MAX_LEGAL_MOVES);
 	int weightSum = 0;
-	for (int i = 0; i < node->numLegalMoves; i++) {
-		weightSum += (frameCountSum - node->legalMoves[i]->description.framesTaken);
+	for (int i = 0; i < numMoves; i++) {
+		weightSum += softMinWeight(ctx, node->legalMoves[i], fastestFrames);
 	}
 
-	// Generate a random number between 0 and weightSum
-	int modSum = randint(0, weightSum);
+	// Only sorts too slow to weigh are left; keep the first one
+	if (weightSum == 0) {
+		return;
+	}
 
-	// Find the legal move that corresponds to the modSum
-	int index;
-	weightSum = 0;
-	for (index = 0; index < node->numLegalMoves; index++) {
-		weightSum += (frameCountSum - node->legalMoves[index]->description.framesTaken);
-		if (modSum < weightSum) {
-			// We have found the corresponding legal move
+	int roll = (int)random_state_randint(&ctx->random, 0, weightSum);
+	int index = 0;
+	for (; index < numMoves - 1; index++) {
+		roll -= softMinWeight(ctx, node->legalMoves[index], fastestFrames);
+		if (roll < 0) {
 			break;
 		}
 	}
@@ -2337,19 +2628,20 @@ void softMin(struct BranchPath *node) {
 
 /*-------------------------------------------------------------------
  * Function 	: shuffleLegalMoves
- * Inputs	: struct BranchPath	*node
+ * Inputs	: struct SearchContext	*ctx
+ *		  struct BranchPath	*node
  *
  * Randomize the order of legal moves by switching two legal moves
  * numlegalMoves times.
  -------------------------------------------------------------------*/
-void shuffleLegalMoves(struct BranchPath *node) {
+void shuffleLegalMoves(struct SearchContext *ctx, struct BranchPath *node) {
 	// Swap 2 legal moves a variable number of times
 	for (int i = 0; i < node->numLegalMoves; i++) {
-		if (checkShutdownOnIndexWithPrefetch(i)) {
+		if (checkShutdownOnIndexWithPrefetch(ctx, i)) {
 			break;
 		}
-		int index1 = randint(0, node->numLegalMoves);
-		int index2 = randint(0, node->numLegalMoves);
+		int index1 = random_state_randint(&ctx->random, 0, node->numLegalMoves);
+		int index2 = random_state_randint(&ctx->random, 0, node->numLegalMoves);
 		struct BranchPath *temp = node->legalMoves[index1];
 		node->legalMoves[index1] = node->legalMoves[index2];
 		node->legalMoves[index2] = temp;
@@ -2379,7 +2671,8 @@ void swapItems(int *ingredientLoc) {
 
 /*-------------------------------------------------------------------
  * Function 	: tryTossInventoryItem
- * Inputs	: struct BranchPath 	  *curNode
+ * Inputs	: struct SearchContext	*ctx
+ *		  struct BranchPath 	  *curNode
  *		  enum Type_Sort	  *tempInventory
  *		  MoveDescription useDescription
  *		  int 			  *tempOutputsFulfilled
@@ -2392,25 +2685,27 @@ void swapItems(int *ingredientLoc) {
  * For the given recipe, try to toss items in the inventory in order
  * to make room for the recipe output.
  -------------------------------------------------------------------*/
-void tryTossInventoryItem(struct BranchPath *curNode, struct Inventory tempInventory, MoveDescription useDescription, const outputCreatedArray_t tempOutputsFulfilled, int numOutputsFulfilled, enum Type_Sort output, int tempFrames, int viableItems) {
+void tryTossInventoryItem(struct SearchContext *ctx, struct BranchPath *curNode, struct Inventory tempInventory, MoveDescription useDescription, const outputCreatedArray_t tempOutputsFulfilled, int numOutputsFulfilled, enum Type_Sort output, int tempFrames, int viableItems) {
 	for (int tossedIndex = 0; tossedIndex < 10; tossedIndex++) {
 		enum Type_Sort tossedItem = tempInventory.inventory[tossedIndex];
 
 		// Make a copy of the tempInventory with the replaced item
 		struct Inventory replacedInventory = replaceItem(tempInventory, tossedIndex, output);
 
-		if (!stateOK(replacedInventory, tempOutputsFulfilled, recipeList)) {
+		if (!stateOK(replacedInventory, tempOutputsFulfilled, ctx->recipeList, ctx->stats)) {
 			continue;
 		}
 
 		// Calculate the additional tossed frames.
-		int tossFrames = invFrames[viableItems][tossedIndex + 1];
+		// Each toss is a separate move, so don't let the frames of one carry over into the next
+		int tossFrames = ctx->invFrames[viableItems][tossedIndex + 1];
 		int replacedFrames = tempFrames + tossFrames;
 
-		useDescription.framesTaken += tossFrames;
-		useDescription.totalFramesTaken += tossFrames;
+		MoveDescription tossDescription = useDescription;
+		tossDescription.framesTaken += tossFrames;
+		tossDescription.totalFramesTaken += tossFrames;
 
-		finalizeLegalMove(curNode, replacedFrames, useDescription, replacedInventory, tempOutputsFulfilled, numOutputsFulfilled, TossOther, tossedItem, tossedIndex);
+		finalizeLegalMove(ctx, curNode, replacedFrames, tossDescription, replacedInventory, tempOutputsFulfilled, numOutputsFulfilled, TossOther, tossedItem, tossedIndex);
 	}
 
 	return;
@@ -2546,7 +2841,7 @@ static bool handleAfterOptimizing(char (*destText)[50], int afterOptimizingFrame
 	}
 }
 
-static void logCloseToPb(int ID, size_t preambleTextLength, const char preambleText[preambleTextLength], const struct BranchPath * curNode, int pbFrames, int afterOptimizingFrames, int level) {
+static void logCloseToPb(int ID, size_t preambleTextLength, const char preambleText[preambleTextLength], int currentFrames, int pbFrames, int afterOptimizingFrames, int level) {
 	if (will_log_level(level)) {
 		_assert_with_stacktrace(preambleTextLength < 80);
 		char callString[30];
@@ -2554,7 +2849,6 @@ static void logCloseToPb(int ID, size_t preambleTextLength, const char preambleT
 		char afterOptimizing[50];
 		sprintf(callString, "Thread %d", ID);
 		handleAfterOptimizing(&afterOptimizing, afterOptimizingFrames);
-		const int currentFrames = curNode->description.totalFramesTaken;
 		sprintf(outText, "%s: Current %d%s, PB: %d, difference %d",
 				preambleText,
 				currentFrames,
@@ -2565,7 +2859,7 @@ static void logCloseToPb(int ID, size_t preambleTextLength, const char preambleT
 	}
 }
 
-static void logIterationsAfterLimitIncrease(int ID, int stepIndex, const struct BranchPath * curNode, int afterOptimizingFrames, long iterationCount, long oldIterationLimit, long iterationLimit, int level)
+static void logIterationsAfterLimitIncrease(int ID, int stepIndex, int currentFrames, int afterOptimizingFrames, long iterationCount, long oldIterationLimit, long iterationLimit, int level)
 {
 	if (will_log_level(level)) {
 		char callString[30];
@@ -2574,7 +2868,7 @@ static void logIterationsAfterLimitIncrease(int ID, int stepIndex, const struct
 		sprintf(callString, "Thread %d", ID);
 		handleAfterOptimizing(&afterOptimizing, afterOptimizingFrames);
 		sprintf(iterationString, "%d steps currently taken, %d%s; %ldk iterations (%ldk previous iteration max, %ldk new iteration max)",
-			stepIndex, curNode->description.totalFramesTaken, afterOptimizing, iterationCount / 1000, oldIterationLimit / 1000, iterationLimit / 1000);
+			stepIndex, currentFrames, afterOptimizing, iterationCount / 1000, oldIterationLimit / 1000, iterationLimit / 1000);
 		recipeLog(level, "Calculator", "Info", callString, iterationString);
 	}
 }
@@ -2593,9 +2887,121 @@ ABSL_ATTRIBUTE_ALWAYS_INLINE static inline int getLimitIncreaseDivisor(int curre
 	return ABSL_PREDICT_FALSE(currentPb >= WEAK_PB_FLOOR) ? WEAK_PB_FLOOR_DIVISIOR : 1;
 }
 
+/*-------------------------------------------------------------------
+ * Function 	: generateLegalMoves
+ * Inputs	: struct SearchContext	*ctx
+ *		  struct BranchPath	*curNode
+ * Outputs	: bool			onlyFinalRecipeLeft
+ *
+ * Generate every legal move of a node which has not been expanded yet.
+ * Returns true if the node only had the final recipe left to cook and
+ * everything but the fastest way to cook it was stripped, in which case
+ * the moves must not be reordered.
+ -------------------------------------------------------------------*/
+bool generateLegalMoves(struct SearchContext *ctx, struct BranchPath *curNode) {
+	fulfillRecipes(ctx, curNode);
+
+	// Special handling of the 56th recipe, which is representative of the Chapter 5 intermission
+
+	// The first item is trading the Mousse Cake and 2 Hot Dogs for a Dried Bouquet
+	// Inventory must contain both items, and Hot Dog must be in a slot such that it can be duplicated
+	// The Mousse Cake and Hot Dog cannot be in a slot such that it is "hidden" due to NULLs in the inventory
+	if (!curNode->outputCreated[getIndexOfRecipe(Dried_Bouquet)]
+		&& indexOfItemInInventory(curNode->inventory, Mousse_Cake) != -1
+		&& indexOfItemInInventory(curNode->inventory, Hot_Dog) >= 10) {
+		fulfillChapter5(ctx, curNode);
+	}
+
+	// Special handling of inventory sorting
+	// Avoid redundant searches
+	if (curNode->description.action == Begin || curNode->description.action == Cook || curNode->description.action == Ch5) {
+		handleSorts(ctx, curNode);
+	}
+
+	// All legal moves evaluated and listed!
+
+	if (curNode->moves == 0) {
+		// Filter out all legal moves that use 2 ingredients in the very first legal move
+		filterOut2Ingredients(curNode);
+	}
+
+	// Special filtering if we only had one recipe left to fulfill
+	if (curNode->numOutputsCreated == NUM_RECIPES-1 && curNode->numLegalMoves > 0 && curNode->legalMoves != NULL && curNode->legalMoves[0]->description.action == Cook) {
+		// If there are any legal moves that satisfy this final recipe,
+		// strip out everything besides the fastest legal move
+		// This saves on recursing down pointless states
+		popAllButFirstLegalMove(curNode);
+		return true;
+	}
+	return false;
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: resumeDive
+ * Inputs	: struct SearchContext	*ctx
+ *		  struct BranchPath	*savedPath
+ *		  int			*stepIndex
+ * Outputs	: struct BranchPath	*curNode
+ *
+ * Rebuild a checkpointed dive. Its moves are replayed first to make
+ * sure they are still legal, then the legal moves of every node along
+ * the path are regenerated and the saved move is stepped into each
+ * time. The siblings come back too, so the dive carries on backtracking
+ * as if it had never been interrupted, apart from re-exploring siblings
+ * that were already done. Returns NULL if the saved path can not be
+ * reproduced (e.g. it was saved by a version with different rules).
+ -------------------------------------------------------------------*/
+static struct BranchPath *resumeDive(struct SearchContext *ctx, const struct BranchPath *savedPath, int *stepIndex) {
+	struct ReplayMove moves[REPLAY_MAX_MOVES];
+	int numMoves = extractReplayMoves(savedPath, moves, REPLAY_MAX_MOVES);
+	if (numMoves < 0) {
+		return NULL;
+	}
+	struct ReplayState state;
+	if (replayMoves(moves, numMoves, &state, NULL) != REPLAY_OK) {
+		return NULL;
+	}
+	const struct BranchPath *savedLast = savedPath;
+	while (savedLast->next != NULL) {
+		savedLast = savedLast->next;
+	}
+	if (!replayStateMatchesNode(&state, savedLast)) {
+		return NULL;
+	}
+
+	initReplayState(&state);
+	struct BranchPath *curNode = initializeRoot(ctx);
+	*stepIndex = 0;
+	for (int i = 0; i < numMoves; ++i) {
+		applyReplayMove(&state, &moves[i]);
+		generateLegalMoves(ctx, curNode);
+		int moveIndex = -1;
+		for (int move = 0; move < curNode->numLegalMoves && moveIndex < 0; ++move) {
+			if (curNode->legalMoves[move]->description.action == moves[i].action
+				&& replayStateMatchesNode(&state, curNode->legalMoves[move])) {
+				moveIndex = move;
+			}
+		}
+		if (moveIndex < 0) {
+			// Legal, but not a move the search would generate any more
+			freeAllNodes(curNode);
+			return NULL;
+		}
+		// Take the saved move and move it to the front of the array
+		struct BranchPath *nextMove = curNode->legalMoves[0];
+		curNode->legalMoves[0] = curNode->legalMoves[moveIndex];
+		curNode->legalMoves[moveIndex] = nextMove;
+		curNode->next = curNode->legalMoves[0];
+		curNode = curNode->next;
+		++*stepIndex;
+	}
+	return curNode;
+}
+
 /*-------------------------------------------------------------------
  * Function 	: calculateOrder
- * Inputs	: int ID
+ * Inputs	: struct SearchContext	*ctx
+ *		  long			max_branches
  * Outputs	: struct Result	result
  *
  * This is the main roadmap evaluation function. This calls various
@@ -2604,13 +3010,15 @@ ABSL_ATTRIBUTE_ALWAYS_INLINE static inline int getLimitIncreaseDivisor(int curre
  * a roadmap is found, the data is printed to a .txt file, and the result
  * is passed back to start.c to try submitting to the server.
  -------------------------------------------------------------------*/
-struct Result calculateOrder(const int rawID, long max_branches) {
+struct Result calculateOrder(struct SearchContext *ctx, long max_branches) {
 	// For debugging stacktraces
 	// _assert_with_stacktrace(false);
+	const int rawID = ctx->rawID;
 	const int displayID = rawID + 1;
 	const int randomise = getConfigInt("randomise");
 	const int select = getConfigInt("select");
 	const int debug = getConfigInt("debug");
+	const int warmStartPercent = getConfigInt("warmStartPercent");
 	// The user may disable all randomization but not be debugging.
 	int freeRunning = !debug && !randomise && !select;
 	const int branchInterval = getConfigInt("branchLogInterval");
@@ -2624,29 +3032,74 @@ struct Result calculateOrder(const int rawID, long max_branches) {
 
 	//Start main loop
 	while (1) {
-		if (askedToShutdown()) {
+		if (contextAskedToShutdown(ctx)) {
 			break;
 		}
 		if (max_branches > 0 && total_dives >= max_branches) {
 			break;
 		}
+		// Threads beyond the active worker count wait here until they are needed again.
+		// A dive they were in the middle of has already been checkpointed for another thread.
+		if (shouldParkWorker(rawID)) {
+			parkWorker(rawID);
+			continue;
+		}
 
 		int stepIndex = 0;
 		long iterationCount = 0;
-		bool useShortIterationLimit = (rand() % 100) < SHORT_ITERATION_LIMIT_CHANCE;
+		bool useShortIterationLimit = random_state_randpercent(&ctx->random) < SHORT_ITERATION_LIMIT_CHANCE;
 		long iterationLimit = useShortIterationLimit ? DEFAULT_ITERATION_LIMIT_SHORT : DEFAULT_ITERATION_LIMIT;
 		bool iterationLimitIncreased = false;
 		bool iterationLimitIncreasedFromPB = false;
 		bool iterationLimitIncreasedFromGettingClose = false;
 		bool iterationLimitIncreasedFromGettingKindOfClose = false;
+		bool parking = false;
+
+		// Pick up a dive interrupted by a shutdown or a parked thread before starting new ones
+		struct DiveCheckpoint checkpoint;
+		curNode = NULL;
+		if (!benchmarkMode && !debug && claimDiveCheckpoint(&checkpoint)) {
+			curNode = resumeDive(ctx, checkpoint.path, &stepIndex);
+			if (curNode != NULL) {
+				iterationCount = checkpoint.iterationCount;
+				iterationLimit = checkpoint.iterationLimit;
+				iterationLimitIncreased = checkpoint.flags & CHECKPOINT_FLAG_LIMIT_INCREASED;
+				iterationLimitIncreasedFromPB = checkpoint.flags & CHECKPOINT_FLAG_LIMIT_INCREASED_FROM_PB;
+				iterationLimitIncreasedFromGettingClose = checkpoint.flags & CHECKPOINT_FLAG_LIMIT_INCREASED_FROM_GETTING_CLOSE;
+				iterationLimitIncreasedFromGettingKindOfClose = checkpoint.flags & CHECKPOINT_FLAG_LIMIT_INCREASED_FROM_GETTING_KIND_OF_CLOSE;
+				logWithThreadInfo(displayID, "Resuming checkpointed dive", 3);
+				logIterations(displayID, stepIndex, curNode, iterationCount, iterationLimit, 3);
+			}
+			else {
+				logWithThreadInfo(displayID, "Checkpointed dive no longer matches the search rules, discarding it", 1);
+			}
+			struct BranchPath *savedLast = checkpoint.path;
+			while (savedLast->next != NULL) {
+				savedLast = savedLast->next;
+			}
+			freeAllNodes(savedLast);
+		}
+
+		// Some dives start partway down one of the fastest roadmaps found so far
+		if (curNode == NULL && warmStartPercent > 0 && !debug && random_state_randpercent(&ctx->random) < warmStartPercent) {
+			curNode = claimElitePrefix(ctx, &stepIndex);
+		}
 
 		// Create root of tree path
-		curNode = initializeRoot();
-		root = curNode; // Necessary when printing results starting from root
+		if (curNode == NULL) {
+			curNode = initializeRoot(ctx);
+		}
+		root = curNode;
+		while (root->prev != NULL) {
+			root = root->prev;
+		}
+		// root is necessary when printing results starting from root
 
 		total_dives++;
+		ctx->diveSerial++;
+		COUNT_SLOT_STAT(ctx->stats, dives);
 
-		if (total_dives % branchInterval == 0 && will_log_level(NEW_BRANCH_LOG_LEVEL)) {
+		if (total_dives % branchInterval == 0 && NEW_BRANCH_LOG_LEVEL <= ctx->logLevel) {
 			char temp1[30];
 			char temp2[50];
 			sprintf(temp1, "Thread %d", displayID);
@@ -2657,9 +3110,87 @@ struct Result calculateOrder(const int rawID, long max_branches) {
 		// If the user is not exploring only one branch, reset when it is time
 		// Start iteration loop
 		while (iterationCount < iterationLimit || freeRunning) {
-			if (checkShutdownOnIndexLong(iterationCount)) {
+			if (checkShutdownOnIndexLong(ctx, iterationCount)) {
+				break;
+			}
+			if (checkParkOnIndexLong(rawID, iterationCount)) {
+				parking = true;
 				break;
 			}
+
+			// Roadmaps this thread finished come back from the optimizer thread some iterations later
+			struct OptimizedRoadmap optimized;
+			while (ABSL_PREDICT_FALSE(pollOptimizedRoadmap(rawID, &optimized))) {
+				COUNT_SLOT_STAT(ctx->stats, optimizeRoadmapCalls);
+				if (optimized.newRecord) {
+					COUNT_SLOT_STAT(ctx->stats, recordsFound);
+					result_cache = (struct Result){ optimized.optimizedFrames, rawID };
+				}
+				// Only the dive the roadmap came from spends more time because of it
+				if (optimized.tag != ctx->diveSerial || optimized.optimizedFrames < 0) {
+					continue;
+				}
+				const long oldIterationLimit = iterationLimit;
+				const int limitIncreaseDivisor = getLimitIncreaseDivisor(optimized.frames);
+				if (optimized.newRecord) {
+					// Reset the iteration count so we continue to explore near this record
+					if (ABSL_PREDICT_TRUE(iterationLimit < ITERATION_LIMIT_MAX)) {
+						if (!iterationLimitIncreasedFromPB) {
+							// On the first time with PB increase, use ITERATION_LIMIT_INCREASE_FIRST.
+							if (iterationLimitIncreasedFromGettingClose) {
+								iterationLimit = MAX(
+									// If ITERATION_LIMIT_INCREASE_GETTING_CLOSE has already been applied, subtract that to get to ITERATION_LIMIT_INCREASE_FIRST.
+									iterationLimit + (ITERATION_LIMIT_INCREASE_FIRST/limitIncreaseDivisor) - ITERATION_LIMIT_INCREASE_GETTING_CLOSE,
+									iterationCount + (ITERATION_LIMIT_INCREASE_FIRST/limitIncreaseDivisor));
+							} else {
+								iterationLimit = MAX(
+									iterationCount + (ITERATION_LIMIT_INCREASE_FIRST/limitIncreaseDivisor),
+									iterationLimit + 2 * ITERATION_LIMIT_INCREASE_PAST_MAX);
+							}
+						} else {
+							iterationLimit = MAX(iterationCount + (ITERATION_LIMIT_INCREASE/limitIncreaseDivisor), iterationLimit + ITERATION_LIMIT_INCREASE_PAST_MAX);
+						}
+						if (ABSL_PREDICT_FALSE(iterationLimit > ITERATION_LIMIT_MAX)) {
+							iterationLimit = ITERATION_LIMIT_MAX;
+						}
+					} else {
+						iterationLimit = MAX(iterationCount + (ITERATION_LIMIT_INCREASE_PAST_MAX/limitIncreaseDivisor), iterationLimit + ITERATION_LIMIT_INCREASE_PAST_MAX/50);
+					}
+					if (iterationLimit > oldIterationLimit) {
+						iterationLimitIncreased = true;
+						iterationLimitIncreasedFromPB = true;
+					}
+					logIterationsAfterLimitIncrease(displayID, stepIndex, optimized.frames, optimized.optimizedFrames, iterationCount, oldIterationLimit, iterationLimit, 3);
+				} else {  // Close enough to optimizeRoadmap but not quite PB
+					NOISY_DEBUG("Not new PB but close\n");
+					// Close enough to optimize but not to PB, still worth spending more time on the branch.
+					if (!iterationLimitIncreasedFromGettingClose && !iterationLimitIncreased && ABSL_PREDICT_TRUE(iterationLimit < ITERATION_LIMIT_MAX)) {
+						if (iterationLimitIncreasedFromGettingKindOfClose) {
+							iterationLimit = MAX(
+								// If ITERATION_LIMIT_INCREASE_GETTING_KINDOF_CLOSE has already been applied, subtract that to get to ITERATION_LIMIT_INCREASE_GETTING_CLOSE.
+								iterationLimit + (ITERATION_LIMIT_INCREASE_GETTING_CLOSE/limitIncreaseDivisor) - ITERATION_LIMIT_INCREASE_GETTING_KINDOF_CLOSE,
+								iterationCount + (ITERATION_LIMIT_INCREASE_GETTING_CLOSE/limitIncreaseDivisor));
+						} else {
+							iterationLimit = MAX(
+								iterationCount + ITERATION_LIMIT_INCREASE_GETTING_CLOSE/limitIncreaseDivisor,
+								iterationLimit + ITERATION_LIMIT_INCREASE_GETTING_CLOSE/50);
+						}
+						if (ABSL_PREDICT_FALSE(iterationLimit > ITERATION_LIMIT_MAX)) {
+							iterationLimit = ITERATION_LIMIT_MAX;
+						}
+						if (iterationLimit > oldIterationLimit) {
+							static const char closeAndOptimizePreamble[] = "Close enough to PB to spend more time on this branch and optimize";
+							// Only log this once
+							logCloseToPb(displayID, sizeof(closeAndOptimizePreamble), closeAndOptimizePreamble, optimized.frames, contextLocalRecord(ctx), optimized.optimizedFrames, 4);
+							logIterationsAfterLimitIncrease(displayID, stepIndex, optimized.frames, optimized.optimizedFrames, iterationCount, oldIterationLimit, iterationLimit, 4);
+							iterationLimitIncreased = true;
+							iterationLimitIncreasedFromGettingClose = true;
+							iterationLimitIncreasedFromGettingKindOfClose = true;
+						}
+					}
+				}
+			}
+
 			// In the rare occassion that the root node runs out of legal moves due to "select",
 			// exit out of the while loop to restart
 			if (curNode == NULL) {
@@ -2683,91 +3214,16 @@ struct Result calculateOrder(const int rawID, long max_branches) {
 				const int currentPb = curNode->description.totalFramesTaken;
 				const int limitIncreaseDivisor = getLimitIncreaseDivisor(currentPb);
 
-				if (currentPb < getLocalRecord() + BUFFER_SEARCH_FRAMES) {
+				if (currentPb < contextLocalRecord(ctx) + BUFFER_SEARCH_FRAMES) {
 					// A finished roadmap has been generated
 					// We are getting close enough to spend extra time on this branch.
 
-					// Rearrange the roadmap to save frames
-					struct OptimizeResult optimizeResult = optimizeRoadmap(root);
-					if (optimizeResult.last->description.totalFramesTaken < getLocalRecord()) {
-						NOISY_DEBUG("New PB!\n");
-						#pragma omp critical(optimize)
-						{
-							setLocalRecord(optimizeResult.last->description.totalFramesTaken);
-							char *filename = malloc(sizeof(char) * 17);
-							sprintf(filename, "results/%d.txt", optimizeResult.last->description.totalFramesTaken);
-							printResults(filename, optimizeResult.root);
-							if (will_log_level(1)) {
-								char tmp[200];
-								sprintf(tmp, "Thread %d][New local fastest roadmap found! %d frames, saved %d after rearranging", displayID, optimizeResult.last->description.totalFramesTaken, curNode->description.totalFramesTaken - optimizeResult.last->description.totalFramesTaken);
-								recipeLog(1, "Calculator", "Info", "Roadmap", tmp);
-							}
-							free(filename);
-							if (debug) {
-								testRecord(result_cache.frames);
-							}
-						}
-						result_cache = (struct Result){ optimizeResult.last->description.totalFramesTaken, rawID };
-
-						// Reset the iteration count so we continue to explore near this record
-						if (ABSL_PREDICT_TRUE(iterationLimit < ITERATION_LIMIT_MAX)) {
-							if (!iterationLimitIncreasedFromPB) {
-								// On the first time with PB increase, use ITERATION_LIMIT_INCREASE_FIRST.
-								if (iterationLimitIncreasedFromGettingClose) {
-									iterationLimit = MAX(
-										// If ITERATION_LIMIT_INCREASE_GETTING_CLOSE has already been applied, subtract that to get to ITERATION_LIMIT_INCREASE_FIRST.
-										iterationLimit + (ITERATION_LIMIT_INCREASE_FIRST/limitIncreaseDivisor) - ITERATION_LIMIT_INCREASE_GETTING_CLOSE,
-										iterationCount + (ITERATION_LIMIT_INCREASE_FIRST/limitIncreaseDivisor));
-								} else {
-									iterationLimit = MAX(
-										iterationCount + (ITERATION_LIMIT_INCREASE_FIRST/limitIncreaseDivisor),
-										iterationLimit + 2 * ITERATION_LIMIT_INCREASE_PAST_MAX);
-								}
-							} else {
-								iterationLimit = MAX(iterationCount + (ITERATION_LIMIT_INCREASE/limitIncreaseDivisor), iterationLimit + ITERATION_LIMIT_INCREASE_PAST_MAX);
-							}
-							if (ABSL_PREDICT_FALSE(iterationLimit > ITERATION_LIMIT_MAX)) {
-								iterationLimit = ITERATION_LIMIT_MAX;
-							}
-						} else {
-							iterationLimit = MAX(iterationCount + (ITERATION_LIMIT_INCREASE_PAST_MAX/limitIncreaseDivisor), iterationLimit + ITERATION_LIMIT_INCREASE_PAST_MAX/50);
-						}
-						if (iterationLimit > oldIterationLimit) {
-							iterationLimitIncreased = true;
-							iterationLimitIncreasedFromPB = true;
-						}
-						logIterationsAfterLimitIncrease(displayID, stepIndex, curNode, optimizeResult.last->description.totalFramesTaken, iterationCount, oldIterationLimit, iterationLimit, 3);
-					} else {  // Close enough to optimizeRoadmap but not quite PB
-						NOISY_DEBUG("Not new PB but close\n");
-						// Close enough to optimize but not to PB, still worth spending more time on the branch.
-						if (!iterationLimitIncreasedFromGettingClose && !iterationLimitIncreased && ABSL_PREDICT_TRUE(iterationLimit < ITERATION_LIMIT_MAX)) {
-							if (iterationLimitIncreasedFromGettingKindOfClose) {
-								iterationLimit = MAX(
-									// If ITERATION_LIMIT_INCREASE_GETTING_KINDOF_CLOSE has already been applied, subtract that to get to ITERATION_LIMIT_INCREASE_GETTING_CLOSE.
-									iterationLimit + (ITERATION_LIMIT_INCREASE_GETTING_CLOSE/limitIncreaseDivisor) - ITERATION_LIMIT_INCREASE_GETTING_KINDOF_CLOSE,
-									iterationCount + (ITERATION_LIMIT_INCREASE_GETTING_CLOSE/limitIncreaseDivisor));
-							} else {
-								iterationLimit = MAX(
-									iterationCount + ITERATION_LIMIT_INCREASE_GETTING_CLOSE/limitIncreaseDivisor,
-									iterationLimit + ITERATION_LIMIT_INCREASE_GETTING_CLOSE/50);
-							}
-							if (ABSL_PREDICT_FALSE(iterationLimit > ITERATION_LIMIT_MAX)) {
-								iterationLimit = ITERATION_LIMIT_MAX;
-							}
-							if (iterationLimit > oldIterationLimit) {
-								static const char closeAndOptimizePreamble[] = "Close enough to PB to spend more time on this branch and optimize";
-								// Only log this once
-								int afterOptimizing = optimizeResult.last->description.totalFramesTaken;
-								logCloseToPb(displayID, sizeof(closeAndOptimizePreamble), closeAndOptimizePreamble, curNode, getLocalRecord(), afterOptimizing, 4);
-								logIterationsAfterLimitIncrease(displayID, stepIndex, curNode, afterOptimizing, iterationCount, oldIterationLimit, iterationLimit, 4);
-								iterationLimitIncreased = true;
-								iterationLimitIncreasedFromGettingClose = true;
-								iterationLimitIncreasedFromGettingKindOfClose = true;
-							}
-						}
-					}
-					freeAllNodes(optimizeResult.last);
-				} else if (curNode->description.totalFramesTaken < getLocalRecord() + BUFFER_SEARCH_FRAMES_KIND_OF_CLOSE) {
+					offerEliteRoadmap(root, currentPb);
+
+					// Rearranging the roadmap to save frames is left to the optimizer thread.
+					// The iteration limit is raised once its outcome comes back (see the top of this loop).
+					submitRoadmapForOptimizing(rawID, root, currentPb, ctx->diveSerial);
+				} else if (curNode->description.totalFramesTaken < contextLocalRecord(ctx) + BUFFER_SEARCH_FRAMES_KIND_OF_CLOSE) {
 					// Close enough to look harder but not enough to put in the optimizeRoadmap overhead yet.
 					NOISY_DEBUG("Kind of close\n");
 					if (!iterationLimitIncreased && !iterationLimitIncreasedFromGettingKindOfClose && ABSL_PREDICT_TRUE(iterationLimit < ITERATION_LIMIT_MAX)) {
@@ -2776,8 +3232,8 @@ struct Result calculateOrder(const int rawID, long max_branches) {
 															iterationLimit + ITERATION_LIMIT_INCREASE_GETTING_KINDOF_CLOSE/50);
 						if (iterationLimit > oldIterationLimit) {
 							static const char closePreamble[] = "Close enough to PB to spend more time on this branch";
-							logCloseToPb(displayID, sizeof(closePreamble), closePreamble, curNode, getLocalRecord(), 0, 4);
-							logIterationsAfterLimitIncrease(displayID, stepIndex, curNode, -1, iterationCount, oldIterationLimit, iterationLimit, 4);
+							logCloseToPb(displayID, sizeof(closePreamble), closePreamble, currentPb, contextLocalRecord(ctx), 0, 4);
+							logIterationsAfterLimitIncrease(displayID, stepIndex, currentPb, -1, iterationCount, oldIterationLimit, iterationLimit, 4);
 							iterationLimitIncreasedFromGettingKindOfClose = true;
 							// This is such a tiny increase we aren't even bothering to set iterationLimitIncreased.
 						}
@@ -2797,43 +3253,13 @@ struct Result calculateOrder(const int rawID, long max_branches) {
 				NOISY_DEBUG("End condition not met. Check if this current level has something in the event queue\n");
 				// This node has not yet been assigned an array of legal moves.
 				// Generate the list of all possible recipes
-				fulfillRecipes(curNode);
-
-				// Special handling of the 56th recipe, which is representative of the Chapter 5 intermission
-
-				// The first item is trading the Mousse Cake and 2 Hot Dogs for a Dried Bouquet
-				// Inventory must contain both items, and Hot Dog must be in a slot such that it can be duplicated
-				// The Mousse Cake and Hot Dog cannot be in a slot such that it is "hidden" due to NULLs in the inventory
-				if (!curNode->outputCreated[getIndexOfRecipe(Dried_Bouquet)]
-					&& indexOfItemInInventory(curNode->inventory, Mousse_Cake) != -1
-					&& indexOfItemInInventory(curNode->inventory, Hot_Dog) >= 10) {
-					fulfillChapter5(curNode);
-				}
-
-				// Special handling of inventory sorting
-				// Avoid redundant searches
-				if (curNode->description.action == Begin || curNode->description.action == Cook || curNode->description.action == Ch5) {
-					handleSorts(curNode);
-				}
-
-				// All legal moves evaluated and listed!
-
-				if (curNode->moves == 0) {
-					// Filter out all legal moves that use 2 ingredients in the very first legal move
-					filterOut2Ingredients(curNode);
-				}
-
-				// Special filtering if we only had one recipe left to fulfill
-				if (curNode->numOutputsCreated == NUM_RECIPES-1 && curNode->numLegalMoves > 0 && curNode->legalMoves != NULL && curNode->legalMoves[0]->description.action == Cook) {
-					// If there are any legal moves that satisfy this final recipe,
-					// strip out everything besides the fastest legal move
-					// This saves on recursing down pointless states
-					popAllButFirstLegalMove(curNode);
-				}
+				COUNT_SLOT_STAT(ctx->stats, nodesExpanded);
+				SET_SLOT_GAUGE(ctx->stats, depth, stepIndex);
+				SET_SLOT_GAUGE(ctx->stats, iterationLimit, iterationLimit);
 				// Apply randomization when not debugging or when done
 				// choosing moves
-				else if (!debug || freeRunning) {
-					handleSelectAndRandom(curNode, select, randomise);
+				if (!generateLegalMoves(ctx, curNode) && (!debug || freeRunning)) {
+					handleSelectAndRandom(ctx, curNode, select, randomise);
 				}
 
 				if (curNode->numLegalMoves == 0) {
@@ -2842,8 +3268,10 @@ struct Result calculateOrder(const int rawID, long max_branches) {
 
 					// Handle the case where the root node runs out of legal moves
 					if (curNode->prev == NULL) {
+						// The tree is used up, but the dive still ends the usual way below
 						freeNode(curNode);
-						return (struct Result) {-1, -1};
+						curNode = NULL;
+						break;
 					}
 
 					struct BranchPath* curNodePrev = curNode->prev;
@@ -2872,7 +3300,7 @@ struct Result calculateOrder(const int rawID, long max_branches) {
 
 					if (moveToExplore == curNode->numLegalMoves) {
 						freeRunning = 1;
-						handleSelectAndRandom(curNode, select, randomise);
+						handleSelectAndRandom(ctx, curNode, select, randomise);
 					}
 					else {
 						// Take the legal move at nextMoveIndex and move it to the front of the array
@@ -2900,8 +3328,10 @@ struct Result calculateOrder(const int rawID, long max_branches) {
 
 					// Handle the case where the root node runs out of legal moves
 					if (curNode->prev == NULL) {
+						// The tree is used up, but the dive still ends the usual way below
 						freeNode(curNode);
-						return (struct Result) {-1, -1};
+						curNode = NULL;
+						break;
 					}
 
 					curNode = curNode->prev;
@@ -2911,11 +3341,11 @@ struct Result calculateOrder(const int rawID, long max_branches) {
 					continue;
 				}
 
-				prefetchShutdownOnIndexLong(iterationCount);
+				prefetchShutdownOnIndexLong(ctx, iterationCount);
 
 				// Moves would already be shuffled with randomise, but select
 				// would always choose the first one unless we select here
-				handleSelectAndRandom(curNode, select, 0);
+				handleSelectAndRandom(ctx, curNode, select, 0);
 
 				// Once the list is generated, choose the top-most (quickest) path and iterate downward
 				curNode->next = curNode->legalMoves[0];
@@ -2934,70 +3364,63 @@ struct Result calculateOrder(const int rawID, long max_branches) {
 			}
 		}
 
+		// Save the dive so the next run, or an active thread when parking, can carry on with it
+		if ((contextAskedToShutdown(ctx) || parking) && curNode != NULL && (iterationCount < iterationLimit || freeRunning) && !benchmarkMode && !debug) {
+			const int flags = (iterationLimitIncreased ? CHECKPOINT_FLAG_LIMIT_INCREASED : 0)
+				| (iterationLimitIncreasedFromPB ? CHECKPOINT_FLAG_LIMIT_INCREASED_FROM_PB : 0)
+				| (iterationLimitIncreasedFromGettingClose ? CHECKPOINT_FLAG_LIMIT_INCREASED_FROM_GETTING_CLOSE : 0)
+				| (iterationLimitIncreasedFromGettingKindOfClose ? CHECKPOINT_FLAG_LIMIT_INCREASED_FROM_GETTING_KIND_OF_CLOSE : 0);
+			// Only the path down to the current node is saved
+			curNode->next = NULL;
+			writeDiveCheckpoint(rawID, root, iterationCount, iterationLimit, flags);
+		}
+
 		// We have passed the iteration maximum
 		// Free everything before reinitializing
-		freeAllNodes(curNode);
-		curNode = NULL;
+		if (curNode != NULL) {
+			freeAllNodes(curNode);
+			curNode = NULL;
+		}
+
+		// Records only found after the dive ended still have to be returned. Nothing
+		// is left outstanding when returning for good, as that loses the record.
+		if (contextAskedToShutdown(ctx) || (max_branches > 0 && total_dives >= max_branches)) {
+			waitForOptimizedRoadmaps(rawID);
+		}
+		struct OptimizedRoadmap optimized;
+		while (pollOptimizedRoadmap(rawID, &optimized)) {
+			COUNT_SLOT_STAT(ctx->stats, optimizeRoadmapCalls);
+			if (optimized.newRecord) {
+				COUNT_SLOT_STAT(ctx->stats, recordsFound);
+				result_cache = (struct Result){ optimized.optimizedFrames, rawID };
+			}
+		}
 
 		// Check the cache to see if a result was generated
 		if (result_cache.frames > -1) {
 
-			// Enter critical section to prevent corrupted file
+			// Prevent slower threads from overwriting a faster record in PB.txt
+			// by first checking the current record
 			#pragma omp critical(pb)
 			{
-				// Prevent slower threads from overwriting a faster record in PB.txt
-				// by first checking the current record
-				FILE* fp = NULL;
-				if ((fp = fopen("results/PB.txt", "r+")) == NULL) {
-					// The file has not been created
-					fp = fopen("results/PB.txt", "w");
+				if (result_cache.frames > savedPbRecord) {
+					// This is a slower thread and a faster record was already found
+					result_cache = (struct Result) { -1, -1 };
 				}
 				else {
-					// Verify that this new roadmap is faster than PB
-					int pb_record;
-					fscanf(fp, "%d", &pb_record);
-					fclose(fp);
-					fp = NULL;
-					if (result_cache.frames > pb_record) {
-						// This is a slower thread and a faster record was already found
-						result_cache = (struct Result) { -1, -1 };
-					}
-					else {
-						if (ABSL_PREDICT_TRUE(result_cache.frames > -1)) {
-							fp = fopen("results/PB.txt", "w");
-						}
-					}
-				}
-
-				// Modify PB.txt
-				if (fp != NULL) {
-					if (ABSL_PREDICT_FALSE(result_cache.frames < 0)) {
-						// Somehow got invalid number of frames.
-						// Fetch the current known max from the global.
-						int localRecord = getLocalRecord();
-						if (ABSL_PREDICT_FALSE(localRecord < 0)) {
-							recipeLog(1, "Calculator", "Roadmap", "Error", "Current cached local record is corrupt (less then 0 frames). Not writing invalid PB file but your PB may be lost.");
-						} else if (ABSL_PREDICT_FALSE(localRecord > UNSET_FRAME_RECORD)) {
-							char reportStr[200];
-							sprintf(reportStr, "Current cached local record is corrupt (current [%d] greater then nonsense upper bound of [%d]). Not writing invalid PB file but your PB may be lost.",
-								localRecord, UNSET_FRAME_RECORD);
-							recipeLog(1, "Calculator", "Roadmap", "Error", reportStr);
-						} else {
-							fprintf(fp, "%d", localRecord);
-						}
-					} else {
-						fprintf(fp, "%d", result_cache.frames);
-					}
-					fclose(fp);
+					savedPbRecord = result_cache.frames;
 				}
 			}
+			if (result_cache.frames > -1 && !benchmarkMode) {
+				writePbFile();
+			}
 
 			// Return the cached result
 			return result_cache;
 		}
 
 		// Period check for Github update (only perform on thread 0)
-		if (total_dives % 10000 == 0 && rawID == 0) {
+		if (total_dives % 10000 == 0 && rawID == 0 && !benchmarkMode) {
 			periodicGithubCheck();
 		}
 
@@ -5,6 +5,17 @@
 #include "inventory.h"
 #include "recipes.h"
 #include "start.h"
+#include "search_stats.h"
+#include "thread_local_random.h"
+
+// DON'T TOUCH: These reflect the logic of Paper Mario TTYD itself. Changing these will result in invalid plans.
+#define CHOOSE_2ND_INGREDIENT_FRAMES 56 	// Penalty for choosing a 2nd item
+#define TOSS_FRAMES 32				// Penalty for having to toss an item
+#define ALPHA_SORT_FRAMES 38			// Penalty to perform alphabetical ascending sort
+#define REVERSE_ALPHA_SORT_FRAMES 40		// Penalty to perform alphabetical descending sort
+#define TYPE_SORT_FRAMES 39			// Penalty to perform type ascending sort
+#define REVERSE_TYPE_SORT_FRAMES 41		// Penalty to perform type descending sort
+#define JUMP_STORAGE_NO_TOSS_FRAMES 5		// Penalty for not tossing the last item (because we need to get Jump Storage)
 
 // Represent the action at a particular node in the roadmap
 enum Action {
@@ -87,27 +98,44 @@ struct BranchPath {
 	int totalSorts;
 };
 
-// Structure to return the head and tail of an optimized roadmap
-struct OptimizeResult {
-	struct BranchPath *root;
-	struct BranchPath *last;
+// Everything a search thread reads on every node it expands, gathered in one place and
+// handed down the legal move generators, instead of each of them looking up globals,
+// thread-local variables and config on their own.
+// It owns its random number generator, so no two contexts ever draw from the same stream,
+// but only the thread it was initialized on may use it, as it holds that thread's stats slot.
+struct SearchContext {
+	int rawID;
+	int **invFrames;
+	struct Recipe *recipeList;
+	const int *localRecord;			// Read through contextLocalRecord
+	const bool *shutdownRequested;
+	int logLevel;
+	struct SearchStatsSlot *stats;
+	const int *softMinWeights;
+	int softMinMaxDelta;			// -1 while softMin is disabled
+	long diveSerial;				// Every dive started with this context, across calls to calculateOrder
+	random_state_t random;			// Last, as it is larger than everything else put together
 };
 
+// An optimized roadmap, held as its moves alone (defined in path_replay.h)
+struct CompactRoadmap;
+
 // optimizeRoadmap functions
-struct BranchPath* copyAllNodes(struct BranchPath* newNode, const struct BranchPath* oldNode);
-struct OptimizeResult optimizeRoadmap(const struct BranchPath* root);
-void reallocateRecipes(struct BranchPath *newRoot, const enum Type_Sort *rearranged_recipes, int num_rearranged_recipes);
-int removeRecipesForReallocation(struct BranchPath *node, enum Type_Sort *rearranged_recipes);
+void optimizeRoadmap(const struct BranchPath* root, struct CompactRoadmap* optimized);
+bool optimizeAndSaveRoadmap(int rawID, const struct BranchPath* root, int frames, int* optimizedFrames, bool allowLocalSearch);
+void reallocateRecipes(const struct BranchPath* const* keptNodes, int numKeptNodes, const enum Type_Sort* rearranged_recipes, int num_rearranged_recipes, struct CompactRoadmap* optimized);
+int removeRecipesForReallocation(const struct BranchPath* root, const struct BranchPath** keptNodes, int* numKeptNodes, enum Type_Sort* rearranged_recipes);
 
 // Legal move functions
 
-struct BranchPath* createLegalMove(struct BranchPath* node, struct Inventory inventory, struct MoveDescription description, const outputCreatedArray_t outputsFulfilled, int numOutputsFulfilled);
+struct BranchPath* createLegalMove(struct SearchContext* ctx, struct BranchPath* node, struct Inventory inventory, struct MoveDescription description, const outputCreatedArray_t outputsFulfilled, int numOutputsFulfilled);
 void filterOut2Ingredients(struct BranchPath* node);
-void finalizeChapter5Eval(struct BranchPath* node, struct Inventory inventory, struct CH5* ch5Data, int temp_frame_sum, const outputCreatedArray_t outputsFulfilled, int numOutputsFulfilled);
-void finalizeLegalMove(struct BranchPath* node, int tempFrames, struct MoveDescription useDescription, struct Inventory tempInventory, const outputCreatedArray_t tempOutputsFulfilled, int numOutputsFulfilled, enum HandleOutput tossType, enum Type_Sort toss, int tossIndex);
+void finalizeChapter5Eval(struct SearchContext* ctx, struct BranchPath* node, struct Inventory inventory, struct CH5* ch5Data, int temp_frame_sum, const outputCreatedArray_t outputsFulfilled, int numOutputsFulfilled);
+void finalizeLegalMove(struct SearchContext* ctx, struct BranchPath* node, int tempFrames, struct MoveDescription useDescription, struct Inventory tempInventory, const outputCreatedArray_t tempOutputsFulfilled, int numOutputsFulfilled, enum HandleOutput tossType, enum Type_Sort toss, int tossIndex);
 void freeLegalMove(struct BranchPath* node, int index);
+bool generateLegalMoves(struct SearchContext* ctx, struct BranchPath* curNode);
 int getInsertionIndex(const struct BranchPath* node, int frames);
-void insertIntoLegalMoves(int insertIndex, struct BranchPath* newLegalMove, struct BranchPath* curNode);
+void insertIntoLegalMoves(struct SearchContext* ctx, int insertIndex, struct BranchPath* newLegalMove, struct BranchPath* curNode);
 void popAllButFirstLegalMove(struct BranchPath* node);
 void shiftDownLegalMoves(struct BranchPath *node, int lowerBound, int uppderBound);
 void shiftUpLegalMoves(struct BranchPath* node, int startIndex);
@@ -125,28 +153,37 @@ ABSL_ATTRIBUTE_ALWAYS_INLINE inline void copyCook(struct Cook *cookNew, const st
 	*cookNew = *cookOld;
 	return;
 }
-void createCookDescription2Items(const struct BranchPath* node, struct Recipe recipe, struct ItemCombination combo, struct Inventory* tempInventory, int* ingredientLoc, int* tempFrames, int viableItems, struct MoveDescription* useDescription);
-void createCookDescription1Item(const struct BranchPath* node, struct Recipe recipe, struct ItemCombination combo, struct Inventory* tempInventory, int* ingredientLoc, int* tempFrames, int viableItems, struct MoveDescription* useDescription);
-struct MoveDescription createCookDescription(const struct BranchPath* node, struct Recipe recipe, struct ItemCombination combo, struct Inventory *tempInventory, int* tempFrames, int viableItems);
-void fulfillRecipes(struct BranchPath* curNode);
-void generateCook(struct MoveDescription* description, const struct ItemCombination combo, const struct Recipe recipe, const int* ingredientLoc, int swap);
-void handleRecipeOutput(struct BranchPath* curNode, struct Inventory tempInventory, int tempFrames, struct MoveDescription useDescription, const outputCreatedArray_t tempOutputsFulfilled, int numOutputsFulfilled, enum Type_Sort output, int viableItems);
-void tryTossInventoryItem(struct BranchPath* curNode, struct Inventory tempInventory, struct MoveDescription useDescription, const outputCreatedArray_t tempOutputsFulfilled, int numOutputsFulfilled, enum Type_Sort output, int tempFrames, int viableItems);
+void createCookDescription2Items(struct SearchContext* ctx, const struct BranchPath* node, struct Recipe recipe, struct ItemCombination combo, struct Inventory* tempInventory, int* ingredientLoc, int* tempFrames, int viableItems, struct MoveDescription* useDescription);
+void createCookDescription1Item(struct SearchContext* ctx, const struct BranchPath* node, struct Recipe recipe, struct ItemCombination combo, struct Inventory* tempInventory, int* ingredientLoc, int* tempFrames, int viableItems, struct MoveDescription* useDescription);
+struct MoveDescription createCookDescription(struct SearchContext* ctx, const struct BranchPath* node, struct Recipe recipe, struct ItemCombination combo, struct Inventory *tempInventory, int* tempFrames, int viableItems);
+void fulfillRecipes(struct SearchContext* ctx, struct BranchPath* curNode);
+int getCookFrames(const struct Inventory* inventory, const int* ingredientLoc, int numItems);
+struct Inventory removeCookIngredients(struct Inventory inventory, const int* ingredientLoc, int numItems);
+void generateCook(struct SearchContext* ctx, struct MoveDescription* description, const struct ItemCombination combo, const struct Recipe recipe, const int* ingredientLoc, int swap);
+void handleRecipeOutput(struct SearchContext* ctx, struct BranchPath* curNode, struct Inventory tempInventory, int tempFrames, struct MoveDescription useDescription, const outputCreatedArray_t tempOutputsFulfilled, int numOutputsFulfilled, enum Type_Sort output, int viableItems);
+void tryTossInventoryItem(struct SearchContext* ctx, struct BranchPath* curNode, struct Inventory tempInventory, struct MoveDescription useDescription, const outputCreatedArray_t tempOutputsFulfilled, int numOutputsFulfilled, enum Type_Sort output, int tempFrames, int viableItems);
 
 // Chapter 5 functions
-void fulfillChapter5(struct BranchPath* curNode);
-void handleChapter5Eval(struct BranchPath* node, struct Inventory inventory, const outputCreatedArray_t outputsFulfilled, int numOutputsFulfilled, struct CH5_Eval eval);
-void handleChapter5EarlySortEndItems(struct BranchPath* node, struct Inventory inventory, const outputCreatedArray_t outputsFulfilled, int numOutputsFulfilled, struct CH5_Eval eval);
-void handleChapter5Sorts(struct BranchPath* node, struct Inventory inventory, const outputCreatedArray_t outputsFulfilled, int numOutputsFulfilled, struct CH5_Eval eval);
-void handleChapter5LateSortEndItems(struct BranchPath* node, struct Inventory inventory, const outputCreatedArray_t outputsFulfilled, int numOutputsFulfilled, struct CH5_Eval eval);
-void handleDBCOAllocation0Nulls(struct BranchPath* curNode, struct Inventory tempInventory, const outputCreatedArray_t tempOutputsFulfilled, int numOutputsFulfilled, struct CH5_Eval eval);
-void handleDBCOAllocation1Null(struct BranchPath* curNode, struct Inventory tempInventory, const outputCreatedArray_t tempOutputsFulfilled, int numOutputsFulfilled, struct CH5_Eval eval);
-void handleDBCOAllocation2Nulls(struct BranchPath* curNode, struct Inventory tempInventory, const outputCreatedArray_t tempOutputsFulfilled, int numOutputsFulfilled, struct CH5_Eval eval);
-struct CH5* createChapter5Struct(struct CH5_Eval eval, int lateSort);
+// The moves of the intermission, shared by the search and the path replay. frameTable is invFrames.
+struct Inventory tradeForDriedBouquet(int** frameTable, struct Inventory inventory, int* frames_HD, int* frames_MC);
+struct Inventory placeChapter5Item(int** frameTable, struct Inventory inventory, int index, enum Type_Sort item, int* frames);
+struct Inventory useThunderRage(int** frameTable, struct Inventory inventory, int* index, int* frames);
+void fulfillChapter5(struct SearchContext* ctx, struct BranchPath* curNode);
+void handleChapter5Eval(struct SearchContext* ctx, struct BranchPath* node, struct Inventory inventory, const outputCreatedArray_t outputsFulfilled, int numOutputsFulfilled, struct CH5_Eval eval);
+void handleChapter5EarlySortEndItems(struct SearchContext* ctx, struct BranchPath* node, struct Inventory inventory, const outputCreatedArray_t outputsFulfilled, int numOutputsFulfilled, struct CH5_Eval eval);
+void handleChapter5Sorts(struct SearchContext* ctx, struct BranchPath* node, struct Inventory inventory, const outputCreatedArray_t outputsFulfilled, int numOutputsFulfilled, struct CH5_Eval eval);
+void handleChapter5LateSortEndItems(struct SearchContext* ctx, struct BranchPath* node, struct Inventory inventory, const outputCreatedArray_t outputsFulfilled, int numOutputsFulfilled, struct CH5_Eval eval);
+void handleDBCOAllocation0Nulls(struct SearchContext* ctx, struct BranchPath* curNode, struct Inventory tempInventory, const outputCreatedArray_t tempOutputsFulfilled, int numOutputsFulfilled, struct CH5_Eval eval);
+void handleDBCOAllocation1Null(struct SearchContext* ctx, struct BranchPath* curNode, struct Inventory tempInventory, const outputCreatedArray_t tempOutputsFulfilled, int numOutputsFulfilled, struct CH5_Eval eval);
+void handleDBCOAllocation2Nulls(struct SearchContext* ctx, struct BranchPath* curNode, struct Inventory tempInventory, const outputCreatedArray_t tempOutputsFulfilled, int numOutputsFulfilled, struct CH5_Eval eval);
+struct CH5* createChapter5Struct(struct SearchContext* ctx, struct CH5_Eval eval, int lateSort);
 
 // Initialization functions
 void initializeInvFrames();
+void initializeSoftMin(int temperature);
 void initializeRecipeList();
+extern int **invFrames;
+extern struct Recipe *recipeList;
 
 // File output functions
 void printCh5Data(const struct BranchPath* curNode, struct MoveDescription desc, FILE* fp);
@@ -156,20 +193,20 @@ void printFileHeader(FILE* fp);
 void printInventoryData(const struct BranchPath* curNode, FILE* fp);
 void printOutputsCreated(const struct BranchPath* curNode, FILE* fp);
 void printNodeDescription(const struct BranchPath * curNode, FILE * fp);
-void printResults(const char* filename, const struct BranchPath* path);
+bool printResults(const char* filename, const struct BranchPath* path);
 void printSortData(FILE* fp, enum Action curNodeAction);
 
 // Select and random methodology functions
-void handleSelectAndRandom(struct BranchPath* curNode, int select, int randomise);
-void shuffleLegalMoves(struct BranchPath* node);
-void softMin(struct BranchPath *node);
+void handleSelectAndRandom(struct SearchContext* ctx, struct BranchPath* curNode, int select, int randomise);
+void shuffleLegalMoves(struct SearchContext* ctx, struct BranchPath* node);
+void softMin(struct SearchContext* ctx, struct BranchPath *node);
 
 // Sorting functions
 int alpha_sort(const void* elem1, const void* elem2);
 int alpha_sort_reverse(const void* elem1, const void* elem2);
 struct Inventory getSortedInventory(struct Inventory inventory, enum Action sort);
 int getSortFrames(enum Action action);
-void handleSorts(struct BranchPath* curNode);
+void handleSorts(struct SearchContext* ctx, struct BranchPath* curNode);
 int type_sort(const void* elem1, const void* elem2);
 int type_sort_reverse(const void* elem1, const void* elem2);
 
@@ -184,11 +221,16 @@ void swapItems(int* ingredientLoc);
 // ABSL_MUST_USE_RESULT_INCLUSIVE int *copyOutputsFulfilled(int *oldOutputsFulfilled);
 void freeAllNodes(struct BranchPath* node);
 void freeNode(struct BranchPath *node);
-struct BranchPath* initializeRoot();
+struct BranchPath* initializeRoot(struct SearchContext* ctx);
 
 // Other
 void periodicGithubCheck();
+void setSavedPbRecord(int frames);
+void setBenchmarkMode(bool enabled);
 // void logIterations(int ID, int stepIndex, struct BranchPath * curNode, long iterationCount, long iterationLimit, int level);
-struct Result calculateOrder(int rawID, long max_branches);
+// Bind a context to the calling thread, whose stats slot and generator must already be
+// bound and seeded. Cheap enough to call before every search.
+void initSearchContext(struct SearchContext* ctx, int rawID);
+struct Result calculateOrder(struct SearchContext* ctx, long max_branches);
 
 #endif
@@ -0,0 +1,193 @@
+#include "checkpoint.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include "base.h"
+#include "atomic_file.h"
+#include "logger.h"
+#include "roadmap_binary.h"
+#if _CIPES_IS_WINDOWS
+#include <direct.h>
+#endif
+
+#define CHECKPOINT_MAX_SIZE (CHECKPOINT_HEADER_SIZE + ROADMAP_BINARY_HEADER_SIZE + ROADMAP_BINARY_MAX_RECORDS * ROADMAP_BINARY_RECORD_SIZE)
+
+static const char checkpointMagic[4] = { 'C', 'R', 'C', 'P' };
+
+// Cleared once the directory has been found empty, so threads stop scanning it on every dive.
+// Set again when a parked thread saves its dive mid-run.
+static bool checkpointsPending = false;
+// Tells apart checkpoints one thread writes within the same second
+static int checkpointSequence = 0;
+
+static void putLittleEndian(uint8_t *dest, uint64_t value, int bytes) {
+	for (int i = 0; i < bytes; ++i) {
+		dest[i] = (uint8_t)(value >> (8 * i));
+	}
+}
+
+static uint64_t getLittleEndian(const uint8_t *src, int bytes) {
+	uint64_t value = 0;
+	for (int i = 0; i < bytes; ++i) {
+		value |= (uint64_t)src[i] << (8 * i);
+	}
+	return value;
+}
+
+static bool isCheckpointName(const char *name) {
+	size_t length = strlen(name);
+	size_t suffixLength = strlen(CHECKPOINT_SUFFIX);
+	return length > suffixLength && strcmp(name + length - suffixLength, CHECKPOINT_SUFFIX) == 0;
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: initCheckpoints
+ *
+ * Make sure the checkpoint directory exists (results/ must already
+ * exist), and check whether there are dives to resume.
+ -------------------------------------------------------------------*/
+void initCheckpoints() {
+#if _CIPES_IS_WINDOWS
+	_mkdir(CHECKPOINT_DIR);
+#else
+	mkdir(CHECKPOINT_DIR, 0777);
+#endif
+	int pending = 0;
+	DIR *dir = opendir(CHECKPOINT_DIR);
+	if (dir != NULL) {
+		struct dirent *entry;
+		while ((entry = readdir(dir)) != NULL) {
+			pending += isCheckpointName(entry->d_name);
+		}
+		closedir(dir);
+	}
+	checkpointsPending = pending > 0;
+	if (pending > 0 && will_log_level(2)) {
+		char logText[100];
+		sprintf(logText, "Found %d checkpointed dives to resume", pending);
+		recipeLog(2, "Calculator", "Checkpoint", "Load", logText);
+	}
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: writeDiveCheckpoint
+ * Inputs	: int			rawID
+ *		  struct BranchPath	*root
+ *		  long			iterationCount
+ *		  long			iterationLimit
+ *		  int			flags
+ * Outputs	: bool			success
+ *
+ * Files are named after the time, thread and a sequence number, so a run
+ * never overwrites a checkpoint that has not been resumed yet. Once
+ * written, the dive can be claimed by any search thread of this run.
+ -------------------------------------------------------------------*/
+bool writeDiveCheckpoint(int rawID, const struct BranchPath *root, long iterationCount, long iterationLimit, int flags) {
+	size_t pathSize;
+	uint8_t *path = encodeBinaryRoadmap(root, &pathSize);
+	uint8_t header[CHECKPOINT_HEADER_SIZE];
+	memcpy(header, checkpointMagic, sizeof(checkpointMagic));
+	putLittleEndian(header + 4, CHECKPOINT_VERSION, 2);
+	putLittleEndian(header + 6, (uint64_t)flags, 2);
+	putLittleEndian(header + 8, (uint64_t)iterationCount, 8);
+	putLittleEndian(header + 16, (uint64_t)iterationLimit, 8);
+
+	int sequence;
+	#pragma omp atomic capture
+	sequence = checkpointSequence++;
+
+	char filename[ATOMIC_FILE_MAX_PATH];
+	snprintf(filename, sizeof(filename), "%s/%ld-%d-%d%s", CHECKPOINT_DIR, (long)time(NULL), rawID, sequence, CHECKPOINT_SUFFIX);
+	struct AtomicFile file;
+	bool ok = atomicFileOpen(&file, filename);
+	if (ok) {
+		if (fwrite(header, 1, sizeof(header), file.fp) == sizeof(header)
+			&& fwrite(path, 1, pathSize, file.fp) == pathSize) {
+			ok = atomicFileCommit(&file);
+		}
+		else {
+			atomicFileAbort(&file);
+			ok = false;
+		}
+	}
+	free(path);
+
+	if (!ok) {
+		recipeLog(1, "Calculator", "Checkpoint", "Error", "Unable to write dive checkpoint.");
+	}
+	else {
+		#pragma omp critical(checkpoint)
+		checkpointsPending = true;
+	}
+	return ok;
+}
+
+static bool readDiveCheckpoint(const char *filename, struct DiveCheckpoint *checkpoint) {
+	FILE *fp = fopen(filename, "rb");
+	if (fp == NULL) {
+		return false;
+	}
+	uint8_t *data = malloc(CHECKPOINT_MAX_SIZE);
+	checkMallocFailed(data);
+	size_t size = fread(data, 1, CHECKPOINT_MAX_SIZE, fp);
+	fclose(fp);
+
+	bool ok = size >= CHECKPOINT_HEADER_SIZE
+		&& memcmp(data, checkpointMagic, sizeof(checkpointMagic)) == 0
+		&& getLittleEndian(data + 4, 2) == CHECKPOINT_VERSION;
+	if (ok) {
+		checkpoint->flags = (int)getLittleEndian(data + 6, 2);
+		checkpoint->iterationCount = (long)getLittleEndian(data + 8, 8);
+		checkpoint->iterationLimit = (long)getLittleEndian(data + 16, 8);
+		checkpoint->path = decodeBinaryRoadmap(data + CHECKPOINT_HEADER_SIZE, size - CHECKPOINT_HEADER_SIZE);
+		ok = checkpoint->path != NULL;
+	}
+	free(data);
+	return ok;
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: claimDiveCheckpoint
+ * Inputs	: struct DiveCheckpoint	*checkpoint
+ * Outputs	: bool			found
+ *
+ * Read the first checkpoint in the directory and delete it. Once the
+ * resumed dive is interrupted again, it gets a new checkpoint.
+ * Unreadable checkpoints are deleted and skipped.
+ -------------------------------------------------------------------*/
+bool claimDiveCheckpoint(struct DiveCheckpoint *checkpoint) {
+	if (!checkpointsPending) {
+		return false;
+	}
+	bool found = false;
+	#pragma omp critical(checkpoint)
+	{
+		DIR *dir = checkpointsPending ? opendir(CHECKPOINT_DIR) : NULL;
+		struct dirent *entry;
+		while (!found && dir != NULL && (entry = readdir(dir)) != NULL) {
+			if (!isCheckpointName(entry->d_name)) {
+				continue;
+			}
+			char filename[ATOMIC_FILE_MAX_PATH];
+			snprintf(filename, sizeof(filename), "%s/%s", CHECKPOINT_DIR, entry->d_name);
+			found = readDiveCheckpoint(filename, checkpoint);
+			if (!found) {
+				recipeLog(1, "Calculator", "Checkpoint", "Error", "Discarding unreadable dive checkpoint.");
+			}
+			remove(filename);
+		}
+		if (dir != NULL) {
+			closedir(dir);
+		}
+		if (!found) {
+			checkpointsPending = false;
+		}
+	}
+	return found;
+}
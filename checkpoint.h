@@ -0,0 +1,45 @@
+#ifndef CIPES_CHECKPOINT_H
+#define CIPES_CHECKPOINT_H
+
+#include <stdbool.h>
+#include "calculator.h"
+
+// When asked to shut down, each search thread saves the dive it was in the middle of here,
+// and the next run resumes those dives before starting any new ones. A thread parked by
+// the worker manager saves its dive here too, for an active thread of the same run to resume.
+#define CHECKPOINT_DIR "results/checkpoints"
+#define CHECKPOINT_SUFFIX ".ckpt"
+
+// File layout (all multi-byte fields little endian):
+//   char     magic[4]         "CRCP"
+//   uint16   version          CHECKPOINT_VERSION
+//   uint16   flags            CHECKPOINT_FLAG_*
+//   uint64   iterationCount
+//   uint64   iterationLimit
+//   ...      path             The path from the root to the deepest node, in the
+//                             binary roadmap format (see roadmap_binary.h)
+#define CHECKPOINT_VERSION 1
+#define CHECKPOINT_HEADER_SIZE 24
+
+#define CHECKPOINT_FLAG_LIMIT_INCREASED 0x1
+#define CHECKPOINT_FLAG_LIMIT_INCREASED_FROM_PB 0x2
+#define CHECKPOINT_FLAG_LIMIT_INCREASED_FROM_GETTING_CLOSE 0x4
+#define CHECKPOINT_FLAG_LIMIT_INCREASED_FROM_GETTING_KIND_OF_CLOSE 0x8
+
+struct DiveCheckpoint {
+	long iterationCount;
+	long iterationLimit;
+	int flags;
+	// Root of the saved path. Nodes have no legal moves; free with freeAllNodes on the last node.
+	struct BranchPath *path;
+};
+
+// Create the checkpoint directory, and note whether a previous run left anything to resume.
+void initCheckpoints();
+// Save the path from root (following next) along with the dive's iteration state.
+bool writeDiveCheckpoint(int rawID, const struct BranchPath *root, long iterationCount, long iterationLimit, int flags);
+// Take one saved dive off disk. Returns false if there is nothing (more) to resume.
+// Safe to call from several search threads at once; each checkpoint is handed out only once.
+bool claimDiveCheckpoint(struct DiveCheckpoint *checkpoint);
+
+#endif
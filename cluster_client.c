@@ -0,0 +1,272 @@
+#include "cluster_client.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+#include <pthread.h>
+#include "base.h"
+#include "cluster_protocol.h"
+#include "elite_pool.h"
+#include "logger.h"
+#include "roadmap_binary.h"
+#include "start.h"
+#if !_CIPES_IS_WINDOWS
+#include <poll.h>
+#endif
+
+static pthread_t clientThread;
+static pthread_mutex_t clientLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t clientCond = PTHREAD_COND_INITIALIZER;
+static bool clientStopping = false;
+static bool clientThreadStarted = false;
+static char coordinatorAddress[256];
+// Only touched by the client thread, once it has started
+static struct ClusterConnection connection = { .fd = -1 };
+
+static bool clusterSeedReceived = false;
+static uint64_t clusterSeed;
+
+// The fastest roadmap this process knows of, found here or sent by the coordinator,
+// and whether the coordinator has yet to hear of it. Only touched under clientLock.
+static struct CompactRoadmap bestRoadmap = { .numMoves = 0, .frames = UNSET_FRAME_RECORD };
+static bool bestRoadmapUnsent = false;
+
+#if !_CIPES_IS_WINDOWS
+static void dropCoordinator() {
+	freeClusterConnection(&connection);
+	char message[350];
+	snprintf(message, sizeof(message), "Lost the coordinator at %s. Searching on our own until it is back.", coordinatorAddress);
+	recipeLog(1, "Cluster", "Coordinator", "Lost", message);
+}
+
+static void takeFleetRoadmap(const char *arguments) {
+	static struct CompactRoadmap roadmap;
+	if (!parseRoadmapMessage(arguments, &roadmap)) {
+		recipeLog(2, "Cluster", "Roadmap", "Error", "The coordinator sent a roadmap which does not hold up. Ignoring it.");
+		return;
+	}
+	offerEliteMoves(roadmap.moves, roadmap.numMoves, roadmap.frames);
+	pthread_mutex_lock(&clientLock);
+	if (roadmap.frames < bestRoadmap.frames) {
+		bestRoadmap = roadmap;
+		bestRoadmapUnsent = false;
+	}
+	pthread_mutex_unlock(&clientLock);
+	if (lowerLocalRecord(roadmap.frames)) {
+		char message[150];
+		sprintf(message, "The fleet found a %d frame roadmap. Searching for faster ones from here on.", roadmap.frames);
+		recipeLog(1, "Cluster", "Roadmap", "Record", message);
+	}
+}
+
+static void handleCoordinatorLines() {
+	char *line;
+	while ((line = nextClusterLine(&connection)) != NULL) {
+		if (strncmp(line, "ROADMAP ", strlen("ROADMAP ")) == 0) {
+			takeFleetRoadmap(line + strlen("ROADMAP "));
+		}
+	}
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: joinCoordinator
+ * Inputs	: bool	atStartup
+ * Outputs	: bool	joined
+ *
+ * Connect and say HELLO, then wait a moment for the WELCOME. Anything
+ * sent after it is left in the buffer for the client thread.
+ -------------------------------------------------------------------*/
+static bool joinCoordinator(bool atStartup) {
+	const int fd = openClusterSocket(coordinatorAddress, false);
+	if (fd < 0) {
+		return false;
+	}
+	initClusterConnection(&connection, fd);
+	char hello[50];
+	sprintf(hello, "HELLO %d %d", CLUSTER_PROTOCOL_VERSION, getLocalRecord());
+	int workerNumber = -1;
+	uint64_t seed;
+	int record;
+	if (sendClusterLine(fd, hello)) {
+		struct pollfd pending = { .fd = fd, .events = POLLIN };
+		char *line = NULL;
+		while (line == NULL && poll(&pending, 1, CLUSTER_CONNECT_TIMEOUT_MS) > 0 && receiveClusterData(&connection)) {
+			line = nextClusterLine(&connection);
+		}
+		if (line == NULL || sscanf(line, "WELCOME %d %" SCNu64 " %d", &workerNumber, &seed, &record) != 3) {
+			workerNumber = -1;
+		}
+	}
+	if (workerNumber < 0) {
+		freeClusterConnection(&connection);
+		return false;
+	}
+
+	if (atStartup) {
+		clusterSeed = seed;
+		clusterSeedReceived = true;
+	}
+	pthread_mutex_lock(&clientLock);
+	// Sent again after every reconnect, in case the coordinator restarted and lost it
+	bestRoadmapUnsent = bestRoadmap.numMoves > 0;
+	pthread_mutex_unlock(&clientLock);
+	char message[350];
+	snprintf(message, sizeof(message), "Joined the coordinator at %s as worker %d. The fleet record is %d frames.", coordinatorAddress, workerNumber, record);
+	recipeLog(1, "Cluster", "Coordinator", "Joined", message);
+	return true;
+}
+
+static bool sendBestRoadmap() {
+	static struct CompactRoadmap unsent;
+	pthread_mutex_lock(&clientLock);
+	const bool haveUnsent = bestRoadmapUnsent;
+	if (haveUnsent) {
+		unsent = bestRoadmap;
+		bestRoadmapUnsent = false;
+	}
+	pthread_mutex_unlock(&clientLock);
+	if (!haveUnsent) {
+		return true;
+	}
+	char *line = formatRoadmapMessage(&unsent);
+	if (line == NULL) {
+		return true;
+	}
+	const bool sent = sendClusterLine(connection.fd, line);
+	free(line);
+	if (!sent) {
+		pthread_mutex_lock(&clientLock);
+		bestRoadmapUnsent = bestRoadmap.frames == unsent.frames;
+		pthread_mutex_unlock(&clientLock);
+	}
+	return sent;
+}
+
+static void *clusterClientMain(void *unused) {
+	pthread_mutex_lock(&clientLock);
+	while (!clientStopping) {
+		if (connection.fd < 0) {
+			struct timespec deadline;
+			clock_gettime(CLOCK_REALTIME, &deadline);
+			deadline.tv_sec += CLUSTER_RETRY_SECS;
+			pthread_cond_timedwait(&clientCond, &clientLock, &deadline);
+			if (clientStopping) {
+				break;
+			}
+			pthread_mutex_unlock(&clientLock);
+			joinCoordinator(false);
+		}
+		else {
+			pthread_mutex_unlock(&clientLock);
+			// Lines left in the buffer by joinCoordinator are handled on the first pass
+			struct pollfd pending = { .fd = connection.fd, .events = POLLIN };
+			bool connected = true;
+			if (poll(&pending, 1, CLUSTER_POLL_INTERVAL_MS) > 0) {
+				connected = receiveClusterData(&connection);
+			}
+			if (connected) {
+				handleCoordinatorLines();
+				connected = sendBestRoadmap();
+			}
+			if (!connected) {
+				dropCoordinator();
+			}
+		}
+		pthread_mutex_lock(&clientLock);
+	}
+	pthread_mutex_unlock(&clientLock);
+	return NULL;
+}
+#endif
+
+/*-------------------------------------------------------------------
+ * Function 	: startClusterClient
+ * Inputs	: const char	*address
+ *
+ * The PB roadmap in results/ is made ready to send, so the fleet hears
+ * of it even if it was found before the coordinator started. The first
+ * connection is made here rather than on the thread, so the seed the
+ * coordinator hands out is known before any search thread is seeded.
+ -------------------------------------------------------------------*/
+void startClusterClient(const char *address) {
+	if (address == NULL || address[0] == '\0') {
+		return;
+	}
+#if _CIPES_IS_WINDOWS
+	recipeLog(2, "Cluster", "Coordinator", "Error", "Cluster mode is not supported on Windows. Searching on our own.");
+#else
+	if (strlen(address) >= sizeof(coordinatorAddress)) {
+		recipeLog(1, "Cluster", "Coordinator", "Error", "coordinatorAddress is too long. Searching on our own.");
+		return;
+	}
+	strcpy(coordinatorAddress, address);
+
+	char filename[32];
+	sprintf(filename, "results/%d.bin", getLocalRecord());
+	struct BranchPath *root = readBinaryRoadmap(filename);
+	if (root != NULL) {
+		struct BranchPath *last = root;
+		while (last->next != NULL) {
+			last = last->next;
+		}
+		bestRoadmap.numMoves = extractReplayMoves(root, bestRoadmap.moves, REPLAY_MAX_MOVES);
+		bestRoadmap.frames = last->description.totalFramesTaken;
+		if (bestRoadmap.numMoves < 0) {
+			bestRoadmap.numMoves = 0;
+			bestRoadmap.frames = UNSET_FRAME_RECORD;
+		}
+		freeAllNodes(last);
+	}
+
+	if (!joinCoordinator(true)) {
+		char message[350];
+		snprintf(message, sizeof(message), "No coordinator at %s. Searching on our own, and trying again every %d seconds.", coordinatorAddress, CLUSTER_RETRY_SECS);
+		recipeLog(1, "Cluster", "Coordinator", "Standalone", message);
+	}
+	clientStopping = false;
+	if (pthread_create(&clientThread, NULL, clusterClientMain, NULL) != 0) {
+		recipeLog(1, "Cluster", "Coordinator", "Error", "Unable to start the cluster thread. Searching on our own.");
+		if (connection.fd >= 0) {
+			freeClusterConnection(&connection);
+		}
+		return;
+	}
+	clientThreadStarted = true;
+#endif
+}
+
+void stopClusterClient() {
+	if (!clientThreadStarted) {
+		return;
+	}
+	pthread_mutex_lock(&clientLock);
+	clientStopping = true;
+	pthread_cond_signal(&clientCond);
+	pthread_mutex_unlock(&clientLock);
+	pthread_join(clientThread, NULL);
+	if (connection.fd >= 0) {
+		freeClusterConnection(&connection);
+	}
+	clientThreadStarted = false;
+}
+
+bool getClusterSeed(uint64_t *seed) {
+	if (clusterSeedReceived) {
+		*seed = clusterSeed;
+	}
+	return clusterSeedReceived;
+}
+
+void reportClusterRecord(const struct CompactRoadmap *roadmap) {
+	if (!clientThreadStarted) {
+		return;
+	}
+	pthread_mutex_lock(&clientLock);
+	if (roadmap->frames < bestRoadmap.frames) {
+		bestRoadmap = *roadmap;
+		bestRoadmapUnsent = true;
+	}
+	pthread_mutex_unlock(&clientLock);
+}
@@ -0,0 +1,26 @@
+#ifndef CIPES_CLUSTER_CLIENT_H
+#define CIPES_CLUSTER_CLIENT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "path_replay.h"
+
+// The worker side of cluster mode (see coordinator.h). A thread of its own talks to the
+// coordinator: it reports every new record, and takes the fleet's fastest roadmaps into the
+// elite pool and the local record. While the coordinator can't be reached the search carries
+// on standalone, and the thread tries again every CLUSTER_RETRY_SECS.
+
+#define CLUSTER_RETRY_SECS 60
+
+// Connect to the coordinator at address (see cluster_protocol.h) and start the thread.
+// Does nothing if address is NULL or empty. Must be called after the recipe tables are
+// initialized, and before chooseMasterSeed so that the coordinator's seed can be used.
+void startClusterClient(const char *address);
+void stopClusterClient();
+// The seed the coordinator handed this process at startup.
+// Returns false if there was no coordinator to hand one out.
+bool getClusterSeed(uint64_t *seed);
+// Pass a new local record on to the coordinator. Never waits on the network.
+void reportClusterRecord(const struct CompactRoadmap *roadmap);
+
+#endif
@@ -0,0 +1,366 @@
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+// For getaddrinfo, which -std=c17 otherwise hides
+#define _POSIX_C_SOURCE 200112L
+#endif
+#include "cluster_protocol.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include "base.h"
+#include "logger.h"
+#include "recipes.h"
+#include "roadmap_binary.h"
+#if !_CIPES_IS_WINDOWS
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#endif
+
+#define CLUSTER_LISTEN_BACKLOG 16
+#define CLUSTER_UNIX_PREFIX "unix:"
+
+#ifdef MSG_NOSIGNAL
+#define CLUSTER_SEND_FLAGS MSG_NOSIGNAL
+#else
+#define CLUSTER_SEND_FLAGS 0
+#endif
+
+static const char hexDigits[] = "0123456789abcdef";
+
+static int hexValue(char c) {
+	if (c >= '0' && c <= '9') {
+		return c - '0';
+	}
+	if (c >= 'a' && c <= 'f') {
+		return c - 'a' + 10;
+	}
+	if (c >= 'A' && c <= 'F') {
+		return c - 'A' + 10;
+	}
+	return -1;
+}
+
+#if !_CIPES_IS_WINDOWS
+// Workers retry the coordinator now and then, so failing to reach it is less worth logging than failing to listen
+static void logSocketError(const char *what, const char *address, bool listening) {
+	char message[250];
+	snprintf(message, sizeof(message), "%s %s: %s", what, address, strerror(errno));
+	recipeLog(listening ? 1 : 2, "Cluster", "Socket", "Error", message);
+}
+
+// connect, giving up after CLUSTER_CONNECT_TIMEOUT_MS instead of the system's much longer timeout
+static bool connectWithTimeout(int fd, const struct sockaddr *address, socklen_t addressLength) {
+	const int flags = fcntl(fd, F_GETFL, 0);
+	fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+	bool connected = connect(fd, address, addressLength) == 0;
+	if (!connected && errno == EINPROGRESS) {
+		struct pollfd pending = { .fd = fd, .events = POLLOUT };
+		if (poll(&pending, 1, CLUSTER_CONNECT_TIMEOUT_MS) > 0) {
+			int error = 0;
+			socklen_t errorLength = sizeof(error);
+			connected = getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &errorLength) == 0 && error == 0;
+			errno = error;
+		}
+		else {
+			errno = ETIMEDOUT;
+		}
+	}
+	fcntl(fd, F_SETFL, flags);
+	return connected;
+}
+
+static int openUnixSocket(const char *address, bool listening) {
+	const char *path = address + strlen(CLUSTER_UNIX_PREFIX);
+	struct sockaddr_un unixAddress = { .sun_family = AF_UNIX };
+	if (path[0] == '\0' || strlen(path) >= sizeof(unixAddress.sun_path)) {
+		recipeLog(1, "Cluster", "Socket", "Error", "The Unix socket path of the coordinator address is empty or too long.");
+		return -1;
+	}
+	strcpy(unixAddress.sun_path, path);
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0) {
+		logSocketError("Unable to create a socket for", address, listening);
+		return -1;
+	}
+	bool ok;
+	if (listening) {
+		unlink(path);
+		ok = bind(fd, (struct sockaddr *)&unixAddress, sizeof(unixAddress)) == 0 && listen(fd, CLUSTER_LISTEN_BACKLOG) == 0;
+	}
+	else {
+		ok = connectWithTimeout(fd, (struct sockaddr *)&unixAddress, sizeof(unixAddress));
+	}
+	if (!ok) {
+		logSocketError(listening ? "Unable to listen on" : "Unable to connect to", address, listening);
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: openTcpSocket
+ * Inputs	: const char	*address
+ *		  bool		listening
+ * Outputs	: int		fd
+ *
+ * address is <host>:<port>, with an IPv6 host in brackets. Names are
+ * resolved as the system does (e.g. /etc/hosts), and every address
+ * found is tried in turn.
+ -------------------------------------------------------------------*/
+static int openTcpSocket(const char *address, bool listening) {
+	char host[256];
+	const char *portStart = strrchr(address, ':');
+	size_t hostLength = portStart == NULL ? 0 : (size_t)(portStart - address);
+	if (portStart == NULL || portStart[1] == '\0' || hostLength >= sizeof(host)) {
+		recipeLog(1, "Cluster", "Socket", "Error", "The coordinator address must be unix:<path> or <host>:<port>.");
+		return -1;
+	}
+	memcpy(host, address, hostLength);
+	host[hostLength] = '\0';
+	char *hostName = host;
+	if (hostLength >= 2 && host[0] == '[' && host[hostLength - 1] == ']') {
+		host[hostLength - 1] = '\0';
+		++hostName;
+	}
+
+	struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM, .ai_flags = listening ? AI_PASSIVE : 0 };
+	struct addrinfo *found = NULL;
+	int lookup = getaddrinfo(hostName[0] != '\0' ? hostName : NULL, portStart + 1, &hints, &found);
+	if (lookup != 0) {
+		char message[300];
+		snprintf(message, sizeof(message), "Unable to look up %s: %s", address, gai_strerror(lookup));
+		recipeLog(1, "Cluster", "Socket", "Error", message);
+		return -1;
+	}
+
+	int fd = -1;
+	for (struct addrinfo *candidate = found; candidate != NULL && fd < 0; candidate = candidate->ai_next) {
+		fd = socket(candidate->ai_family, candidate->ai_socktype, candidate->ai_protocol);
+		if (fd < 0) {
+			continue;
+		}
+		bool ok;
+		if (listening) {
+			int reuse = 1;
+			setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+			ok = bind(fd, candidate->ai_addr, candidate->ai_addrlen) == 0 && listen(fd, CLUSTER_LISTEN_BACKLOG) == 0;
+		}
+		else {
+			ok = connectWithTimeout(fd, candidate->ai_addr, candidate->ai_addrlen);
+		}
+		if (!ok) {
+			close(fd);
+			fd = -1;
+		}
+	}
+	if (fd < 0) {
+		logSocketError(listening ? "Unable to listen on" : "Unable to connect to", address, listening);
+	}
+	freeaddrinfo(found);
+	return fd;
+}
+#endif
+
+// Bound how long a peer can hold up a send, and never die of SIGPIPE if it hangs up
+void setUpClusterSocket(int fd) {
+#if !_CIPES_IS_WINDOWS
+	struct timeval timeout = { CLUSTER_SEND_TIMEOUT_SECS, 0 };
+	setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+#ifdef SO_NOSIGPIPE
+	int noSigpipe = 1;
+	setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &noSigpipe, sizeof(noSigpipe));
+#endif
+#endif
+}
+
+int openClusterSocket(const char *address, bool listening) {
+#if _CIPES_IS_WINDOWS
+	recipeLog(1, "Cluster", "Socket", "Error", "Cluster mode is not supported on Windows.");
+	return -1;
+#else
+	const int fd = strncmp(address, CLUSTER_UNIX_PREFIX, strlen(CLUSTER_UNIX_PREFIX)) == 0
+		? openUnixSocket(address, listening) : openTcpSocket(address, listening);
+	if (fd >= 0) {
+		setUpClusterSocket(fd);
+	}
+	return fd;
+#endif
+}
+
+void closeClusterSocket(int fd) {
+#if !_CIPES_IS_WINDOWS
+	if (fd >= 0) {
+		close(fd);
+	}
+#endif
+}
+
+void closeClusterListener(int fd, const char *address) {
+	closeClusterSocket(fd);
+#if !_CIPES_IS_WINDOWS
+	if (strncmp(address, CLUSTER_UNIX_PREFIX, strlen(CLUSTER_UNIX_PREFIX)) == 0) {
+		unlink(address + strlen(CLUSTER_UNIX_PREFIX));
+	}
+#endif
+}
+
+void initClusterConnection(struct ClusterConnection *connection, int fd) {
+	connection->fd = fd;
+	connection->buffer = malloc(CLUSTER_MAX_LINE);
+	checkMallocFailed(connection->buffer);
+	connection->length = 0;
+	connection->consumed = 0;
+}
+
+void freeClusterConnection(struct ClusterConnection *connection) {
+	closeClusterSocket(connection->fd);
+	free(connection->buffer);
+	connection->fd = -1;
+	connection->buffer = NULL;
+}
+
+bool receiveClusterData(struct ClusterConnection *connection) {
+#if _CIPES_IS_WINDOWS
+	return false;
+#else
+	// Lines already handed out are dropped now, as their pointers are no longer used
+	memmove(connection->buffer, connection->buffer + connection->consumed, connection->length - connection->consumed);
+	connection->length -= connection->consumed;
+	connection->consumed = 0;
+	if (connection->length == CLUSTER_MAX_LINE) {
+		return false;
+	}
+	ssize_t received = recv(connection->fd, connection->buffer + connection->length, CLUSTER_MAX_LINE - connection->length, 0);
+	if (received <= 0) {
+		return received < 0 && errno == EINTR;
+	}
+	connection->length += received;
+	return true;
+#endif
+}
+
+char *nextClusterLine(struct ClusterConnection *connection) {
+	char *start = connection->buffer + connection->consumed;
+	char *newline = memchr(start, '\n', connection->length - connection->consumed);
+	if (newline == NULL) {
+		return NULL;
+	}
+	*newline = '\0';
+	if (newline > start && newline[-1] == '\r') {
+		newline[-1] = '\0';
+	}
+	connection->consumed = newline + 1 - connection->buffer;
+	return start;
+}
+
+bool sendClusterLine(int fd, const char *line) {
+#if _CIPES_IS_WINDOWS
+	return false;
+#else
+	const char *parts[] = { line, "\n" };
+	for (int i = 0; i < 2; ++i) {
+		const char *data = parts[i];
+		size_t length = strlen(data);
+		while (length > 0) {
+			ssize_t sent = send(fd, data, length, CLUSTER_SEND_FLAGS);
+			if (sent <= 0) {
+				return false;
+			}
+			data += sent;
+			length -= sent;
+		}
+	}
+	return true;
+#endif
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: formatRoadmapMessage
+ * Inputs	: struct CompactRoadmap	*roadmap
+ * Outputs	: char			*line
+ *
+ * Rebuild the nodes of the roadmap, so it can be sent in the same
+ * binary format as results/<frames>.bin.
+ -------------------------------------------------------------------*/
+char *formatRoadmapMessage(const struct CompactRoadmap *roadmap) {
+	struct BranchPath *last = buildReplayPath(roadmap->moves, roadmap->numMoves, NULL, NULL);
+	if (last == NULL) {
+		return NULL;
+	}
+	if (last->description.totalFramesTaken != roadmap->frames) {
+		freeAllNodes(last);
+		return NULL;
+	}
+	struct BranchPath *root = last;
+	while (root->prev != NULL) {
+		root = root->prev;
+	}
+	size_t size;
+	uint8_t *encoded = encodeBinaryRoadmap(root, &size);
+	freeAllNodes(last);
+
+	char *line = malloc(32 + 2 * size);
+	checkMallocFailed(line);
+	char *out = line + sprintf(line, "ROADMAP %d ", roadmap->frames);
+	for (size_t i = 0; i < size; ++i) {
+		*out++ = hexDigits[encoded[i] >> 4];
+		*out++ = hexDigits[encoded[i] & 0xF];
+	}
+	*out = '\0';
+	free(encoded);
+	return line;
+}
+
+bool parseRoadmapMessage(const char *arguments, struct CompactRoadmap *roadmap) {
+	char *hex;
+	long frames = strtol(arguments, &hex, 10);
+	if (hex == arguments || *hex != ' ' || frames < 0 || frames > INT32_MAX) {
+		return false;
+	}
+	++hex;
+	const size_t hexLength = strlen(hex);
+	if (hexLength == 0 || hexLength % 2 != 0) {
+		return false;
+	}
+	const size_t size = hexLength / 2;
+	uint8_t *data = malloc(size);
+	checkMallocFailed(data);
+	for (size_t i = 0; i < size; ++i) {
+		const int high = hexValue(hex[2 * i]);
+		const int low = hexValue(hex[2 * i + 1]);
+		if (high < 0 || low < 0) {
+			free(data);
+			return false;
+		}
+		data[i] = (uint8_t)(high << 4 | low);
+	}
+	struct BranchPath *root = decodeBinaryRoadmap(data, size);
+	free(data);
+	if (root == NULL) {
+		return false;
+	}
+	struct BranchPath *last = root;
+	while (last->next != NULL) {
+		last = last->next;
+	}
+	roadmap->numMoves = extractReplayMoves(root, roadmap->moves, REPLAY_MAX_MOVES);
+	roadmap->frames = (int)frames;
+	freeAllNodes(last);
+
+	// The nodes sent along are not trusted; only the moves are, once they replay to the claimed frames
+	struct ReplayState state;
+	int failedMove;
+	return roadmap->numMoves > 0
+		&& replayMoves(roadmap->moves, roadmap->numMoves, &state, &failedMove) == REPLAY_OK
+		&& state.numOutputsCreated == NUM_RECIPES
+		&& state.totalFramesTaken == roadmap->frames;
+}
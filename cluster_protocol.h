@@ -0,0 +1,57 @@
+#ifndef CIPES_CLUSTER_PROTOCOL_H
+#define CIPES_CLUSTER_PROTOCOL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "path_replay.h"
+
+// What the coordinator (coordinator.c) and its workers (cluster_client.c) say to each other,
+// over a Unix domain socket ("unix:<path>") or TCP ("<host>:<port>", e.g. "192.168.1.5:7878").
+// One message per line:
+//   worker -> coordinator	HELLO <version> <record>
+//   coordinator -> worker	WELCOME <workerNumber> <seed> <record>
+//   either way			ROADMAP <frames> <hex of the binary roadmap format (roadmap_binary.h)>
+// Unknown messages are ignored, so either side can be newer.
+
+#define CLUSTER_PROTOCOL_VERSION 1
+// Room for a hex encoded roadmap of ROADMAP_BINARY_MAX_RECORDS nodes, with plenty to spare
+#define CLUSTER_MAX_LINE 65536
+// The coordinator keeps, and hands every new worker, this many of the fleet's fastest roadmaps
+#define CLUSTER_ELITE_SIZE 8
+#define CLUSTER_CONNECT_TIMEOUT_MS 2000
+// A peer which doesn't take a message within this long is dropped
+#define CLUSTER_SEND_TIMEOUT_SECS 5
+#define CLUSTER_POLL_INTERVAL_MS 250
+
+// Bytes received from one peer, not yet taken as lines
+struct ClusterConnection {
+	int fd;
+	char *buffer;		// CLUSTER_MAX_LINE bytes
+	size_t length;
+	size_t consumed;
+};
+
+// Listen on, or connect to, address. Returns the socket, or -1 after logging why not.
+int openClusterSocket(const char *address, bool listening);
+// Done by openClusterSocket; only needed for sockets from accept
+void setUpClusterSocket(int fd);
+void closeClusterSocket(int fd);
+// Close a socket opened with listening set, removing its socket file if it is a Unix socket.
+void closeClusterListener(int fd, const char *address);
+void initClusterConnection(struct ClusterConnection *connection, int fd);
+// Closes the socket too
+void freeClusterConnection(struct ClusterConnection *connection);
+// Read whatever has arrived. Returns false once the peer hangs up, fails, or sends a line too long to hold.
+bool receiveClusterData(struct ClusterConnection *connection);
+// The next complete line, without its newline, or NULL. Only valid until the next receiveClusterData.
+char *nextClusterLine(struct ClusterConnection *connection);
+// line must not hold a newline; one is sent after it.
+bool sendClusterLine(int fd, const char *line);
+
+// A malloced "ROADMAP ..." line, or NULL if the moves don't replay to roadmap->frames.
+char *formatRoadmapMessage(const struct CompactRoadmap *roadmap);
+// Read what follows "ROADMAP " into roadmap. Returns false unless it is a complete roadmap
+// whose moves are legal and take the frames it claims.
+bool parseRoadmapMessage(const char *arguments, struct CompactRoadmap *roadmap);
+
+#endif
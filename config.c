@@ -26,14 +26,53 @@ void initConfig() {
 	config = configInstance;
 }
 
+/*-------------------------------------------------------------------
+ * Function 	: initConfigFromString
+ * Inputs	: const char	*contents
+ *
+ * Same as initConfig, but parses a built in config instead of config.txt.
+ * Used by modes that must behave the same regardless of the user's config.
+ -------------------------------------------------------------------*/
+void initConfigFromString(const char *contents) {
+	config_t *configInstance = malloc(sizeof(config_t));
+	config_init(configInstance);
+	if (config_read_string(configInstance, contents) == CONFIG_FALSE) {
+		printf("Built in config is malformed: %s\n", config_error_text(configInstance));
+		exit(1);
+	}
+
+	config = configInstance;
+}
+
 const char *getConfigStr(char *str) {
-	const char *temp;
+	// Options missing from older config files read as NULL
+	const char *temp = NULL;
 	config_lookup_string(config, str, &temp);
 	return temp;
 }
 
 int getConfigInt(char* str) {
-	int temp;
+	// Options missing from older config files read as 0
+	int temp = 0;
 	config_lookup_int(config, str, &temp);
 	return temp;
 }
+
+/*-------------------------------------------------------------------
+ * Function 	: rereadConfigInt
+ * Inputs	: const char	*str
+ *		  int		*value
+ * Outputs	: bool		whether the option was read
+ *
+ * Read one option from config.txt as it is now, for settings that can
+ * change while running. The config read at startup is left alone,
+ * as the search threads may be reading it at the same time.
+ -------------------------------------------------------------------*/
+bool rereadConfigInt(const char *str, int *value) {
+	config_t current;
+	config_init(&current);
+	bool found = config_read_file(&current, "config.txt") == CONFIG_TRUE
+		&& config_lookup_int(&current, str, value) == CONFIG_TRUE;
+	config_destroy(&current);
+	return found;
+}
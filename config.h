@@ -1,7 +1,11 @@
 #include <libconfig.h>
+#include <stdbool.h>
 
 void initConfig();
+void initConfigFromString(const char *contents);
 
 const char* getConfigStr(char* str);
 
-int getConfigInt(char* str);
\ No newline at end of file
+int getConfigInt(char* str);
+
+bool rereadConfigInt(const char *str, int *value);
\ No newline at end of file
@@ -0,0 +1,272 @@
+#include "coordinator.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "base.h"
+#include "calculator.h"
+#include "cluster_protocol.h"
+#include "logger.h"
+#include "shutdown.h"
+#include "start.h"
+#if !_CIPES_IS_WINDOWS
+#include <poll.h>
+#include <sys/socket.h>
+#endif
+
+#define COORDINATOR_MAX_WORKERS 64
+
+struct CoordinatorWorker {
+	struct ClusterConnection connection;
+	int number;		// 0 until it has said HELLO
+	bool failed;	// Dropped at the end of the current poll round
+};
+
+static struct CoordinatorWorker workers[COORDINATOR_MAX_WORKERS];
+static int numWorkers = 0;
+static int nextWorkerNumber = 1;
+static uint64_t coordinatorSeed;
+
+// The fleet's fastest roadmaps, fastest first, each with the ROADMAP line that passes it on
+static struct CompactRoadmap elites[CLUSTER_ELITE_SIZE];
+static char *eliteMessages[CLUSTER_ELITE_SIZE];
+static int numElites = 0;
+
+// One splitmix64 round, so neighbouring worker numbers get unrelated seeds
+static uint64_t workerSeed(int number) {
+	uint64_t seed = coordinatorSeed + (uint64_t)number * UINT64_C(0x9E3779B97F4A7C15);
+	seed = (seed ^ (seed >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+	seed = (seed ^ (seed >> 27)) * UINT64_C(0x94D049BB133111EB);
+	return seed ^ (seed >> 31);
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: offerCoordinatorElite
+ * Inputs	: struct CompactRoadmap	*roadmap
+ *		  const char		*message
+ * Outputs	: bool			accepted
+ *
+ * Insert the roadmap in frame order, evicting the slowest if the table
+ * is full. Roadmaps already in the table are turned away, so a worker
+ * sending back what it was given is not passed on again.
+ -------------------------------------------------------------------*/
+static bool offerCoordinatorElite(const struct CompactRoadmap *roadmap, const char *message) {
+	if (numElites == CLUSTER_ELITE_SIZE && roadmap->frames >= elites[numElites - 1].frames) {
+		return false;
+	}
+	for (int i = 0; i < numElites; ++i) {
+		if (elites[i].frames == roadmap->frames && elites[i].numMoves == roadmap->numMoves
+			&& memcmp(elites[i].moves, roadmap->moves, sizeof(roadmap->moves[0]) * roadmap->numMoves) == 0) {
+			return false;
+		}
+	}
+	if (numElites == CLUSTER_ELITE_SIZE) {
+		free(eliteMessages[--numElites]);
+	}
+	int index = numElites;
+	while (index > 0 && elites[index - 1].frames > roadmap->frames) {
+		elites[index] = elites[index - 1];
+		eliteMessages[index] = eliteMessages[index - 1];
+		--index;
+	}
+	elites[index] = *roadmap;
+	eliteMessages[index] = malloc(strlen(message) + 1);
+	checkMallocFailed(eliteMessages[index]);
+	strcpy(eliteMessages[index], message);
+	++numElites;
+	return true;
+}
+
+static void broadcastRoadmap(const char *message, const struct CoordinatorWorker *sender) {
+	for (int i = 0; i < numWorkers; ++i) {
+		struct CoordinatorWorker *worker = &workers[i];
+		if (worker != sender && worker->number != 0 && !worker->failed) {
+			worker->failed = !sendClusterLine(worker->connection.fd, message);
+		}
+	}
+}
+
+static bool greetWorker(struct CoordinatorWorker *worker, const char *arguments) {
+	int version;
+	int record;
+	if (sscanf(arguments, "%d %d", &version, &record) != 2 || version != CLUSTER_PROTOCOL_VERSION) {
+		char message[150];
+		sprintf(message, "A worker speaking a different protocol (not version %d) connected. Hanging up.", CLUSTER_PROTOCOL_VERSION);
+		recipeLog(1, "Coordinator", "Worker", "Error", message);
+		return false;
+	}
+	if (worker->number != 0) {
+		return true;
+	}
+	worker->number = nextWorkerNumber++;
+	char reply[100];
+	const uint64_t seed = workerSeed(worker->number);
+	sprintf(reply, "WELCOME %d %" PRIu64 " %d", worker->number, seed, numElites > 0 ? elites[0].frames : UNSET_FRAME_RECORD);
+	if (!sendClusterLine(worker->connection.fd, reply)) {
+		return false;
+	}
+	for (int i = 0; i < numElites; ++i) {
+		if (!sendClusterLine(worker->connection.fd, eliteMessages[i])) {
+			return false;
+		}
+	}
+	char message[200];
+	sprintf(message, "Worker %d joined with a %d frame record, and was given seed %" PRIu64 " and %d roadmaps", worker->number, record, seed, numElites);
+	recipeLog(1, "Coordinator", "Worker", "Joined", message);
+	return true;
+}
+
+static void takeRoadmap(struct CoordinatorWorker *worker, const char *line) {
+	static struct CompactRoadmap roadmap;
+	char message[150];
+	if (!parseRoadmapMessage(line + strlen("ROADMAP "), &roadmap)) {
+		sprintf(message, "Worker %d sent a roadmap which does not hold up. Ignoring it.", worker->number);
+		recipeLog(2, "Coordinator", "Roadmap", "Error", message);
+		return;
+	}
+	const bool fleetRecord = numElites == 0 || roadmap.frames < elites[0].frames;
+	if (!offerCoordinatorElite(&roadmap, line)) {
+		return;
+	}
+	if (fleetRecord) {
+		sprintf(message, "Worker %d found a %d frame roadmap, the fastest in the fleet", worker->number, roadmap.frames);
+		recipeLog(1, "Coordinator", "Roadmap", "Record", message);
+	}
+	else {
+		sprintf(message, "Worker %d found a %d frame roadmap", worker->number, roadmap.frames);
+		recipeLog(3, "Coordinator", "Roadmap", "Elite", message);
+	}
+	broadcastRoadmap(line, worker);
+}
+
+// Returns false if the worker should be dropped
+static bool handleWorkerLine(struct CoordinatorWorker *worker, const char *line) {
+	if (strncmp(line, "HELLO ", strlen("HELLO ")) == 0) {
+		return greetWorker(worker, line + strlen("HELLO "));
+	}
+	if (worker->number == 0) {
+		recipeLog(2, "Coordinator", "Worker", "Error", "A client sent something before saying HELLO. Hanging up.");
+		return false;
+	}
+	if (strncmp(line, "ROADMAP ", strlen("ROADMAP ")) == 0) {
+		takeRoadmap(worker, line);
+	}
+	return true;
+}
+
+#if !_CIPES_IS_WINDOWS
+static void acceptWorker(int listenFd) {
+	const int fd = accept(listenFd, NULL, NULL);
+	if (fd < 0) {
+		return;
+	}
+	if (numWorkers == COORDINATOR_MAX_WORKERS) {
+		recipeLog(1, "Coordinator", "Worker", "Error", "Too many workers are connected. Turning one away.");
+		closeClusterSocket(fd);
+		return;
+	}
+	setUpClusterSocket(fd);
+	struct CoordinatorWorker *worker = &workers[numWorkers++];
+	initClusterConnection(&worker->connection, fd);
+	worker->number = 0;
+	worker->failed = false;
+}
+
+static void dropFailedWorkers() {
+	for (int i = 0; i < numWorkers; ) {
+		if (!workers[i].failed) {
+			++i;
+			continue;
+		}
+		if (workers[i].number != 0) {
+			char message[100];
+			sprintf(message, "Worker %d left (%d still connected)", workers[i].number, numWorkers - 1);
+			recipeLog(1, "Coordinator", "Worker", "Left", message);
+		}
+		freeClusterConnection(&workers[i].connection);
+		workers[i] = workers[--numWorkers];
+	}
+}
+#endif
+
+/*-------------------------------------------------------------------
+ * Function 	: coordinatorMain
+ * Inputs	: int	argc
+ *		  char	**argv
+ * Outputs	: int	exit code
+ *
+ * Serve every worker from one thread: poll them all, act on each
+ * complete line, and drop the workers that hung up or could not keep
+ * up. The roadmaps kept are forgotten on exit; workers send theirs
+ * again when they reconnect.
+ -------------------------------------------------------------------*/
+int coordinatorMain(int argc, char **argv) {
+	if (argc != 3) {
+		printf("Usage: %s --coordinator <unix:path | host:port>\n", argv[0]);
+		return 1;
+	}
+#if _CIPES_IS_WINDOWS
+	printf("Cluster mode is not supported on Windows.\n");
+	return 1;
+#else
+	// For logLevel and randomSeed
+	initConfig();
+	// Needed to replay the roadmaps workers report
+	initializeInvFrames();
+	initializeRecipeList();
+
+	const char *address = argv[2];
+	const int listenFd = openClusterSocket(address, true);
+	if (listenFd < 0) {
+		return 1;
+	}
+	coordinatorSeed = chooseMasterSeed();
+	setSignalHandlers();
+	char message[300];
+	snprintf(message, sizeof(message), "Coordinating workers on %s. Random seed: %" PRIu64, address, coordinatorSeed);
+	recipeLog(1, "Coordinator", "Startup", "Listening", message);
+
+	struct pollfd fds[1 + COORDINATOR_MAX_WORKERS];
+	while (!askedToShutdown()) {
+		fds[0] = (struct pollfd) { .fd = listenFd, .events = POLLIN };
+		const int numPolled = numWorkers;
+		for (int i = 0; i < numPolled; ++i) {
+			fds[1 + i] = (struct pollfd) { .fd = workers[i].connection.fd, .events = POLLIN };
+		}
+		if (poll(fds, 1 + numPolled, CLUSTER_POLL_INTERVAL_MS) <= 0) {
+			continue;
+		}
+		for (int i = 0; i < numPolled; ++i) {
+			struct CoordinatorWorker *worker = &workers[i];
+			if (worker->failed || fds[1 + i].revents == 0) {
+				continue;
+			}
+			if (!receiveClusterData(&worker->connection)) {
+				worker->failed = true;
+				continue;
+			}
+			char *line;
+			while (!worker->failed && (line = nextClusterLine(&worker->connection)) != NULL) {
+				worker->failed = !handleWorkerLine(worker, line);
+			}
+		}
+		dropFailedWorkers();
+		if (fds[0].revents & POLLIN) {
+			acceptWorker(listenFd);
+		}
+	}
+
+	for (int i = 0; i < numWorkers; ++i) {
+		freeClusterConnection(&workers[i].connection);
+	}
+	numWorkers = 0;
+	for (int i = 0; i < numElites; ++i) {
+		free(eliteMessages[i]);
+	}
+	numElites = 0;
+	closeClusterListener(listenFd, address);
+	recipeLog(1, "Coordinator", "Shutdown", "Stopped", "Coordinator stopped.");
+	return 0;
+#endif
+}
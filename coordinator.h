@@ -0,0 +1,12 @@
+#ifndef CIPES_COORDINATOR_H
+#define CIPES_COORDINATOR_H
+
+// recipesAtHome --coordinator <address>
+// Run as the coordinator of a fleet of recipesAtHome processes, listening on address
+// ("unix:<path>", or "<host>:<port>" such as "0.0.0.0:7878" for a LAN). Every worker that
+// connects is handed its own random seed and the fleet's fastest roadmaps to warm-start from,
+// and every record a worker reports is checked, then passed on to all the others.
+// Nothing is searched here, and nothing outside the fleet is contacted. Stops on Ctrl-C.
+int coordinatorMain(int argc, char **argv);
+
+#endif
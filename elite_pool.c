@@ -0,0 +1,104 @@
+#include "elite_pool.h"
+
+#include <stdbool.h>
+#include <string.h>
+#include "base.h"
+#include "path_replay.h"
+#include "shared_record.h"
+#include "thread_local_random.h"
+
+struct EliteRoadmap {
+	struct ReplayMove moves[REPLAY_MAX_MOVES];
+	int numMoves;
+	int frames;
+};
+
+// Sorted fastest first. Only touched inside critical(elite_pool).
+static struct EliteRoadmap elitePool[ELITE_POOL_SIZE];
+static int elitePoolSize = 0;
+
+static bool isSameRoadmap(const struct EliteRoadmap *elite, const struct ReplayMove *moves, int numMoves, int frames) {
+	return elite->frames == frames && elite->numMoves == numMoves
+		&& memcmp(elite->moves, moves, sizeof(moves[0]) * numMoves) == 0;
+}
+
+void offerEliteRoadmap(const struct BranchPath *root, int frames) {
+	struct ReplayMove moves[REPLAY_MAX_MOVES];
+	int numMoves = extractReplayMoves(root, moves, REPLAY_MAX_MOVES);
+	if (numMoves >= 0) {
+		offerEliteMoves(moves, numMoves, frames);
+	}
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: offerEliteMoves
+ * Inputs	: struct ReplayMove	*moves
+ *		  int			numMoves
+ *		  int			frames
+ *
+ * Insert the moves of the roadmap in frame order, evicting the slowest
+ * roadmap if the pool is full. Roadmaps already in the pool are ignored.
+ -------------------------------------------------------------------*/
+void offerEliteMoves(const struct ReplayMove *moves, int numMoves, int frames) {
+	#pragma omp critical(elite_pool)
+	{
+		bool accept = elitePoolSize < ELITE_POOL_SIZE || frames < elitePool[elitePoolSize - 1].frames;
+		for (int i = 0; accept && i < elitePoolSize && elitePool[i].frames <= frames; ++i) {
+			accept = !isSameRoadmap(&elitePool[i], moves, numMoves, frames);
+		}
+		if (accept) {
+			if (elitePoolSize == ELITE_POOL_SIZE) {
+				--elitePoolSize;
+			}
+			int index = elitePoolSize;
+			while (index > 0 && elitePool[index - 1].frames > frames) {
+				elitePool[index] = elitePool[index - 1];
+				--index;
+			}
+			memcpy(elitePool[index].moves, moves, sizeof(moves[0]) * numMoves);
+			elitePool[index].numMoves = numMoves;
+			elitePool[index].frames = frames;
+			++elitePoolSize;
+		}
+	}
+	offerSharedElite(moves, numMoves, frames);
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: claimElitePrefix
+ * Inputs	: struct SearchContext	*ctx
+ *		  int			*stepIndex
+ * Outputs	: struct BranchPath	*deepestNode
+ *
+ * Any elite roadmap is equally likely to be picked, so the pool keeps
+ * some diversity instead of always restarting from the single best.
+ * Only the moves are copied under the lock; the path is replayed after.
+ * When other processes share the record, half the prefixes are taken
+ * from the roadmaps they found instead.
+ -------------------------------------------------------------------*/
+struct BranchPath *claimElitePrefix(struct SearchContext *ctx, int *stepIndex) {
+	struct ReplayMove moves[REPLAY_MAX_MOVES];
+	int depth = -1;
+	if (isSharedRecordAttached() && random_state_randint(&ctx->random, 0, 2) == 0) {
+		const int maxDepth = copySharedElite(ctx, moves) - ELITE_MIN_SUFFIX_DEPTH;
+		if (maxDepth >= ELITE_MIN_PREFIX_DEPTH) {
+			depth = random_state_randint(&ctx->random, ELITE_MIN_PREFIX_DEPTH, maxDepth + 1);
+		}
+	}
+	#pragma omp critical(elite_pool)
+	{
+		if (depth < 0 && elitePoolSize > 0) {
+			const struct EliteRoadmap *elite = &elitePool[random_state_randint(&ctx->random, 0, elitePoolSize)];
+			const int maxDepth = elite->numMoves - ELITE_MIN_SUFFIX_DEPTH;
+			if (maxDepth >= ELITE_MIN_PREFIX_DEPTH) {
+				depth = random_state_randint(&ctx->random, ELITE_MIN_PREFIX_DEPTH, maxDepth + 1);
+				memcpy(moves, elite->moves, sizeof(moves[0]) * depth);
+			}
+		}
+	}
+	if (depth < 0) {
+		return NULL;
+	}
+	*stepIndex = depth;
+	return buildReplayPath(moves, depth, NULL, NULL);
+}
@@ -0,0 +1,25 @@
+#ifndef CIPES_ELITE_POOL_H
+#define CIPES_ELITE_POOL_H
+
+#include "calculator.h"
+#include "path_replay.h"
+
+// The fastest roadmaps seen this run, shared by every search thread.
+// Some dives start partway down one of them instead of from the root.
+#define ELITE_POOL_SIZE 32
+// A warm-started dive keeps at least this many moves of the elite roadmap...
+#define ELITE_MIN_PREFIX_DEPTH 5
+// ...and leaves at least this many moves for the search to redo.
+#define ELITE_MIN_SUFFIX_DEPTH 10
+
+// Offer a complete roadmap (root of a path followed via next) that finished at frames.
+// Its moves are copied into the pool if the pool has room or it beats the slowest roadmap there.
+void offerEliteRoadmap(const struct BranchPath *root, int frames);
+// The same, for a roadmap held as its moves alone (such as one sent by the coordinator).
+void offerEliteMoves(const struct ReplayMove *moves, int numMoves, int frames);
+// Replay the start of a random elite roadmap, cut at a random depth, and return its deepest node
+// (set up as in buildReplayPath), with *stepIndex set to its depth.
+// The random choices are drawn from ctx's generator. Returns NULL if the pool has nothing to offer yet.
+struct BranchPath *claimElitePrefix(struct SearchContext *ctx, int *stepIndex);
+
+#endif
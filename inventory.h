@@ -241,10 +241,13 @@ struct Recipe {
 	struct ItemCombination *combos; // Where there are countCombos different ways to cook output
 };
 
+struct SearchStatsSlot;
+
 // Recipe functions
 int getIndexOfRecipe(enum Type_Sort item);
 struct Recipe* getRecipeList();
-int stateOK(struct Inventory inventory, const outputCreatedArray_t outputsCreated, struct Recipe* recipeList);
+// Calls and rejections are counted in stats
+int stateOK(struct Inventory inventory, const outputCreatedArray_t outputsCreated, struct Recipe* recipeList, struct SearchStatsSlot* stats);
 
 struct ItemCombination parseCombo(int itemCount, enum Type_Sort item1, enum Type_Sort item2);
 
@@ -0,0 +1,343 @@
+#include "local_search.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <omp.h>
+#include "base.h"
+#include "inventory.h"
+#include "path_replay.h"
+#include "thread_local_random.h"
+
+// A roadmap under local search, together with the state before each of its moves,
+// so a neighbour only has to be replayed from the first move it changes
+struct LocalSearchPath {
+	struct ReplayMove moves[REPLAY_MAX_MOVES];
+	struct ReplayState states[REPLAY_MAX_MOVES + 1];	// states[i] is the state before moves[i]
+	int numMoves;
+};
+
+enum LocalSearchOperator {
+	SWAP_NEIGHBOURS,
+	SHIFT_SORT,
+	CHANGE_SORT,
+	DROP_SORT,
+	CHANGE_TOSS,
+	NUM_LOCAL_SEARCH_OPERATORS
+};
+
+static const enum Action sortActions[] = { Sort_Alpha_Asc, Sort_Alpha_Des, Sort_Type_Asc, Sort_Type_Des };
+
+static bool isSort(enum Action action) {
+	return action == Sort_Alpha_Asc || action == Sort_Alpha_Des || action == Sort_Type_Asc || action == Sort_Type_Des;
+}
+
+static int getFrames(const struct LocalSearchPath *path) {
+	return path->states[path->numMoves].totalFramesTaken;
+}
+
+// The first visible copy of item, other than the one in slot skip
+static int findVisibleItem(const struct Inventory *inventory, enum Type_Sort item, int skip) {
+	for (int i = inventory->nulls; i < inventory->length; ++i) {
+		if ((i < 10 || i < inventory->length - inventory->nulls) && i != skip && inventory->inventory[i] == item) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: tryCook
+ * Inputs	: struct ReplayState	*state
+ *		  struct Cook		cook
+ *		  enum Type_Sort	firstItem
+ *		  int			firstIndex
+ *		  enum Type_Sort	secondItem
+ *		  int			secondIndex
+ *		  struct ReplayState	*bestState
+ *		  struct Cook		*bestCook
+ *
+ * Apply the cook picking firstItem from firstIndex first, and keep it if
+ * it is the fastest legal way to cook it so far. How the output is
+ * handled follows from the nulls left, as in handleRecipeOutput.
+ -------------------------------------------------------------------*/
+static void tryCook(const struct ReplayState *state, struct Cook cook, enum Type_Sort firstItem, int firstIndex,
+	enum Type_Sort secondItem, int secondIndex, struct ReplayState *bestState, struct Cook *bestCook) {
+	const int length = state->inventory.length;
+	if (firstIndex < 0 || firstIndex >= length || (cook.numItems == 2 && (secondIndex < 0 || secondIndex >= length))) {
+		return;
+	}
+	cook.item1 = firstItem;
+	cook.itemIndex1 = firstIndex;
+	cook.item2 = cook.numItems == 2 ? secondItem : -1;
+	cook.itemIndex2 = cook.numItems == 2 ? secondIndex : -1;
+
+	const int ingredientLoc[2] = { cook.itemIndex1, cook.itemIndex2 };
+	struct Inventory remaining = removeCookIngredients(state->inventory, ingredientLoc, cook.numItems);
+	if (remaining.nulls) {
+		cook.handleOutput = Autoplace;
+	}
+	else if (cook.handleOutput == TossOther) {
+		cook.indexToss = -1;
+		for (int i = 0; i < 10 && i < remaining.length; ++i) {
+			if (remaining.inventory[i] == cook.toss) {
+				cook.indexToss = i;
+				break;
+			}
+		}
+		if (cook.indexToss < 0) {
+			return;
+		}
+	}
+	else {
+		cook.handleOutput = Toss;
+	}
+	if (cook.handleOutput != TossOther) {
+		cook.toss = -1;
+		cook.indexToss = -1;
+	}
+
+	struct ReplayState next = *state;
+	struct ReplayMove move = { .action = Cook, .cook = cook };
+	if (applyReplayMove(&next, &move) == REPLAY_OK && next.totalFramesTaken < bestState->totalFramesTaken) {
+		*bestState = next;
+		*bestCook = cook;
+	}
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: applyResolvedCook
+ * Inputs	: struct ReplayState	*state
+ *		  struct Cook		*cook
+ * Outputs	: bool			legal
+ *
+ * Moving other moves around shifts items between slots, so the slots of
+ * the ingredients and the tossed item are looked up again. The slots the
+ * cook used before are kept if the ingredients are still there, unless
+ * the first copies are faster. Both orders of 2 ingredients are tried.
+ -------------------------------------------------------------------*/
+static bool applyResolvedCook(struct ReplayState *state, struct Cook *cook) {
+	const struct Inventory *inventory = &state->inventory;
+	struct ReplayState best = *state;
+	best.totalFramesTaken = INT_MAX;
+	struct Cook bestCook = *cook;
+
+	const enum Type_Sort item1 = cook->item1;
+	const enum Type_Sort item2 = cook->item2;
+	if (cook->numItems == 1) {
+		tryCook(state, *cook, item1, cook->itemIndex1, -1, -1, &best, &bestCook);
+		tryCook(state, *cook, item1, findVisibleItem(inventory, item1, -1), -1, -1, &best, &bestCook);
+	}
+	else {
+		tryCook(state, *cook, item1, cook->itemIndex1, item2, cook->itemIndex2, &best, &bestCook);
+		tryCook(state, *cook, item2, cook->itemIndex2, item1, cook->itemIndex1, &best, &bestCook);
+		const int index1 = findVisibleItem(inventory, item1, -1);
+		const int index2 = findVisibleItem(inventory, item2, index1);
+		tryCook(state, *cook, item1, index1, item2, index2, &best, &bestCook);
+		tryCook(state, *cook, item2, index2, item1, index1, &best, &bestCook);
+	}
+	if (best.totalFramesTaken == INT_MAX) {
+		return false;
+	}
+	*state = best;
+	*cook = bestCook;
+	return true;
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: replayFrom
+ * Inputs	: struct LocalSearchPath	*path
+ *		  int				start
+ * Outputs	: bool				valid
+ *
+ * Recompute the states after moves[start] onwards, resolving each cook
+ * against the inventory it now sees. Stops at the first illegal move.
+ -------------------------------------------------------------------*/
+static bool replayFrom(struct LocalSearchPath *path, int start) {
+	for (int i = start; i < path->numMoves; ++i) {
+		struct ReplayState *state = &path->states[i + 1];
+		*state = path->states[i];
+		struct ReplayMove *move = &path->moves[i];
+		if (move->action == Cook) {
+			if (!applyResolvedCook(state, &move->cook)) {
+				return false;
+			}
+		}
+		else if (applyReplayMove(state, move) != REPLAY_OK) {
+			return false;
+		}
+	}
+	return path->states[path->numMoves].numOutputsCreated == NUM_RECIPES;
+}
+
+static int pickMove(const struct LocalSearchPath *path, bool (*matches)(const struct ReplayMove *move)) {
+	// The final move stays last, so the Jump Storage handling of the roadmap is never disturbed
+	int candidates[REPLAY_MAX_MOVES];
+	int numCandidates = 0;
+	for (int i = 0; i < path->numMoves - 1; ++i) {
+		if (matches(&path->moves[i])) {
+			candidates[numCandidates++] = i;
+		}
+	}
+	return numCandidates ? candidates[threadlocal_randint(0, numCandidates)] : -1;
+}
+
+static bool isSortMove(const struct ReplayMove *move) {
+	return isSort(move->action);
+}
+
+static bool isTossingCook(const struct ReplayMove *move) {
+	return move->action == Cook && move->cook.handleOutput != Autoplace;
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: makeNeighbour
+ * Inputs	: struct LocalSearchPath	*path
+ * Outputs	: int				start
+ *
+ * Apply one random change to the moves of path. Returns the first move
+ * changed, or -1 if the chosen kind of change is not possible.
+ -------------------------------------------------------------------*/
+static int makeNeighbour(struct LocalSearchPath *path) {
+	const int lastMovable = path->numMoves - 2;
+	int index;
+	switch (threadlocal_randint(0, NUM_LOCAL_SEARCH_OPERATORS)) {
+		case SWAP_NEIGHBOURS : {
+			if (lastMovable < 1) {
+				return -1;
+			}
+			index = threadlocal_randint(0, lastMovable);
+			struct ReplayMove move = path->moves[index];
+			path->moves[index] = path->moves[index + 1];
+			path->moves[index + 1] = move;
+			return index;
+		}
+		case SHIFT_SORT : {
+			index = pickMove(path, isSortMove);
+			if (index < 0) {
+				return -1;
+			}
+			int target = index - LOCAL_SEARCH_MAX_SORT_SHIFT + (int)threadlocal_randint(0, 2 * LOCAL_SEARCH_MAX_SORT_SHIFT + 1);
+			target = MAX(0, MIN(target, lastMovable));
+			if (target == index) {
+				return -1;
+			}
+			struct ReplayMove sort = path->moves[index];
+			if (target < index) {
+				memmove(&path->moves[target + 1], &path->moves[target], sizeof(struct ReplayMove) * (index - target));
+			}
+			else {
+				memmove(&path->moves[index], &path->moves[index + 1], sizeof(struct ReplayMove) * (target - index));
+			}
+			path->moves[target] = sort;
+			return MIN(index, target);
+		}
+		case CHANGE_SORT : {
+			index = pickMove(path, isSortMove);
+			if (index < 0) {
+				return -1;
+			}
+			enum Action sort = sortActions[threadlocal_randint(0, 4)];
+			if (sort == path->moves[index].action) {
+				return -1;
+			}
+			path->moves[index].action = sort;
+			return index;
+		}
+		case DROP_SORT : {
+			index = pickMove(path, isSortMove);
+			if (index < 0) {
+				return -1;
+			}
+			memmove(&path->moves[index], &path->moves[index + 1], sizeof(struct ReplayMove) * (path->numMoves - index - 1));
+			--path->numMoves;
+			return index;
+		}
+		case CHANGE_TOSS : {
+			index = pickMove(path, isTossingCook);
+			if (index < 0) {
+				return -1;
+			}
+			// Either toss the output, or keep it and toss whatever is in a random slot of the first 10
+			struct Cook *cook = &path->moves[index].cook;
+			const struct Inventory *inventory = &path->states[index].inventory;
+			int slot = (int)threadlocal_randint(0, MIN(10, inventory->length) + 1) - 1;
+			if (slot < 0) {
+				cook->handleOutput = Toss;
+			}
+			else {
+				cook->handleOutput = TossOther;
+				cook->toss = inventory->inventory[slot];
+			}
+			return index;
+		}
+		default :
+			return -1;
+	}
+}
+
+// Copy what a neighbour of from needs before it is changed from start onwards
+static void copyPath(struct LocalSearchPath *to, const struct LocalSearchPath *from, int numStates) {
+	to->numMoves = from->numMoves;
+	memcpy(to->moves, from->moves, sizeof(struct ReplayMove) * from->numMoves);
+	memcpy(to->states, from->states, sizeof(struct ReplayState) * numStates);
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: improveRoadmapLocally
+ * Inputs	: struct CompactRoadmap	*roadmap
+ *		  double		budgetSecs
+ * Outputs	: bool			improved
+ *
+ * Neighbours no slower than the current roadmap are always taken.
+ * Slower ones are taken with probability T / (T + extra frames), with
+ * T falling linearly to 0 over the budget, so the search can climb out
+ * of a local minimum early on and settles into plain hill climbing.
+ -------------------------------------------------------------------*/
+bool improveRoadmapLocally(struct CompactRoadmap *roadmap, double budgetSecs) {
+	struct LocalSearchPath *current = malloc(sizeof(struct LocalSearchPath));
+	struct LocalSearchPath *neighbour = malloc(sizeof(struct LocalSearchPath));
+	checkMallocFailed(current);
+	checkMallocFailed(neighbour);
+
+	bool improved = false;
+	current->numMoves = roadmap->numMoves;
+	memcpy(current->moves, roadmap->moves, sizeof(struct ReplayMove) * roadmap->numMoves);
+	initReplayState(&current->states[0]);
+	if (current->numMoves >= 2 && replayFrom(current, 0)) {
+		const double startTime = omp_get_wtime();
+		double elapsed = 0.0;
+		for (long tries = 0; elapsed < budgetSecs; ++tries) {
+			if (tries % LOCAL_SEARCH_CLOCK_INTERVAL == 0) {
+				elapsed = omp_get_wtime() - startTime;
+			}
+			copyPath(neighbour, current, current->numMoves + 1);
+			int start = makeNeighbour(neighbour);
+			if (start < 0 || !replayFrom(neighbour, start)) {
+				continue;
+			}
+
+			const int extraFrames = getFrames(neighbour) - getFrames(current);
+			if (extraFrames > 0) {
+				const double temperature = LOCAL_SEARCH_START_TEMPERATURE * (1.0 - elapsed / budgetSecs);
+				if (threadlocal_randint(0, 1 << 20) >= (1 << 20) * temperature / (temperature + extraFrames)) {
+					continue;
+				}
+			}
+			struct LocalSearchPath *swap = current;
+			current = neighbour;
+			neighbour = swap;
+
+			if (getFrames(current) < roadmap->frames) {
+				roadmap->frames = getFrames(current);
+				roadmap->numMoves = current->numMoves;
+				memcpy(roadmap->moves, current->moves, sizeof(struct ReplayMove) * current->numMoves);
+				improved = true;
+			}
+		}
+	}
+
+	free(current);
+	free(neighbour);
+	return improved;
+}
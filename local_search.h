@@ -0,0 +1,24 @@
+#ifndef CIPES_LOCAL_SEARCH_H
+#define CIPES_LOCAL_SEARCH_H
+
+#include <stdbool.h>
+#include "path_replay.h"
+
+// Simulated annealing over the moves of a complete roadmap, for the moves optimizeRoadmap
+// never tries: swapping neighbouring moves, moving a sort earlier or later, changing the
+// kind of a sort, dropping a sort, and tossing a different item.
+// Every neighbour is replayed with the path replay engine from the first move it changes,
+// so only valid roadmaps are ever kept.
+
+// Annealing starts out accepting a neighbour this many frames slower about a third of the time
+#define LOCAL_SEARCH_START_TEMPERATURE 4.0
+// How far a sort may be moved in one step
+#define LOCAL_SEARCH_MAX_SORT_SHIFT 6
+// Neighbours tried between checks of the clock
+#define LOCAL_SEARCH_CLOCK_INTERVAL 64
+
+// Search for budgetSecs from the complete roadmap. If a faster one is found, it replaces
+// roadmap and true is returned.
+bool improveRoadmapLocally(struct CompactRoadmap *roadmap, double budgetSecs);
+
+#endif
@@ -0,0 +1,329 @@
+#include "metrics_server.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+#include <omp.h>
+#include "base.h"
+#include "calculator.h"
+#include "logger.h"
+#include "search_stats.h"
+#include "start.h"
+#include "thread_pool.h"
+#include "worker_manager.h"
+#if !_CIPES_IS_WINDOWS
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+
+#define METRICS_POLL_INTERVAL_MS 250	// How quickly the server notices it has been asked to stop
+#define METRICS_REQUEST_WAIT_MS 100	// How long to wait for a client to send a request before answering anyway
+#define METRICS_LISTEN_BACKLOG 8
+#define METRICS_INITIAL_BUFFER_SIZE 4096
+
+#ifdef MSG_NOSIGNAL
+#define METRICS_SEND_FLAGS MSG_NOSIGNAL
+#else
+#define METRICS_SEND_FLAGS 0
+#endif
+
+struct MetricsBuffer {
+	char *data;
+	size_t length;
+	size_t capacity;
+};
+
+static pthread_t metricsThread;
+static pthread_mutex_t metricsLock = PTHREAD_MUTEX_INITIALIZER;
+static bool metricsStopping = false;
+static bool metricsThreadStarted = false;
+static int metricsListenFd = -1;
+static char metricsSocketPath[108];	// sun_path is at least this big on every platform
+
+// Only touched by the server thread, to compute rates between scrapes
+static struct SearchStats *lastScrapeStats;
+static double lastScrapeTime;
+
+static void appendMetrics(struct MetricsBuffer *buffer, const char *format, ...) {
+	while (true) {
+		va_list args;
+		va_start(args, format);
+		int written = vsnprintf(buffer->data + buffer->length, buffer->capacity - buffer->length, format, args);
+		va_end(args);
+		if (written < 0) {
+			return;
+		}
+		if ((size_t)written < buffer->capacity - buffer->length) {
+			buffer->length += written;
+			return;
+		}
+		buffer->capacity = 2 * buffer->capacity + written;
+		buffer->data = realloc(buffer->data, buffer->capacity);
+		checkMallocFailed(buffer->data);
+	}
+}
+
+static void appendMetricHeader(struct MetricsBuffer *buffer, const char *name, const char *type, const char *help) {
+	appendMetrics(buffer, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: buildMetrics
+ * Inputs	: struct MetricsBuffer	*buffer
+ *
+ * Render every metric in the Prometheus text exposition format.
+ * Rates are computed over the time since the previous scrape.
+ -------------------------------------------------------------------*/
+static void buildMetrics(struct MetricsBuffer *buffer) {
+	const int numThreads = getSearchStatsSlotCount();
+	const double now = omp_get_wtime();
+	const double elapsedSecs = now - lastScrapeTime;
+	struct SearchStats *stats = calloc(numThreads, sizeof(struct SearchStats));
+	struct SearchGauges *gauges = calloc(numThreads, sizeof(struct SearchGauges));
+	checkMallocFailed(stats);
+	checkMallocFailed(gauges);
+	for (int i = 0; i < numThreads; ++i) {
+		readSearchStats(i, &stats[i]);
+		readSearchGauges(i, &gauges[i]);
+	}
+
+	appendMetricHeader(buffer, "recipes_local_record_frames", "gauge", "Fastest roadmap found on this host, in frames.");
+	appendMetrics(buffer, "recipes_local_record_frames %d\n", getLocalRecord());
+	appendMetricHeader(buffer, "recipes_search_threads", "gauge", "Number of search threads.");
+	appendMetrics(buffer, "recipes_search_threads %d\n", numThreads);
+	appendMetricHeader(buffer, "recipes_active_search_threads", "gauge", "Number of search threads searching, rather than parked.");
+	appendMetrics(buffer, "recipes_active_search_threads %d\n", getActiveWorkerCount());
+
+	appendMetricHeader(buffer, "recipes_dives_total", "counter", "Branches started.");
+	for (int i = 0; i < numThreads; ++i) {
+		appendMetrics(buffer, "recipes_dives_total{thread=\"%d\"} %ld\n", i + 1, stats[i].dives);
+	}
+	appendMetricHeader(buffer, "recipes_nodes_expanded_total", "counter", "Nodes whose legal moves were generated.");
+	for (int i = 0; i < numThreads; ++i) {
+		appendMetrics(buffer, "recipes_nodes_expanded_total{thread=\"%d\"} %ld\n", i + 1, stats[i].nodesExpanded);
+	}
+	appendMetricHeader(buffer, "recipes_nodes_per_second", "gauge", "Nodes expanded per second since the previous scrape.");
+	for (int i = 0; i < numThreads; ++i) {
+		double rate = elapsedSecs > 0 ? (stats[i].nodesExpanded - lastScrapeStats[i].nodesExpanded) / elapsedSecs : 0.0;
+		appendMetrics(buffer, "recipes_nodes_per_second{thread=\"%d\"} %.1f\n", i + 1, rate);
+	}
+	appendMetricHeader(buffer, "recipes_optimize_roadmap_calls_total", "counter", "Completed roadmaps close enough to the record to be optimized.");
+	for (int i = 0; i < numThreads; ++i) {
+		appendMetrics(buffer, "recipes_optimize_roadmap_calls_total{thread=\"%d\"} %ld\n", i + 1, stats[i].optimizeRoadmapCalls);
+	}
+	appendMetricHeader(buffer, "recipes_records_found_total", "counter", "Roadmaps that beat the local record.");
+	for (int i = 0; i < numThreads; ++i) {
+		appendMetrics(buffer, "recipes_records_found_total{thread=\"%d\"} %ld\n", i + 1, stats[i].recordsFound);
+	}
+	appendMetricHeader(buffer, "recipes_search_depth", "gauge", "Step index of the node most recently expanded.");
+	for (int i = 0; i < numThreads; ++i) {
+		appendMetrics(buffer, "recipes_search_depth{thread=\"%d\"} %ld\n", i + 1, gauges[i].depth);
+	}
+	appendMetricHeader(buffer, "recipes_iteration_limit", "gauge", "Iteration limit of the current dive.");
+	for (int i = 0; i < numThreads; ++i) {
+		appendMetrics(buffer, "recipes_iteration_limit{thread=\"%d\"} %ld\n", i + 1, gauges[i].iterationLimit);
+	}
+	appendMetricHeader(buffer, "recipes_search_node_bytes", "gauge", "Approximate memory held by live search nodes (node structs only).");
+	for (int i = 0; i < numThreads; ++i) {
+		appendMetrics(buffer, "recipes_search_node_bytes{thread=\"%d\"} %ld\n", i + 1, gauges[i].liveNodes * (long)sizeof(struct BranchPath));
+	}
+
+	struct JobQueueStats queueStats[NUM_JOB_CLASSES];
+	for (int c = 0; c < NUM_JOB_CLASSES; ++c) {
+		readJobQueueStats((enum JobClass)c, &queueStats[c]);
+	}
+	appendMetricHeader(buffer, "recipes_jobs_run_total", "counter", "Jobs taken off the queue of each job class.");
+	for (int c = 0; c < NUM_JOB_CLASSES; ++c) {
+		appendMetrics(buffer, "recipes_jobs_run_total{class=\"%s\"} %ld\n", getJobClassName((enum JobClass)c), queueStats[c].jobsRun);
+	}
+	appendMetricHeader(buffer, "recipes_jobs_queued", "gauge", "Jobs waiting for a worker of their class.");
+	for (int c = 0; c < NUM_JOB_CLASSES; ++c) {
+		appendMetrics(buffer, "recipes_jobs_queued{class=\"%s\"} %ld\n", getJobClassName((enum JobClass)c), queueStats[c].jobsQueued);
+	}
+	appendMetricHeader(buffer, "recipes_jobs_rejected_total", "counter", "Jobs run by their submitter instead, as their class had no room for them.");
+	for (int c = 0; c < NUM_JOB_CLASSES; ++c) {
+		appendMetrics(buffer, "recipes_jobs_rejected_total{class=\"%s\"} %ld\n", getJobClassName((enum JobClass)c), queueStats[c].jobsRejected);
+	}
+	appendMetricHeader(buffer, "recipes_job_wait_seconds_total", "counter", "Time jobs spent queued before a worker started them.");
+	for (int c = 0; c < NUM_JOB_CLASSES; ++c) {
+		appendMetrics(buffer, "recipes_job_wait_seconds_total{class=\"%s\"} %.6f\n", getJobClassName((enum JobClass)c), queueStats[c].totalWaitSecs);
+	}
+	appendMetricHeader(buffer, "recipes_job_wait_seconds_max", "gauge", "Longest time a job spent queued.");
+	for (int c = 0; c < NUM_JOB_CLASSES; ++c) {
+		appendMetrics(buffer, "recipes_job_wait_seconds_max{class=\"%s\"} %.6f\n", getJobClassName((enum JobClass)c), queueStats[c].maxWaitSecs);
+	}
+	appendMetricHeader(buffer, "recipes_job_busy_seconds_total", "counter", "Time workers spent running jobs which have finished.");
+	for (int c = 0; c < NUM_JOB_CLASSES; ++c) {
+		appendMetrics(buffer, "recipes_job_busy_seconds_total{class=\"%s\"} %.3f\n", getJobClassName((enum JobClass)c), queueStats[c].busySecs);
+	}
+
+	free(gauges);
+	free(lastScrapeStats);
+	lastScrapeStats = stats;
+	lastScrapeTime = now;
+}
+
+#if !_CIPES_IS_WINDOWS
+static bool sendAll(int fd, const char *data, size_t length) {
+	while (length > 0) {
+		ssize_t sent = send(fd, data, length, METRICS_SEND_FLAGS);
+		if (sent <= 0) {
+			return false;
+		}
+		data += sent;
+		length -= sent;
+	}
+	return true;
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: serveMetricsClient
+ * Inputs	: int	clientFd
+ *
+ * Give the client a moment to send a request, so HTTP scrapers get
+ * a proper HTTP response, then send the metrics and hang up.
+ -------------------------------------------------------------------*/
+static void serveMetricsClient(int clientFd) {
+	bool isHttp = false;
+	struct pollfd request = { .fd = clientFd, .events = POLLIN };
+	if (poll(&request, 1, METRICS_REQUEST_WAIT_MS) > 0 && (request.revents & POLLIN)) {
+		char requestLine[512];
+		ssize_t received = recv(clientFd, requestLine, sizeof(requestLine) - 1, 0);
+		if (received > 0) {
+			requestLine[received] = '\0';
+			isHttp = strncmp(requestLine, "GET ", 4) == 0 || strncmp(requestLine, "HEAD ", 5) == 0;
+		}
+	}
+
+	struct MetricsBuffer body = { .capacity = METRICS_INITIAL_BUFFER_SIZE };
+	body.data = malloc(body.capacity);
+	checkMallocFailed(body.data);
+	buildMetrics(&body);
+
+	if (isHttp) {
+		char header[200];
+		int headerLength = snprintf(header, sizeof(header),
+			"HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n", body.length);
+		if (sendAll(clientFd, header, headerLength)) {
+			sendAll(clientFd, body.data, body.length);
+		}
+	}
+	else {
+		sendAll(clientFd, body.data, body.length);
+	}
+	free(body.data);
+}
+
+static void *metricsThreadMain(void *unused) {
+	while (true) {
+		pthread_mutex_lock(&metricsLock);
+		bool stopping = metricsStopping;
+		pthread_mutex_unlock(&metricsLock);
+		if (stopping) {
+			break;
+		}
+
+		struct pollfd listener = { .fd = metricsListenFd, .events = POLLIN };
+		if (poll(&listener, 1, METRICS_POLL_INTERVAL_MS) <= 0) {
+			continue;
+		}
+		int clientFd = accept(metricsListenFd, NULL, NULL);
+		if (clientFd < 0) {
+			continue;
+		}
+#ifdef SO_NOSIGPIPE
+		int noSigpipe = 1;
+		setsockopt(clientFd, SOL_SOCKET, SO_NOSIGPIPE, &noSigpipe, sizeof(noSigpipe));
+#endif
+		serveMetricsClient(clientFd);
+		close(clientFd);
+	}
+	return NULL;
+}
+#endif
+
+/*-------------------------------------------------------------------
+ * Function 	: startMetricsServer
+ * Inputs	: const char	*socketPath
+ *
+ * Bind the socket (replacing any stale one left by a previous run)
+ * and start the server thread.
+ -------------------------------------------------------------------*/
+void startMetricsServer(const char *socketPath) {
+	if (socketPath == NULL || socketPath[0] == '\0') {
+		return;
+	}
+#if _CIPES_IS_WINDOWS
+	recipeLog(2, "Metrics", "Socket", "Error", "The metrics socket is not supported on Windows.");
+#else
+	struct sockaddr_un address = { .sun_family = AF_UNIX };
+	if (strlen(socketPath) >= sizeof(address.sun_path) || strlen(socketPath) >= sizeof(metricsSocketPath)) {
+		recipeLog(1, "Metrics", "Socket", "Error", "metricsSocket path is too long.");
+		return;
+	}
+	strcpy(address.sun_path, socketPath);
+	strcpy(metricsSocketPath, socketPath);
+
+	metricsListenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (metricsListenFd < 0) {
+		recipeLog(1, "Metrics", "Socket", "Error", "Unable to create the metrics socket.");
+		return;
+	}
+	unlink(socketPath);
+	if (bind(metricsListenFd, (struct sockaddr *)&address, sizeof(address)) != 0
+		|| listen(metricsListenFd, METRICS_LISTEN_BACKLOG) != 0) {
+		char logText[200];
+		snprintf(logText, sizeof(logText), "Unable to listen on %s", socketPath);
+		recipeLog(1, "Metrics", "Socket", "Error", logText);
+		close(metricsListenFd);
+		metricsListenFd = -1;
+		return;
+	}
+
+	metricsStopping = false;
+	lastScrapeTime = omp_get_wtime();
+	lastScrapeStats = calloc(getSearchStatsSlotCount(), sizeof(struct SearchStats));
+	checkMallocFailed(lastScrapeStats);
+	if (pthread_create(&metricsThread, NULL, metricsThreadMain, NULL) != 0) {
+		recipeLog(1, "Metrics", "Socket", "Error", "Unable to start the metrics thread.");
+		close(metricsListenFd);
+		metricsListenFd = -1;
+		unlink(metricsSocketPath);
+		free(lastScrapeStats);
+		lastScrapeStats = NULL;
+		return;
+	}
+	metricsThreadStarted = true;
+	char logText[200];
+	snprintf(logText, sizeof(logText), "Serving metrics on %s", socketPath);
+	recipeLog(2, "Metrics", "Socket", "Start", logText);
+#endif
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: stopMetricsServer
+ *
+ * Stop the server thread and remove the socket.
+ -------------------------------------------------------------------*/
+void stopMetricsServer() {
+	if (!metricsThreadStarted) {
+		return;
+	}
+#if !_CIPES_IS_WINDOWS
+	pthread_mutex_lock(&metricsLock);
+	metricsStopping = true;
+	pthread_mutex_unlock(&metricsLock);
+	pthread_join(metricsThread, NULL);
+	close(metricsListenFd);
+	metricsListenFd = -1;
+	unlink(metricsSocketPath);
+	free(lastScrapeStats);
+	lastScrapeStats = NULL;
+#endif
+	metricsThreadStarted = false;
+}
@@ -0,0 +1,14 @@
+#ifndef CIPES_METRICS_SERVER_H
+#define CIPES_METRICS_SERVER_H
+
+// Serve a snapshot of the search metrics, in the Prometheus text exposition format,
+// to every client that connects to the Unix domain socket at socketPath.
+// Clients that send an HTTP request (e.g. curl --unix-socket) get an HTTP response;
+// anything else just gets the metrics text.
+// Runs on its own thread, so scraping never blocks the search threads.
+// Does nothing if socketPath is NULL or empty. initSearchStats must have been called.
+void startMetricsServer(const char *socketPath);
+// Stops the server thread and removes the socket.
+void stopMetricsServer();
+
+#endif
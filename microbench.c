@@ -0,0 +1,497 @@
+#include "microbench.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+#include "base.h"
+#include "calculator.h"
+#include "inventory.h"
+#include "path_replay.h"
+#include "recipes.h"
+#include "start.h"
+#include "thread_local_random.h"
+
+#define MICROBENCH_CORPUS_ROADMAPS 16	// Number of complete roadmaps captured for the corpus
+#define MICROBENCH_CORPUS_SEED 1		// Fixed, so every build benchmarks exactly the same node states
+#define MICROBENCH_MAX_CAPTURE_ATTEMPTS 1000	// Give up if this many walks in a row dead end
+#define MICROBENCH_WARMUP_REPS 3
+#define MICROBENCH_DEFAULT_REPS 15
+#define MICROBENCH_RANDOM_DRAWS 65536		// Random numbers drawn per pass by the random number kernels
+#define MICROBENCH_RANDOM_MAX_RANGE 48		// Their bounds cycle up to this, like the number of legal moves at a node
+
+// One node state captured from a real walk down the search tree.
+// The shadow is a copy of the node with no legal moves, which the kernels are run on.
+struct CorpusState {
+	struct BranchPath *shadow;
+	struct BranchPath **insertPool;	// Legal moves generated from this state, for insertIntoLegalMoves
+	int insertPoolSize;
+};
+
+struct Corpus {
+	struct BranchPath *roadmaps[MICROBENCH_CORPUS_ROADMAPS];	// Roots of the captured roadmaps
+	struct BranchPath *leaves[MICROBENCH_CORPUS_ROADMAPS];
+	struct ReplayMove replayMoves[MICROBENCH_CORPUS_ROADMAPS][REPLAY_MAX_MOVES];	// The moves of each captured roadmap
+	int numReplayMoves[MICROBENCH_CORPUS_ROADMAPS];
+	struct CorpusState *states;
+	int numStates;
+	struct SearchContext context;	// Bound to the thread which built the corpus, which also runs the kernels
+};
+
+struct MicrobenchResult {
+	const char *name;
+	long opsPerRep;
+	double minNs;
+	double medianNs;
+	double meanNs;
+	double maxNs;
+	double iqrNs;	// Interquartile range, as a measure of run to run noise
+};
+
+// Runs one pass over the corpus and returns the seconds spent in the kernel itself,
+// excluding any setup or cleanup. Sets *ops to the number of kernel calls made.
+typedef double (*MicrobenchPass)(struct Corpus *corpus, long *ops);
+
+// Keeps the compiler from discarding results of pure kernels.
+static volatile long microbenchSink;
+
+static void discardLegalMoves(struct BranchPath *node) {
+	while (node->numLegalMoves > 0) {
+		freeLegalMove(node, node->numLegalMoves - 1);
+	}
+	free(node->legalMoves);
+	node->legalMoves = NULL;
+	node->capacityLegalMoves = 0;
+	node->next = NULL;
+}
+
+static bool canDoChapter5(const struct BranchPath *node) {
+	return !node->outputCreated[getIndexOfRecipe(Dried_Bouquet)]
+		&& indexOfItemInInventory(node->inventory, Mousse_Cake) != -1
+		&& indexOfItemInInventory(node->inventory, Hot_Dog) >= 10;
+}
+
+static bool shouldHandleSorts(const struct BranchPath *node) {
+	enum Action action = node->description.action;
+	return action == Begin || action == Cook || action == Ch5;
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: captureRoadmap
+ * Inputs	: struct SearchContext	*ctx
+ * Outputs	: struct BranchPath	*leaf
+ *
+ * Walk from the root to a complete roadmap using the select strategy,
+ * keeping only the chosen move at each step. Returns NULL on a dead end.
+ -------------------------------------------------------------------*/
+static struct BranchPath *captureRoadmap(struct SearchContext *ctx) {
+	struct BranchPath *curNode = initializeRoot(ctx);
+	while (curNode->numOutputsCreated < NUM_RECIPES) {
+		const bool onlyFinalRecipeLeft = generateLegalMoves(ctx, curNode);
+		if (curNode->numLegalMoves == 0) {
+			freeAllNodes(curNode);
+			return NULL;
+		}
+		if (!onlyFinalRecipeLeft) {
+			handleSelectAndRandom(ctx, curNode, 1, 0);
+		}
+		while (curNode->numLegalMoves > 1) {
+			freeLegalMove(curNode, curNode->numLegalMoves - 1);
+		}
+		curNode->next = curNode->legalMoves[0];
+		curNode = curNode->next;
+	}
+	applyJumpStorageFramePenalty(curNode);
+	return curNode;
+}
+
+static struct BranchPath *createShadow(const struct BranchPath *node) {
+	struct BranchPath *shadow = malloc(sizeof(struct BranchPath));
+	checkMallocFailed(shadow);
+	*shadow = *node;
+	shadow->next = NULL;
+	shadow->legalMoves = NULL;
+	shadow->numLegalMoves = 0;
+	shadow->capacityLegalMoves = 0;
+	return shadow;
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: buildCorpus
+ * Inputs	: struct Corpus	*corpus
+ * Outputs	: bool		success
+ *
+ * Capture MICROBENCH_CORPUS_ROADMAPS complete roadmaps from a fixed
+ * seed, and collect every node along them that still has moves to make.
+ -------------------------------------------------------------------*/
+static bool buildCorpus(struct Corpus *corpus) {
+	memset(corpus, 0, sizeof(*corpus));
+	threadlocal_srand(MICROBENCH_CORPUS_SEED);
+	initSearchContext(&corpus->context, 0);
+
+	int capacity = 0;
+	for (int i = 0; i < MICROBENCH_CORPUS_ROADMAPS; ++i) {
+		struct BranchPath *leaf = NULL;
+		for (int attempt = 0; leaf == NULL && attempt < MICROBENCH_MAX_CAPTURE_ATTEMPTS; ++attempt) {
+			leaf = captureRoadmap(&corpus->context);
+		}
+		if (leaf == NULL) {
+			return false;
+		}
+		corpus->leaves[i] = leaf;
+		struct BranchPath *root = leaf;
+		while (root->prev != NULL) {
+			root = root->prev;
+		}
+		corpus->roadmaps[i] = root;
+		corpus->numReplayMoves[i] = extractReplayMoves(root, corpus->replayMoves[i], REPLAY_MAX_MOVES);
+		if (corpus->numReplayMoves[i] < 0) {
+			return false;
+		}
+
+		for (struct BranchPath *node = root; node != leaf; node = node->next) {
+			if (corpus->numStates == capacity) {
+				capacity = capacity ? 2 * capacity : 256;
+				corpus->states = realloc(corpus->states, sizeof(struct CorpusState) * capacity);
+				checkMallocFailed(corpus->states);
+			}
+			struct CorpusState *state = &corpus->states[corpus->numStates++];
+			state->shadow = createShadow(node);
+
+			// Steal the freshly generated moves for the insertion benchmark
+			fulfillRecipes(&corpus->context, state->shadow);
+			state->insertPoolSize = state->shadow->numLegalMoves;
+			state->insertPool = state->shadow->legalMoves;
+			state->shadow->legalMoves = NULL;
+			state->shadow->numLegalMoves = 0;
+			state->shadow->capacityLegalMoves = 0;
+		}
+	}
+	return true;
+}
+
+static void freeCorpus(struct Corpus *corpus) {
+	for (int i = 0; i < corpus->numStates; ++i) {
+		struct CorpusState *state = &corpus->states[i];
+		for (int move = 0; move < state->insertPoolSize; ++move) {
+			freeNode(state->insertPool[move]);
+		}
+		free(state->insertPool);
+		// The description data is shared with the captured roadmap, so only free the shadow itself
+		free(state->shadow);
+	}
+	free(corpus->states);
+	for (int i = 0; i < MICROBENCH_CORPUS_ROADMAPS; ++i) {
+		if (corpus->leaves[i] != NULL) {
+			freeAllNodes(corpus->leaves[i]);
+		}
+	}
+}
+
+static double passStateOK(struct Corpus *corpus, long *ops) {
+	long ok = 0;
+	double start = omp_get_wtime();
+	for (int i = 0; i < corpus->numStates; ++i) {
+		const struct BranchPath *node = corpus->states[i].shadow;
+		ok += stateOK(node->inventory, node->outputCreated, corpus->context.recipeList, corpus->context.stats);
+	}
+	double elapsed = omp_get_wtime() - start;
+	microbenchSink = ok;
+	*ops = corpus->numStates;
+	return elapsed;
+}
+
+static double passGetSortedInventory(struct Corpus *corpus, long *ops) {
+	long checksum = 0;
+	double start = omp_get_wtime();
+	for (int i = 0; i < corpus->numStates; ++i) {
+		const struct BranchPath *node = corpus->states[i].shadow;
+		for (enum Action sort = Sort_Alpha_Asc; sort <= Sort_Type_Des; sort++) {
+			checksum += getSortedInventory(node->inventory, sort).inventory[0];
+		}
+	}
+	double elapsed = omp_get_wtime() - start;
+	microbenchSink = checksum;
+	*ops = 4l * corpus->numStates;
+	return elapsed;
+}
+
+// Shared by the kernels which append legal moves to a node.
+static double passLegalMoveKernel(struct Corpus *corpus, long *ops, void (*kernel)(struct SearchContext *, struct BranchPath *), bool (*applies)(const struct BranchPath *)) {
+	long count = 0;
+	double start = omp_get_wtime();
+	for (int i = 0; i < corpus->numStates; ++i) {
+		struct BranchPath *shadow = corpus->states[i].shadow;
+		if (applies == NULL || applies(shadow)) {
+			kernel(&corpus->context, shadow);
+			++count;
+		}
+	}
+	double elapsed = omp_get_wtime() - start;
+	for (int i = 0; i < corpus->numStates; ++i) {
+		discardLegalMoves(corpus->states[i].shadow);
+	}
+	*ops = count;
+	return elapsed;
+}
+
+static double passFulfillRecipes(struct Corpus *corpus, long *ops) {
+	return passLegalMoveKernel(corpus, ops, fulfillRecipes, NULL);
+}
+
+static double passHandleSorts(struct Corpus *corpus, long *ops) {
+	return passLegalMoveKernel(corpus, ops, handleSorts, shouldHandleSorts);
+}
+
+static double passFulfillChapter5(struct Corpus *corpus, long *ops) {
+	return passLegalMoveKernel(corpus, ops, fulfillChapter5, canDoChapter5);
+}
+
+static double passInsertIntoLegalMoves(struct Corpus *corpus, long *ops) {
+	long count = 0;
+	double start = omp_get_wtime();
+	for (int i = 0; i < corpus->numStates; ++i) {
+		struct CorpusState *state = &corpus->states[i];
+		// Insert the even moves first, then the odd ones, so inserts land all over the array
+		for (int parity = 0; parity < 2; ++parity) {
+			for (int move = parity; move < state->insertPoolSize; move += 2) {
+				struct BranchPath *legalMove = state->insertPool[move];
+				insertIntoLegalMoves(&corpus->context, getInsertionIndex(state->shadow, legalMove->description.framesTaken), legalMove, state->shadow);
+			}
+		}
+		count += state->insertPoolSize;
+	}
+	double elapsed = omp_get_wtime() - start;
+	for (int i = 0; i < corpus->numStates; ++i) {
+		// The moves themselves belong to the pool
+		struct BranchPath *shadow = corpus->states[i].shadow;
+		free(shadow->legalMoves);
+		shadow->legalMoves = NULL;
+		shadow->numLegalMoves = 0;
+		shadow->capacityLegalMoves = 0;
+	}
+	*ops = count;
+	return elapsed;
+}
+
+static double passOptimizeRoadmap(struct Corpus *corpus, long *ops) {
+	struct CompactRoadmap *results = malloc(sizeof(struct CompactRoadmap) * MICROBENCH_CORPUS_ROADMAPS);
+	checkMallocFailed(results);
+	double start = omp_get_wtime();
+	for (int i = 0; i < MICROBENCH_CORPUS_ROADMAPS; ++i) {
+		optimizeRoadmap(corpus->roadmaps[i], &results[i]);
+	}
+	double elapsed = omp_get_wtime() - start;
+	long checksum = 0;
+	for (int i = 0; i < MICROBENCH_CORPUS_ROADMAPS; ++i) {
+		checksum += results[i].frames;
+	}
+	free(results);
+	microbenchSink = checksum;
+	*ops = MICROBENCH_CORPUS_ROADMAPS;
+	return elapsed;
+}
+
+static double passReplayMoves(struct Corpus *corpus, long *ops) {
+	long checksum = 0;
+	double start = omp_get_wtime();
+	for (int i = 0; i < MICROBENCH_CORPUS_ROADMAPS; ++i) {
+		struct ReplayState state;
+		if (replayMoves(corpus->replayMoves[i], corpus->numReplayMoves[i], &state, NULL) == REPLAY_OK) {
+			checksum += state.totalFramesTaken;
+		}
+	}
+	double elapsed = omp_get_wtime() - start;
+	microbenchSink = checksum;
+	*ops = MICROBENCH_CORPUS_ROADMAPS;
+	return elapsed;
+}
+
+// The generator this build uses for the search, bounded as the search bounds it
+static double passRandint(struct Corpus *corpus, long *ops) {
+	long checksum = 0;
+	double start = omp_get_wtime();
+	for (int i = 0; i < MICROBENCH_RANDOM_DRAWS; ++i) {
+		checksum += threadlocal_randint(0, 1 + i % MICROBENCH_RANDOM_MAX_RANGE);
+	}
+	double elapsed = omp_get_wtime() - start;
+	microbenchSink = checksum;
+	*ops = MICROBENCH_RANDOM_DRAWS;
+	return elapsed;
+}
+
+static double passRandpercent(struct Corpus *corpus, long *ops) {
+	long checksum = 0;
+	double start = omp_get_wtime();
+	for (int i = 0; i < MICROBENCH_RANDOM_DRAWS; ++i) {
+		checksum += threadlocal_randpercent();
+	}
+	double elapsed = omp_get_wtime() - start;
+	microbenchSink = checksum;
+	*ops = MICROBENCH_RANDOM_DRAWS;
+	return elapsed;
+}
+
+// The other generators, each drawn one number at a time and bounded with a modulo,
+// as thread_local_random.h does for them. The C++ generators can only be compared
+// by building with their flag, as only one of them is ever compiled in.
+static double passRandSystem(struct Corpus *corpus, long *ops) {
+#if _HAS_RANDR
+	static unsigned seed = MICROBENCH_CORPUS_SEED;
+#endif
+	long checksum = 0;
+	double start = omp_get_wtime();
+	for (int i = 0; i < MICROBENCH_RANDOM_DRAWS; ++i) {
+#if _HAS_RANDR
+		checksum += rand_r(&seed) % (1 + i % MICROBENCH_RANDOM_MAX_RANGE);
+#else
+		checksum += rand() % (1 + i % MICROBENCH_RANDOM_MAX_RANGE);
+#endif
+	}
+	double elapsed = omp_get_wtime() - start;
+	microbenchSink = checksum;
+	*ops = MICROBENCH_RANDOM_DRAWS;
+	return elapsed;
+}
+
+#ifdef __SIZEOF_INT128__
+static double passRandLehmer64(struct Corpus *corpus, long *ops) {
+	static __uint128_t state = MICROBENCH_CORPUS_SEED;
+	long checksum = 0;
+	double start = omp_get_wtime();
+	for (int i = 0; i < MICROBENCH_RANDOM_DRAWS; ++i) {
+		state *= UINT64_C(0xda942042e4dd58b5);
+		checksum += (uint64_t)(state >> 64) % (1 + i % MICROBENCH_RANDOM_MAX_RANGE);
+	}
+	double elapsed = omp_get_wtime() - start;
+	microbenchSink = checksum;
+	*ops = MICROBENCH_RANDOM_DRAWS;
+	return elapsed;
+}
+#endif
+
+#if _USING_BATCHED_RANDOM
+// The search's own generator and bounding, one number at a time, without the batching.
+// In this tight loop the state never leaves registers, which the search can't count on.
+static double passRandXoshiroUnbatched(struct Corpus *corpus, long *ops) {
+	static uint64_t state[4] = { 1, 2, 3, 4 };
+	long checksum = 0;
+	double start = omp_get_wtime();
+	for (int i = 0; i < MICROBENCH_RANDOM_DRAWS; ++i) {
+		checksum += ((_xoshiro256starstar_next(state) >> 32) * (1 + i % MICROBENCH_RANDOM_MAX_RANGE)) >> 32;
+	}
+	double elapsed = omp_get_wtime() - start;
+	microbenchSink = checksum;
+	*ops = MICROBENCH_RANDOM_DRAWS;
+	return elapsed;
+}
+#endif
+
+static int compareDoubles(const void *elem1, const void *elem2) {
+	double a = *(const double *)elem1;
+	double b = *(const double *)elem2;
+	return (a > b) - (a < b);
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: runMicrobench
+ * Inputs	: struct Corpus	*corpus
+ *		  const char	*name
+ *		  MicrobenchPass	pass
+ *		  int		reps
+ * Outputs	: struct MicrobenchResult	result
+ *
+ * Warm up, then time reps passes over the corpus and summarize ns/op.
+ -------------------------------------------------------------------*/
+static struct MicrobenchResult runMicrobench(struct Corpus *corpus, const char *name, MicrobenchPass pass, int reps) {
+	struct MicrobenchResult result = { .name = name };
+	long ops = 0;
+	for (int i = 0; i < MICROBENCH_WARMUP_REPS; ++i) {
+		pass(corpus, &ops);
+	}
+
+	double *nsPerOp = malloc(sizeof(double) * reps);
+	checkMallocFailed(nsPerOp);
+	double sum = 0;
+	for (int i = 0; i < reps; ++i) {
+		double elapsed = pass(corpus, &ops);
+		nsPerOp[i] = ops > 0 ? elapsed * 1e9 / ops : 0;
+		sum += nsPerOp[i];
+	}
+	result.opsPerRep = ops;
+	result.meanNs = sum / reps;
+	qsort(nsPerOp, reps, sizeof(double), compareDoubles);
+	result.minNs = nsPerOp[0];
+	result.maxNs = nsPerOp[reps - 1];
+	result.iqrNs = nsPerOp[(3 * reps) / 4] - nsPerOp[reps / 4];
+	result.medianNs = reps % 2 ? nsPerOp[reps / 2] : (nsPerOp[reps / 2 - 1] + nsPerOp[reps / 2]) / 2;
+	free(nsPerOp);
+	return result;
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: microbenchMain
+ * Inputs	: int	argc
+ *		  char	**argv
+ * Outputs	: int	exit code
+ *
+ * Nothing here depends on config.txt, the network, or the clock
+ * (other than for timing), so numbers are comparable across commits
+ * as long as the search itself generates the same moves.
+ -------------------------------------------------------------------*/
+int microbenchMain(int argc, char **argv) {
+	const int reps = argc >= 3 ? atoi(argv[2]) : MICROBENCH_DEFAULT_REPS;
+	if (reps <= 0) {
+		printf("Usage: %s --microbench [repetitions]\n", argv[0]);
+		return 1;
+	}
+
+	initializeInvFrames();
+	initializeRecipeList();
+	// Don't let the local record prune anything, so every kernel does its full amount of work
+	setLocalRecord(UNSET_FRAME_RECORD);
+
+	struct Corpus corpus;
+	if (!buildCorpus(&corpus)) {
+		printf("Unable to capture a corpus of complete roadmaps.\n");
+		freeCorpus(&corpus);
+		return 1;
+	}
+
+	static const struct {
+		const char *name;
+		MicrobenchPass pass;
+	} microbenches[] = {
+		{ "stateOK", passStateOK },
+		{ "getSortedInventory", passGetSortedInventory },
+		{ "fulfillRecipes", passFulfillRecipes },
+		{ "handleSorts", passHandleSorts },
+		{ "fulfillChapter5", passFulfillChapter5 },
+		{ "insertIntoLegalMoves", passInsertIntoLegalMoves },
+		{ "optimizeRoadmap", passOptimizeRoadmap },
+		{ "replayMoves", passReplayMoves },
+		{ "randint", passRandint },
+		{ "randpercent", passRandpercent },
+		{ "randint system rand", passRandSystem },
+#ifdef __SIZEOF_INT128__
+		{ "randint lehmer64", passRandLehmer64 },
+#endif
+#if _USING_BATCHED_RANDOM
+		{ "randint xoshiro256**", passRandXoshiroUnbatched },
+#endif
+	};
+
+	printf("Corpus: %d node states from %d roadmaps (seed %d), %d warm-up and %d timed repetitions\n",
+		corpus.numStates, MICROBENCH_CORPUS_ROADMAPS, MICROBENCH_CORPUS_SEED, MICROBENCH_WARMUP_REPS, reps);
+	printf("%-22s %10s %12s %12s %12s %12s %12s\n", "kernel", "ops/rep", "min ns/op", "median ns/op", "mean ns/op", "max ns/op", "IQR");
+	for (size_t i = 0; i < sizeof(microbenches) / sizeof(microbenches[0]); ++i) {
+		struct MicrobenchResult result = runMicrobench(&corpus, microbenches[i].name, microbenches[i].pass, reps);
+		printf("%-22s %10ld %12.1f %12.1f %12.1f %12.1f %12.1f\n", result.name, result.opsPerRep,
+			result.minNs, result.medianNs, result.meanNs, result.maxNs, result.iqrNs);
+	}
+
+	freeCorpus(&corpus);
+	threadlocal_rand_destroy();
+	return 0;
+}
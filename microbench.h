@@ -0,0 +1,9 @@
+#ifndef MICROBENCH_H
+#define MICROBENCH_H
+
+// recipesAtHome --microbench [repetitions]   (or: make bench)
+// Time the hot search kernels in isolation over a fixed corpus of node states,
+// captured from seeded walks down the search tree, and print ns/op per kernel.
+int microbenchMain(int argc, char **argv);
+
+#endif
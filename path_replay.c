@@ -0,0 +1,480 @@
+#include "path_replay.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include "base.h"
+#include "inventory.h"
+#include "recipes.h"
+#include "search_stats.h"
+
+_CIPES_STATIC_ASSERT(NUM_RECIPES <= 64, "outputsCreated is packed into a single uint64");
+
+static bool isValidItem(int item) {
+	return item >= 0 && item <= Mistake;
+}
+
+// Slots past length - nulls are hidden by the nulls, apart from the first 10 slots which are always shown
+static bool isVisibleIndex(const struct Inventory *inventory, int index) {
+	return index >= (int)inventory->nulls && index < (int)inventory->length
+		&& (index < 10 || index < (int)(inventory->length - inventory->nulls));
+}
+
+static bool isRecipeCombo(const struct Cook *cook, int recipeIndex) {
+	const struct Recipe *recipe = &recipeList[recipeIndex];
+	for (int i = 0; i < recipe->countCombos; ++i) {
+		const struct ItemCombination *combo = &recipe->combos[i];
+		if (combo->numItems != cook->numItems) {
+			continue;
+		}
+		if (combo->numItems == 1) {
+			if (combo->item1 == cook->item1) {
+				return true;
+			}
+		}
+		else if ((combo->item1 == cook->item1 && combo->item2 == cook->item2)
+			|| (combo->item1 == cook->item2 && combo->item2 == cook->item1)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: replayCook
+ * Inputs	: struct ReplayState	*state
+ *		  struct Cook		*cook
+ *		  struct Inventory	*inventory
+ *		  int			*frames
+ * Outputs	: enum ReplayError	error
+ *
+ * Validate a Cook move and compute the resulting inventory and frames,
+ * the same way createCookDescription and handleRecipeOutput do, except
+ * that the ingredient order and output handling are taken from the move
+ * rather than chosen.
+ -------------------------------------------------------------------*/
+static enum ReplayError replayCook(const struct ReplayState *state, const struct Cook *cook, struct Inventory *inventory, int *frames) {
+	if ((cook->numItems != 1 && cook->numItems != 2) || !isValidItem(cook->output)) {
+		return REPLAY_UNKNOWN_RECIPE;
+	}
+	int recipeIndex = getIndexOfRecipe(cook->output);
+	// The Dried Bouquet is only ever obtained through the Chapter 5 move
+	if (recipeIndex < 0 || cook->output == Dried_Bouquet || !isRecipeCombo(cook, recipeIndex)) {
+		return REPLAY_UNKNOWN_RECIPE;
+	}
+	if (state->outputsCreated & (UINT64_C(1) << recipeIndex)) {
+		return REPLAY_RECIPE_ALREADY_COOKED;
+	}
+
+	const struct Inventory *before = &state->inventory;
+	int ingredientLoc[2] = { cook->itemIndex1, cook->itemIndex2 };
+	if (!isVisibleIndex(before, ingredientLoc[0]) || before->inventory[ingredientLoc[0]] != cook->item1) {
+		return REPLAY_INGREDIENT_MISSING;
+	}
+	if (cook->numItems == 2) {
+		if (!isVisibleIndex(before, ingredientLoc[1]) || before->inventory[ingredientLoc[1]] != cook->item2) {
+			return REPLAY_INGREDIENT_MISSING;
+		}
+		// We cannot cook a recipe with two items on the first move
+		if (state->moves == 0 || ingredientLoc[0] == ingredientLoc[1]) {
+			return REPLAY_ILLEGAL_INGREDIENTS;
+		}
+		// Picking the last slot first makes the item nulls slots before it vanish (see createCookDescription2Items)
+		int lastVisibleSlot = before->length - 1;
+		if (before->nulls && ingredientLoc[0] == lastVisibleSlot && ingredientLoc[1] == lastVisibleSlot - (int)before->nulls) {
+			return REPLAY_ILLEGAL_INGREDIENTS;
+		}
+	}
+
+	int viableItems = before->length - 2 * before->nulls;
+	*frames = getCookFrames(before, ingredientLoc, cook->numItems);
+	*inventory = removeCookIngredients(*before, ingredientLoc, cook->numItems);
+
+	switch (cook->handleOutput) {
+		case Autoplace:
+			if (inventory->nulls == 0) {
+				return REPLAY_ILLEGAL_OUTPUT;
+			}
+			*inventory = addItem(*inventory, cook->output);
+			break;
+		case Toss:
+			if (inventory->nulls != 0) {
+				return REPLAY_ILLEGAL_OUTPUT;
+			}
+			*frames += TOSS_FRAMES;
+			break;
+		case TossOther:
+			// Assumed that it is impossible to toss and replace any items in the last 10 positions
+			if (inventory->nulls != 0 || cook->indexToss < 0 || cook->indexToss >= 10
+				|| inventory->inventory[cook->indexToss] != cook->toss) {
+				return REPLAY_ILLEGAL_OUTPUT;
+			}
+			*frames += TOSS_FRAMES + invFrames[viableItems][cook->indexToss + 1];
+			*inventory = replaceItem(*inventory, cook->indexToss, cook->output);
+			break;
+		default:
+			return REPLAY_ILLEGAL_OUTPUT;
+	}
+	return REPLAY_OK;
+}
+
+// Replace the item in a slot with a Chapter 5 item, in a slot the handleDBCOAllocation/handleChapter5 functions try
+static bool replaceForChapter5(struct Inventory *inventory, int index, int lowestIndex, enum Type_Sort item, int *frames) {
+	if (index < lowestIndex || index >= 10 || inventory->inventory[index] == Thunder_Rage) {
+		return false;
+	}
+	int placeFrames;
+	*inventory = placeChapter5Item(invFrames, *inventory, index, item, &placeFrames);
+	*frames += placeFrames;
+	return true;
+}
+
+static bool sortForChapter5(struct Inventory *inventory, enum Action sort, int *frames) {
+	if (sort < Sort_Alpha_Asc || sort > Sort_Type_Des) {
+		return false;
+	}
+	*inventory = getSortedInventory(*inventory, sort);
+	*frames += getSortFrames(sort);
+	// The Coconut must end up in the latter half of the inventory so it can be duplicated
+	return indexOfItemInInventory(*inventory, Coconut) >= 10;
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: replayChapter5
+ * Inputs	: struct ReplayState	*state
+ *		  struct CH5		*ch5
+ *		  struct Inventory	*inventory
+ *		  int			*frames
+ * Outputs	: enum ReplayError	error
+ *
+ * Validate a Chapter 5 move and compute the resulting inventory and
+ * frames. This walks the single path through fulfillChapter5 and the
+ * functions it calls which produced this particular CH5 struct, making
+ * each move with the same helpers the search uses.
+ -------------------------------------------------------------------*/
+static enum ReplayError replayChapter5(const struct ReplayState *state, const struct CH5 *ch5, struct Inventory *inventory, int *frames) {
+	if (state->outputsCreated & (UINT64_C(1) << getIndexOfRecipe(Dried_Bouquet))) {
+		return REPLAY_RECIPE_ALREADY_COOKED;
+	}
+
+	// Trade the Mousse Cake and 2 Hot Dogs for the Dried Bouquet
+	if (indexOfItemInInventory(state->inventory, Mousse_Cake) == -1 || indexOfItemInInventory(state->inventory, Hot_Dog) < 10) {
+		return REPLAY_CH5_UNAVAILABLE;
+	}
+	int hotDogFrames;
+	int mousseCakeFrames;
+	*inventory = tradeForDriedBouquet(invFrames, state->inventory, &hotDogFrames, &mousseCakeFrames);
+	*frames = hotDogFrames + mousseCakeFrames;
+
+	// Place the Dried Bouquet and Coconut
+	switch (inventory->nulls) {
+		case 0 :
+			if (!replaceForChapter5(inventory, ch5->indexDriedBouquet, 0, Dried_Bouquet, frames)
+				|| ch5->indexCoconut == ch5->indexDriedBouquet
+				|| !replaceForChapter5(inventory, ch5->indexCoconut, 1, Coconut, frames)) {
+				return REPLAY_ILLEGAL_CH5;
+			}
+			break;
+		case 1 :
+			if (ch5->indexDriedBouquet != 0) {
+				return REPLAY_ILLEGAL_CH5;
+			}
+			*inventory = addItem(*inventory, Dried_Bouquet);
+			if (!replaceForChapter5(inventory, ch5->indexCoconut, 1, Coconut, frames)) {
+				return REPLAY_ILLEGAL_CH5;
+			}
+			break;
+		default :
+			if (ch5->indexDriedBouquet != 0 || ch5->indexCoconut != 0) {
+				return REPLAY_ILLEGAL_CH5;
+			}
+			*inventory = addItem(*inventory, Dried_Bouquet);
+			*inventory = addItem(*inventory, Coconut);
+	}
+
+	// Place the Keel Mango and Courage Shell, with the sort either before or after the Keel Mango
+	if (ch5->lateSort) {
+		if (inventory->nulls >= 1) {
+			if (ch5->indexKeelMango != 0) {
+				return REPLAY_ILLEGAL_CH5;
+			}
+			*inventory = addItem(*inventory, Keel_Mango);
+		}
+		else if (!replaceForChapter5(inventory, ch5->indexKeelMango, 2, Keel_Mango, frames)) {
+			return REPLAY_ILLEGAL_CH5;
+		}
+		if (!sortForChapter5(inventory, ch5->ch5Sort, frames)
+			|| !replaceForChapter5(inventory, ch5->indexCourageShell, 0, Courage_Shell, frames)) {
+			return REPLAY_ILLEGAL_CH5;
+		}
+	}
+	else {
+		if (!sortForChapter5(inventory, ch5->ch5Sort, frames)
+			|| ch5->indexKeelMango < 0 || ch5->indexKeelMango >= 10
+			|| inventory->inventory[ch5->indexKeelMango] == Dried_Bouquet
+			|| !replaceForChapter5(inventory, ch5->indexKeelMango, 0, Keel_Mango, frames)
+			|| ch5->indexCourageShell == ch5->indexKeelMango
+			|| !replaceForChapter5(inventory, ch5->indexCourageShell, 1, Courage_Shell, frames)) {
+			return REPLAY_ILLEGAL_CH5;
+		}
+	}
+
+	// Use the Thunder Rage
+	if (indexOfItemInInventory(*inventory, Thunder_Rage) != ch5->indexThunderRage || ch5->indexThunderRage == -1) {
+		return REPLAY_ILLEGAL_CH5;
+	}
+	int thunderRageIndex;
+	int thunderRageFrames;
+	*inventory = useThunderRage(invFrames, *inventory, &thunderRageIndex, &thunderRageFrames);
+	*frames += thunderRageFrames;
+	return REPLAY_OK;
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: initReplayState
+ * Inputs	: struct ReplayState	*state
+ *
+ * Set up the state of the Begin node.
+ -------------------------------------------------------------------*/
+void initReplayState(struct ReplayState *state) {
+	memset(state, 0, sizeof(*state));
+	state->inventory = getStartingInventory();
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: applyReplayMove
+ * Inputs	: struct ReplayState	*state
+ *		  struct ReplayMove	*move
+ * Outputs	: enum ReplayError	error
+ *
+ * Validate a move against the current state and apply it. Search
+ * heuristics which don't affect whether a roadmap can be performed
+ * (stateOK, the sort limit, cooking the Mistake last) are not checked,
+ * as optimizeRoadmap deliberately steps outside of them.
+ -------------------------------------------------------------------*/
+enum ReplayError applyReplayMove(struct ReplayState *state, const struct ReplayMove *move) {
+	struct Inventory inventory;
+	int frames = 0;
+	int recipeIndex = -1;
+	enum ReplayError error;
+	switch (move->action) {
+		case Cook :
+			error = replayCook(state, &move->cook, &inventory, &frames);
+			recipeIndex = getIndexOfRecipe(move->cook.output);
+			break;
+		case Ch5 :
+			error = replayChapter5(state, &move->ch5, &inventory, &frames);
+			recipeIndex = getIndexOfRecipe(Dried_Bouquet);
+			break;
+		case Sort_Alpha_Asc :
+		case Sort_Alpha_Des :
+		case Sort_Type_Asc :
+		case Sort_Type_Des :
+			inventory = getSortedInventory(state->inventory, move->action);
+			frames = getSortFrames(move->action);
+			error = REPLAY_OK;
+			break;
+		default :
+			error = REPLAY_UNKNOWN_ACTION;
+	}
+	if (error != REPLAY_OK) {
+		return error;
+	}
+
+	state->inventory = inventory;
+	if (recipeIndex >= 0) {
+		state->outputsCreated |= UINT64_C(1) << recipeIndex;
+		++state->numOutputsCreated;
+	}
+	else {
+		++state->totalSorts;
+	}
+	// The search applies this penalty once the roadmap is complete (see applyJumpStorageFramePenalty)
+	if (move->action == Cook && move->cook.handleOutput == Autoplace && state->numOutputsCreated == NUM_RECIPES) {
+		frames += JUMP_STORAGE_NO_TOSS_FRAMES;
+	}
+	++state->moves;
+	state->framesTaken = frames;
+	state->totalFramesTaken += frames;
+	return REPLAY_OK;
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: replayMoves
+ * Inputs	: struct ReplayMove	*moves
+ *		  int			numMoves
+ *		  struct ReplayState	*state
+ *		  int			*failedMove
+ * Outputs	: enum ReplayError	error
+ *
+ * Replay a whole move list without allocating anything.
+ -------------------------------------------------------------------*/
+enum ReplayError replayMoves(const struct ReplayMove *moves, int numMoves, struct ReplayState *state, int *failedMove) {
+	initReplayState(state);
+	for (int i = 0; i < numMoves; ++i) {
+		enum ReplayError error = applyReplayMove(state, &moves[i]);
+		if (error != REPLAY_OK) {
+			if (failedMove != NULL) {
+				*failedMove = i;
+			}
+			return error;
+		}
+	}
+	return REPLAY_OK;
+}
+
+void getReplayMove(const struct BranchPath *node, struct ReplayMove *move) {
+	memset(move, 0, sizeof(*move));
+	move->action = node->description.action;
+	if (move->action == Cook) {
+		move->cook = *(const struct Cook *)node->description.data;
+	}
+	else if (move->action == Ch5) {
+		move->ch5 = *(const struct CH5 *)node->description.data;
+	}
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: extractReplayMoves
+ * Inputs	: struct BranchPath	*root
+ *		  struct ReplayMove	*moves
+ *		  int			maxMoves
+ * Outputs	: int			numMoves
+ *
+ * Strip a path down to its moves.
+ -------------------------------------------------------------------*/
+int extractReplayMoves(const struct BranchPath *root, struct ReplayMove *moves, int maxMoves) {
+	if (root == NULL || root->description.action != Begin) {
+		return -1;
+	}
+	int numMoves = 0;
+	for (const struct BranchPath *node = root->next; node != NULL; node = node->next) {
+		if (numMoves == maxMoves) {
+			return -1;
+		}
+		getReplayMove(node, &moves[numMoves++]);
+	}
+	return numMoves;
+}
+
+static void *copyReplayMoveData(const struct ReplayMove *move) {
+	void *data = NULL;
+	if (move->action == Cook) {
+		data = malloc(sizeof(struct Cook));
+		checkMallocFailed(data);
+		copyCook(data, &move->cook);
+	}
+	else if (move->action == Ch5) {
+		data = malloc(sizeof(struct CH5));
+		checkMallocFailed(data);
+		*(struct CH5 *)data = move->ch5;
+	}
+	else {
+		return NULL;
+	}
+	COUNT_SEARCH_STAT(allocations);
+	return data;
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: buildReplayPath
+ * Inputs	: struct ReplayMove	*moves
+ *		  int			numMoves
+ *		  enum ReplayError	*error
+ *		  int			*failedMove
+ * Outputs	: struct BranchPath	*deepestNode
+ *
+ * Replay moves, creating only the node each move leads to.
+ -------------------------------------------------------------------*/
+struct BranchPath *buildReplayPath(const struct ReplayMove *moves, int numMoves, enum ReplayError *error, int *failedMove) {
+	struct ReplayState state;
+	initReplayState(&state);
+	// Replaying is rare enough that the nodes are counted through a context made on the spot
+	struct SearchContext ctx;
+	initSearchContext(&ctx, -1);
+	struct BranchPath *curNode = initializeRoot(&ctx);
+	for (int i = 0; i < numMoves; ++i) {
+		enum ReplayError moveError = applyReplayMove(&state, &moves[i]);
+		if (moveError != REPLAY_OK) {
+			if (error != NULL) {
+				*error = moveError;
+			}
+			if (failedMove != NULL) {
+				*failedMove = i;
+			}
+			freeAllNodes(curNode);
+			return NULL;
+		}
+
+		struct MoveDescription description;
+		description.action = moves[i].action;
+		description.data = copyReplayMoveData(&moves[i]);
+		description.framesTaken = state.framesTaken;
+		description.totalFramesTaken = state.totalFramesTaken;
+		outputCreatedArray_t outputCreated;
+		for (int recipe = 0; recipe < NUM_RECIPES; ++recipe) {
+			outputCreated[recipe] = (state.outputsCreated >> recipe) & 1;
+		}
+		struct BranchPath *nextNode = createLegalMove(&ctx, curNode, state.inventory, description, outputCreated, state.numOutputsCreated);
+
+		curNode->legalMoves = malloc(sizeof(curNode->legalMoves[0]));
+		COUNT_SEARCH_STAT(allocations);
+		checkMallocFailed(curNode->legalMoves);
+		curNode->legalMoves[0] = nextNode;
+		curNode->numLegalMoves = 1;
+		curNode->capacityLegalMoves = 1;
+		curNode->next = nextNode;
+		curNode = nextNode;
+	}
+	if (error != NULL) {
+		*error = REPLAY_OK;
+	}
+	return curNode;
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: replayStateMatchesNode
+ * Inputs	: struct ReplayState	*state
+ *		  struct BranchPath	*node
+ * Outputs	: bool			matches
+ -------------------------------------------------------------------*/
+bool replayStateMatchesNode(const struct ReplayState *state, const struct BranchPath *node) {
+	if (state->totalFramesTaken != node->description.totalFramesTaken
+		|| state->numOutputsCreated != node->numOutputsCreated
+		|| !compareInventories(state->inventory, node->inventory)) {
+		return false;
+	}
+	for (int i = 0; i < NUM_RECIPES; ++i) {
+		if (node->outputCreated[i] != ((state->outputsCreated >> i) & 1)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+const char *getReplayErrorName(enum ReplayError error) {
+	switch (error) {
+		case REPLAY_OK :
+			return "OK";
+		case REPLAY_UNKNOWN_ACTION :
+			return "Unknown action";
+		case REPLAY_UNKNOWN_RECIPE :
+			return "Not a recipe";
+		case REPLAY_RECIPE_ALREADY_COOKED :
+			return "Recipe already cooked";
+		case REPLAY_INGREDIENT_MISSING :
+			return "Ingredient not in that slot";
+		case REPLAY_ILLEGAL_INGREDIENTS :
+			return "Ingredients can't be picked that way";
+		case REPLAY_ILLEGAL_OUTPUT :
+			return "Output can't be handled that way";
+		case REPLAY_CH5_UNAVAILABLE :
+			return "Chapter 5 trade not possible";
+		case REPLAY_ILLEGAL_CH5 :
+			return "Chapter 5 placements not possible";
+		case REPLAY_TOO_MANY_MOVES :
+			return "Too many moves";
+		case REPLAY_STATE_MISMATCH :
+			return "Result does not match the stored roadmap";
+	}
+	return "Unknown error";
+}
@@ -0,0 +1,74 @@
+#ifndef CIPES_PATH_REPLAY_H
+#define CIPES_PATH_REPLAY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "calculator.h"
+
+// Replays a roadmap from its list of moves alone, without generating any sibling moves.
+// Every move is checked against the rules the search follows when generating it,
+// and the inventory and frames are recomputed from scratch rather than trusted.
+
+// Comfortably more than the 57 recipe moves plus every sort the search will ever do
+#define REPLAY_MAX_MOVES 128
+
+// One move of a roadmap, as the search describes it (the Begin node is not a move)
+struct ReplayMove {
+	enum Action action;
+	union {
+		struct Cook cook;	// Only if action is Cook
+		struct CH5 ch5;		// Only if action is Ch5
+	};
+};
+
+// A complete roadmap held as its moves alone, with no node per move, as optimizeRoadmap writes it
+struct CompactRoadmap {
+	struct ReplayMove moves[REPLAY_MAX_MOVES];
+	int numMoves;
+	int frames;		// Total frames taken, including the Jump Storage penalty
+};
+
+// Everything needed to apply the next move
+struct ReplayState {
+	struct Inventory inventory;
+	uint64_t outputsCreated;	// Bit i set if recipe i has been cooked
+	int numOutputsCreated;
+	int moves;
+	int totalSorts;
+	int framesTaken;			// Of the last move applied
+	int totalFramesTaken;
+};
+
+enum ReplayError {
+	REPLAY_OK,
+	REPLAY_UNKNOWN_ACTION,
+	REPLAY_UNKNOWN_RECIPE,			// The output can't be cooked, or not from these ingredients
+	REPLAY_RECIPE_ALREADY_COOKED,
+	REPLAY_INGREDIENT_MISSING,		// The ingredient is not in the given (visible) slot
+	REPLAY_ILLEGAL_INGREDIENTS,		// 2 ingredients on the first move, the same slot twice, or an order that makes an ingredient vanish
+	REPLAY_ILLEGAL_OUTPUT,			// The output can't be handled this way with this many nulls
+	REPLAY_CH5_UNAVAILABLE,			// Mousse Cake or a duplicable Hot Dog is missing
+	REPLAY_ILLEGAL_CH5,				// One of the Chapter 5 placements or the sort is impossible
+	REPLAY_TOO_MANY_MOVES,
+	REPLAY_STATE_MISMATCH			// Reported by callers comparing against a stored roadmap
+};
+
+void initReplayState(struct ReplayState *state);
+// Apply one move to state. state is left untouched if the move is illegal.
+enum ReplayError applyReplayMove(struct ReplayState *state, const struct ReplayMove *move);
+// Replay moves from the starting inventory. On failure, *failedMove is set to the index of the illegal move.
+enum ReplayError replayMoves(const struct ReplayMove *moves, int numMoves, struct ReplayState *state, int *failedMove);
+// Describe the move which led to node (which must not be a Begin node)
+void getReplayMove(const struct BranchPath *node, struct ReplayMove *move);
+// Fill moves with the moves of the path starting at root (following next).
+// Returns the number of moves, or -1 if root is not a Begin node or there are more than maxMoves.
+int extractReplayMoves(const struct BranchPath *root, struct ReplayMove *moves, int maxMoves);
+// Replay moves into a freshly allocated path and return its deepest node (set up as the
+// search expects a warm-started dive: every node has its successor as its only legal move).
+// Returns NULL if a move is illegal, in which case *error and *failedMove say why (either may be NULL).
+struct BranchPath *buildReplayPath(const struct ReplayMove *moves, int numMoves, enum ReplayError *error, int *failedMove);
+// Whether node holds the same state as the replay (inventory, outputs and frames)
+bool replayStateMatchesNode(const struct ReplayState *state, const struct BranchPath *node);
+const char *getReplayErrorName(enum ReplayError error);
+
+#endif
@@ -19,6 +19,8 @@
 
 #define randint threadlocal_randint
 
+#define randpercent threadlocal_randpercent
+
 #define srand threadlocal_srand
 
 #define _RAND_REPLACE_REPLACEMENTS_DONE 1
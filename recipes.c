@@ -6,6 +6,7 @@
 #include "inventory.h"
 #include "recipes.h"
 #include "base.h"
+#include "search_stats.h"
 
 _CIPES_STATIC_ASSERT(true == 1, "true from stdbool.h must be 1 for the math to work correctly");
 
@@ -658,6 +659,7 @@ int checkRecipe(struct ItemCombination combo, int *makeableItems, const outputCr
  * Inputs	: struct Inventory inventory
  *			  int			   *outputsCreated
  *			  struct Recipe	   *recipeList
+ *			  struct SearchStatsSlot *stats
  * Outputs	: 1 if we can still make all remaining recipes with the
  *			  current inventory. Else, return 0
  *
@@ -665,11 +667,13 @@ int checkRecipe(struct ItemCombination combo, int *makeableItems, const outputCr
  * been already created, and calls checkRecipe to see if each remaining
  * recipe can still be fulfilled at some point in the roadmap.
  -------------------------------------------------------------------*/
-int stateOK(struct Inventory inventory, const outputCreatedArray_t outputsCreated, struct Recipe *recipeList) {
+int stateOK(struct Inventory inventory, const outputCreatedArray_t outputsCreated, struct Recipe *recipeList, struct SearchStatsSlot *stats) {
+	COUNT_SLOT_STAT(stats, stateOKCalls);
 	// With the given inventory, can the remaining recipes be fulfilled?
 
 	// If Chapter 5 has not been done, verify that Thunder Rage is in the inventory
 	if (!outputsCreated[getIndexOfRecipe(Dried_Bouquet)] && indexOfItemInInventory(inventory, Thunder_Rage) == -1) {
+		COUNT_SLOT_STAT(stats, stateOKRejections);
 		return 0;
 	}
 
@@ -841,6 +845,7 @@ int stateOK(struct Inventory inventory, const outputCreatedArray_t outputsCreate
 
 		// The item cannot be fulfilled
 		if (makeable == 0) {
+			COUNT_SLOT_STAT(stats, stateOKRejections);
 			return 0;
 		}
 
@@ -0,0 +1,364 @@
+#include "roadmap_binary.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "base.h"
+#include "calculator.h"
+#include "inventory.h"
+#include "recipes.h"
+#include "logger.h"
+#include "atomic_file.h"
+
+static const char roadmapBinaryMagic[4] = { 'C', 'R', 'M', 'B' };
+
+_CIPES_STATIC_ASSERT(NUM_RECIPES <= 64, "outputsCreated is packed into a single uint64");
+_CIPES_STATIC_ASSERT(Mistake <= UINT8_MAX, "Items are packed into a single byte");
+_CIPES_STATIC_ASSERT(Ch5 <= UINT8_MAX, "Actions are packed into a single byte");
+
+// Offsets within a record
+#define RECORD_ACTION 0
+#define RECORD_MOVE_DATA 1
+#define RECORD_FRAMES_TAKEN 10
+#define RECORD_TOTAL_FRAMES_TAKEN 14
+#define RECORD_NULLS 18
+#define RECORD_LENGTH 19
+#define RECORD_INVENTORY 20
+#define RECORD_OUTPUTS_CREATED 40
+_CIPES_STATIC_ASSERT(RECORD_OUTPUTS_CREATED + 8 == ROADMAP_BINARY_RECORD_SIZE, "Record layout does not add up");
+
+static void putU16(uint8_t *dest, uint16_t value) {
+	dest[0] = (uint8_t)value;
+	dest[1] = (uint8_t)(value >> 8);
+}
+
+static void putU32(uint8_t *dest, uint32_t value) {
+	for (int i = 0; i < 4; ++i) {
+		dest[i] = (uint8_t)(value >> (8 * i));
+	}
+}
+
+static void putU64(uint8_t *dest, uint64_t value) {
+	for (int i = 0; i < 8; ++i) {
+		dest[i] = (uint8_t)(value >> (8 * i));
+	}
+}
+
+static uint16_t getU16(const uint8_t *src) {
+	return (uint16_t)(src[0] | (src[1] << 8));
+}
+
+static uint32_t getU32(const uint8_t *src) {
+	uint32_t value = 0;
+	for (int i = 0; i < 4; ++i) {
+		value |= (uint32_t)src[i] << (8 * i);
+	}
+	return value;
+}
+
+static uint64_t getU64(const uint8_t *src) {
+	uint64_t value = 0;
+	for (int i = 0; i < 8; ++i) {
+		value |= (uint64_t)src[i] << (8 * i);
+	}
+	return value;
+}
+
+// Indices may be -1 for unused slots, so they are stored as signed bytes.
+static uint8_t packIndex(int index) {
+	return (uint8_t)(int8_t)index;
+}
+
+static int unpackIndex(uint8_t packed) {
+	return (int8_t)packed;
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: packMoveData
+ * Inputs	: const struct MoveDescription	*desc
+ *		  uint8_t			*dest
+ *
+ * Pack the Cook or CH5 data of a move into 9 bytes.
+ * Fields that are meaningless for this particular move are zeroed so
+ * the same roadmap always produces the same file.
+ -------------------------------------------------------------------*/
+static void packMoveData(const struct MoveDescription *desc, uint8_t *dest) {
+	memset(dest, 0, 9);
+	if (desc->action == Cook) {
+		const struct Cook *cook = desc->data;
+		dest[0] = (uint8_t)cook->numItems;
+		dest[1] = (uint8_t)cook->item1;
+		dest[2] = packIndex(cook->itemIndex1);
+		if (cook->numItems == 2) {
+			dest[3] = (uint8_t)cook->item2;
+			dest[4] = packIndex(cook->itemIndex2);
+		}
+		dest[5] = (uint8_t)cook->output;
+		dest[6] = (uint8_t)cook->handleOutput;
+		if (cook->handleOutput == TossOther) {
+			dest[7] = (uint8_t)cook->toss;
+			dest[8] = packIndex(cook->indexToss);
+		}
+	}
+	else if (desc->action == Ch5) {
+		const struct CH5 *ch5 = desc->data;
+		dest[0] = packIndex(ch5->indexDriedBouquet);
+		dest[1] = packIndex(ch5->indexCoconut);
+		dest[2] = (uint8_t)ch5->ch5Sort;
+		dest[3] = packIndex(ch5->indexKeelMango);
+		dest[4] = packIndex(ch5->indexCourageShell);
+		dest[5] = packIndex(ch5->indexThunderRage);
+		dest[6] = (uint8_t)ch5->lateSort;
+	}
+}
+
+static void *unpackMoveData(enum Action action, const uint8_t *src) {
+	if (action == Cook) {
+		struct Cook *cook = malloc(sizeof(struct Cook));
+		checkMallocFailed(cook);
+		cook->numItems = src[0];
+		cook->item1 = (enum Type_Sort)src[1];
+		cook->itemIndex1 = unpackIndex(src[2]);
+		cook->item2 = (enum Type_Sort)src[3];
+		cook->itemIndex2 = unpackIndex(src[4]);
+		cook->output = (enum Type_Sort)src[5];
+		cook->handleOutput = (enum HandleOutput)src[6];
+		cook->toss = (enum Type_Sort)src[7];
+		cook->indexToss = unpackIndex(src[8]);
+		return cook;
+	}
+	if (action == Ch5) {
+		struct CH5 *ch5 = malloc(sizeof(struct CH5));
+		checkMallocFailed(ch5);
+		ch5->indexDriedBouquet = unpackIndex(src[0]);
+		ch5->indexCoconut = unpackIndex(src[1]);
+		ch5->ch5Sort = (enum Action)src[2];
+		ch5->indexKeelMango = unpackIndex(src[3]);
+		ch5->indexCourageShell = unpackIndex(src[4]);
+		ch5->indexThunderRage = unpackIndex(src[5]);
+		ch5->lateSort = src[6];
+		return ch5;
+	}
+	return NULL;
+}
+
+static void packRecord(const struct BranchPath *node, uint8_t *record) {
+	record[RECORD_ACTION] = (uint8_t)node->description.action;
+	packMoveData(&node->description, record + RECORD_MOVE_DATA);
+	putU32(record + RECORD_FRAMES_TAKEN, (uint32_t)node->description.framesTaken);
+	putU32(record + RECORD_TOTAL_FRAMES_TAKEN, (uint32_t)node->description.totalFramesTaken);
+	record[RECORD_NULLS] = (uint8_t)node->inventory.nulls;
+	record[RECORD_LENGTH] = (uint8_t)node->inventory.length;
+	for (size_t i = 0; i < 20; ++i) {
+		record[RECORD_INVENTORY + i] = i < node->inventory.length ? (uint8_t)node->inventory.inventory[i] : 0;
+	}
+	uint64_t outputs = 0;
+	for (int i = 0; i < NUM_RECIPES; ++i) {
+		if (node->outputCreated[i]) {
+			outputs |= UINT64_C(1) << i;
+		}
+	}
+	putU64(record + RECORD_OUTPUTS_CREATED, outputs);
+}
+
+static bool unpackRecord(const uint8_t *record, struct BranchPath *node) {
+	enum Action action = (enum Action)record[RECORD_ACTION];
+	size_t nulls = record[RECORD_NULLS];
+	size_t length = record[RECORD_LENGTH];
+	if (action > Ch5 || length > 20 || nulls > length) {
+		return false;
+	}
+	node->description.action = action;
+	node->description.data = unpackMoveData(action, record + RECORD_MOVE_DATA);
+	node->description.framesTaken = (int)getU32(record + RECORD_FRAMES_TAKEN);
+	node->description.totalFramesTaken = (int)getU32(record + RECORD_TOTAL_FRAMES_TAKEN);
+	node->inventory.nulls = nulls;
+	node->inventory.length = length;
+	for (size_t i = 0; i < 20; ++i) {
+		node->inventory.inventory[i] = (enum Type_Sort)record[RECORD_INVENTORY + i];
+	}
+	uint64_t outputs = getU64(record + RECORD_OUTPUTS_CREATED);
+	node->numOutputsCreated = 0;
+	for (int i = 0; i < NUM_RECIPES; ++i) {
+		node->outputCreated[i] = (outputs >> i) & 1;
+		node->numOutputsCreated += node->outputCreated[i];
+	}
+	return true;
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: encodeBinaryRoadmap
+ * Inputs	: struct BranchPath	*path
+ *		  size_t		*size
+ * Outputs	: uint8_t		*buffer
+ *
+ * Encode the roadmap starting at path (following next) into a freshly
+ * allocated buffer, which the caller frees.
+ -------------------------------------------------------------------*/
+uint8_t *encodeBinaryRoadmap(const struct BranchPath *path, size_t *size) {
+	uint32_t numRecords = 0;
+	const struct BranchPath *lastNode = path;
+	for (const struct BranchPath *node = path; node != NULL; node = node->next) {
+		++numRecords;
+		lastNode = node;
+	}
+
+	*size = ROADMAP_BINARY_HEADER_SIZE + (size_t)numRecords * ROADMAP_BINARY_RECORD_SIZE;
+	uint8_t *buffer = malloc(*size);
+	checkMallocFailed(buffer);
+
+	memcpy(buffer, roadmapBinaryMagic, sizeof(roadmapBinaryMagic));
+	putU16(buffer + 4, ROADMAP_BINARY_VERSION);
+	putU16(buffer + 6, ROADMAP_BINARY_RECORD_SIZE);
+	putU32(buffer + 8, numRecords);
+	putU32(buffer + 12, (uint32_t)lastNode->description.totalFramesTaken);
+
+	uint8_t *record = buffer + ROADMAP_BINARY_HEADER_SIZE;
+	for (const struct BranchPath *node = path; node != NULL; node = node->next) {
+		packRecord(node, record);
+		record += ROADMAP_BINARY_RECORD_SIZE;
+	}
+	return buffer;
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: decodeBinaryRoadmap
+ * Inputs	: const uint8_t		*data
+ *		  size_t		size
+ * Outputs	: struct BranchPath	*root
+ *
+ * Rebuild the linked list of nodes from an encoded roadmap.
+ * The nodes have no legal moves, just like the output of optimizeRoadmap.
+ -------------------------------------------------------------------*/
+struct BranchPath *decodeBinaryRoadmap(const uint8_t *data, size_t size) {
+	if (size < ROADMAP_BINARY_HEADER_SIZE
+		|| memcmp(data, roadmapBinaryMagic, sizeof(roadmapBinaryMagic)) != 0
+		|| getU16(data + 4) > ROADMAP_BINARY_VERSION
+		|| getU16(data + 6) < ROADMAP_BINARY_RECORD_SIZE) {
+		return NULL;
+	}
+	uint16_t recordSize = getU16(data + 6);
+	uint32_t numRecords = getU32(data + 8);
+	if (numRecords == 0 || numRecords > ROADMAP_BINARY_MAX_RECORDS
+		|| size < ROADMAP_BINARY_HEADER_SIZE + (size_t)numRecords * recordSize) {
+		return NULL;
+	}
+
+	const uint8_t *records = data + ROADMAP_BINARY_HEADER_SIZE;
+	struct BranchPath *root = NULL;
+	struct BranchPath *prevNode = NULL;
+	bool ok = true;
+	for (uint32_t i = 0; ok && i < numRecords; ++i) {
+		struct BranchPath *node = calloc(1, sizeof(struct BranchPath));
+		checkMallocFailed(node);
+		node->moves = (int)i;
+		node->prev = prevNode;
+		if (prevNode == NULL) {
+			root = node;
+		}
+		else {
+			prevNode->next = node;
+		}
+		prevNode = node;
+		ok = unpackRecord(records + (size_t)i * recordSize, node);
+	}
+
+	if (!ok) {
+		freeAllNodes(prevNode);
+		return NULL;
+	}
+	return root;
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: writeBinaryRoadmap
+ * Inputs	: const char		*filename
+ *		  struct BranchPath	*path
+ * Outputs	: bool			success
+ *
+ * Write the roadmap starting at path in the compact binary format.
+ * The whole file is assembled in memory and written with one fwrite,
+ * then atomically renamed into place.
+ -------------------------------------------------------------------*/
+bool writeBinaryRoadmap(const char *filename, const struct BranchPath *path) {
+	size_t fileSize;
+	uint8_t *buffer = encodeBinaryRoadmap(path, &fileSize);
+
+	struct AtomicFile file;
+	bool ok = atomicFileOpen(&file, filename);
+	if (ok) {
+		if (fwrite(buffer, 1, fileSize, file.fp) == fileSize) {
+			ok = atomicFileCommit(&file);
+		}
+		else {
+			atomicFileAbort(&file);
+			ok = false;
+		}
+	}
+	free(buffer);
+
+	if (!ok) {
+		recipeLog(1, "Calculator", "File", "Error", "Unable to write binary roadmap.");
+		return false;
+	}
+	recipeLog(5, "Calculator", "File", "Write", "Binary data for roadmap written.");
+	return true;
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: readBinaryRoadmap
+ * Inputs	: const char		*filename
+ * Outputs	: struct BranchPath	*root
+ *
+ * Read and decode a whole binary roadmap file.
+ -------------------------------------------------------------------*/
+struct BranchPath *readBinaryRoadmap(const char *filename) {
+	FILE *fp = fopen(filename, "rb");
+	if (fp == NULL) {
+		return NULL;
+	}
+	const size_t maxSize = ROADMAP_BINARY_HEADER_SIZE + (size_t)ROADMAP_BINARY_MAX_RECORDS * UINT16_MAX;
+	size_t capacity = ROADMAP_BINARY_HEADER_SIZE + (size_t)ROADMAP_BINARY_MAX_RECORDS * ROADMAP_BINARY_RECORD_SIZE;
+	size_t size = 0;
+	uint8_t *data = malloc(capacity);
+	checkMallocFailed(data);
+	while (true) {
+		size += fread(data + size, 1, capacity - size, fp);
+		if (size < capacity || capacity >= maxSize) {
+			break;
+		}
+		// Records written by a newer version may be bigger than ours
+		capacity *= 2;
+		data = realloc(data, capacity);
+		checkMallocFailed(data);
+	}
+	fclose(fp);
+
+	struct BranchPath *root = decodeBinaryRoadmap(data, size);
+	free(data);
+	return root;
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: convertBinaryRoadmapToText
+ * Inputs	: const char	*binFilename
+ *		  const char	*txtFilename
+ * Outputs	: bool		success
+ *
+ * Regenerate the tab-separated text roadmap from a binary roadmap.
+ * Requires initializeRecipeList to have been called.
+ -------------------------------------------------------------------*/
+bool convertBinaryRoadmapToText(const char *binFilename, const char *txtFilename) {
+	struct BranchPath *root = readBinaryRoadmap(binFilename);
+	if (root == NULL) {
+		return false;
+	}
+	const bool written = printResults(txtFilename, root);
+
+	struct BranchPath *lastNode = root;
+	while (lastNode->next != NULL) {
+		lastNode = lastNode->next;
+	}
+	freeAllNodes(lastNode);
+	return written;
+}
@@ -0,0 +1,47 @@
+#ifndef ROADMAP_BINARY_H
+#define ROADMAP_BINARY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "calculator.h"
+
+// Compact binary roadmap format, written as results/<frames>.bin next to results/<frames>.txt.
+//
+// All multi-byte fields are little endian.
+//
+// Header (ROADMAP_BINARY_HEADER_SIZE bytes):
+//   char     magic[4]        "CRMB"
+//   uint16   version         ROADMAP_BINARY_VERSION
+//   uint16   recordSize      ROADMAP_BINARY_RECORD_SIZE (lets older readers skip fields appended by newer versions)
+//   uint32   numRecords      One per node, including the Begin node
+//   uint32   totalFrames     totalFramesTaken of the last node
+//
+// Record (ROADMAP_BINARY_RECORD_SIZE bytes):
+//   uint8    action          enum Action
+//   uint8    moveData[9]     struct Cook or struct CH5 fields, one byte each (see roadmap_binary.c)
+//   int32    framesTaken
+//   int32    totalFramesTaken
+//   uint8    nulls
+//   uint8    length
+//   uint8    inventory[20]   enum Type_Sort, unused slots are 0
+//   uint64   outputsCreated  bit i set if recipe i has been cooked
+
+#define ROADMAP_BINARY_VERSION 1
+#define ROADMAP_BINARY_HEADER_SIZE 16
+#define ROADMAP_BINARY_RECORD_SIZE 48
+#define ROADMAP_BINARY_MAX_RECORDS 256
+
+// The in-memory form of the file, for embedding roadmaps in other files.
+// Returns a malloced buffer of *size bytes.
+uint8_t *encodeBinaryRoadmap(const struct BranchPath *path, size_t *size);
+// Returns NULL if the data is malformed. Bytes past the last record are ignored.
+struct BranchPath *decodeBinaryRoadmap(const uint8_t *data, size_t size);
+bool writeBinaryRoadmap(const char *filename, const struct BranchPath *path);
+// Returns the root of a freshly allocated roadmap (free with freeAllNodes on the last node),
+// or NULL if the file is missing or malformed.
+struct BranchPath *readBinaryRoadmap(const char *filename);
+// Regenerates the same text layout printResults writes, so the result can be submitted as usual.
+bool convertBinaryRoadmapToText(const char *binFilename, const char *txtFilename);
+
+#endif
@@ -0,0 +1,189 @@
+#include "roadmap_optimizer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "base.h"
+#include "logger.h"
+#include "path_replay.h"
+#include "thread_pool.h"
+
+struct OptimizerJob {
+	struct ReplayMove moves[REPLAY_MAX_MOVES];
+	int numMoves;
+	int frames;
+	int rawID;
+	long tag;
+};
+
+struct OptimizerMailbox {
+	struct OptimizedRoadmap results[OPTIMIZER_MAILBOX_SIZE];
+	int head;
+	int outstanding;	// Submitted and not yet polled
+	volatile int ready;	// Ready to be polled. Written under the lock, but read without it.
+};
+
+static pthread_mutex_t optimizerLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t optimizerResultCond = PTHREAD_COND_INITIALIZER;
+// Whether roadmaps are handed to the service workers of the thread pool
+static bool optimizerStarted = false;
+
+// Everything below is only touched under optimizerLock
+static struct OptimizerMailbox *optimizerMailboxes = NULL;
+static int numOptimizerMailboxes = 0;
+
+static void postOptimizedRoadmap(int rawID, const struct OptimizedRoadmap *result) {
+	struct OptimizerMailbox *mailbox = &optimizerMailboxes[rawID];
+	_assert_with_stacktrace(mailbox->ready < OPTIMIZER_MAILBOX_SIZE);
+	mailbox->results[(mailbox->head + mailbox->ready) % OPTIMIZER_MAILBOX_SIZE] = *result;
+	++mailbox->ready;
+	pthread_cond_broadcast(&optimizerResultCond);
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: runOptimizerJob
+ * Inputs	: struct OptimizerJob	*job
+ * Outputs	: struct OptimizedRoadmap	result
+ *
+ * Rebuild the roadmap from its moves, then optimize it (and save it,
+ * if it is a record) exactly as the search thread would have.
+ -------------------------------------------------------------------*/
+static struct OptimizedRoadmap runOptimizerJob(const struct OptimizerJob *job) {
+	struct OptimizedRoadmap result = { job->tag, job->frames, -1, false };
+	enum ReplayError error = REPLAY_OK;
+	int failedMove = -1;
+	struct BranchPath *last = buildReplayPath(job->moves, job->numMoves, &error, &failedMove);
+	if (last == NULL || last->description.totalFramesTaken != job->frames) {
+		char message[150];
+		sprintf(message, "Thread %d][Could not rebuild a %d frame roadmap to optimize it: %s at move %d", job->rawID + 1, job->frames,
+			last == NULL ? getReplayErrorName(error) : getReplayErrorName(REPLAY_STATE_MISMATCH), failedMove);
+		recipeLog(1, "Calculator", "Optimizer", "Error", message);
+	}
+	else {
+		struct BranchPath *root = last;
+		while (root->prev != NULL) {
+			root = root->prev;
+		}
+		result.newRecord = optimizeAndSaveRoadmap(job->rawID, root, job->frames, &result.optimizedFrames, true);
+	}
+	if (last != NULL) {
+		freeAllNodes(last);
+	}
+	return result;
+}
+
+static void optimizerJobMain(struct WorkerContext *worker, void *arg) {
+	struct OptimizerJob *job = arg;
+	struct OptimizedRoadmap result = runOptimizerJob(job);
+	pthread_mutex_lock(&optimizerLock);
+	postOptimizedRoadmap(job->rawID, &result);
+	pthread_mutex_unlock(&optimizerLock);
+	free(job);
+}
+
+void initRoadmapOptimizer(int numWorkers) {
+	optimizerMailboxes = calloc(numWorkers, sizeof(struct OptimizerMailbox));
+	checkMallocFailed(optimizerMailboxes);
+	numOptimizerMailboxes = numWorkers;
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: startRoadmapOptimizer
+ *
+ * Start handing submitted roadmaps to the service workers of the thread
+ * pool. If there are none, the search threads keep optimizing their own
+ * roadmaps.
+ -------------------------------------------------------------------*/
+void startRoadmapOptimizer() {
+	if (getJobClassWorkerCount(JOB_CLASS_SERVICE) == 0) {
+		recipeLog(1, "Calculator", "Optimizer", "Error", "No service worker is running. Roadmaps will be optimized on the search threads.");
+		return;
+	}
+	pthread_mutex_lock(&optimizerLock);
+	optimizerStarted = true;
+	pthread_mutex_unlock(&optimizerLock);
+}
+
+void stopRoadmapOptimizer() {
+	pthread_mutex_lock(&optimizerLock);
+	const bool wasStarted = optimizerStarted;
+	optimizerStarted = false;
+	pthread_mutex_unlock(&optimizerLock);
+	if (wasStarted) {
+		waitForJobClass(JOB_CLASS_SERVICE);
+	}
+}
+
+void freeRoadmapOptimizer() {
+	free(optimizerMailboxes);
+	optimizerMailboxes = NULL;
+	numOptimizerMailboxes = 0;
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: submitRoadmapForOptimizing
+ * Inputs	: int			rawID
+ *		  struct BranchPath	*root
+ *		  int			frames
+ *		  long			tag
+ *
+ * Queue the moves of the roadmap as a service job. If the optimizer is
+ * not started or the service queue is full, optimize it here instead
+ * (without the local search), so no roadmap is ever dropped; the outcome
+ * is posted to the mailbox either way.
+ -------------------------------------------------------------------*/
+void submitRoadmapForOptimizing(int rawID, const struct BranchPath *root, int frames, long tag) {
+	_assert_with_stacktrace(rawID >= 0 && rawID < numOptimizerMailboxes);
+	pthread_mutex_lock(&optimizerLock);
+	const bool started = optimizerStarted;
+	// Counted before the job is queued, so its outcome can never be posted before it is expected
+	++optimizerMailboxes[rawID].outstanding;
+	pthread_mutex_unlock(&optimizerLock);
+
+	if (started) {
+		struct OptimizerJob *job = malloc(sizeof(struct OptimizerJob));
+		checkMallocFailed(job);
+		job->numMoves = extractReplayMoves(root, job->moves, REPLAY_MAX_MOVES);
+		job->frames = frames;
+		job->rawID = rawID;
+		job->tag = tag;
+		if (job->numMoves >= 0 && submitJob(JOB_CLASS_SERVICE, optimizerJobMain, job)) {
+			return;
+		}
+		free(job);
+	}
+
+	// Local search takes far longer than optimizeRoadmap, so it is only ever run by the service worker
+	struct OptimizedRoadmap result = { tag, frames, -1, false };
+	result.newRecord = optimizeAndSaveRoadmap(rawID, root, frames, &result.optimizedFrames, false);
+	pthread_mutex_lock(&optimizerLock);
+	postOptimizedRoadmap(rawID, &result);
+	pthread_mutex_unlock(&optimizerLock);
+}
+
+bool pollOptimizedRoadmap(int rawID, struct OptimizedRoadmap *dest) {
+	struct OptimizerMailbox *mailbox = &optimizerMailboxes[rawID];
+	// Checked on every iteration of the search, so avoid the lock while there is nothing to take
+	if (ABSL_PREDICT_TRUE(mailbox->ready == 0)) {
+		return false;
+	}
+	pthread_mutex_lock(&optimizerLock);
+	*dest = mailbox->results[mailbox->head];
+	mailbox->head = (mailbox->head + 1) % OPTIMIZER_MAILBOX_SIZE;
+	--mailbox->ready;
+	--mailbox->outstanding;
+	pthread_mutex_unlock(&optimizerLock);
+	return true;
+}
+
+bool waitForOptimizedRoadmaps(int rawID) {
+	struct OptimizerMailbox *mailbox = &optimizerMailboxes[rawID];
+	pthread_mutex_lock(&optimizerLock);
+	const bool outstanding = mailbox->outstanding > 0;
+	while (mailbox->ready < mailbox->outstanding) {
+		pthread_cond_wait(&optimizerResultCond, &optimizerLock);
+	}
+	pthread_mutex_unlock(&optimizerLock);
+	return outstanding;
+}
@@ -0,0 +1,40 @@
+#ifndef CIPES_ROADMAP_OPTIMIZER_H
+#define CIPES_ROADMAP_OPTIMIZER_H
+
+#include <stdbool.h>
+#include "calculator.h"
+
+// Finished roadmaps close to the record are handed to the service worker of the thread pool as jobs,
+// which run optimizeRoadmap on them and save any new record, so search threads never stall on it.
+// The outcome goes back to the search thread's own mailbox, which it polls between iterations.
+
+// Capacity of the service job queue. While it is full, roadmaps are optimized on the search thread.
+#define OPTIMIZER_QUEUE_SIZE 64
+// Outcomes waiting to be polled: everything queued, the one being optimized by the (single)
+// service worker, and one optimized inline
+#define OPTIMIZER_MAILBOX_SIZE (OPTIMIZER_QUEUE_SIZE + 2)
+
+struct OptimizedRoadmap {
+	long tag;				// As passed in with the roadmap
+	int frames;				// Of the roadmap as it was finished
+	int optimizedFrames;	// After optimizeRoadmap, or -1 if the roadmap could not be rebuilt
+	bool newRecord;			// Beat the local record, and was saved to results/
+};
+
+// Allocate mailboxes for rawIDs 0 to numWorkers - 1. Must be called before any roadmap is submitted.
+void initRoadmapOptimizer(int numWorkers);
+// Until started, submitted roadmaps are optimized on the calling thread. Needs the service workers running.
+void startRoadmapOptimizer();
+// Stop queueing roadmaps, and wait until everything already queued is optimized.
+void stopRoadmapOptimizer();
+void freeRoadmapOptimizer();
+// Hand over a complete roadmap (root of a path followed via next) that finished at frames.
+// Only its moves are copied, so the path may be changed as soon as this returns.
+void submitRoadmapForOptimizing(int rawID, const struct BranchPath *root, int frames, long tag);
+// Take the oldest outcome for rawID out of its mailbox. Returns false if none is ready.
+bool pollOptimizedRoadmap(int rawID, struct OptimizedRoadmap *dest);
+// Block until the outcome of every roadmap rawID submitted is ready to be polled.
+// Returns false, without blocking, if every roadmap rawID submitted has already been polled.
+bool waitForOptimizedRoadmaps(int rawID);
+
+#endif
@@ -0,0 +1,564 @@
+#include "roadmap_verify.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <dirent.h>
+#include <omp.h>
+#include "base.h"
+#include "calculator.h"
+#include "inventory.h"
+#include "recipes.h"
+#include "path_replay.h"
+#include "roadmap_binary.h"
+
+#define VERIFY_DEFAULT_PATH "results"
+#define VERIFY_MAX_PATH 512
+#define VERIFY_MAX_LINE 8192	// A text row is under 1000 characters
+#define VERIFY_TEXT_COLUMNS (3 + 20 + NUM_RECIPES)	// Description, frames taken, total frames, slots, outputs
+
+enum VerifyStatus {
+	VERIFY_OK,
+	VERIFY_MISMATCH,	// Illegal move, or the roadmap disagrees with what its moves produce
+	VERIFY_UNREADABLE
+};
+
+struct VerifyResult {
+	enum VerifyStatus status;
+	int frames;				// Replayed frames of the whole roadmap
+	int optimizedFrames;	// What optimizeRoadmap makes of it now, or -1 if it is not complete
+	char message[160];
+};
+
+/*-------------------------------------------------------------------
+ * Text roadmap parsing. This is the inverse of printNodeDescription,
+ * printInventoryData and printOutputsCreated in calculator.c.
+ -------------------------------------------------------------------*/
+
+static bool skipLiteral(const char **p, const char *literal) {
+	size_t length = strlen(literal);
+	if (strncmp(*p, literal, length) != 0) {
+		return false;
+	}
+	*p += length;
+	return true;
+}
+
+static bool parseNumber(const char **p, int *value) {
+	char *end;
+	long parsed = strtol(*p, &end, 10);
+	if (end == *p) {
+		return false;
+	}
+	*value = (int)parsed;
+	*p = end;
+	return true;
+}
+
+static bool lookupItem(const char *name, size_t length, enum Type_Sort *item) {
+	for (int t = 0; t <= Mistake; ++t) {
+		const char *itemName = getItemName(t);
+		if (strncmp(itemName, name, length) == 0 && itemName[length] == '\0') {
+			*item = t;
+			return true;
+		}
+	}
+	return false;
+}
+
+// Parse an item name surrounded by open and close, e.g. [Mushroom] or <Shroom_Fry>
+static bool parseItem(const char **p, char open, char close, enum Type_Sort *item) {
+	if (**p != open) {
+		return false;
+	}
+	const char *end = strchr(*p + 1, close);
+	if (end == NULL || !lookupItem(*p + 1, end - (*p + 1), item)) {
+		return false;
+	}
+	*p = end + 1;
+	return true;
+}
+
+// Slots are printed as the player sees them, so the first 10 are shifted up by the nulls
+static int displaySlotToIndex(int slot, const struct Inventory *inventory) {
+	if (slot >= 11) {
+		return slot - 1;
+	}
+	if (slot >= 1 && slot <= 10 - (int)inventory->nulls) {
+		return slot - 1 + inventory->nulls;
+	}
+	return -1;
+}
+
+static bool parseCook(const char *p, const struct Inventory *inventory, struct Cook *cook) {
+	int slot;
+	cook->numItems = 1;
+	if (!skipLiteral(&p, "Use ") || !parseItem(&p, '[', ']', &cook->item1)
+		|| !skipLiteral(&p, " in slot ") || !parseNumber(&p, &slot) || !skipLiteral(&p, " ")) {
+		return false;
+	}
+	cook->itemIndex1 = displaySlotToIndex(slot, inventory);
+	cook->item2 = -1;
+	cook->itemIndex2 = -1;
+	if (skipLiteral(&p, "and ")) {
+		cook->numItems = 2;
+		if (!parseItem(&p, '[', ']', &cook->item2) || !skipLiteral(&p, " in slot ")
+			|| !parseNumber(&p, &slot) || !skipLiteral(&p, " ")) {
+			return false;
+		}
+		cook->itemIndex2 = displaySlotToIndex(slot, inventory);
+	}
+	if (!skipLiteral(&p, "to make ")) {
+		return false;
+	}
+	cook->handleOutput = skipLiteral(&p, "(and toss) ") ? Toss
+		: skipLiteral(&p, "(and auto-place) ") ? Autoplace
+		: TossOther;
+	if (!parseItem(&p, '<', '>', &cook->output)) {
+		return false;
+	}
+	cook->toss = -1;
+	cook->indexToss = -1;
+	if (cook->handleOutput == TossOther) {
+		if (!skipLiteral(&p, ", toss ") || !parseItem(&p, '[', ']', &cook->toss)
+			|| !skipLiteral(&p, " in slot ") || !parseNumber(&p, &slot)) {
+			return false;
+		}
+		cook->indexToss = slot - 1;
+	}
+	// The note on the final move is derived from the move itself
+	if (!skipLiteral(&p, " (No-Toss 5 Frame Penalty for Jump Storage)")) {
+		skipLiteral(&p, " (Jump Storage on Tossed Item)");
+	}
+	return *p == '\0';
+}
+
+// "DB filling null, " or "DB replacing #3, "
+static bool parseChapter5Placement(const char **p, const char *item, int *index) {
+	int slot;
+	if (!skipLiteral(p, item)) {
+		return false;
+	}
+	if (skipLiteral(p, " filling null, ")) {
+		*index = 0;
+		return true;
+	}
+	if (!skipLiteral(p, " replacing #") || !parseNumber(p, &slot) || !skipLiteral(p, ", ")) {
+		return false;
+	}
+	*index = slot - 1;
+	return true;
+}
+
+static bool parseChapter5Sort(const char **p, enum Action *sort) {
+	*sort = skipLiteral(p, "sort (Alpha), ") ? Sort_Alpha_Asc
+		: skipLiteral(p, "sort (Reverse-Alpha), ") ? Sort_Alpha_Des
+		: skipLiteral(p, "sort (Type), ") ? Sort_Type_Asc
+		: skipLiteral(p, "sort (Reverse-Type), ") ? Sort_Type_Des
+		: Begin;
+	return *sort != Begin;
+}
+
+static bool parseChapter5(const char *p, struct CH5 *ch5) {
+	int slot;
+	if (!skipLiteral(&p, "Ch.5 Break: ")
+		|| !parseChapter5Placement(&p, "DB", &ch5->indexDriedBouquet)
+		|| !parseChapter5Placement(&p, "CO", &ch5->indexCoconut)) {
+		return false;
+	}
+	ch5->lateSort = strncmp(p, "KM", 2) == 0;
+	if (ch5->lateSort) {
+		if (!parseChapter5Placement(&p, "KM", &ch5->indexKeelMango) || !parseChapter5Sort(&p, &ch5->ch5Sort)) {
+			return false;
+		}
+	}
+	else if (!parseChapter5Sort(&p, &ch5->ch5Sort) || !parseChapter5Placement(&p, "KM", &ch5->indexKeelMango)) {
+		return false;
+	}
+	if (!skipLiteral(&p, "CS replacing #") || !parseNumber(&p, &slot)) {
+		return false;
+	}
+	ch5->indexCourageShell = slot - 1;
+	if (!skipLiteral(&p, ", use TR in #") || !parseNumber(&p, &slot)) {
+		return false;
+	}
+	ch5->indexThunderRage = slot - 1;
+	return *p == '\0';
+}
+
+static bool parseMove(const char *description, const struct Inventory *inventory, struct ReplayMove *move) {
+	memset(move, 0, sizeof(*move));
+	if (strcmp(description, "Sort - Alphabetical") == 0) {
+		move->action = Sort_Alpha_Asc;
+	}
+	else if (strcmp(description, "Sort - Reverse Alphabetical") == 0) {
+		move->action = Sort_Alpha_Des;
+	}
+	else if (strcmp(description, "Sort - Type") == 0) {
+		move->action = Sort_Type_Asc;
+	}
+	else if (strcmp(description, "Sort - Reverse Type") == 0) {
+		move->action = Sort_Type_Des;
+	}
+	else if (strncmp(description, "Use ", 4) == 0) {
+		move->action = Cook;
+		return parseCook(description, inventory, &move->cook);
+	}
+	else if (strncmp(description, "Ch.5 Break: ", 12) == 0) {
+		move->action = Ch5;
+		return parseChapter5(description, &move->ch5);
+	}
+	else {
+		return false;
+	}
+	return true;
+}
+
+// Split a row into its tab separated cells in place. Returns the number of cells.
+static int splitRow(char *line, char **cells, int maxCells) {
+	line[strcspn(line, "\r\n")] = '\0';
+	int numCells = 0;
+	while (numCells < maxCells) {
+		cells[numCells++] = line;
+		char *tab = strchr(line, '\t');
+		if (tab == NULL) {
+			break;
+		}
+		*tab = '\0';
+		line = tab + 1;
+	}
+	return numCells;
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: compareRowToState
+ * Inputs	: char			**cells
+ *		  struct ReplayState	*state
+ *		  char			*message
+ * Outputs	: bool			matches
+ *
+ * Compare the frames, inventory and outputs of a text row with the
+ * replayed state, laid out the same way printInventoryData does.
+ -------------------------------------------------------------------*/
+static bool compareRowToState(char **cells, const struct ReplayState *state, char *message, size_t messageSize) {
+	int framesTaken = atoi(cells[1]);
+	int totalFramesTaken = atoi(cells[2]);
+	if (framesTaken != state->framesTaken || totalFramesTaken != state->totalFramesTaken) {
+		snprintf(message, messageSize, "stored %d frames (%d total), moves take %d (%d total)",
+			framesTaken, totalFramesTaken, state->framesTaken, state->totalFramesTaken);
+		return false;
+	}
+
+	const struct Inventory *inventory = &state->inventory;
+	size_t nulls = inventory->nulls;
+	int column = 3;
+	bool inventoryMatches = true;
+	size_t i;
+	for (i = nulls; i < 10; ++i) {
+		inventoryMatches &= strcmp(cells[column++], getItemName(inventory->inventory[i])) == 0;
+	}
+	for (i = 0; i < nulls; ++i) {
+		inventoryMatches &= strcmp(cells[column++], "NULL") == 0;
+	}
+	for (i = 10; i < inventory->length - nulls; ++i) {
+		inventoryMatches &= strcmp(cells[column++], getItemName(inventory->inventory[i])) == 0;
+	}
+	for (; i < inventory->length; ++i) {
+		const char *cell = cells[column++];
+		const char *name = getItemName(inventory->inventory[i]);
+		size_t nameLength = strlen(name);
+		inventoryMatches &= cell[0] == '(' && strncmp(cell + 1, name, nameLength) == 0 && strcmp(cell + 1 + nameLength, ")") == 0;
+	}
+	for (; i < 20; ++i) {
+		inventoryMatches &= strcmp(cells[column++], "BLOCKED") == 0;
+	}
+	if (!inventoryMatches) {
+		snprintf(message, messageSize, "stored inventory does not match what the moves produce");
+		return false;
+	}
+
+	for (int recipe = 0; recipe < NUM_RECIPES; ++recipe) {
+		bool created = (state->outputsCreated >> recipe) & 1;
+		if (strcmp(cells[column++], created ? "True" : "False") != 0) {
+			snprintf(message, messageSize, "stored outputs do not match what the moves produce");
+			return false;
+		}
+	}
+	return true;
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: verifyTextRoadmap
+ * Inputs	: char			*path
+ *		  struct ReplayMove	*moves
+ *		  int			*numMoves
+ *		  struct ReplayState	*state
+ *		  struct VerifyResult	*result
+ *
+ * Replay a results/<frames>.txt roadmap row by row.
+ -------------------------------------------------------------------*/
+static void verifyTextRoadmap(const char *path, struct ReplayMove *moves, int *numMoves, struct ReplayState *state, struct VerifyResult *result) {
+	FILE *fp = fopen(path, "r");
+	if (fp == NULL) {
+		result->status = VERIFY_UNREADABLE;
+		snprintf(result->message, sizeof(result->message), "could not open the file");
+		return;
+	}
+	char *line = malloc(VERIFY_MAX_LINE);
+	checkMallocFailed(line);
+	char *cells[VERIFY_TEXT_COLUMNS];
+
+	initReplayState(state);
+	*numMoves = 0;
+	if (fgets(line, VERIFY_MAX_LINE, fp) == NULL || strncmp(line, "Description\t", 12) != 0) {
+		result->status = VERIFY_UNREADABLE;
+		snprintf(result->message, sizeof(result->message), "not a roadmap (missing header)");
+	}
+	for (int row = 1; result->status == VERIFY_OK && fgets(line, VERIFY_MAX_LINE, fp) != NULL; ++row) {
+		if (splitRow(line, cells, VERIFY_TEXT_COLUMNS) != VERIFY_TEXT_COLUMNS) {
+			result->status = VERIFY_UNREADABLE;
+			snprintf(result->message, sizeof(result->message), "row %d: wrong number of columns", row);
+			break;
+		}
+		if (row == 1) {
+			if (strcmp(cells[0], "Begin") != 0) {
+				result->status = VERIFY_UNREADABLE;
+				snprintf(result->message, sizeof(result->message), "row 1: roadmap does not start with Begin");
+				break;
+			}
+		}
+		else {
+			if (*numMoves == REPLAY_MAX_MOVES) {
+				result->status = VERIFY_MISMATCH;
+				snprintf(result->message, sizeof(result->message), "%s", getReplayErrorName(REPLAY_TOO_MANY_MOVES));
+				break;
+			}
+			struct ReplayMove *move = &moves[*numMoves];
+			if (!parseMove(cells[0], &state->inventory, move)) {
+				result->status = VERIFY_UNREADABLE;
+				snprintf(result->message, sizeof(result->message), "row %d: can't parse \"%.80s\"", row, cells[0]);
+				break;
+			}
+			enum ReplayError error = applyReplayMove(state, move);
+			if (error != REPLAY_OK) {
+				result->status = VERIFY_MISMATCH;
+				snprintf(result->message, sizeof(result->message), "row %d: %s", row, getReplayErrorName(error));
+				break;
+			}
+			++*numMoves;
+		}
+		char detail[120];
+		if (!compareRowToState(cells, state, detail, sizeof(detail))) {
+			result->status = VERIFY_MISMATCH;
+			snprintf(result->message, sizeof(result->message), "row %d: %s", row, detail);
+		}
+	}
+	free(line);
+	fclose(fp);
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: verifyBinaryRoadmap
+ * Inputs	: char			*path
+ *		  struct ReplayMove	*moves
+ *		  int			*numMoves
+ *		  struct ReplayState	*state
+ *		  struct VerifyResult	*result
+ *
+ * Replay a results/<frames>.bin roadmap record by record.
+ -------------------------------------------------------------------*/
+static void verifyBinaryRoadmap(const char *path, struct ReplayMove *moves, int *numMoves, struct ReplayState *state, struct VerifyResult *result) {
+	struct BranchPath *root = readBinaryRoadmap(path);
+	if (root == NULL) {
+		result->status = VERIFY_UNREADABLE;
+		snprintf(result->message, sizeof(result->message), "missing or malformed binary roadmap");
+		return;
+	}
+	*numMoves = extractReplayMoves(root, moves, REPLAY_MAX_MOVES);
+	initReplayState(state);
+	const struct BranchPath *node = root;
+	if (*numMoves < 0) {
+		result->status = VERIFY_MISMATCH;
+		snprintf(result->message, sizeof(result->message), "%s", getReplayErrorName(REPLAY_TOO_MANY_MOVES));
+	}
+	else if (!replayStateMatchesNode(state, node)) {
+		result->status = VERIFY_MISMATCH;
+		snprintf(result->message, sizeof(result->message), "record 1: %s", getReplayErrorName(REPLAY_STATE_MISMATCH));
+	}
+	for (int i = 0; result->status == VERIFY_OK && i < *numMoves; ++i) {
+		node = node->next;
+		enum ReplayError error = applyReplayMove(state, &moves[i]);
+		if (error == REPLAY_OK && (!replayStateMatchesNode(state, node) || state->framesTaken != node->description.framesTaken)) {
+			error = REPLAY_STATE_MISMATCH;
+		}
+		if (error != REPLAY_OK) {
+			result->status = VERIFY_MISMATCH;
+			snprintf(result->message, sizeof(result->message), "record %d: %s (stored %d total frames, moves take %d)",
+				i + 2, getReplayErrorName(error), node->description.totalFramesTaken, state->totalFramesTaken);
+		}
+	}
+	while (node->next != NULL) {
+		node = node->next;
+	}
+	freeAllNodes((struct BranchPath *)node);
+}
+
+static bool hasSuffix(const char *name, const char *suffix) {
+	size_t nameLength = strlen(name);
+	size_t suffixLength = strlen(suffix);
+	return nameLength >= suffixLength && strcmp(name + nameLength - suffixLength, suffix) == 0;
+}
+
+// Returns the frame count in a results/<frames>.txt style name, or -1 if the name is not just a number
+static int getFramesFromName(const char *path) {
+	const char *name = strrchr(path, '/');
+	name = name != NULL ? name + 1 : path;
+	int frames;
+	int consumed = 0;
+	if (sscanf(name, "%d%n", &frames, &consumed) != 1 || (strcmp(name + consumed, ".txt") != 0 && strcmp(name + consumed, ".bin") != 0)) {
+		return -1;
+	}
+	return frames;
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: verifyRoadmap
+ * Inputs	: char			*path
+ * Outputs	: struct VerifyResult	result
+ *
+ * Replay one roadmap file and, if it holds up, re-optimize it.
+ -------------------------------------------------------------------*/
+static struct VerifyResult verifyRoadmap(const char *path) {
+	struct VerifyResult result = { VERIFY_OK, -1, -1, "" };
+	struct ReplayMove moves[REPLAY_MAX_MOVES];
+	int numMoves = 0;
+	struct ReplayState state;
+	if (hasSuffix(path, ".bin")) {
+		verifyBinaryRoadmap(path, moves, &numMoves, &state, &result);
+	}
+	else {
+		verifyTextRoadmap(path, moves, &numMoves, &state, &result);
+	}
+	if (result.status != VERIFY_OK) {
+		return result;
+	}
+	result.frames = state.totalFramesTaken;
+
+	int namedFrames = getFramesFromName(path);
+	if (state.numOutputsCreated != NUM_RECIPES) {
+		result.status = VERIFY_MISMATCH;
+		snprintf(result.message, sizeof(result.message), "incomplete, only %d of %d recipes are made", state.numOutputsCreated, NUM_RECIPES);
+		return result;
+	}
+	if (namedFrames >= 0 && namedFrames != state.totalFramesTaken) {
+		result.status = VERIFY_MISMATCH;
+		snprintf(result.message, sizeof(result.message), "named %d frames, but the moves take %d", namedFrames, state.totalFramesTaken);
+		return result;
+	}
+
+	struct BranchPath *last = buildReplayPath(moves, numMoves, NULL, NULL);
+	struct BranchPath *root = last;
+	while (root->prev != NULL) {
+		root = root->prev;
+	}
+	struct CompactRoadmap *optimized = malloc(sizeof(struct CompactRoadmap));
+	checkMallocFailed(optimized);
+	optimizeRoadmap(root, optimized);
+	result.optimizedFrames = optimized->frames;
+	free(optimized);
+	freeAllNodes(last);
+	return result;
+}
+
+static void addPath(char ***paths, int *numPaths, int *capacity, const char *path) {
+	if (*numPaths == *capacity) {
+		*capacity = *capacity ? 2 * *capacity : 64;
+		*paths = realloc(*paths, sizeof(char *) * *capacity);
+		checkMallocFailed(*paths);
+	}
+	(*paths)[*numPaths] = malloc(strlen(path) + 1);
+	checkMallocFailed((*paths)[*numPaths]);
+	strcpy((*paths)[(*numPaths)++], path);
+}
+
+// Directories contribute their <frames>.txt and <frames>.bin files; anything else is taken as a file
+static void collectPaths(const char *path, char ***paths, int *numPaths, int *capacity) {
+	DIR *dir = opendir(path);
+	if (dir == NULL) {
+		addPath(paths, numPaths, capacity, path);
+		return;
+	}
+	struct dirent *entry;
+	while ((entry = readdir(dir)) != NULL) {
+		if (getFramesFromName(entry->d_name) < 0) {
+			continue;
+		}
+		char filePath[VERIFY_MAX_PATH];
+		snprintf(filePath, sizeof(filePath), "%s/%s", path, entry->d_name);
+		addPath(paths, numPaths, capacity, filePath);
+	}
+	closedir(dir);
+}
+
+static int comparePaths(const void *elem1, const void *elem2) {
+	return strcmp(*(char * const *)elem1, *(char * const *)elem2);
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: verifyMain
+ * Inputs	: int	argc
+ *		  char	**argv
+ * Outputs	: int	exit code
+ *
+ * Nothing here depends on config.txt or the network. Files are spread
+ * over every core, but reported in name order.
+ -------------------------------------------------------------------*/
+int verifyMain(int argc, char **argv) {
+	initializeInvFrames();
+	initializeRecipeList();
+
+	char **paths = NULL;
+	int numPaths = 0;
+	int capacity = 0;
+	if (argc <= 2) {
+		collectPaths(VERIFY_DEFAULT_PATH, &paths, &numPaths, &capacity);
+	}
+	for (int i = 2; i < argc; ++i) {
+		collectPaths(argv[i], &paths, &numPaths, &capacity);
+	}
+	if (numPaths == 0) {
+		printf("No roadmaps to verify.\n");
+		return 0;
+	}
+	qsort(paths, numPaths, sizeof(paths[0]), comparePaths);
+
+	struct VerifyResult *results = malloc(sizeof(struct VerifyResult) * numPaths);
+	checkMallocFailed(results);
+	double start = omp_get_wtime();
+	#pragma omp parallel for schedule(dynamic, 4)
+	for (int i = 0; i < numPaths; ++i) {
+		results[i] = verifyRoadmap(paths[i]);
+	}
+	double elapsed = omp_get_wtime() - start;
+
+	int counts[VERIFY_UNREADABLE + 1] = {0};
+	int improvable = 0;
+	for (int i = 0; i < numPaths; ++i) {
+		const struct VerifyResult *result = &results[i];
+		++counts[result->status];
+		if (result->status != VERIFY_OK) {
+			printf("%s: %s: %s\n", paths[i], result->status == VERIFY_MISMATCH ? "MISMATCH" : "UNREADABLE", result->message);
+		}
+		else if (result->optimizedFrames >= 0 && result->optimizedFrames < result->frames) {
+			++improvable;
+			printf("%s: OK, %d frames, re-optimizes to %d\n", paths[i], result->frames, result->optimizedFrames);
+		}
+		free(paths[i]);
+	}
+	printf("Verified %d roadmaps in %.2fs using %d threads: %d OK, %d mismatched, %d unreadable, %d improved by re-optimizing\n",
+		numPaths, elapsed, omp_get_max_threads(), counts[VERIFY_OK], counts[VERIFY_MISMATCH], counts[VERIFY_UNREADABLE], improvable);
+	free(paths);
+	free(results);
+	return counts[VERIFY_OK] == numPaths ? 0 : 1;
+}
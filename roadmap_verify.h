@@ -0,0 +1,12 @@
+#ifndef CIPES_ROADMAP_VERIFY_H
+#define CIPES_ROADMAP_VERIFY_H
+
+// recipesAtHome --verify [file or directory...]   (or: make verify)
+// Re-simulate every move of the given roadmaps (results/<frames>.txt or .bin, default: results/)
+// with the current move rules and frame costs, across all cores, and report any roadmap which
+// is illegal, or whose stored frames or inventory no longer match what the moves produce.
+// Complete roadmaps are also run through optimizeRoadmap again, to see if they now do better.
+// Exits with 1 if anything did not verify.
+int verifyMain(int argc, char **argv);
+
+#endif
@@ -0,0 +1,95 @@
+#include "search_stats.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "base.h"
+
+static struct SearchStatsSlot unboundSearchStats;
+struct SearchStatsSlot *threadSearchStatsSlot = &unboundSearchStats;
+#pragma omp threadprivate(threadSearchStatsSlot)
+
+static struct SearchStatsSlot *searchStatsSlots = NULL;
+static void *searchStatsAllocation = NULL;	// What was actually allocated; searchStatsSlots is aligned within it
+static int numSearchStatsSlots = 0;
+
+/*-------------------------------------------------------------------
+ * Function 	: initSearchStats
+ * Inputs	: int	numThreads
+ *
+ * Allocate one cache line aligned slot per search thread.
+ -------------------------------------------------------------------*/
+void initSearchStats(int numThreads) {
+	freeSearchStats();
+	// aligned_alloc is missing on Windows, so over-allocate by a slot and align by hand
+	searchStatsAllocation = calloc(numThreads + 1, sizeof(struct SearchStatsSlot));
+	checkMallocFailed(searchStatsAllocation);
+	uintptr_t address = (uintptr_t)searchStatsAllocation;
+	address = (address + SEARCH_STATS_CACHE_LINE - 1) & ~(uintptr_t)(SEARCH_STATS_CACHE_LINE - 1);
+	searchStatsSlots = (struct SearchStatsSlot *)address;
+	numSearchStatsSlots = numThreads;
+}
+
+void bindSearchStatsSlot(int rawID) {
+	if (rawID >= 0 && rawID < numSearchStatsSlots) {
+		threadSearchStatsSlot = &searchStatsSlots[rawID];
+	}
+	else {
+		threadSearchStatsSlot = &unboundSearchStats;
+	}
+}
+
+int getSearchStatsSlotCount() {
+	return numSearchStatsSlots;
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: readSearchStats
+ * Inputs	: int			rawID
+ *		  struct SearchStats	*dest
+ *
+ * The owning thread keeps writing while this reads. Every counter is an
+ * aligned long, which is loaded in a single access on every platform we
+ * build for, so the worst case is a value that is slightly out of date.
+ -------------------------------------------------------------------*/
+void readSearchStats(int rawID, struct SearchStats *dest) {
+	const volatile struct SearchStats *src = &searchStatsSlots[rawID].stats;
+	dest->dives = src->dives;
+	dest->nodesExpanded = src->nodesExpanded;
+	dest->legalMovesGenerated = src->legalMovesGenerated;
+	dest->stateOKCalls = src->stateOKCalls;
+	dest->stateOKRejections = src->stateOKRejections;
+	dest->optimizeRoadmapCalls = src->optimizeRoadmapCalls;
+	dest->recordsFound = src->recordsFound;
+	dest->allocations = src->allocations;
+}
+
+void readSearchGauges(int rawID, struct SearchGauges *dest) {
+	const volatile struct SearchGauges *src = &searchStatsSlots[rawID].gauges;
+	dest->depth = src->depth;
+	dest->iterationLimit = src->iterationLimit;
+	dest->liveNodes = src->liveNodes;
+}
+
+void readTotalSearchStats(struct SearchStats *dest) {
+	memset(dest, 0, sizeof(*dest));
+	for (int i = 0; i < numSearchStatsSlots; ++i) {
+		struct SearchStats stats;
+		readSearchStats(i, &stats);
+		dest->dives += stats.dives;
+		dest->nodesExpanded += stats.nodesExpanded;
+		dest->legalMovesGenerated += stats.legalMovesGenerated;
+		dest->stateOKCalls += stats.stateOKCalls;
+		dest->stateOKRejections += stats.stateOKRejections;
+		dest->optimizeRoadmapCalls += stats.optimizeRoadmapCalls;
+		dest->recordsFound += stats.recordsFound;
+		dest->allocations += stats.allocations;
+	}
+}
+
+void freeSearchStats() {
+	free(searchStatsAllocation);
+	searchStatsAllocation = NULL;
+	searchStatsSlots = NULL;
+	numSearchStatsSlots = 0;
+}
@@ -0,0 +1,60 @@
+#ifndef SEARCH_STATS_H
+#define SEARCH_STATS_H
+
+// Counters describing how much work each search thread has done.
+// Every thread counts into its own slot, so bumping them needs no synchronization.
+struct SearchStats {
+	long dives;				// Branches started by calculateOrder
+	long nodesExpanded;		// Nodes whose legal moves were generated
+	long legalMovesGenerated;	// Legal moves inserted into a node's move list
+	long stateOKCalls;
+	long stateOKRejections;	// stateOK calls which found the remaining recipes can no longer be made
+	long optimizeRoadmapCalls;
+	long recordsFound;		// Roadmaps that beat the local record
+	long allocations;		// Heap allocations made while searching (nodes, move data, legal move arrays)
+};
+
+// Point in time values describing what each search thread is doing right now.
+struct SearchGauges {
+	long depth;				// Step index of the node most recently expanded
+	long iterationLimit;	// Iteration limit of the current dive
+	long liveNodes;			// Search nodes allocated and not yet freed by this thread
+};
+
+// Slots live in one shared array so the stats reporter can read them.
+// Each one is aligned (and therefore padded) to a cache line, so threads
+// bumping their own counters never invalidate each other's cache lines.
+#define SEARCH_STATS_CACHE_LINE 64
+
+struct SearchStatsSlot {
+	_Alignas(SEARCH_STATS_CACHE_LINE) struct SearchStats stats;
+	struct SearchGauges gauges;
+};
+
+// The calling thread's slot. Threads that never bind a slot share a throwaway one.
+extern struct SearchStatsSlot *threadSearchStatsSlot;
+#pragma omp threadprivate(threadSearchStatsSlot)
+
+#define COUNT_SEARCH_STAT(field) COUNT_SLOT_STAT(threadSearchStatsSlot, field)
+#define COUNT_SEARCH_STATS(field, amount) (threadSearchStatsSlot->stats.field += (amount))
+#define SET_SEARCH_GAUGE(field, value) SET_SLOT_GAUGE(threadSearchStatsSlot, field, value)
+#define ADJUST_SEARCH_GAUGE(field, amount) (threadSearchStatsSlot->gauges.field += (amount))
+// The same, for code which already holds its slot (e.g. through a SearchContext)
+#define COUNT_SLOT_STAT(slot, field) (++(slot)->stats.field)
+#define SET_SLOT_GAUGE(slot, field, value) ((slot)->gauges.field = (value))
+#define ADJUST_SLOT_GAUGE(slot, field, amount) ((slot)->gauges.field += (amount))
+
+// Allocate (zeroed) slots for rawIDs 0 to numThreads - 1. Must be called before any thread binds a slot.
+void initSearchStats(int numThreads);
+// Point the calling thread's counters at the slot for rawID.
+void bindSearchStatsSlot(int rawID);
+int getSearchStatsSlotCount();
+// Copy the counters of one slot. Safe to call from any thread while the search is running;
+// the values may be a few increments stale, but each counter is never torn.
+void readSearchStats(int rawID, struct SearchStats *dest);
+void readSearchGauges(int rawID, struct SearchGauges *dest);
+// Sum every slot into dest.
+void readTotalSearchStats(struct SearchStats *dest);
+void freeSearchStats();
+
+#endif
@@ -0,0 +1,343 @@
+#include "shared_record.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include "base.h"
+#include "logger.h"
+#include "start.h"
+#include "thread_local_random.h"
+#if !_CIPES_IS_WINDOWS
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#define SHARED_RECORD_MAGIC 0x53504943u	// "CIPS"
+// Bump whenever the layout or the meaning of anything in the segment changes
+#define SHARED_RECORD_VERSION 1
+#define SHARED_RECORD_MAX_NAME 100
+#define SHARED_RECORD_POLL_MS 10
+
+// Every field is only changed with __atomic builtins, which work between processes as long as
+// they are lock-free, since no lock lives in the segment.
+_CIPES_STATIC_ASSERT(__atomic_always_lock_free(sizeof(int), 0), "ints must be lock-free to share them between processes");
+_CIPES_STATIC_ASSERT(__atomic_always_lock_free(sizeof(unsigned int), 0), "ints must be lock-free to share them between processes");
+
+// A seqlock: sequence is odd while a process rewrites the roadmap, and a reader
+// only trusts its copy if sequence was even and unchanged from before to after.
+struct SharedElite {
+	unsigned int sequence;
+	int frames;
+	int numMoves;			// 0 while the entry is empty
+	struct ReplayMove moves[REPLAY_MAX_MOVES];
+};
+
+struct SharedRecordSegment {
+	unsigned int magic;		// Stored last by the process that created the segment
+	unsigned int version;
+	unsigned int segmentSize;
+	unsigned int replayMoveSize;
+	int record;
+	struct SharedElite elites[SHARED_ELITE_SIZE];
+};
+
+static struct SharedRecordSegment *segment = NULL;
+static int segmentFd = -1;
+
+#if !_CIPES_IS_WINDOWS
+static void sleepMillis(int millis) {
+	struct timespec delay = { millis / 1000, (millis % 1000) * 1000000L };
+	nanosleep(&delay, NULL);
+}
+
+static void logSharedError(const char *what, const char *name) {
+	char message[250];
+	snprintf(message, sizeof(message), "%s %s: %s. Carrying on without sharing the record.", what, name, strerror(errno));
+	recipeLog(1, "Shared", "Record", "Error", message);
+}
+
+// A process that just created the segment may not have sized it yet
+static bool waitForSegmentSize(int fd, const char *name) {
+	for (int waited = 0; waited <= SHARED_RECORD_SETUP_WAIT_MS; waited += SHARED_RECORD_POLL_MS) {
+		struct stat info;
+		if (fstat(fd, &info) != 0) {
+			logSharedError("Unable to check the size of", name);
+			return false;
+		}
+		if (info.st_size == sizeof(struct SharedRecordSegment)) {
+			return true;
+		}
+		if (info.st_size != 0) {
+			break;
+		}
+		sleepMillis(SHARED_RECORD_POLL_MS);
+	}
+	char message[250];
+	snprintf(message, sizeof(message), "%s was made by an incompatible build, or never set up. Carrying on without sharing the record.", name);
+	recipeLog(1, "Shared", "Record", "Error", message);
+	return false;
+}
+
+static bool waitForSegmentSetup(const char *name) {
+	for (int waited = 0; waited <= SHARED_RECORD_SETUP_WAIT_MS; waited += SHARED_RECORD_POLL_MS) {
+		if (__atomic_load_n(&segment->magic, __ATOMIC_ACQUIRE) == SHARED_RECORD_MAGIC) {
+			break;
+		}
+		sleepMillis(SHARED_RECORD_POLL_MS);
+	}
+	if (__atomic_load_n(&segment->magic, __ATOMIC_ACQUIRE) != SHARED_RECORD_MAGIC
+		|| segment->version != SHARED_RECORD_VERSION
+		|| segment->segmentSize != sizeof(struct SharedRecordSegment)
+		|| segment->replayMoveSize != sizeof(struct ReplayMove)) {
+		char message[250];
+		snprintf(message, sizeof(message), "%s was made by an incompatible build, or never set up. Carrying on without sharing the record.", name);
+		recipeLog(1, "Shared", "Record", "Error", message);
+		return false;
+	}
+	return true;
+}
+#endif
+
+/*-------------------------------------------------------------------
+ * Function 	: attachSharedRecord
+ * Inputs	: const char	*name
+ *		  int		localRecord
+ * Outputs	: bool		attached
+ *
+ * The first process to open name creates the segment and sets it up,
+ * publishing the magic number last. Others wait for that, then check
+ * the layout matches their build before using it.
+ -------------------------------------------------------------------*/
+bool attachSharedRecord(const char *name, int localRecord) {
+	if (name == NULL || name[0] == '\0') {
+		return false;
+	}
+#if _CIPES_IS_WINDOWS
+	recipeLog(2, "Shared", "Record", "Error", "Sharing the record between processes is not supported on Windows.");
+	return false;
+#else
+	if (name[0] != '/' || strchr(name + 1, '/') != NULL || strlen(name) > SHARED_RECORD_MAX_NAME) {
+		recipeLog(1, "Shared", "Record", "Error", "sharedRecordName must start with '/', have no other '/' and be at most 100 characters. Carrying on without sharing the record.");
+		return false;
+	}
+
+	bool created = true;
+	int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (fd < 0 && errno == EEXIST) {
+		created = false;
+		fd = shm_open(name, O_RDWR, 0);
+	}
+	if (fd < 0) {
+		logSharedError("Unable to open shared memory", name);
+		return false;
+	}
+	if (created && ftruncate(fd, sizeof(struct SharedRecordSegment)) != 0) {
+		logSharedError("Unable to size shared memory", name);
+		close(fd);
+		shm_unlink(name);
+		return false;
+	}
+	if (!created && !waitForSegmentSize(fd, name)) {
+		close(fd);
+		return false;
+	}
+	void *mapped = mmap(NULL, sizeof(struct SharedRecordSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (mapped == MAP_FAILED) {
+		logSharedError("Unable to map shared memory", name);
+		close(fd);
+		return false;
+	}
+	segment = mapped;
+	segmentFd = fd;
+
+	if (created) {
+		// ftruncate zero filled the rest, which leaves every elite entry empty
+		segment->version = SHARED_RECORD_VERSION;
+		segment->segmentSize = sizeof(struct SharedRecordSegment);
+		segment->replayMoveSize = sizeof(struct ReplayMove);
+		segment->record = UNSET_FRAME_RECORD;
+		__atomic_store_n(&segment->magic, SHARED_RECORD_MAGIC, __ATOMIC_RELEASE);
+	}
+	else if (!waitForSegmentSetup(name)) {
+		detachSharedRecord();
+		return false;
+	}
+
+	if (localRecord >= 0) {
+		lowerSharedRecord(localRecord);
+	}
+	char message[250];
+	snprintf(message, sizeof(message), "Sharing the record with other processes through %s (%s). The record is %d frames.",
+		name, created ? "created" : "already there", getSharedRecord());
+	recipeLog(2, "Shared", "Record", "Attached", message);
+	return true;
+#endif
+}
+
+void detachSharedRecord() {
+#if !_CIPES_IS_WINDOWS
+	if (segment != NULL) {
+		munmap(segment, sizeof(struct SharedRecordSegment));
+		close(segmentFd);
+	}
+#endif
+	segment = NULL;
+	segmentFd = -1;
+}
+
+bool isSharedRecordAttached() {
+	return segment != NULL;
+}
+
+const int *getSharedRecordAddress() {
+	return segment != NULL ? &segment->record : NULL;
+}
+
+int getSharedRecord() {
+	return __atomic_load_n(&segment->record, __ATOMIC_ACQUIRE);
+}
+
+bool lowerSharedRecord(int frames) {
+	int current = __atomic_load_n(&segment->record, __ATOMIC_ACQUIRE);
+	while (frames < current) {
+		// On failure, current is reloaded with what another process stored
+		if (__atomic_compare_exchange_n(&segment->record, &current, frames, true, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// flock belongs to the open file, so threads of this process don't exclude each other
+bool lockSharedRecordFile() {
+#if _CIPES_IS_WINDOWS
+	return false;
+#else
+	if (segment == NULL) {
+		return false;
+	}
+	while (flock(segmentFd, LOCK_EX) != 0) {
+		if (errno != EINTR) {
+			return false;
+		}
+	}
+	return true;
+#endif
+}
+
+void unlockSharedRecordFile() {
+#if !_CIPES_IS_WINDOWS
+	flock(segmentFd, LOCK_UN);
+#endif
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: readSharedElite
+ * Inputs	: int			index
+ *		  struct ReplayMove	*moves
+ *		  int			*frames
+ *		  unsigned int		*sequence
+ * Outputs	: int			numMoves
+ *
+ * Copy an elite entry, retrying if a process rewrites it meanwhile.
+ * Returns 0 for an empty entry, or -1 if no clean copy could be made.
+ * *sequence is the version that was copied.
+ -------------------------------------------------------------------*/
+static int readSharedElite(int index, struct ReplayMove *moves, int *frames, unsigned int *sequence) {
+	struct SharedElite *elite = &segment->elites[index];
+	for (int attempt = 0; attempt < SHARED_ELITE_READ_RETRIES; ++attempt) {
+		const unsigned int before = __atomic_load_n(&elite->sequence, __ATOMIC_ACQUIRE);
+		if (before & 1) {
+			continue;
+		}
+		int numMoves = __atomic_load_n(&elite->numMoves, __ATOMIC_RELAXED);
+		*frames = __atomic_load_n(&elite->frames, __ATOMIC_RELAXED);
+		if (numMoves < 0 || numMoves > REPLAY_MAX_MOVES) {
+			continue;
+		}
+		memcpy(moves, elite->moves, sizeof(moves[0]) * numMoves);
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&elite->sequence, __ATOMIC_RELAXED) == before) {
+			*sequence = before;
+			return numMoves;
+		}
+	}
+	return -1;
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: offerSharedElite
+ * Inputs	: struct ReplayMove	*moves
+ *		  int			numMoves
+ *		  int			frames
+ *
+ * Replace an empty entry, or else the slowest one if the roadmap beats
+ * it. The entry is claimed by swapping its sequence from the version
+ * that was compared against, so if another process replaced it since,
+ * this offer is dropped rather than overwrite a faster roadmap.
+ -------------------------------------------------------------------*/
+void offerSharedElite(const struct ReplayMove *moves, int numMoves, int frames) {
+	if (segment == NULL || numMoves <= 0 || numMoves > REPLAY_MAX_MOVES) {
+		return;
+	}
+	struct ReplayMove existing[REPLAY_MAX_MOVES];
+	int victim = -1;
+	int victimFrames = frames;
+	unsigned int victimSequence = 0;
+	for (int i = 0; i < SHARED_ELITE_SIZE; ++i) {
+		int existingFrames;
+		unsigned int sequence;
+		const int existingMoves = readSharedElite(i, existing, &existingFrames, &sequence);
+		if (existingMoves < 0) {
+			continue;
+		}
+		if (existingMoves == 0) {
+			existingFrames = INT_MAX;
+		}
+		else if (existingFrames == frames && existingMoves == numMoves
+			&& memcmp(existing, moves, sizeof(moves[0]) * numMoves) == 0) {
+			return;
+		}
+		if (existingFrames > victimFrames) {
+			victim = i;
+			victimFrames = existingFrames;
+			victimSequence = sequence;
+		}
+	}
+	if (victim < 0) {
+		return;
+	}
+
+	struct SharedElite *elite = &segment->elites[victim];
+	unsigned int expected = victimSequence;
+	if (!__atomic_compare_exchange_n(&elite->sequence, &expected, victimSequence + 1, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+		return;
+	}
+	__atomic_store_n(&elite->frames, frames, __ATOMIC_RELAXED);
+	__atomic_store_n(&elite->numMoves, numMoves, __ATOMIC_RELAXED);
+	memcpy(elite->moves, moves, sizeof(moves[0]) * numMoves);
+	__atomic_store_n(&elite->sequence, victimSequence + 2, __ATOMIC_RELEASE);
+}
+
+int copySharedElite(struct SearchContext *ctx, struct ReplayMove *moves) {
+	if (segment == NULL) {
+		return -1;
+	}
+	// Start from a random entry, so the processes don't all warm-start from the same roadmap
+	const int start = random_state_randint(&ctx->random, 0, SHARED_ELITE_SIZE);
+	for (int i = 0; i < SHARED_ELITE_SIZE; ++i) {
+		int frames;
+		unsigned int sequence;
+		const int numMoves = readSharedElite((start + i) % SHARED_ELITE_SIZE, moves, &frames, &sequence);
+		if (numMoves > 0) {
+			return numMoves;
+		}
+	}
+	return -1;
+}
@@ -0,0 +1,44 @@
+#ifndef CIPES_SHARED_RECORD_H
+#define CIPES_SHARED_RECORD_H
+
+#include <stdbool.h>
+#include "path_replay.h"
+
+// A POSIX shared memory segment holding the record and a few of the fastest roadmaps,
+// so every recipesAtHome process on a host prunes against the same record and can
+// warm-start from roadmaps the others found. It is only changed with atomic
+// compare-and-swap, so no process ever waits on another, even one that was killed.
+// The segment outlives the processes using it; remove /dev/shm/<name> to forget it.
+
+#define SHARED_ELITE_SIZE 8
+// How long to wait for another process to finish setting up a segment it just created
+#define SHARED_RECORD_SETUP_WAIT_MS 1000
+// How many times a reader retries an elite roadmap that is being rewritten before skipping it
+#define SHARED_ELITE_READ_RETRIES 4
+
+// Map the segment named name (e.g. "/recipesAtHome"), creating it if this is the first process,
+// and lower its record to localRecord. Returns false, and leaves this process on its own,
+// if name is NULL or empty, or the segment can't be used.
+bool attachSharedRecord(const char *name, int localRecord);
+// Unmap the segment. Everything below goes back to doing nothing.
+void detachSharedRecord();
+bool isSharedRecordAttached();
+
+// The record field of the segment, for the search to read directly. NULL if not attached.
+const int *getSharedRecordAddress();
+int getSharedRecord();
+// Lower the shared record to frames. Returns false if some process already has a record that fast.
+bool lowerSharedRecord(int frames);
+
+// Hold an exclusive lock shared by every process on the segment, e.g. while results/PB.txt is rewritten.
+// Returns false, without locking, if not attached. The lock is dropped if the process dies.
+bool lockSharedRecordFile();
+void unlockSharedRecordFile();
+
+// Copy a roadmap into the shared elite table if it beats the slowest one there.
+void offerSharedElite(const struct ReplayMove *moves, int numMoves, int frames);
+// Copy the moves of a random shared elite roadmap, picked with ctx's generator, into moves
+// (room for REPLAY_MAX_MOVES). Returns its number of moves, or -1 if there is none to copy.
+int copySharedElite(struct SearchContext *ctx, struct ReplayMove *moves);
+
+#endif
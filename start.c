@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <omp.h>
 #include <libconfig.h>
 #include "base.h"
@@ -13,6 +14,22 @@
 #include "config.h"
 #include "recipes.h"
 #include "FTPManagement.h"
+#include "submission_spool.h"
+#include "roadmap_binary.h"
+#include "benchmark.h"
+#include "checkpoint.h"
+#include "cluster_client.h"
+#include "coordinator.h"
+#include "metrics_server.h"
+#include "microbench.h"
+#include "roadmap_verify.h"
+#include "roadmap_optimizer.h"
+#include "search_stats.h"
+#include "shared_record.h"
+#include "stats_reporter.h"
+#include "thread_affinity.h"
+#include "thread_pool.h"
+#include "worker_manager.h"
 #include "start.h"
 #include "calculator.h"
 #include <time.h>
@@ -33,17 +50,30 @@
 #include <errno.h>
 #include <string.h>
 #endif
+#if !_CIPES_IS_WINDOWS
+#include <sys/utsname.h>
+#endif
 #if _CIPES_IS_WINDOWS
 #include <direct.h>
+#include <process.h>
 #endif
+#include <inttypes.h>
 
 #define WAIT_TIME_BEFORE_CONTINUE_ON_FAILED_UPDATE_CHECK_SECS 10
 
 int current_frame_record;
 const char *local_ver;
+// Command line limits on each search job: calculateOrder cycles, and dives per cycle (-1 for no limit)
+static int searchMaxOuterLoops = -1;
+static long searchMaxBranches = -1;
+// One per search worker, indexed by workerID, and only used on that worker's thread
+static struct SearchContext *searchContexts = NULL;
 
 // May get a value <0 if local record was corrupt.
 int getLocalRecord() {
+	if (isSharedRecordAttached()) {
+		return getSharedRecord();
+	}
 	int current_frame_record_orig = current_frame_record;
 	if (ABSL_PREDICT_FALSE(current_frame_record < 0)) {
 		printf("Current frame record is corrupt (less then 0 frames). Resetting (you may get false PBs for a while).\n");
@@ -57,8 +87,35 @@ void setLocalRecord(int frames) {
 		printf("Got corrupt PB if %d frames. Ignoring\n", frames);
 		return;
 	}
+	if (isSharedRecordAttached()) {
+		// Other processes may have a faster record, which must never be raised
+		lowerSharedRecord(frames);
+		return;
+	}
 	current_frame_record = frames;
 }
+bool lowerLocalRecord(int frames) {
+	if (ABSL_PREDICT_FALSE(frames < 0)) {
+		printf("Got corrupt PB if %d frames. Ignoring\n", frames);
+		return false;
+	}
+	if (isSharedRecordAttached()) {
+		return lowerSharedRecord(frames);
+	}
+	bool lowered;
+	#pragma omp critical(local_record)
+	{
+		lowered = frames < current_frame_record;
+		if (lowered) {
+			current_frame_record = frames;
+		}
+	}
+	return lowered;
+}
+// Searches read the record through this, so once attached they prune against the shared one.
+const int *getLocalRecordAddress() {
+	return isSharedRecordAttached() ? getSharedRecordAddress() : &current_frame_record;
+}
 
 const char *getLocalVersion() {
 	return local_ver;
@@ -85,6 +142,10 @@ void handleTermSignal(int signum) {
 	countAndSetShutdown(true);
 }
 
+void handleReloadSignal(int signum) {
+	requestWorkerCountReload();
+}
+
 void handleAbrtSignal(int signum) {
 	// First off, reset our signal handler to default in case we encounter another signal in trying to print out debugging info, we don't loop.
 	signal(signum, SIG_DFL);
@@ -129,6 +190,9 @@ void setSignalHandlers() {
 #ifdef SIGQUIT
 	signal(SIGQUIT, handleAbrtSignal);
 #endif
+#ifdef SIGHUP
+	signal(SIGHUP, handleReloadSignal);
+#endif
 #ifdef SIGSYS
 	signal(SIGSYS, handleAbrtSignal);
 #endif
@@ -139,8 +203,154 @@ void setSignalHandlers() {
 #endif
 }
 
+/*-------------------------------------------------------------------
+ * Function 	: convertRoadmapMain
+ * Inputs	: int	argc
+ *		  char	**argv
+ * Outputs	: int	exit code
+ *
+ * recipesAtHome --convert-roadmap <roadmap.bin> <roadmap.txt>
+ * Turn a binary roadmap back into the text layout used for submissions.
+ -------------------------------------------------------------------*/
+int convertRoadmapMain(int argc, char **argv) {
+	if (argc != 4) {
+		printf("Usage: %s --convert-roadmap <roadmap.bin> <roadmap.txt>\n", argv[0]);
+		return 1;
+	}
+	initializeRecipeList();
+	if (!convertBinaryRoadmapToText(argv[2], argv[3])) {
+		printf("Could not read %s as a binary roadmap.\n", argv[2]);
+		return 1;
+	}
+	return 0;
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: chooseMasterSeed
+ * Outputs	: uint64_t	seed
+ *
+ * Use randomSeed from config.txt when it is set, to repeat an earlier
+ * run, or else the seed a coordinator handed out. Otherwise mix the
+ * time with the process ID and host name, so processes started in the
+ * same second, on one host or across many, never search the same streams.
+ -------------------------------------------------------------------*/
+uint64_t chooseMasterSeed() {
+	const char *configured = getConfigStr("randomSeed");
+	if (configured != NULL && configured[0] != '\0') {
+		char *end;
+		const uint64_t seed = strtoull(configured, &end, 0);
+		if (*end == '\0') {
+			return seed;
+		}
+		printf("randomSeed \"%s\" is not a number. Picking a new seed instead.\n", configured);
+	}
+	uint64_t clusterSeed;
+	if (getClusterSeed(&clusterSeed)) {
+		return clusterSeed;
+	}
+
+#if _CIPES_IS_WINDOWS
+	const char *hostName = getenv("COMPUTERNAME");
+	const uint64_t processID = (uint64_t)_getpid();
+#else
+	struct utsname host;
+	const char *hostName = uname(&host) == 0 ? host.nodename : NULL;
+	const uint64_t processID = (uint64_t)getpid();
+#endif
+	// FNV-1a of the host name
+	uint64_t hostHash = UINT64_C(0xcbf29ce484222325);
+	for (const char *c = hostName; c != NULL && *c != '\0'; ++c) {
+		hostHash = (hostHash ^ (unsigned char)*c) * UINT64_C(0x100000001b3);
+	}
+
+	// One splitmix64 round per input, so nearby times and process IDs give unrelated seeds
+	uint64_t seed = (uint64_t)time(NULL);
+	const uint64_t salts[] = { processID, hostHash };
+	for (int i = 0; i < 2; ++i) {
+		seed += UINT64_C(0x9E3779B97F4A7C15);
+		seed = (seed ^ (seed >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+		seed = (seed ^ (seed >> 27)) * UINT64_C(0x94D049BB133111EB);
+		seed ^= (seed >> 31) ^ salts[i];
+	}
+	return seed;
+}
+
+static void startSearchWorker(struct WorkerContext *worker) {
+	// Pin before the first dive, so this thread's search nodes are placed in its own NUMA node's memory
+	pinThreadToPlannedCpu(worker->workerID);
+	bindSearchStatsSlot(worker->workerID);
+
+#pragma omp critical(printing_on_failure)
+	{
+		printf("[Thread %d/%d][Started]\n", worker->workerID + 1, getActiveWorkerCount());
+	}
+
+	// The select and randomise config options draw from the context's own generator, seeded with
+	// stream workerID. The thread's generator is seeded too, for anything else run on this thread.
+	threadlocal_srand_stream(worker->workerID);
+	initSearchContext(&searchContexts[worker->workerID], worker->workerID);
+}
+
+static void stopSearchWorker(struct WorkerContext *worker) {
+#pragma omp critical(printing_on_failure)
+	{
+		printf("[Thread %d/%d][Done]\n", worker->workerID + 1, getActiveWorkerCount());
+	}
+	threadlocal_rand_destroy();
+}
+
+static void startServiceWorker(struct WorkerContext *worker) {
+	// The local search draws random numbers on this thread, from the streams after the search threads'
+	threadlocal_srand_stream(getWorkerPoolSize() + worker->workerID);
+}
+
+static void stopServiceWorker(struct WorkerContext *worker) {
+	threadlocal_rand_destroy();
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: runSearchCycle
+ * Inputs	: struct WorkerContext	*worker
+ *		  long			*cycleCount
+ *
+ * One cycle of the search: calculateOrder on the worker's rawID until it
+ * finds a record, or has run max_branches dives. The job then queues its
+ * next cycle behind any other search job waiting for a worker.
+ -------------------------------------------------------------------*/
+static void runSearchCycle(struct WorkerContext *worker, void *arg) {
+	long *cycleCount = arg;
+	++*cycleCount;
+	struct Result result = calculateOrder(&searchContexts[worker->workerID], searchMaxBranches);
+
+	// result might store -1 frames for errors that might be recoverable
+	if (result.frames > -1) {
+		spoolSubmission(result.frames);
+	}
+
+	if (askedToShutdown() || (searchMaxOuterLoops >= 0 && *cycleCount >= searchMaxOuterLoops)
+		|| !submitJob(JOB_CLASS_SEARCH, runSearchCycle, cycleCount)) {
+		free(cycleCount);
+	}
+}
+
 int main(int argc, char **argv) {
 
+	if (argc >= 2 && strcmp(argv[1], "--convert-roadmap") == 0) {
+		return convertRoadmapMain(argc, argv);
+	}
+	if (argc >= 2 && strcmp(argv[1], "--bench") == 0) {
+		return benchmarkMain(argc, argv);
+	}
+	if (argc >= 2 && strcmp(argv[1], "--microbench") == 0) {
+		return microbenchMain(argc, argv);
+	}
+	if (argc >= 2 && strcmp(argv[1], "--verify") == 0) {
+		return verifyMain(argc, argv);
+	}
+	if (argc >= 2 && strcmp(argv[1], "--coordinator") == 0) {
+		return coordinatorMain(argc, argv);
+	}
+
 	int max_outer_loops = -1;
 	long max_branches = -1;
 	if (argc >= 2) {
@@ -158,11 +368,15 @@ int main(int argc, char **argv) {
 
 	// If select and randomise are both 0, the same roadmap will be calculated on every thread, so set threads = 1
 	// The debug setting can only be meaningfully used with one thread as well.
-	int workerCount = (getConfigInt("select") || getConfigInt("randomise"))
-					  && !getConfigInt("debug") ? getConfigInt("workerCount") : 1;
+	const bool canScaleWorkers = (getConfigInt("select") || getConfigInt("randomise")) && !getConfigInt("debug");
+	int workerCount = canScaleWorkers ? getConfigInt("workerCount") : 1;
 
-	// Create workerCount threads
-	omp_set_num_threads(workerCount);
+	// Create enough threads that workerCount can later be raised to maxWorkerCount (by default one per CPU)
+	// without a restart. Those beyond workerCount park until they are needed.
+	// A run limited to max_outer_loops cycles per thread keeps exactly workerCount threads, as a parked
+	// thread would never finish its cycles.
+	const int maxWorkerCount = getConfigInt("maxWorkerCount") > 0 ? getConfigInt("maxWorkerCount") : omp_get_num_procs();
+	const int poolSize = canScaleWorkers && max_outer_loops < 0 ? MAX(workerCount, maxWorkerCount) : workerCount;
 
 	prepareStackTraces();
 
@@ -227,6 +441,8 @@ int main(int argc, char **argv) {
 #else
 	mkdir("./results", 0777);
 #endif
+	initSubmissionSpool();
+	initCheckpoints();
 
 	// To avoid generating roadmaps that are slower than the user's record best,
 	// use PB.txt to identify the user's current best
@@ -240,10 +456,11 @@ int main(int argc, char **argv) {
 				printf("PB.txt is corrupted (PB record less then 0 frames). Ignoring.\n");
 			} else {
 				current_frame_record = PB_record;
+				setSavedPbRecord(PB_record);
 				if (current_frame_record < UNSET_FRAME_RECORD) {
 					printf("Your current PB is %d frames.\n", current_frame_record);
 				}
-				testRecord(current_frame_record);
+				spoolSubmission(current_frame_record);
 			}
 		}
 		fclose(fp);
@@ -257,46 +474,76 @@ int main(int argc, char **argv) {
 	// persist through all parallel calls to calculator.c
 	initializeInvFrames();
 	initializeRecipeList();
+	initializeSoftMin(getConfigInt("softMin") ? getConfigInt("softMinTemperature") : 0);
+	initSearchStats(poolSize);
+	initRoadmapOptimizer(poolSize);
+	initThreadAffinity(getConfigStr("threadAffinity"), poolSize);
+	initWorkerManager(poolSize, workerCount);
+	// Before any search context binds to the record, so they all prune against the shared one
+	attachSharedRecord(getConfigStr("sharedRecordName"), current_frame_record);
+	// Before the seed is chosen, as the coordinator hands each worker its own
+	startClusterClient(getConfigStr("coordinatorAddress"));
+
+	threadlocal_set_master_seed(chooseMasterSeed());
+	char seedMessage[100];
+	sprintf(seedMessage, "Random seed: %" PRIu64, threadlocal_get_master_seed());
+	recipeLog(1, "Startup", "Random", "Seed", seedMessage);
 
 	setSignalHandlers();
 
-	// copying to const so OpenMP knows it doesn't have to have each thread
-	// recheck this.
-	const int max_outer_loops_fixed = max_outer_loops;
-	const long max_branches_fixed = max_branches;
-
-	#pragma omp parallel
-	{
-		long cycle_count = 0;
-		int rawID = omp_get_thread_num();
-		int displayID = rawID + 1;
-
-#pragma omp critical(printing_on_failure)
-		{
-			printf("[Thread %d/%d][Started]\n", displayID, workerCount);
-		}
-
-		// Seed each thread's PRNG for the select and randomise config options
-		threadlocal_srand(((int)time(NULL)) ^ rawID);
-
-		while (max_outer_loops_fixed < 0 || cycle_count < max_outer_loops_fixed) {
-			if (askedToShutdown()) {
-				break;
-			}
-			++cycle_count;
-			struct Result result = calculateOrder(rawID, max_branches_fixed);
+	searchMaxOuterLoops = max_outer_loops;
+	searchMaxBranches = max_branches;
+
+	// One search worker per search thread, each taking the next calculateOrder cycle from the queue.
+	// One service worker optimizes finished roadmaps, as the optimizer mailboxes only have room for
+	// one roadmap being optimized at a time.
+	initJobClass(JOB_CLASS_SEARCH, poolSize, poolSize, startSearchWorker, stopSearchWorker);
+	searchContexts = calloc(poolSize, sizeof(struct SearchContext));
+	checkMallocFailed(searchContexts);
+	initJobClass(JOB_CLASS_SERVICE, 1, OPTIMIZER_QUEUE_SIZE, startServiceWorker, stopServiceWorker);
+
+	// Submissions (including anything left over from previous runs) are
+	// handled on their own thread, so search threads never block on the network.
+	startSubmissionWorker();
+	startStatsReporter(getConfigInt("statsSnapshotInterval"));
+	startMetricsServer(getConfigStr("metricsSocket"));
+	if (!startThreadPool()) {
+		recipeLog(1, "Startup", "Pool", "Error", "Unable to start the worker threads.");
+	}
+	// Finished roadmaps are optimized by the service worker, so search threads never wait for optimizeRoadmap.
+	startRoadmapOptimizer();
+	// workerCount is re-read whenever config.txt changes, to start or park threads while running
+	if (searchMaxOuterLoops < 0) {
+		startWorkerManager();
+	}
 
-			// result might store -1 frames for errors that might be recoverable
-			if (result.frames > -1) {
-				testRecord(result.frames);
+	// Every search thread gets one search job. Each job queues the next cycle itself as it finishes,
+	// until it has run max_outer_loops of them or a shutdown is asked for.
+	if (searchMaxOuterLoops != 0) {
+		for (int i = 0; i < poolSize; ++i) {
+			long *cycleCount = malloc(sizeof(long));
+			checkMallocFailed(cycleCount);
+			*cycleCount = 0;
+			if (!submitJob(JOB_CLASS_SEARCH, runSearchCycle, cycleCount)) {
+				free(cycleCount);
 			}
 		}
-#pragma omp critical(printing_on_failure)
-		{
-			printf("[Thread %d/%d][Done]\n", displayID, workerCount);
-		}
-		threadlocal_rand_destroy();
 	}
+	waitForJobClass(JOB_CLASS_SEARCH);
+
+	stopWorkerManager();
+	stopRoadmapOptimizer();
+	stopThreadPool();
+	stopMetricsServer();
+	stopClusterClient();
+	stopStatsReporter();
+	stopSubmissionWorker();
+	curl_global_cleanup();
+	freeRoadmapOptimizer();
+	freeThreadPool();
+	free(searchContexts);
+	freeSearchStats();
+	detachSharedRecord();
 
 	return 0;
 }
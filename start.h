@@ -1,6 +1,7 @@
 #ifndef START_H
 #define START_H
 
+#include <stdint.h>
 #include "inventory.h"
 #include "recipes.h"
 #include "config.h"
@@ -17,7 +18,15 @@ struct Result {
 // May get a value <0 if local record was corrupt.
 int getLocalRecord();
 void setLocalRecord(int frames);
+// Lower the record to frames, returning false if it was already that fast.
+// Safe to race with other threads, and with other processes sharing the record.
+bool lowerLocalRecord(int frames);
+// Where the local record lives, for a SearchContext to read it without a call
+const int *getLocalRecordAddress();
 const char* getLocalVersion();
+// The seed every thread's random stream is jumped ahead from, as logged at startup
+uint64_t chooseMasterSeed();
+void setSignalHandlers();
 
 int main(int argc, char **argv); // Main method for entire algorithm
 
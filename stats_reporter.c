@@ -0,0 +1,199 @@
+#include "stats_reporter.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <time.h>
+#include <pthread.h>
+#include <omp.h>
+#include "base.h"
+#include "atomic_file.h"
+#include "cJSON.h"
+#include "logger.h"
+#include "search_stats.h"
+#include "start.h"
+#include "thread_affinity.h"
+#include "thread_pool.h"
+#include "worker_manager.h"
+
+static const struct {
+	const char *name;
+	size_t offset;
+} statFields[] = {
+	{ "dives", offsetof(struct SearchStats, dives) },
+	{ "nodesExpanded", offsetof(struct SearchStats, nodesExpanded) },
+	{ "legalMovesGenerated", offsetof(struct SearchStats, legalMovesGenerated) },
+	{ "stateOKCalls", offsetof(struct SearchStats, stateOKCalls) },
+	{ "stateOKRejections", offsetof(struct SearchStats, stateOKRejections) },
+	{ "optimizeRoadmapCalls", offsetof(struct SearchStats, optimizeRoadmapCalls) },
+	{ "recordsFound", offsetof(struct SearchStats, recordsFound) },
+	{ "allocations", offsetof(struct SearchStats, allocations) },
+};
+#define NUM_STAT_FIELDS (sizeof(statFields) / sizeof(statFields[0]))
+
+static pthread_t reporterThread;
+static pthread_mutex_t reporterLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t reporterCond = PTHREAD_COND_INITIALIZER;
+static bool reporterStopping = false;
+static bool reporterThreadStarted = false;
+static int reporterIntervalSecs;
+
+// Only touched by the reporter thread
+static double reporterStartTime;
+static double lastSnapshotTime;
+static struct SearchStats *lastSnapshotStats;	// Per thread, from the previous snapshot
+
+static long statField(const struct SearchStats *stats, size_t field) {
+	return *(const long *)((const char *)stats + statFields[field].offset);
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: addStatsToJson
+ * Inputs	: cJSON			*object
+ *		  const struct SearchStats	*current
+ *		  const struct SearchStats	*previous
+ *		  double			elapsedSecs
+ *
+ * Add every counter as "<name>", and its rate since the previous
+ * snapshot as "<name>PerSec".
+ -------------------------------------------------------------------*/
+static void addStatsToJson(cJSON *object, const struct SearchStats *current, const struct SearchStats *previous, double elapsedSecs) {
+	for (size_t i = 0; i < NUM_STAT_FIELDS; ++i) {
+		char rateName[64];
+		long value = statField(current, i);
+		double rate = elapsedSecs > 0 ? (value - statField(previous, i)) / elapsedSecs : 0.0;
+		snprintf(rateName, sizeof(rateName), "%sPerSec", statFields[i].name);
+		cJSON_AddNumberToObject(object, statFields[i].name, value);
+		cJSON_AddNumberToObject(object, rateName, rate);
+	}
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: writeStatsSnapshot
+ *
+ * Read every thread's counters and atomically replace the snapshot file.
+ -------------------------------------------------------------------*/
+static void writeStatsSnapshot() {
+	const int numThreads = getSearchStatsSlotCount();
+	const double now = omp_get_wtime();
+	const double elapsedSecs = now - lastSnapshotTime;
+
+	struct SearchStats *current = calloc(numThreads, sizeof(struct SearchStats));
+	checkMallocFailed(current);
+	struct SearchStats total = {0};
+	struct SearchStats previousTotal = {0};
+	for (int i = 0; i < numThreads; ++i) {
+		readSearchStats(i, &current[i]);
+		for (size_t field = 0; field < NUM_STAT_FIELDS; ++field) {
+			*(long *)((char *)&total + statFields[field].offset) += statField(&current[i], field);
+			*(long *)((char *)&previousTotal + statFields[field].offset) += statField(&lastSnapshotStats[i], field);
+		}
+	}
+
+	cJSON *json = cJSON_CreateObject();
+	cJSON_AddNumberToObject(json, "timestamp", (double)time(NULL));
+	cJSON_AddNumberToObject(json, "uptimeSecs", now - reporterStartTime);
+	cJSON_AddNumberToObject(json, "intervalSecs", elapsedSecs);
+	cJSON_AddNumberToObject(json, "threads", numThreads);
+	cJSON_AddNumberToObject(json, "activeThreads", getActiveWorkerCount());
+	cJSON_AddNumberToObject(json, "localRecord", getLocalRecord());
+	addStatsToJson(cJSON_AddObjectToObject(json, "total"), &total, &previousTotal, elapsedSecs);
+	cJSON *perThread = cJSON_AddArrayToObject(json, "perThread");
+	for (int i = 0; i < numThreads; ++i) {
+		cJSON *thread = cJSON_CreateObject();
+		cJSON_AddNumberToObject(thread, "thread", i + 1);
+		if (getThreadCpu(i) >= 0) {
+			cJSON_AddNumberToObject(thread, "cpu", getThreadCpu(i));
+			cJSON_AddNumberToObject(thread, "numaNode", getThreadNumaNode(i));
+		}
+		addStatsToJson(thread, &current[i], &lastSnapshotStats[i], elapsedSecs);
+		cJSON_AddItemToArray(perThread, thread);
+	}
+	cJSON *jobQueues = cJSON_AddObjectToObject(json, "jobQueues");
+	for (int c = 0; c < NUM_JOB_CLASSES; ++c) {
+		struct JobQueueStats queueStats;
+		readJobQueueStats((enum JobClass)c, &queueStats);
+		cJSON *queue = cJSON_AddObjectToObject(jobQueues, getJobClassName((enum JobClass)c));
+		cJSON_AddNumberToObject(queue, "workers", getJobClassWorkerCount((enum JobClass)c));
+		cJSON_AddNumberToObject(queue, "jobsRun", queueStats.jobsRun);
+		cJSON_AddNumberToObject(queue, "jobsQueued", queueStats.jobsQueued);
+		cJSON_AddNumberToObject(queue, "jobsRejected", queueStats.jobsRejected);
+		cJSON_AddNumberToObject(queue, "meanWaitMillis", queueStats.jobsRun > 0 ? 1000.0 * queueStats.totalWaitSecs / queueStats.jobsRun : 0.0);
+		cJSON_AddNumberToObject(queue, "maxWaitMillis", 1000.0 * queueStats.maxWaitSecs);
+		cJSON_AddNumberToObject(queue, "busySecs", queueStats.busySecs);
+	}
+
+	char *text = cJSON_Print(json);
+	if (text == NULL || !atomicWriteString(STATS_SNAPSHOT_FILE, text)) {
+		recipeLog(5, "Stats", "Snapshot", "Error", "Unable to write " STATS_SNAPSHOT_FILE);
+	}
+	free(text);
+	cJSON_Delete(json);
+
+	free(lastSnapshotStats);
+	lastSnapshotStats = current;
+	lastSnapshotTime = now;
+}
+
+static void *reporterThreadMain(void *unused) {
+	bool stopping = false;
+	while (!stopping) {
+		pthread_mutex_lock(&reporterLock);
+		if (!reporterStopping) {
+			struct timespec deadline;
+			clock_gettime(CLOCK_REALTIME, &deadline);
+			deadline.tv_sec += reporterIntervalSecs;
+			pthread_cond_timedwait(&reporterCond, &reporterLock, &deadline);
+		}
+		stopping = reporterStopping;
+		pthread_mutex_unlock(&reporterLock);
+
+		writeStatsSnapshot();
+	}
+	return NULL;
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: startStatsReporter
+ * Inputs	: int	intervalSecs
+ *
+ * Start the thread which periodically writes STATS_SNAPSHOT_FILE.
+ -------------------------------------------------------------------*/
+void startStatsReporter(int intervalSecs) {
+	if (intervalSecs <= 0) {
+		return;
+	}
+	reporterIntervalSecs = intervalSecs;
+	reporterStopping = false;
+	reporterStartTime = omp_get_wtime();
+	lastSnapshotTime = reporterStartTime;
+	lastSnapshotStats = calloc(getSearchStatsSlotCount(), sizeof(struct SearchStats));
+	checkMallocFailed(lastSnapshotStats);
+	if (pthread_create(&reporterThread, NULL, reporterThreadMain, NULL) != 0) {
+		recipeLog(1, "Stats", "Snapshot", "Error", "Unable to start the stats reporter thread. No stats snapshots will be written.");
+		free(lastSnapshotStats);
+		lastSnapshotStats = NULL;
+		return;
+	}
+	reporterThreadStarted = true;
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: stopStatsReporter
+ *
+ * Wake the reporter for one final snapshot, and wait for it to finish.
+ -------------------------------------------------------------------*/
+void stopStatsReporter() {
+	if (!reporterThreadStarted) {
+		return;
+	}
+	pthread_mutex_lock(&reporterLock);
+	reporterStopping = true;
+	pthread_cond_signal(&reporterCond);
+	pthread_mutex_unlock(&reporterLock);
+	pthread_join(reporterThread, NULL);
+	reporterThreadStarted = false;
+	free(lastSnapshotStats);
+	lastSnapshotStats = NULL;
+}
@@ -0,0 +1,14 @@
+#ifndef CIPES_STATS_REPORTER_H
+#define CIPES_STATS_REPORTER_H
+
+#define STATS_SNAPSHOT_FILE "results/stats.json"
+
+// Start a background thread which, every intervalSecs seconds, sums the per-thread
+// search counters and atomically rewrites STATS_SNAPSHOT_FILE with the totals,
+// per-thread values, and rates per second since the previous snapshot.
+// Does nothing if intervalSecs <= 0. initSearchStats must have been called.
+void startStatsReporter(int intervalSecs);
+// Writes one final snapshot, then stops the background thread.
+void stopStatsReporter();
+
+#endif
@@ -0,0 +1,214 @@
+#include "submission_spool.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include "base.h"
+#include "atomic_file.h"
+#include "FTPManagement.h"
+#include "logger.h"
+#if _CIPES_IS_WINDOWS
+#include <direct.h>
+#endif
+
+#define SPOOL_ENTRY_SUFFIX ".pending"
+#define SPOOL_RETRY_INTERVAL_SECS 120 // How long to wait before retrying when the server could not be reached
+#define SPOOL_MAX_ENTRIES_PER_DRAIN 256 // Anything past this will be picked up on the next drain
+
+static pthread_t submissionThread;
+static pthread_mutex_t submissionLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t submissionCond = PTHREAD_COND_INITIALIZER;
+static bool submissionPending = false;
+static bool submissionStopping = false;
+static bool submissionThreadStarted = false;
+
+/*-------------------------------------------------------------------
+ * Function 	: initSubmissionSpool
+ *
+ * Make sure the spool directory exists.
+ -------------------------------------------------------------------*/
+void initSubmissionSpool() {
+#if _CIPES_IS_WINDOWS
+	_mkdir(SUBMISSION_SPOOL_DIR);
+#else
+	mkdir(SUBMISSION_SPOOL_DIR, 0777);
+#endif
+}
+
+static void spoolEntryPath(char *dest, size_t destSize, int frames) {
+	snprintf(dest, destSize, "%s/%d%s", SUBMISSION_SPOOL_DIR, frames, SPOOL_ENTRY_SUFFIX);
+}
+
+static void notifySubmissionWorker() {
+	pthread_mutex_lock(&submissionLock);
+	submissionPending = true;
+	pthread_cond_signal(&submissionCond);
+	pthread_mutex_unlock(&submissionLock);
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: spoolSubmission
+ * Inputs	: int frames
+ * Outputs	: bool success
+ *
+ * Atomically create a spool entry for results/<frames>.txt and wake up
+ * the network thread. Spooling the same frame count twice is harmless,
+ * as the entry is keyed by frame count.
+ -------------------------------------------------------------------*/
+bool spoolSubmission(int frames) {
+	if (frames < 0) {
+		return false;
+	}
+	char path[ATOMIC_FILE_MAX_PATH];
+	char contents[32];
+	spoolEntryPath(path, sizeof(path), frames);
+	sprintf(contents, "%d\n", frames);
+	if (!atomicWriteString(path, contents)) {
+		char logText[ATOMIC_FILE_MAX_PATH + 50];
+		sprintf(logText, "Unable to write spool entry %s", path);
+		recipeLog(1, "Server", "Spool", "Error", logText);
+		return false;
+	}
+	notifySubmissionWorker();
+	return true;
+}
+
+// Returns the frame count of the spool entry, or -1 if this is not a spool entry.
+static int parseSpoolEntryName(const char *name) {
+	int frames;
+	int consumed = 0;
+	if (sscanf(name, "%d%n", &frames, &consumed) != 1 || frames < 0) {
+		return -1;
+	}
+	if (strcmp(name + consumed, SPOOL_ENTRY_SUFFIX) != 0) {
+		return -1;
+	}
+	return frames;
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: drainSubmissionSpool
+ * Outputs	: int resolved entries (-1 if the server was unreachable)
+ *
+ * Batch up everything currently in the spool, submit only the fastest
+ * roadmap, and on success drop every entry that was part of the batch,
+ * since the slower ones are superseded. Entries spooled while this is
+ * running are not part of the batch and are left for the next drain.
+ -------------------------------------------------------------------*/
+int drainSubmissionSpool() {
+	DIR *dir = opendir(SUBMISSION_SPOOL_DIR);
+	if (dir == NULL) {
+		return 0;
+	}
+	int batch[SPOOL_MAX_ENTRIES_PER_DRAIN];
+	int batchSize = 0;
+	int best = -1;
+	struct dirent *entry;
+	while ((entry = readdir(dir)) != NULL && batchSize < SPOOL_MAX_ENTRIES_PER_DRAIN) {
+		int frames = parseSpoolEntryName(entry->d_name);
+		if (frames < 0) {
+			continue;
+		}
+		batch[batchSize++] = frames;
+		if (best < 0 || frames < best) {
+			best = frames;
+		}
+	}
+	closedir(dir);
+
+	if (batchSize == 0) {
+		return 0;
+	}
+
+	int status = testRecord(best);
+	if (status == TEST_RECORD_SERVER_UNREACHABLE) {
+		recipeLog(3, "Server", "Spool", "Retry", "Could not reach the server; pending roadmaps will be submitted later.");
+		return -1;
+	}
+	if (status != TEST_RECORD_SUBMITTED) {
+		// The roadmap file is missing or the record is invalid; retrying will never help.
+		// Only drop the broken entry so the next fastest can be tried.
+		char path[ATOMIC_FILE_MAX_PATH];
+		spoolEntryPath(path, sizeof(path), best);
+		remove(path);
+		return 1;
+	}
+
+	for (int i = 0; i < batchSize; ++i) {
+		char path[ATOMIC_FILE_MAX_PATH];
+		spoolEntryPath(path, sizeof(path), batch[i]);
+		remove(path);
+	}
+	if (batchSize > 1 && will_log_level(3)) {
+		char logText[100];
+		sprintf(logText, "Submitted %d frames, skipped %d superseded pending roadmaps", best, batchSize - 1);
+		recipeLog(3, "Server", "Spool", "Drain", logText);
+	}
+	return batchSize;
+}
+
+static void *submissionThreadMain(void *unused) {
+	bool stopping = false;
+	bool lastAttemptFailed = false;
+	while (!stopping) {
+		pthread_mutex_lock(&submissionLock);
+		if (!submissionPending && !submissionStopping) {
+			if (lastAttemptFailed) {
+				struct timespec deadline;
+				clock_gettime(CLOCK_REALTIME, &deadline);
+				deadline.tv_sec += SPOOL_RETRY_INTERVAL_SECS;
+				pthread_cond_timedwait(&submissionCond, &submissionLock, &deadline);
+			} else {
+				pthread_cond_wait(&submissionCond, &submissionLock);
+			}
+		}
+		submissionPending = false;
+		stopping = submissionStopping;
+		pthread_mutex_unlock(&submissionLock);
+
+		// Keep going while there are broken or newly spooled entries to work through.
+		int resolved;
+		while ((resolved = drainSubmissionSpool()) > 0) {}
+		lastAttemptFailed = resolved < 0;
+	}
+	return NULL;
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: startSubmissionWorker
+ *
+ * Start the network thread. Anything already in the spool (e.g. from a
+ * previous run that could not reach the server) is drained right away.
+ -------------------------------------------------------------------*/
+void startSubmissionWorker() {
+	submissionStopping = false;
+	submissionPending = true;
+	if (pthread_create(&submissionThread, NULL, submissionThreadMain, NULL) != 0) {
+		recipeLog(1, "Server", "Spool", "Error", "Unable to start the submission thread. Roadmaps will only be submitted on the next startup.");
+		return;
+	}
+	submissionThreadStarted = true;
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: stopSubmissionWorker
+ *
+ * Ask the network thread for one final drain, and wait for it to finish.
+ -------------------------------------------------------------------*/
+void stopSubmissionWorker() {
+	if (!submissionThreadStarted) {
+		return;
+	}
+	pthread_mutex_lock(&submissionLock);
+	submissionStopping = true;
+	pthread_cond_signal(&submissionCond);
+	pthread_mutex_unlock(&submissionLock);
+	pthread_join(submissionThread, NULL);
+	submissionThreadStarted = false;
+}
@@ -0,0 +1,28 @@
+#ifndef CIPES_SUBMISSION_SPOOL_H
+#define CIPES_SUBMISSION_SPOOL_H
+
+#include <stdbool.h>
+
+// Pending submissions are kept here until the server has accepted them
+// (or they are superseded by a faster pending roadmap).
+#define SUBMISSION_SPOOL_DIR "results/spool"
+
+// Create the spool directory (results/ must already exist).
+void initSubmissionSpool();
+
+// Record that results/<frames>.txt should be submitted.
+// Never touches the network; safe to call from the search threads.
+bool spoolSubmission(int frames);
+
+// Submit the fastest pending roadmap and discard all pending roadmaps it supersedes.
+// Returns the number of spool entries resolved, or -1 if the server could not be reached
+// (in which case everything is left in the spool for the next attempt).
+int drainSubmissionSpool();
+
+// Background network thread which drains the spool whenever something new is
+// spooled, and periodically retries while the server is unreachable.
+void startSubmissionWorker();
+// Makes one last attempt to drain the spool, then stops the background thread.
+void stopSubmissionWorker();
+
+#endif
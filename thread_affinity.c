@@ -0,0 +1,317 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+// For sched_setaffinity and the CPU_SET macros
+#define _GNU_SOURCE
+#endif
+#include "thread_affinity.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "base.h"
+#include "logger.h"
+#if _CIPES_IS_WINDOWS
+#include <windows.h>
+#elif defined(__linux__)
+#include <sched.h>
+#define _HAS_SCHED_AFFINITY 1
+#endif
+
+// NUMA nodes looked for in sysfs. Node numbers may have gaps, so every one up to this is tried.
+#define THREAD_AFFINITY_MAX_NUMA_NODES 64
+#define THREAD_AFFINITY_CPULIST_LENGTH 4096
+
+struct CpuPlacement {
+	int cpu;
+	int numaNode;
+};
+
+// Indexed by rawID. NULL while no thread is to be pinned.
+static struct CpuPlacement *plannedCpus = NULL;
+static bool *threadPinned = NULL;
+static int numPlannedThreads = 0;
+
+/*-------------------------------------------------------------------
+ * Function 	: parseCpuList
+ * Inputs	: const char	*list
+ *		  int		*cpus
+ *		  int		maxCpus
+ * Outputs	: int		number of CPUs, or -1 if the list is malformed
+ *
+ * Parse a list of CPUs and CPU ranges such as "0,2,8-11", the same
+ * layout Linux uses for its cpulist files.
+ -------------------------------------------------------------------*/
+static int parseCpuList(const char *list, int *cpus, int maxCpus) {
+	int numCpus = 0;
+	const char *c = list;
+	while (1) {
+		while (isspace((unsigned char)*c)) {
+			++c;
+		}
+		if (*c == '\0') {
+			return numCpus;
+		}
+		char *end;
+		long first = strtol(c, &end, 10);
+		if (end == c || first < 0 || first >= THREAD_AFFINITY_MAX_CPUS) {
+			return -1;
+		}
+		long last = first;
+		c = end;
+		while (isspace((unsigned char)*c)) {
+			++c;
+		}
+		if (*c == '-') {
+			++c;
+			last = strtol(c, &end, 10);
+			if (end == c || last < first || last >= THREAD_AFFINITY_MAX_CPUS) {
+				return -1;
+			}
+			c = end;
+		}
+		for (long cpu = first; cpu <= last; ++cpu) {
+			if (numCpus == maxCpus) {
+				return -1;
+			}
+			cpus[numCpus++] = (int)cpu;
+		}
+		while (isspace((unsigned char)*c)) {
+			++c;
+		}
+		if (*c == ',') {
+			++c;
+		}
+		else if (*c != '\0') {
+			return -1;
+		}
+	}
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: listUsableCpus
+ * Inputs	: struct CpuPlacement	*cpus
+ * Outputs	: int			number of CPUs
+ *
+ * Fill cpus, in order of CPU number, with every CPU this process may
+ * run on and the NUMA node it belongs to. CPUs whose node can't be
+ * found are put on node 0.
+ -------------------------------------------------------------------*/
+static int listUsableCpus(struct CpuPlacement *cpus) {
+	int numCpus = 0;
+#if _HAS_SCHED_AFFINITY
+	int *nodeOfCpu = calloc(THREAD_AFFINITY_MAX_CPUS, sizeof(int));
+	int *nodeCpus = malloc(THREAD_AFFINITY_MAX_CPUS * sizeof(int));
+	char *cpuList = malloc(THREAD_AFFINITY_CPULIST_LENGTH);
+	checkMallocFailed(nodeOfCpu);
+	checkMallocFailed(nodeCpus);
+	checkMallocFailed(cpuList);
+	for (int node = 0; node < THREAD_AFFINITY_MAX_NUMA_NODES; ++node) {
+		char path[64];
+		sprintf(path, "/sys/devices/system/node/node%d/cpulist", node);
+		FILE *fp = fopen(path, "r");
+		if (fp == NULL) {
+			continue;
+		}
+		if (fgets(cpuList, THREAD_AFFINITY_CPULIST_LENGTH, fp) != NULL) {
+			int numNodeCpus = parseCpuList(cpuList, nodeCpus, THREAD_AFFINITY_MAX_CPUS);
+			for (int i = 0; i < numNodeCpus; ++i) {
+				nodeOfCpu[nodeCpus[i]] = node;
+			}
+		}
+		fclose(fp);
+	}
+
+	cpu_set_t allowed;
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0) {
+		for (int cpu = 0; cpu < THREAD_AFFINITY_MAX_CPUS && cpu < CPU_SETSIZE; ++cpu) {
+			if (CPU_ISSET(cpu, &allowed)) {
+				cpus[numCpus++] = (struct CpuPlacement) { cpu, nodeOfCpu[cpu] };
+			}
+		}
+	}
+	free(nodeOfCpu);
+	free(nodeCpus);
+	free(cpuList);
+#elif _CIPES_IS_WINDOWS
+	DWORD_PTR processMask, systemMask;
+	if (GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask)) {
+		// A thread's affinity mask only covers the first processor group
+		for (int cpu = 0; cpu < (int)(8 * sizeof(DWORD_PTR)); ++cpu) {
+			if (processMask & ((DWORD_PTR)1 << cpu)) {
+				UCHAR node = 0;
+				GetNumaProcessorNode((UCHAR)cpu, &node);
+				cpus[numCpus++] = (struct CpuPlacement) { cpu, node == 0xFF ? 0 : node };
+			}
+		}
+	}
+#endif
+	return numCpus;
+}
+
+static int compareByNumaNode(const void *elem1, const void *elem2) {
+	const struct CpuPlacement *a = elem1;
+	const struct CpuPlacement *b = elem2;
+	if (a->numaNode != b->numaNode) {
+		return a->numaNode - b->numaNode;
+	}
+	return a->cpu - b->cpu;
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: scatterAcrossNumaNodes
+ * Inputs	: struct CpuPlacement	*cpus
+ *		  int			numCpus
+ *
+ * Reorder cpus so consecutive entries come from different NUMA nodes
+ * in turn, taking the lowest numbered CPU left on each node.
+ -------------------------------------------------------------------*/
+static void scatterAcrossNumaNodes(struct CpuPlacement *cpus, int numCpus) {
+	qsort(cpus, numCpus, sizeof(struct CpuPlacement), compareByNumaNode);
+	struct CpuPlacement *byNode = malloc(numCpus * sizeof(struct CpuPlacement));
+	bool *taken = calloc(numCpus, sizeof(bool));
+	checkMallocFailed(byNode);
+	checkMallocFailed(taken);
+	memcpy(byNode, cpus, numCpus * sizeof(struct CpuPlacement));
+
+	int placed = 0;
+	while (placed < numCpus) {
+		// One pass takes the first CPU not yet taken from every node
+		int lastNode = -1;
+		for (int i = 0; i < numCpus; ++i) {
+			if (!taken[i] && byNode[i].numaNode != lastNode) {
+				taken[i] = true;
+				cpus[placed++] = byNode[i];
+				lastNode = byNode[i].numaNode;
+			}
+		}
+	}
+	free(byNode);
+	free(taken);
+}
+
+bool initThreadAffinity(const char *policy, int numThreads) {
+	freeThreadAffinity();
+	if (policy == NULL || policy[0] == '\0') {
+		return false;
+	}
+#if !_HAS_SCHED_AFFINITY && !_CIPES_IS_WINDOWS
+	recipeLog(2, "Affinity", "Plan", "Error", "Pinning threads to CPUs is not supported on this platform.");
+	return false;
+#endif
+
+	struct CpuPlacement *usable = malloc(THREAD_AFFINITY_MAX_CPUS * sizeof(struct CpuPlacement));
+	checkMallocFailed(usable);
+	int numUsable = listUsableCpus(usable);
+	if (numUsable == 0) {
+		recipeLog(2, "Affinity", "Plan", "Error", "Could not find the CPUs this process may run on. Threads will not be pinned.");
+		free(usable);
+		return false;
+	}
+
+	struct CpuPlacement *order = malloc(THREAD_AFFINITY_MAX_CPUS * sizeof(struct CpuPlacement));
+	checkMallocFailed(order);
+	int numOrdered = 0;
+	if (strcmp(policy, "compact") == 0) {
+		memcpy(order, usable, numUsable * sizeof(struct CpuPlacement));
+		numOrdered = numUsable;
+		qsort(order, numOrdered, sizeof(struct CpuPlacement), compareByNumaNode);
+	}
+	else if (strcmp(policy, "scatter") == 0) {
+		memcpy(order, usable, numUsable * sizeof(struct CpuPlacement));
+		numOrdered = numUsable;
+		scatterAcrossNumaNodes(order, numOrdered);
+	}
+	else {
+		int *listed = malloc(THREAD_AFFINITY_MAX_CPUS * sizeof(int));
+		checkMallocFailed(listed);
+		numOrdered = parseCpuList(policy, listed, THREAD_AFFINITY_MAX_CPUS);
+		for (int i = 0; i < numOrdered; ++i) {
+			int j = 0;
+			while (j < numUsable && usable[j].cpu != listed[i]) {
+				++j;
+			}
+			if (j == numUsable) {
+				char message[100];
+				sprintf(message, "CPU %d in threadAffinity is not one this process may run on.", listed[i]);
+				recipeLog(2, "Affinity", "Plan", "Error", message);
+				numOrdered = -1;
+				break;
+			}
+			order[i] = usable[j];
+		}
+		free(listed);
+		if (numOrdered <= 0) {
+			recipeLog(2, "Affinity", "Plan", "Error", "threadAffinity must be \"compact\", \"scatter\", or a list of CPUs like \"0,2,8-11\". Threads will not be pinned.");
+			free(usable);
+			free(order);
+			return false;
+		}
+	}
+
+	if (numThreads > numOrdered) {
+		char message[100];
+		sprintf(message, "%d threads will share %d CPUs.", numThreads, numOrdered);
+		recipeLog(2, "Affinity", "Plan", "Warning", message);
+	}
+	plannedCpus = malloc(numThreads * sizeof(struct CpuPlacement));
+	threadPinned = calloc(numThreads, sizeof(bool));
+	checkMallocFailed(plannedCpus);
+	checkMallocFailed(threadPinned);
+	for (int i = 0; i < numThreads; ++i) {
+		plannedCpus[i] = order[i % numOrdered];
+	}
+	numPlannedThreads = numThreads;
+	free(usable);
+	free(order);
+	return true;
+}
+
+void pinThreadToPlannedCpu(int rawID) {
+	if (plannedCpus == NULL || rawID >= numPlannedThreads) {
+		return;
+	}
+	const struct CpuPlacement placement = plannedCpus[rawID];
+	bool pinned = false;
+#if _HAS_SCHED_AFFINITY
+	cpu_set_t cpuSet;
+	CPU_ZERO(&cpuSet);
+	CPU_SET(placement.cpu, &cpuSet);
+	// 0 is the calling thread, not the whole process
+	pinned = sched_setaffinity(0, sizeof(cpuSet), &cpuSet) == 0;
+#elif _CIPES_IS_WINDOWS
+	pinned = SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << placement.cpu) != 0;
+#endif
+	threadPinned[rawID] = pinned;
+
+	char message[100];
+	if (pinned) {
+		sprintf(message, "Thread %d][Pinned to CPU %d on NUMA node %d", rawID + 1, placement.cpu, placement.numaNode);
+		recipeLog(3, "Affinity", "Pin", "Thread", message);
+	}
+	else {
+		sprintf(message, "Thread %d][Could not be pinned to CPU %d", rawID + 1, placement.cpu);
+		recipeLog(2, "Affinity", "Pin", "Error", message);
+	}
+}
+
+int getThreadCpu(int rawID) {
+	if (plannedCpus == NULL || rawID >= numPlannedThreads || !threadPinned[rawID]) {
+		return -1;
+	}
+	return plannedCpus[rawID].cpu;
+}
+
+int getThreadNumaNode(int rawID) {
+	if (plannedCpus == NULL || rawID >= numPlannedThreads || !threadPinned[rawID]) {
+		return -1;
+	}
+	return plannedCpus[rawID].numaNode;
+}
+
+void freeThreadAffinity() {
+	free(plannedCpus);
+	free(threadPinned);
+	plannedCpus = NULL;
+	threadPinned = NULL;
+	numPlannedThreads = 0;
+}
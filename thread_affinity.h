@@ -0,0 +1,27 @@
+#ifndef CIPES_THREAD_AFFINITY_H
+#define CIPES_THREAD_AFFINITY_H
+
+#include <stdbool.h>
+
+// Pinning search threads to CPUs, as set by the threadAffinity config option:
+//   ""			leave the threads to the OS scheduler
+//   "compact"	fill the CPUs of one NUMA node before moving on to the next
+//   "scatter"	deal the threads out across the NUMA nodes in turn
+//   "0,2,8-11"	thread n gets the nth CPU of the list, wrapping around if there are more threads
+// A pinned thread's search nodes are first touched by that thread, so their pages land in the
+// memory of its own NUMA node instead of wherever the thread happened to be running.
+
+#define THREAD_AFFINITY_MAX_CPUS 1024
+
+// Plan the CPU of every thread. Returns false, and leaves every thread unpinned,
+// if the option is empty, can't be parsed, or pinning isn't supported here.
+bool initThreadAffinity(const char *policy, int numThreads);
+// Pin the calling thread to the CPU planned for rawID, if there is one.
+// Call before the thread allocates any search nodes.
+void pinThreadToPlannedCpu(int rawID);
+// The CPU and NUMA node rawID was pinned to, or -1 if it isn't pinned.
+int getThreadCpu(int rawID);
+int getThreadNumaNode(int rawID);
+void freeThreadAffinity();
+
+#endif
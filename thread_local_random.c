@@ -9,14 +9,48 @@
 #if _NEED_EXTERN_DEF
 #include "absl/base/attributes.h"
 #endif
+#include "splitmix64.h"
 
 #if _USE_LEHMER64_RANDOM
 #include "lehmer64_cipes.h"
 #elif _USING_SYSTEM_RAND && _HAS_RANDR
 unsigned int _threadlocal_seed;
 #pragma omp threadprivate(_threadlocal_seed)
+#elif _USING_BATCHED_RANDOM
+struct RandomBatch _threadlocal_batch;
+#pragma omp threadprivate(_threadlocal_batch)
 #endif
 
+// Expand the seed with splitmix64, as the xoshiro authors recommend.
+// The stateless form, as the header's own state is shared by every thread.
+static void seedRandomBatch(struct RandomBatch *batch, uint64_t seed) {
+	for (int i = 0; i < 4; ++i) {
+		batch->state[i] = splitmix64_stateless(seed + i * UINT64_C(0x9E3779B97F4A7C15));
+	}
+	batch->remaining = 0;
+}
+
+#if _USING_BATCHED_RANDOM
+void _threadlocal_seed_batch(random_seed_t seed) {
+	seedRandomBatch(&_threadlocal_batch, seed);
+}
+#endif
+
+void _random_batch_refill(struct RandomBatch *batch) {
+	// A generator that was never seeded gets the same sequence every time, as rand_r would with a seed of 0
+	if ((batch->state[0] | batch->state[1] | batch->state[2] | batch->state[3]) == 0) {
+		seedRandomBatch(batch, 0);
+	}
+	uint64_t state[4] = { batch->state[0], batch->state[1], batch->state[2], batch->state[3] };
+	for (int i = 0; i < RANDOM_BATCH_SIZE; ++i) {
+		batch->words[i] = _xoshiro256starstar_next(state);
+	}
+	for (int i = 0; i < 4; ++i) {
+		batch->state[i] = state[i];
+	}
+	batch->remaining = RANDOM_BATCH_SIZE;
+}
+
 #if !_NEED_EXTERN_DEF
 
 #if _USE_LEHMER64_RANDOM
@@ -33,6 +67,12 @@ ABSL_ATTRIBUTE_UNUSED
 extern inline random_output_t threadlocal_randint(random_output_t low, random_output_t high);
 ABSL_ATTRIBUTE_UNUSED
 extern inline void threadlocal_rand_destroy();
+#if _USING_BATCHED_RANDOM
+ABSL_ATTRIBUTE_UNUSED
+extern inline uint64_t _threadlocal_next_word();
+ABSL_ATTRIBUTE_UNUSED
+extern inline random_output_t _threadlocal_bounded(random_output_t low, random_output_t high);
+#endif
 
 #else
 
@@ -55,3 +95,62 @@ ABSL_ATTRIBUTE_ALWAYS_INLINE
 inline void threadlocal_rand_destroy() {}
 
 #endif // _USE_LEHMER64_RANDOM
+
+ABSL_ATTRIBUTE_UNUSED
+extern inline random_output_t threadlocal_randpercent();
+ABSL_ATTRIBUTE_UNUSED
+extern inline uint64_t _xoshiro256starstar_next(uint64_t *state);
+ABSL_ATTRIBUTE_UNUSED
+extern inline uint64_t _random_batch_next_word(struct RandomBatch *batch);
+ABSL_ATTRIBUTE_UNUSED
+extern inline random_output_t _random_batch_bounded(struct RandomBatch *batch, random_output_t low, random_output_t high);
+ABSL_ATTRIBUTE_UNUSED
+extern inline random_output_t random_state_randint(random_state_t *state, random_output_t low, random_output_t high);
+ABSL_ATTRIBUTE_UNUSED
+extern inline random_output_t random_state_randpercent(random_state_t *state);
+
+// Only written before the threads that seed from it start
+static uint64_t masterSeed;
+
+void threadlocal_set_master_seed(uint64_t seed) {
+	masterSeed = seed;
+}
+
+uint64_t threadlocal_get_master_seed() {
+	return masterSeed;
+}
+
+// Advance a xoshiro256 state by 2^128 words, with the jump polynomial published alongside the generator
+static void xoshiro256_jump(uint64_t *state) {
+	static const uint64_t JUMP[] = { 0x180ec6d33cfd0aba, 0xd5a61266f0c9392c, 0xa9582618e03fc9aa, 0x39abdc4529b1661c };
+	uint64_t jumped[4] = { 0, 0, 0, 0 };
+	for (int i = 0; i < 4; ++i) {
+		for (int b = 0; b < 64; ++b) {
+			if (JUMP[i] & (UINT64_C(1) << b)) {
+				for (int j = 0; j < 4; ++j) {
+					jumped[j] ^= state[j];
+				}
+			}
+			_xoshiro256starstar_next(state);
+		}
+	}
+	for (int j = 0; j < 4; ++j) {
+		state[j] = jumped[j];
+	}
+}
+
+void random_state_seed_stream(random_state_t *state, int stream) {
+	seedRandomBatch(state, masterSeed);
+	for (int i = 0; i < stream; ++i) {
+		xoshiro256_jump(state->state);
+	}
+}
+
+void threadlocal_srand_stream(int stream) {
+#if _USING_BATCHED_RANDOM
+	random_state_seed_stream(&_threadlocal_batch, stream);
+#else
+	// The other generators can't jump, so each stream is seeded with its own mix of the master seed instead
+	threadlocal_srand((random_seed_t)splitmix64_stateless(masterSeed + stream * UINT64_C(0x9E3779B97F4A7C15)));
+#endif
+}
@@ -8,7 +8,9 @@
 #ifndef _THREAD_LOCAL_RANDOM_H_
 #define _THREAD_LOCAL_RANDOM_H_
 
+#include <stdint.h>
 #include "absl/base/attributes.h"
+#include "absl/base/optimization.h"
 #include "base.h"
 
 #if _POSIX_C_SOURCE >= 1 || _XOPEN_SOURCE || _POSIX_SOURCE
@@ -24,6 +26,13 @@ typedef uint64_t random_seed_t;
 #include "cpp_random_adapter.h"
 typedef random_output_cpp_t random_output_t;
 typedef random_seed_cpp_t random_seed_t;
+#elif !_USE_SYSTEM_RANDOM
+// Unless another generator is asked for, xoshiro256** words are generated in batches
+// and bounded with Lemire's nearly divisionless method.
+#include <stdint.h>
+#define _USING_BATCHED_RANDOM 1
+typedef uint32_t random_output_t;
+typedef uint64_t random_seed_t;
 #else
 #define _USING_SYSTEM_RAND 1
 #include <stdlib.h>
@@ -46,6 +55,76 @@ extern random_seed_t _threadlocal_seed;
 #pragma omp threadprivate(_threadlocal_seed)
 #endif
 
+// Random words generated at a time, so the generator state stays in registers while generating
+#define RANDOM_BATCH_SIZE 64
+
+// xoshiro256** words, generated in batches. This is the thread-local generator unless another is
+// asked for, and whatever the thread-local generator is, the one each search context owns.
+struct RandomBatch {
+	uint64_t state[4];					// xoshiro256**; all zero until seeded
+	uint64_t words[RANDOM_BATCH_SIZE];
+	int remaining;						// Words not yet handed out, taken from the end
+};
+
+void _random_batch_refill(struct RandomBatch *batch);
+
+ABSL_ATTRIBUTE_ALWAYS_INLINE
+inline uint64_t _xoshiro256starstar_next(uint64_t *state) {
+	const uint64_t result = ((state[1] * 5) << 7 | (state[1] * 5) >> 57) * 9;
+	const uint64_t t = state[1] << 17;
+	state[2] ^= state[0];
+	state[3] ^= state[1];
+	state[1] ^= state[2];
+	state[0] ^= state[3];
+	state[2] ^= t;
+	state[3] = state[3] << 45 | state[3] >> 19;
+	return result;
+}
+
+ABSL_ATTRIBUTE_ALWAYS_INLINE
+inline uint64_t _random_batch_next_word(struct RandomBatch *batch) {
+	if (ABSL_PREDICT_FALSE(batch->remaining == 0)) {
+		_random_batch_refill(batch);
+	}
+	return batch->words[--batch->remaining];
+}
+
+// A uniform integer in [low, high), without modulo bias. Only the rare product that lands
+// in the biased sliver needs a division, and when the bounds are constants even that folds away.
+ABSL_ATTRIBUTE_ALWAYS_INLINE
+inline random_output_t _random_batch_bounded(struct RandomBatch *batch, random_output_t low, random_output_t high) {
+	_assert_with_stacktrace(low <= high);
+	const uint32_t range = high - low;
+	uint64_t product = (_random_batch_next_word(batch) >> 32) * range;
+	if (ABSL_PREDICT_FALSE((uint32_t)product < range)) {
+		const uint32_t threshold = -range % range;
+		while ((uint32_t)product < threshold) {
+			product = (_random_batch_next_word(batch) >> 32) * range;
+		}
+	}
+	return low + (random_output_t)(product >> 32);
+}
+
+// Generator state owned by its caller rather than by the thread, such as a search context's
+typedef struct RandomBatch random_state_t;
+
+#if _USING_BATCHED_RANDOM
+extern struct RandomBatch _threadlocal_batch;
+#pragma omp threadprivate(_threadlocal_batch)
+
+void _threadlocal_seed_batch(random_seed_t seed);
+
+ABSL_ATTRIBUTE_ALWAYS_INLINE
+inline uint64_t _threadlocal_next_word() {
+	return _random_batch_next_word(&_threadlocal_batch);
+}
+
+ABSL_ATTRIBUTE_ALWAYS_INLINE
+inline random_output_t _threadlocal_bounded(random_output_t low, random_output_t high) {
+	return _random_batch_bounded(&_threadlocal_batch, low, high);
+}
+#endif
+
 #if _NEED_EXTERN_DEF
 
 void threadlocal_rand_init();
@@ -67,6 +146,8 @@ ABSL_ATTRIBUTE_ALWAYS_INLINE
 inline void threadlocal_srand(random_seed_t seed) {
 #if _USE_CPP_RANDOM
 	cpp_srand(seed);
+#elif _USING_BATCHED_RANDOM
+	_threadlocal_seed_batch(seed);
 #elif _HAS_RANDR
 	_threadlocal_seed = seed;
 #else
@@ -78,6 +159,9 @@ ABSL_ATTRIBUTE_ALWAYS_INLINE
 inline random_output_t threadlocal_rand() {
 #if _USE_CPP_RANDOM
 	return cpp_rand();
+#elif _USING_BATCHED_RANDOM
+	// Same range as rand() on glibc
+	return _threadlocal_next_word() >> 33;
 #elif _HAS_RANDR
 	return rand_r(&_threadlocal_seed);
 #else
@@ -91,6 +175,8 @@ ABSL_ATTRIBUTE_ALWAYS_INLINE
 inline random_output_t threadlocal_randint(random_output_t low, random_output_t high) {
 #if _USE_CPP_RANDOM
 	return cpp_randint(low, high);
+#elif _USING_BATCHED_RANDOM
+	return _threadlocal_bounded(low, high);
 #elif _USING_SYSTEM_RAND && _HAS_RANDR
 	return _internal_scale_to_bounds(threadlocal_rand(), low, high);
 #else
@@ -107,4 +193,33 @@ inline void threadlocal_rand_destroy() {
 
 #endif // _NEED_EXTERN_DEF
 
+// Every thread draws from its own stream of one master seed, so a run can be repeated from that seed alone.
+// The master seed must be set before any thread seeds itself from it.
+void threadlocal_set_master_seed(uint64_t seed);
+uint64_t threadlocal_get_master_seed();
+
+// Seed this thread with the given stream of the master seed. With the batched generator, stream n
+// starts n * 2^128 words into the master seed's sequence, so streams can never overlap.
+void threadlocal_srand_stream(int stream);
+
+// A percent roll, 0 to 99. With constant bounds, the batched generator needs no division at all.
+ABSL_ATTRIBUTE_ALWAYS_INLINE
+inline random_output_t threadlocal_randpercent() {
+	return threadlocal_randint(0, 100);
+}
+
+// Seed state with the given stream of the master seed. These are the same streams the batched
+// thread-local generator draws from, so a context seeded with stream n draws what thread n would have.
+void random_state_seed_stream(random_state_t *state, int stream);
+
+ABSL_ATTRIBUTE_ALWAYS_INLINE
+inline random_output_t random_state_randint(random_state_t *state, random_output_t low, random_output_t high) {
+	return _random_batch_bounded(state, low, high);
+}
+
+ABSL_ATTRIBUTE_ALWAYS_INLINE
+inline random_output_t random_state_randpercent(random_state_t *state) {
+	return random_state_randint(state, 0, 100);
+}
+
 #endif /* _THREAD_LOCAL_RANDOM_H_ */
@@ -0,0 +1,223 @@
+#include "thread_pool.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+#include <pthread.h>
+#include "base.h"
+#include "logger.h"
+
+struct Job {
+	JobFunction run;
+	void *arg;
+	double queuedAt;
+};
+
+struct PoolWorker {
+	struct WorkerContext context;
+	pthread_t thread;
+	bool started;
+};
+
+struct JobClassState {
+	int numWorkers;
+	int queueCapacity;
+	WorkerHook startWorker;
+	WorkerHook stopWorker;
+	struct PoolWorker *workers;
+	int numRunningWorkers;		// Threads started and not yet stopped
+	struct Job *queue;
+	int queueHead;
+	int running;				// Jobs taken off the queue and not yet finished
+	bool stopping;
+	pthread_cond_t jobCond;		// A job was queued, or the class is stopping
+	pthread_cond_t idleCond;	// Nothing is queued or running any more
+	struct JobQueueStats stats;
+};
+
+static const char *jobClassNames[NUM_JOB_CLASSES] = { "search", "service" };
+
+// Everything in jobClasses is only touched under poolLock
+static pthread_mutex_t poolLock = PTHREAD_MUTEX_INITIALIZER;
+static struct JobClassState jobClasses[NUM_JOB_CLASSES];
+
+static void *poolWorkerMain(void *arg) {
+	struct PoolWorker *worker = arg;
+	struct JobClassState *jobClass = &jobClasses[worker->context.jobClass];
+	if (jobClass->startWorker != NULL) {
+		jobClass->startWorker(&worker->context);
+	}
+
+	pthread_mutex_lock(&poolLock);
+	while (1) {
+		while (jobClass->stats.jobsQueued == 0 && !jobClass->stopping) {
+			pthread_cond_wait(&jobClass->jobCond, &poolLock);
+		}
+		// Jobs still queued when stopping are run first, as they may hold a record
+		if (jobClass->stats.jobsQueued == 0) {
+			break;
+		}
+		const struct Job job = jobClass->queue[jobClass->queueHead];
+		jobClass->queueHead = (jobClass->queueHead + 1) % jobClass->queueCapacity;
+		--jobClass->stats.jobsQueued;
+		++jobClass->running;
+		const double startTime = omp_get_wtime();
+		const double waitSecs = startTime - job.queuedAt;
+		++jobClass->stats.jobsRun;
+		jobClass->stats.totalWaitSecs += waitSecs;
+		if (waitSecs > jobClass->stats.maxWaitSecs) {
+			jobClass->stats.maxWaitSecs = waitSecs;
+		}
+		pthread_mutex_unlock(&poolLock);
+
+		job.run(&worker->context, job.arg);
+
+		const double busySecs = omp_get_wtime() - startTime;
+		pthread_mutex_lock(&poolLock);
+		++worker->context.jobsRun;
+		--jobClass->running;
+		jobClass->stats.busySecs += busySecs;
+		if (jobClass->running == 0 && jobClass->stats.jobsQueued == 0) {
+			pthread_cond_broadcast(&jobClass->idleCond);
+		}
+	}
+	--jobClass->numRunningWorkers;
+	pthread_mutex_unlock(&poolLock);
+
+	if (jobClass->stopWorker != NULL) {
+		jobClass->stopWorker(&worker->context);
+	}
+	return NULL;
+}
+
+void initJobClass(enum JobClass jobClass, int numWorkers, int queueCapacity, WorkerHook startWorker, WorkerHook stopWorker) {
+	struct JobClassState *state = &jobClasses[jobClass];
+	_assert_with_stacktrace(state->workers == NULL);
+	_assert_with_stacktrace(numWorkers > 0 && queueCapacity > 0);
+	memset(state, 0, sizeof(struct JobClassState));
+	state->numWorkers = numWorkers;
+	state->queueCapacity = queueCapacity;
+	state->startWorker = startWorker;
+	state->stopWorker = stopWorker;
+	state->workers = calloc(numWorkers, sizeof(struct PoolWorker));
+	state->queue = malloc(queueCapacity * sizeof(struct Job));
+	checkMallocFailed(state->workers);
+	checkMallocFailed(state->queue);
+	pthread_cond_init(&state->jobCond, NULL);
+	pthread_cond_init(&state->idleCond, NULL);
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: startThreadPool
+ * Outputs	: bool	false if some class got none of its workers
+ *
+ * Start the workers of every class which was planned. Workers which
+ * fail to start are logged and left out, so their class carries on
+ * with fewer threads.
+ -------------------------------------------------------------------*/
+bool startThreadPool() {
+	bool allClassesStarted = true;
+	for (int c = 0; c < NUM_JOB_CLASSES; ++c) {
+		struct JobClassState *jobClass = &jobClasses[c];
+		if (jobClass->workers == NULL) {
+			continue;
+		}
+		pthread_mutex_lock(&poolLock);
+		jobClass->stopping = false;
+		for (int i = 0; i < jobClass->numWorkers; ++i) {
+			struct PoolWorker *worker = &jobClass->workers[i];
+			worker->context = (struct WorkerContext) { i, (enum JobClass)c, 0 };
+			worker->started = pthread_create(&worker->thread, NULL, poolWorkerMain, worker) == 0;
+			if (worker->started) {
+				++jobClass->numRunningWorkers;
+			}
+			else {
+				char message[100];
+				sprintf(message, "Unable to start %s worker %d of %d.", jobClassNames[c], i + 1, jobClass->numWorkers);
+				recipeLog(1, "Pool", "Start", "Error", message);
+			}
+		}
+		if (jobClass->numRunningWorkers == 0) {
+			allClassesStarted = false;
+		}
+		pthread_mutex_unlock(&poolLock);
+	}
+	return allClassesStarted;
+}
+
+bool submitJob(enum JobClass jobClass, JobFunction run, void *arg) {
+	struct JobClassState *state = &jobClasses[jobClass];
+	bool queued = false;
+	pthread_mutex_lock(&poolLock);
+	if (state->numRunningWorkers > 0 && !state->stopping && state->stats.jobsQueued < state->queueCapacity) {
+		state->queue[(state->queueHead + state->stats.jobsQueued) % state->queueCapacity] = (struct Job) { run, arg, omp_get_wtime() };
+		++state->stats.jobsQueued;
+		pthread_cond_signal(&state->jobCond);
+		queued = true;
+	}
+	else {
+		++state->stats.jobsRejected;
+	}
+	pthread_mutex_unlock(&poolLock);
+	return queued;
+}
+
+void waitForJobClass(enum JobClass jobClass) {
+	struct JobClassState *state = &jobClasses[jobClass];
+	pthread_mutex_lock(&poolLock);
+	while (state->numRunningWorkers > 0 && (state->running > 0 || state->stats.jobsQueued > 0)) {
+		pthread_cond_wait(&state->idleCond, &poolLock);
+	}
+	pthread_mutex_unlock(&poolLock);
+}
+
+void stopThreadPool() {
+	for (int c = 0; c < NUM_JOB_CLASSES; ++c) {
+		struct JobClassState *jobClass = &jobClasses[c];
+		if (jobClass->workers == NULL) {
+			continue;
+		}
+		pthread_mutex_lock(&poolLock);
+		jobClass->stopping = true;
+		pthread_cond_broadcast(&jobClass->jobCond);
+		pthread_mutex_unlock(&poolLock);
+		for (int i = 0; i < jobClass->numWorkers; ++i) {
+			if (jobClass->workers[i].started) {
+				pthread_join(jobClass->workers[i].thread, NULL);
+				jobClass->workers[i].started = false;
+			}
+		}
+	}
+}
+
+int getJobClassWorkerCount(enum JobClass jobClass) {
+	pthread_mutex_lock(&poolLock);
+	const int numWorkers = jobClasses[jobClass].numRunningWorkers;
+	pthread_mutex_unlock(&poolLock);
+	return numWorkers;
+}
+
+const char *getJobClassName(enum JobClass jobClass) {
+	return jobClassNames[jobClass];
+}
+
+void readJobQueueStats(enum JobClass jobClass, struct JobQueueStats *dest) {
+	pthread_mutex_lock(&poolLock);
+	*dest = jobClasses[jobClass].stats;
+	pthread_mutex_unlock(&poolLock);
+}
+
+void freeThreadPool() {
+	for (int c = 0; c < NUM_JOB_CLASSES; ++c) {
+		struct JobClassState *jobClass = &jobClasses[c];
+		if (jobClass->workers == NULL) {
+			continue;
+		}
+		free(jobClass->workers);
+		free(jobClass->queue);
+		pthread_cond_destroy(&jobClass->jobCond);
+		pthread_cond_destroy(&jobClass->idleCond);
+		memset(jobClass, 0, sizeof(struct JobClassState));
+	}
+}
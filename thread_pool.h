@@ -0,0 +1,56 @@
+#ifndef CIPES_THREAD_POOL_H
+#define CIPES_THREAD_POOL_H
+
+#include <stdbool.h>
+
+// A fixed set of worker threads, each taking jobs from the queue of its own job class.
+// Search workers only run search jobs (each one a call to calculateOrder), and service workers
+// only run service jobs (such as optimizing a finished roadmap), so a long dive never holds up
+// an optimization. Every job is timed from being queued to being started, so the stats show
+// how long each class of job waits for a free worker.
+
+enum JobClass {
+	JOB_CLASS_SEARCH,
+	JOB_CLASS_SERVICE,
+	NUM_JOB_CLASSES
+};
+
+// Handed to every job, describing the worker which runs it.
+struct WorkerContext {
+	int workerID;			// Index among the workers of its class. For search workers, this is the rawID.
+	enum JobClass jobClass;
+	long jobsRun;			// By this worker, before the current job
+};
+
+typedef void (*JobFunction)(struct WorkerContext *worker, void *arg);
+// Run on the worker's own thread, before its first job or after its last.
+typedef void (*WorkerHook)(struct WorkerContext *worker);
+
+struct JobQueueStats {
+	long jobsRun;			// Taken off the queue, including those still running
+	long jobsQueued;		// Waiting for a worker right now
+	long jobsRejected;		// Not queued, as the class had no workers or its queue was full
+	double totalWaitSecs;	// From queued to started, summed over every job run
+	double maxWaitSecs;
+	double busySecs;		// Spent running jobs which have finished
+};
+
+// Plan numWorkers threads for jobClass, with room for queueCapacity jobs waiting for them.
+// Either hook may be NULL. Must be called before the pool is started.
+void initJobClass(enum JobClass jobClass, int numWorkers, int queueCapacity, WorkerHook startWorker, WorkerHook stopWorker);
+// Start the planned workers. Returns false if a class with workers planned got none of them.
+bool startThreadPool();
+// Queue a job for the workers of jobClass. Returns false, without queueing it,
+// if that class has no running workers or its queue is full.
+bool submitJob(enum JobClass jobClass, JobFunction run, void *arg);
+// Block until no job of jobClass is queued or running.
+void waitForJobClass(enum JobClass jobClass);
+// Let the workers finish every queued job, then stop them. Search workers stop first,
+// as their last jobs may still hand work to the service workers.
+void stopThreadPool();
+int getJobClassWorkerCount(enum JobClass jobClass);
+const char *getJobClassName(enum JobClass jobClass);
+void readJobQueueStats(enum JobClass jobClass, struct JobQueueStats *dest);
+void freeThreadPool();
+
+#endif
@@ -0,0 +1,168 @@
+#include "worker_manager.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <signal.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include "base.h"
+#include "config.h"
+#include "logger.h"
+#include "shutdown.h"
+
+// Until initWorkerManager is called (e.g. when benchmarking) no thread ever parks
+int _activeWorkers = INT_MAX;
+static int workerPoolSize = 0;
+
+// Guards _activeWorkers writes, and lets parked threads sleep until they are needed
+static pthread_mutex_t workerLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t workerResumeCond = PTHREAD_COND_INITIALIZER;
+
+static pthread_t managerThread;
+static pthread_mutex_t managerLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t managerCond = PTHREAD_COND_INITIALIZER;
+static bool managerStopping = false;
+static bool managerThreadStarted = false;
+static volatile sig_atomic_t reloadRequested = 0;
+
+void initWorkerManager(int poolSize, int activeWorkers) {
+	workerPoolSize = poolSize;
+	pthread_mutex_lock(&workerLock);
+	_activeWorkers = activeWorkers;
+	pthread_mutex_unlock(&workerLock);
+}
+
+int getWorkerPoolSize() {
+	return workerPoolSize;
+}
+
+int getActiveWorkerCount() {
+	int active;
+	#pragma omp atomic read
+	active = _activeWorkers;
+	return active < workerPoolSize ? active : workerPoolSize;
+}
+
+void setActiveWorkerCount(int count) {
+	if (count < 1) {
+		count = 1;
+	}
+	if (count > workerPoolSize) {
+		char message[150];
+		sprintf(message, "Only %d search threads were started, so %d can search at most. Raise maxWorkerCount and restart for more.", workerPoolSize, workerPoolSize);
+		recipeLog(2, "Workers", "Scale", "Warning", message);
+		count = workerPoolSize;
+	}
+
+	pthread_mutex_lock(&workerLock);
+	const int previous = _activeWorkers;
+	#pragma omp atomic write
+	_activeWorkers = count;
+	pthread_cond_broadcast(&workerResumeCond);
+	pthread_mutex_unlock(&workerLock);
+
+	if (count != previous) {
+		char message[100];
+		sprintf(message, "%d of %d search threads are now searching", count, workerPoolSize);
+		recipeLog(1, "Workers", "Scale", "Active", message);
+	}
+}
+
+void requestWorkerCountReload() {
+	reloadRequested = 1;
+}
+
+/*-------------------------------------------------------------------
+ * Function 	: parkWorker
+ * Inputs	: int	rawID
+ *
+ * Sleep until rawID is one of the active workers again. The thread
+ * also wakes now and then to notice a shutdown, as the signal
+ * handler that asks for one can't signal a condition variable.
+ -------------------------------------------------------------------*/
+void parkWorker(int rawID) {
+	char message[50];
+	sprintf(message, "Thread %d][Parked", rawID + 1);
+	recipeLog(3, "Workers", "Park", "Thread", message);
+
+	pthread_mutex_lock(&workerLock);
+	while (rawID >= _activeWorkers && !askedToShutdown()) {
+		struct timespec deadline;
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_sec += WORKER_PARK_CHECK_SECS;
+		pthread_cond_timedwait(&workerResumeCond, &workerLock, &deadline);
+	}
+	pthread_mutex_unlock(&workerLock);
+
+	if (!askedToShutdown()) {
+		sprintf(message, "Thread %d][Resumed", rawID + 1);
+		recipeLog(3, "Workers", "Park", "Thread", message);
+	}
+}
+
+static time_t configModifiedTime() {
+	struct stat info;
+	return stat("config.txt", &info) == 0 ? info.st_mtime : 0;
+}
+
+static void reloadWorkerCount() {
+	int workerCount;
+	if (!rereadConfigInt("workerCount", &workerCount)) {
+		recipeLog(2, "Workers", "Scale", "Error", "Could not read workerCount from config.txt. Keeping the current number of search threads.");
+		return;
+	}
+	setActiveWorkerCount(workerCount);
+}
+
+static void *workerManagerMain(void *unused) {
+	time_t lastModified = configModifiedTime();
+	pthread_mutex_lock(&managerLock);
+	while (!managerStopping) {
+		struct timespec deadline;
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_sec += WORKER_MANAGER_POLL_SECS;
+		pthread_cond_timedwait(&managerCond, &managerLock, &deadline);
+		if (managerStopping) {
+			break;
+		}
+		pthread_mutex_unlock(&managerLock);
+
+		const time_t modified = configModifiedTime();
+		if (reloadRequested || modified != lastModified) {
+			reloadRequested = 0;
+			lastModified = modified;
+			reloadWorkerCount();
+		}
+
+		pthread_mutex_lock(&managerLock);
+	}
+	pthread_mutex_unlock(&managerLock);
+	return NULL;
+}
+
+void startWorkerManager() {
+	if (workerPoolSize <= 1) {
+		return;
+	}
+	managerStopping = false;
+	if (pthread_create(&managerThread, NULL, workerManagerMain, NULL) != 0) {
+		recipeLog(1, "Workers", "Scale", "Error", "Unable to start the worker manager thread. The number of search threads can't change until restarted.");
+		return;
+	}
+	managerThreadStarted = true;
+}
+
+void stopWorkerManager() {
+	if (!managerThreadStarted) {
+		return;
+	}
+	pthread_mutex_lock(&managerLock);
+	managerStopping = true;
+	pthread_cond_signal(&managerCond);
+	pthread_mutex_unlock(&managerLock);
+	pthread_join(managerThread, NULL);
+	managerThreadStarted = false;
+}
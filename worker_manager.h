@@ -0,0 +1,42 @@
+#ifndef CIPES_WORKER_MANAGER_H
+#define CIPES_WORKER_MANAGER_H
+
+#include <stdbool.h>
+#include "absl/base/optimization.h"
+#include "absl/base/port.h"
+
+// The search runs a fixed pool of threads, but only the first activeWorkers of them search.
+// The rest park between dives, so the number of searching threads can change while running
+// without throwing away any dive in progress.
+// workerCount is re-read from config.txt whenever the file changes, or on SIGHUP.
+
+#define WORKER_MANAGER_POLL_SECS 2	// How often config.txt is checked for changes
+#define WORKER_PARK_CHECK_SECS 1	// How often parked threads check for a shutdown
+
+// Only written with the worker lock held. Threads at or above it park at their next dive.
+extern int _activeWorkers;
+
+// Plan for poolSize threads, of which activeWorkers search to begin with.
+void initWorkerManager(int poolSize, int activeWorkers);
+// Start the thread which watches config.txt. Does nothing if the pool can't change size.
+void startWorkerManager();
+void stopWorkerManager();
+int getWorkerPoolSize();
+int getActiveWorkerCount();
+// Clamped to between 1 and the pool size.
+void setActiveWorkerCount(int count);
+// Re-read workerCount at the next poll. Safe to call from a signal handler.
+void requestWorkerCountReload();
+
+ABSL_ATTRIBUTE_ALWAYS_INLINE inline bool shouldParkWorker(int rawID) {
+	int active;
+	#pragma omp atomic read
+	active = _activeWorkers;
+	return ABSL_PREDICT_FALSE(rawID >= active);
+}
+
+// Block the calling search thread until it is one of the active workers again,
+// or a shutdown is asked for.
+void parkWorker(int rawID);
+
+#endif